@@ -621,6 +621,44 @@ void get_query(
     std::random_shuffle(query.begin(), query.end());
 }
 
+// exchange strategy for the dsc batched robinhood maps, from --overlap.  empty keeps the compile time choice.
+static std::string overlap_mode_str;
+
+template <typename MapType>
+auto set_overlap(MapType & map, int) -> decltype(map.calibrate_overlap(), void()) {
+    using mode = ::khmxx::incremental::overlap_mode;
+    if (overlap_mode_str == "none") map.set_overlap_mode(mode::none);
+    else if (overlap_mode_str == "pairwise") map.set_overlap_mode(mode::pairwise);
+    else if (overlap_mode_str == "batch") map.set_overlap_mode(mode::batch);
+    else if (overlap_mode_str == "fullbuffer") map.set_overlap_mode(mode::fullbuffer);
+    else if (overlap_mode_str == "2phase") map.set_overlap_mode(mode::two_phase);
+    else if (overlap_mode_str == "auto") map.set_overlap_mode(mode::automatic);
+    else if (overlap_mode_str == "persistent") map.set_overlap_mode(mode::persistent);
+    else if (overlap_mode_str == "calibrate") map.calibrate_overlap();
+}
+template <typename MapType>
+void set_overlap(MapType &, long) {}
+
+// combine duplicate keys before the exchange, from --stream-combine.  dsc counting maps only.
+static bool stream_combine = false;
+
+template <typename MapType>
+auto set_combine(MapType & map, int) -> decltype(map.set_stream_combine(true), void()) {
+    map.set_stream_combine(stream_combine);
+}
+template <typename MapType>
+void set_combine(MapType &, long) {}
+
+#if defined(SHARED_WINDOW_QUERY)
+// maps with node-shared local tables (dsc batched robinhood maps).  no-op for the rest.
+template <typename MapType>
+auto share_local(MapType & map, int) -> decltype(map.share_local(), void()) {
+    map.share_local();
+}
+template <typename MapType>
+void share_local(MapType &, long) {}
+#endif
+
 template <typename MapType, int pMAP, typename TT>
 void benchmark(std::vector<TT> const & input,
                std::vector<KeyType> const & query,
@@ -653,6 +691,8 @@ void benchmark(std::vector<TT> const & input,
     map.set_insert_lookahead(insert_prefetch);
     map.set_query_lookahead(query_prefetch);
 #endif
+    set_overlap(map, 0);
+    set_combine(map, 0);
     BL_BENCH_END(test, "init", map.local_size());
 
     // debug print total input size.
@@ -677,6 +717,13 @@ void benchmark(std::vector<TT> const & input,
     map.insert(in);
     BL_BENCH_END(test, "insert", map.local_size());
 
+#if defined(SHARED_WINDOW_QUERY)
+    // publish the local tables to the other ranks on the node for the queries below.
+    BL_BENCH_COLLECTIVE_START(test, "share_local", comm);
+    share_local(map, 0);
+    BL_BENCH_END(test, "share_local", map.local_size());
+#endif
+
     // debug print total map size.
     total = map.size();
     if (comm.rank() == 0)
@@ -801,6 +848,19 @@ int main(int argc, char **argv)
         TCLAP::ValueArg<uint32_t> insertPrefetchArg("", "insert_prefetch", "number of elements to prefetch during insert", false, insert_prefetch, "uint32_t", cmd);
         TCLAP::ValueArg<uint32_t> queryPrefetchArg("", "query_prefetch", "number of elements to prefetch during queries", false, query_prefetch, "uint32_t", cmd);
 
+        std::vector<std::string> overlap_modes;
+        overlap_modes.push_back("none");
+        overlap_modes.push_back("pairwise");
+        overlap_modes.push_back("batch");
+        overlap_modes.push_back("fullbuffer");
+        overlap_modes.push_back("2phase");
+        overlap_modes.push_back("auto");
+        overlap_modes.push_back("persistent");
+        overlap_modes.push_back("calibrate");
+        TCLAP::ValuesConstraint<std::string> overlapModeVals(overlap_modes);
+        TCLAP::ValueArg<std::string> overlapModeArg("", "overlap", "communication strategy for batched robinhood maps (default: compile time choice)", false, "", &overlapModeVals, cmd);
+        TCLAP::SwitchArg streamCombineArg("", "stream-combine", "combine duplicate keys before the exchange, in one blocking exchange (counting batched robinhood maps)", cmd, false);
+
 #ifdef VTUNE_ANALYSIS
         std::vector<std::string> measure_modes;
         measure_modes.push_back("insert");
@@ -835,6 +895,8 @@ int main(int argc, char **argv)
         max_load = maxLoadArg.getValue();
         insert_prefetch = insertPrefetchArg.getValue();
         query_prefetch = queryPrefetchArg.getValue();
+        overlap_mode_str = overlapModeArg.getValue();
+        stream_combine = streamCombineArg.getValue();
 
 #ifdef VTUNE_ANALYSIS
         // set the default for query to filename, and reparse
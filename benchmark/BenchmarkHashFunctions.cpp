@@ -28,6 +28,12 @@
 #include <cstdlib>    // std::rand
 #include <sstream>
 #include <exception>
+#include <numeric>    // accumulate
+#include <fstream>
+#include <random>     // mt19937_64, for synthetic skewed input
+#include <cmath>      // sqrt, pow
+#include <cstring>    // memcmp, memcpy
+#include <iomanip>    // setprecision
 
 #include "kmerhash/hash_new.hpp"
 #include "utils/benchmark_utils.hpp"
@@ -324,6 +330,320 @@ BL_BENCH_END(benchmark, "clhash", count);
 }
 
 
+// ================ hash quality.
+// throughput is not the whole story.  in the distributed maps, the distribution hash assigns keys to ranks
+// (h % p, or h & (p-1)), and the storage hash assigns keys to local buckets (h & (buckets - 1)).
+// load imbalance across ranks, long probe sequences in the local table, and correlation between the 2 hash values
+// (e.g. CRC32C used for both, see crc32c_sse.hpp) all slow down the distributed runs more than raw hash speed.
+// the following measures those for a given (distribution hash, storage hash) pair.
+
+/// synthetic input types for the quality benchmark.
+#define QUALITY_INPUT_UNIFORM 0
+#define QUALITY_INPUT_ZIPF 1
+#define QUALITY_INPUT_SEQUENTIAL 2
+#define QUALITY_INPUT_FILE 3
+
+/// generate synthetic input.  uniform: random bytes.  zipf: random distinct keys, repeated with zipf(skew) frequency
+///  sequential: consecutive integers, i.e. low entropy keys with regular bit patterns.
+template <size_t N>
+void generate_quality_input(int input_type, DataStruct<N> * data, size_t count, double skew, size_t distinct) {
+  std::mt19937_64 gen(1234567);
+
+  if (input_type == QUALITY_INPUT_SEQUENTIAL) {
+    for (size_t i = 0; i < count; ++i) {
+      memset(data[i].data, 0, N);
+      memcpy(data[i].data, &i, std::min(N, sizeof(size_t)));
+    }
+    return;
+  }
+
+  // uniform random bytes
+  size_t pool = (input_type == QUALITY_INPUT_ZIPF) ? std::min(count, distinct) : count;
+  for (size_t i = 0; i < pool; ++i) {
+    for (size_t j = 0; j < N; j += sizeof(uint64_t)) {
+      uint64_t r = gen();
+      memcpy(data[i].data + j, &r, std::min(N - j, sizeof(uint64_t)));
+    }
+  }
+  if (input_type != QUALITY_INPUT_ZIPF) return;
+
+  // zipf: rank i (1-based) has frequency proportional to 1/i^skew.  sample via cdf and binary search.
+  std::vector<double> cdf(pool);
+  double sum = 0.0;
+  for (size_t i = 0; i < pool; ++i) {
+    sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+    cdf[i] = sum;
+  }
+  std::uniform_real_distribution<double> dist(0.0, sum);
+  // fill from the back, so that the distinct pool at the front is read before being overwritten.
+  for (size_t i = count; i > pool; --i) {
+    size_t id = std::lower_bound(cdf.begin(), cdf.end(), dist(gen)) - cdf.begin();
+    data[i-1] = data[std::min(id, pool - 1)];
+  }
+}
+
+/// size of the records in a file created by serialize/serialize_vector.  0 if it can not be read.
+inline size_t quality_record_size(std::string const & filename) {
+  std::ifstream fin(filename, std::ios::in | std::ios::binary);
+  size_t el_size = 0;
+  if (!fin.good() || !fin.read(reinterpret_cast<char *>(&el_size), sizeof(size_t))) return 0;
+  return el_size;
+}
+
+/// true if N-byte keys can be taken from records whose keys are key_bytes long.  reports the size as skipped otherwise.
+///  wider keys would include the value bytes of (kmer, value) records.
+inline bool quality_key_fits(size_t const & n, size_t const & key_bytes) {
+  if (n <= key_bytes) return true;
+  std::cout << "quality: skipping " << n << "-byte keys, the input keys are " << key_bytes << " bytes" << std::endl;
+  return false;
+}
+
+/// load keys from a file created by serialize/serialize_vector (e.g. DUMP_DISTRIBUTED_INPUT from the index benchmarks).
+///  each record may be a (kmer, value) pair, so only the first N bytes of each record are used as key.  N should not
+///  exceed the key part of the record, see quality_key_fits.
+template <size_t N>
+size_t load_quality_input(std::string const & filename, DataStruct<N> * data, size_t count) {
+  // same layout as serialize(): element size, element count, then the elements.
+  std::ifstream fin(filename, std::ios::in | std::ios::binary);
+  if (!fin.good()) throw std::invalid_argument("unable to open input file");
+
+  size_t el_size = 0, n_el = 0;
+  fin.read(reinterpret_cast<char *>(&el_size), sizeof(size_t));
+  fin.read(reinterpret_cast<char *>(&n_el), sizeof(size_t));
+  if (el_size < N) throw std::invalid_argument("input record is smaller than the requested key size");
+
+  n_el = std::min(n_el, count);
+  std::vector<char> rec(el_size);
+  size_t i = 0;
+  for (; (i < n_el) && fin.read(rec.data(), el_size); ++i) {
+    memcpy(data[i].data, rec.data(), N);
+  }
+  fin.close();
+  n_el = i;
+  return n_el;
+}
+
+
+/// compare DataStruct for sort/unique.
+template <size_t N>
+struct DataStructLess {
+  DataStruct<N> const * data;
+  inline bool operator()(size_t const & x, size_t const & y) const {
+    return memcmp(data[x].data, data[y].data, N) < 0;
+  }
+};
+template <size_t N>
+struct DataStructEqual {
+  DataStruct<N> const * data;
+  inline bool operator()(size_t const & x, size_t const & y) const {
+    return memcmp(data[x].data, data[y].data, N) == 0;
+  }
+};
+
+/// print min, max, and coefficient of variation, normalized by the mean.
+inline void print_imbalance(std::string const & label, std::vector<size_t> const & counts) {
+  size_t total = std::accumulate(counts.begin(), counts.end(), static_cast<size_t>(0));
+  double mean = static_cast<double>(total) / static_cast<double>(counts.size());
+  double var = 0.0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    var += (static_cast<double>(counts[i]) - mean) * (static_cast<double>(counts[i]) - mean);
+  }
+  var /= static_cast<double>(counts.size());
+  std::cout << "  " << label << ": total " << total <<
+      " min/mean " << (static_cast<double>(*std::min_element(counts.begin(), counts.end())) / mean) <<
+      " max/mean " << (static_cast<double>(*std::max_element(counts.begin(), counts.end())) / mean) <<
+      " cv " << (std::sqrt(var) / mean) << std::endl;
+}
+
+/**
+ * @brief measure the quality of a (distribution hash, storage hash) pair
+ * @details  reports
+ *   1. per-rank load imbalance, for all tuples (communication volume) and for distinct keys (table size)
+ *   2. probe length distribution of a simulated robinhood table (load factor 0.8, same as the local container)
+ *      built with the distinct keys on the most loaded rank
+ *   3. correlation between the distribution hash bits used for rank assignment and the storage hash bits used
+ *      for bucket assignment:  max |phi| over all bit pairs, and the chi-squared of bucket occupancy within the most loaded rank.
+ *      if the 2 are correlated, the keys on a rank occupy a subset of buckets, producing long probes.
+ *   seeds are the same as the distributed maps':  9876543 for distribution, default for storage.
+ */
+template <size_t N, template <typename> class DistHash, template <typename> class StoreHash>
+void hash_quality(std::string const & name, DataStruct<N> const * data, size_t count,
+                  std::vector<size_t> const & unique_ids, size_t ranks) {
+  using DH = ::fsc::hash::TransformedHash<DataStruct<N>, DistHash, ::bliss::transform::identity, ::bliss::transform::identity>;
+  using SH = ::fsc::hash::TransformedHash<DataStruct<N>, StoreHash, ::bliss::transform::identity, ::bliss::transform::identity>;
+  using DHV = typename DH::result_type;
+  using SHV = typename SH::result_type;
+
+  DH dist_hash(DistHash<DataStruct<N> >(9876543));
+  SH store_hash;
+
+  bool is_pow2 = (ranks & (ranks - 1)) == 0;
+  std::cout << "quality " << name << " for " << count << " " << size_t(N) << "-byte elements, " <<
+      unique_ids.size() << " distinct, " << ranks << " ranks" << std::endl;
+
+  // ---- rank assignment, for all tuples.
+  std::vector<DHV> dhashes(count);
+  dist_hash(data, count, dhashes.data());
+
+  std::vector<size_t> rank_counts(ranks, 0);
+  for (size_t i = 0; i < count; ++i) {
+    ++rank_counts[is_pow2 ? (dhashes[i] & (ranks - 1)) : (dhashes[i] % ranks)];
+  }
+  print_imbalance("tuples/rank", rank_counts);
+
+  // ---- rank assignment, distinct keys.
+  std::vector<size_t> unique_counts(ranks, 0);
+  std::vector<uint32_t> unique_ranks(unique_ids.size());
+  for (size_t i = 0; i < unique_ids.size(); ++i) {
+    unique_ranks[i] = is_pow2 ? (dhashes[unique_ids[i]] & (ranks - 1)) : (dhashes[unique_ids[i]] % ranks);
+    ++unique_counts[unique_ranks[i]];
+  }
+  print_imbalance("distinct/rank", unique_counts);
+  size_t hot_rank = std::max_element(unique_counts.begin(), unique_counts.end()) - unique_counts.begin();
+  size_t hot_count = unique_counts[hot_rank];
+
+  // ---- storage hash for distinct keys.
+  std::vector<SHV> shashes(count);
+  store_hash(data, count, shashes.data());
+
+  // table size as the local container would choose it for the most loaded rank.
+  size_t buckets = 1;
+  while (static_cast<double>(buckets) * 0.8 < static_cast<double>(hot_count)) buckets <<= 1;
+  size_t mask = buckets - 1;
+  uint8_t bucket_bits = 0;
+  while ((1ULL << bucket_bits) < buckets) ++bucket_bits;
+
+  // ---- probe length via simulated robinhood insertion (circular, dist -1 is empty)
+  std::vector<int32_t> probe(buckets, -1);
+  for (size_t i = 0; i < unique_ids.size(); ++i) {
+    if (unique_ranks[i] != hot_rank) continue;
+
+    size_t pos = shashes[unique_ids[i]] & mask;
+    int32_t d = 0;
+    while (probe[pos] >= 0) {
+      if (probe[pos] < d) std::swap(probe[pos], d);   // robinhood: rich gives to poor.
+      pos = (pos + 1) & mask;
+      ++d;
+    }
+    probe[pos] = d;
+  }
+  constexpr size_t max_hist = 16;
+  std::vector<size_t> probe_hist(max_hist + 1, 0);
+  size_t probe_sum = 0;
+  int32_t probe_max = 0;
+  for (size_t i = 0; i < buckets; ++i) {
+    if (probe[i] < 0) continue;
+    ++probe_hist[std::min(static_cast<size_t>(probe[i]), max_hist)];
+    probe_sum += probe[i];
+    probe_max = std::max(probe_max, probe[i]);
+  }
+  std::cout << "  probe distance on rank " << hot_rank << " (" << hot_count << " in " << buckets << " buckets): mean " <<
+      (hot_count == 0 ? 0.0 : static_cast<double>(probe_sum) / static_cast<double>(hot_count)) << " max " << probe_max << " histogram";
+  for (size_t i = 0; i <= max_hist; ++i) {
+    std::cout << " " << probe_hist[i];
+  }
+  std::cout << std::endl;
+
+  // ---- chi-squared of bucket occupancy on the most loaded rank.  use at most 2^16 cells so each has enough entries.
+  uint8_t cell_bits = std::min(bucket_bits, static_cast<uint8_t>(16));
+  while ((cell_bits > 0) && ((hot_count >> cell_bits) < 8)) --cell_bits;
+  size_t cells = 1ULL << cell_bits;
+  std::vector<size_t> occupancy(cells, 0);
+  for (size_t i = 0; i < unique_ids.size(); ++i) {
+    if (unique_ranks[i] == hot_rank) ++occupancy[shashes[unique_ids[i]] & (cells - 1)];
+  }
+  double expected = static_cast<double>(hot_count) / static_cast<double>(cells);
+  double chi2 = 0.0;
+  for (size_t i = 0; i < cells; ++i) {
+    chi2 += (static_cast<double>(occupancy[i]) - expected) * (static_cast<double>(occupancy[i]) - expected) / expected;
+  }
+
+  // ---- bit correlation (phi coefficient) between rank bits of distribution hash and bucket bits of storage hash.
+  uint8_t rank_bits = 0;
+  while ((1ULL << rank_bits) < ranks) ++rank_bits;
+  uint8_t store_bits = std::min(bucket_bits, static_cast<uint8_t>(sizeof(SHV) * 8));
+  std::vector<size_t> n1r(rank_bits, 0), n1s(store_bits, 0), n11(rank_bits * store_bits, 0);
+  DHV dh;
+  SHV sh;
+  for (size_t i = 0; i < unique_ids.size(); ++i) {
+    dh = dhashes[unique_ids[i]];
+    sh = shashes[unique_ids[i]];
+    for (uint8_t s = 0; s < store_bits; ++s) {
+      n1s[s] += (sh >> s) & 1;
+    }
+    for (uint8_t r = 0; r < rank_bits; ++r) {
+      if (((dh >> r) & 1) == 0) continue;
+      ++n1r[r];
+      for (uint8_t s = 0; s < store_bits; ++s) {
+        n11[r * store_bits + s] += (sh >> s) & 1;
+      }
+    }
+  }
+  double n = static_cast<double>(unique_ids.size());
+  double max_phi = 0.0, phi, denom;
+  for (uint8_t r = 0; r < rank_bits; ++r) {
+    for (uint8_t s = 0; s < store_bits; ++s) {
+      denom = static_cast<double>(n1r[r]) * (n - static_cast<double>(n1r[r])) *
+          static_cast<double>(n1s[s]) * (n - static_cast<double>(n1s[s]));
+      if (denom <= 0.0) continue;
+      phi = (static_cast<double>(n11[r * store_bits + s]) * n - static_cast<double>(n1r[r]) * static_cast<double>(n1s[s])) / std::sqrt(denom);
+      max_phi = std::max(max_phi, std::abs(phi));
+    }
+  }
+  std::cout << "  correlation: bucket chi2/dof " << (cells > 1 ? chi2 / static_cast<double>(cells - 1) : 0.0) <<
+      " (ideal ~1) over " << cells << " cells, max |phi| " << max_phi <<
+      " for " << static_cast<size_t>(rank_bits) << " rank bits x " << static_cast<size_t>(store_bits) << " bucket bits (noise ~" <<
+      (n > 0 ? 1.0 / std::sqrt(n) : 0.0) << ")" << std::endl;
+}
+
+
+/// run the quality benchmark for the distribution hash, paired with itself and with each of the storage hashes used by the maps.
+template <size_t N, template <typename> class DistHash>
+void hash_quality_pairs(std::string const & name, DataStruct<N> const * data, size_t count,
+                        std::vector<size_t> const & unique_ids, size_t ranks) {
+  hash_quality<N, DistHash, DistHash>(name + " / " + name, data, count, unique_ids, ranks);
+#if defined(__SSE4_2__)
+  hash_quality<N, DistHash, ::fsc::hash::crc32c>(name + " / crc32c", data, count, unique_ids, ranks);
+#endif
+#if defined(__AVX2__)
+  hash_quality<N, DistHash, ::fsc::hash::murmur3avx32>(name + " / murmur32avx", data, count, unique_ids, ranks);
+#endif
+}
+
+template <size_t N>
+void quality_benchmarks(size_t count, unsigned char* in, size_t ranks, int input_type, double skew, size_t distinct,
+                        std::string const & filename) {
+  DataStruct<N>* data = reinterpret_cast<DataStruct<N>*>(in);
+
+  if (input_type == QUALITY_INPUT_FILE) {
+    count = load_quality_input(filename, data, count);
+  } else {
+    generate_quality_input(input_type, data, count, skew, distinct);
+  }
+
+  // distinct keys, as indices into data.
+  std::vector<size_t> unique_ids(count);
+  for (size_t i = 0; i < count; ++i) unique_ids[i] = i;
+  DataStructLess<N> lt{data};
+  DataStructEqual<N> eq{data};
+  std::sort(unique_ids.begin(), unique_ids.end(), lt);
+  unique_ids.erase(std::unique(unique_ids.begin(), unique_ids.end(), eq), unique_ids.end());
+
+  hash_quality_pairs<N, ::fsc::hash::identity>("iden", data, count, unique_ids, ranks);
+  hash_quality_pairs<N, ::fsc::hash::farm>("farm", data, count, unique_ids, ranks);
+  hash_quality_pairs<N, ::fsc::hash::murmur>("murmur", data, count, unique_ids, ranks);
+  hash_quality_pairs<N, ::fsc::hash::murmur32>("murmur32", data, count, unique_ids, ranks);
+#if defined(__SSE4_2__)
+  hash_quality_pairs<N, ::fsc::hash::crc32c>("crc32c", data, count, unique_ids, ranks);
+#endif
+#if defined(__AVX2__)
+  hash_quality_pairs<N, ::fsc::hash::murmur3avx32>("murmur32avx", data, count, unique_ids, ranks);
+  hash_quality_pairs<N, ::fsc::hash::murmur3avx64>("murmur64avx", data, count, unique_ids, ranks);
+  hash_quality_pairs<N, ::fsc::hash::clhash>("clhash", data, count, unique_ids, ranks);
+#endif
+}
+
+
 int main(int argc, char** argv) {
 
 #ifdef VTUNE_ANALYSIS
@@ -333,6 +653,14 @@ int main(int argc, char** argv) {
       size_t count = 100000000;
       size_t el_size = 0;
 
+      bool quality = false;
+      size_t ranks = 512;
+      int input_type = QUALITY_INPUT_UNIFORM;
+      double skew = 1.0;
+      size_t distinct = 1000000;
+      std::string filename;
+      size_t key_bytes = 0;
+
       try {
 
         // Define the command line object, and insert a message
@@ -350,6 +678,20 @@ int main(int argc, char** argv) {
         TCLAP::ValueArg<size_t> countArg("c","count","number of elements to hash", false, count, "size_t", cmd);
         TCLAP::ValueArg<size_t> elSizeArg("e","el_size","size of elements in bytes. 0 to run all", false, el_size, "size_t", cmd);
 
+        // hash quality (distribution) mode
+        TCLAP::SwitchArg qualityArg("q", "quality", "measure rank load imbalance, probe lengths, and hash correlation instead of throughput", cmd, false);
+        TCLAP::ValueArg<size_t> ranksArg("p","ranks","number of ranks to partition into, for quality mode", false, ranks, "size_t", cmd);
+        std::vector<std::string> input_types;
+        input_types.push_back("uniform");
+        input_types.push_back("zipf");
+        input_types.push_back("sequential");
+        TCLAP::ValuesConstraint<std::string> inputTypeVals( input_types );
+        TCLAP::ValueArg<std::string> inputTypeArg("i","input","synthetic input for quality mode (default uniform)", false, "uniform", &inputTypeVals, cmd);
+        TCLAP::ValueArg<double> skewArg("s","skew","zipf exponent for the zipf input", false, skew, "double", cmd);
+        TCLAP::ValueArg<size_t> distinctArg("d","distinct","number of distinct keys for the zipf input", false, distinct, "size_t", cmd);
+        TCLAP::ValueArg<std::string> fileArg("f","file","serialized k-mer file (e.g. from dumpKIndex) for quality mode.  overrides --input", false, "", "string", cmd);
+        TCLAP::ValueArg<size_t> keyBytesArg("k","key_bytes","bytes at the start of each file record that are the key, e.g. 8 for k <= 31 kmers with counts.  default whole record", false, key_bytes, "size_t", cmd);
+
     #ifdef VTUNE_ANALYSIS
         std::vector<std::string> measure_modes;
         measure_modes.push_back("farm");
@@ -372,6 +714,27 @@ int main(int argc, char** argv) {
         el_size = elSizeArg.getValue();
         std::cout << "Executing for " << el_size << " element size. 0 means all" << std::endl;
 
+        quality = qualityArg.getValue();
+        ranks = ranksArg.getValue();
+        if (ranks == 0) throw TCLAP::ArgException("ranks should be positive", "ranks");
+        skew = skewArg.getValue();
+        distinct = distinctArg.getValue();
+        filename = fileArg.getValue();
+        if (filename.length() > 0) {
+          input_type = QUALITY_INPUT_FILE;
+          size_t record_size = quality_record_size(filename);
+          if (record_size == 0) throw TCLAP::ArgException("unable to read input file", "file");
+          key_bytes = keyBytesArg.getValue();
+          if (key_bytes == 0) key_bytes = record_size;
+          if (key_bytes > record_size) throw TCLAP::ArgException("key_bytes is larger than the file records", "key_bytes");
+        } else if (inputTypeArg.getValue() == "zipf") {
+          input_type = QUALITY_INPUT_ZIPF;
+        } else if (inputTypeArg.getValue() == "sequential") {
+          input_type = QUALITY_INPUT_SEQUENTIAL;
+        } else {
+          input_type = QUALITY_INPUT_UNIFORM;
+        }
+
     #ifdef VTUNE_ANALYSIS
         // set the default for query to filename, and reparse
         std::string measure_mode_str = measureModeArg.getValue();
@@ -425,6 +788,20 @@ unsigned int* hashes = (unsigned int*) malloc(count * sizeof(size_t));
   }
 
 
+  if (quality) {
+    // k-mers of k <= 31 fit in 8 bytes, k <= 63 in 16 bytes.
+    // synthetic keys have any size.  file keys are only narrowed.
+    size_t max_key = (input_type == QUALITY_INPUT_FILE) ? key_bytes : 64;
+    if (((el_size == 0) || (el_size ==   8)) && quality_key_fits( 8, max_key)) quality_benchmarks<  8>(count, data, ranks, input_type, skew, distinct, filename);
+    if (((el_size == 0) || (el_size ==  16)) && quality_key_fits(16, max_key)) quality_benchmarks< 16>(count, data, ranks, input_type, skew, distinct, filename);
+    if (((el_size == 0) || (el_size ==  32)) && quality_key_fits(32, max_key)) quality_benchmarks< 32>(count, data, ranks, input_type, skew, distinct, filename);
+    if (((el_size == 0) || (el_size ==  64)) && quality_key_fits(64, max_key)) quality_benchmarks< 64>(count, data, ranks, input_type, skew, distinct, filename);
+
+    free(data);
+    free(hashes);
+    return 0;
+  }
+
   if ((el_size == 0) || (el_size ==   1)) benchmarks<  1>(count, data, hashes);
   if ((el_size == 0) || (el_size ==   2)) benchmarks<  2>(count, data, hashes);
   if ((el_size == 0) || (el_size ==   4)) benchmarks<  4>(count, data, hashes);
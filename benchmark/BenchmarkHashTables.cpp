@@ -177,6 +177,12 @@ struct equal_to {
     }
 };
 
+namespace fsc {
+  // plain operator==, so the hash tables can compare 2 and 4 word kmers with simd.
+  template <typename T>
+  struct is_bitwise_equal<::equal_to<T> > : public ::std::true_type {};
+}
+
 
 template <typename Kmer, typename Value>
 void generate_input(std::vector<::std::pair<Kmer, Value> > & output,
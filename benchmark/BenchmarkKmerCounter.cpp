@@ -158,6 +158,7 @@ static int measure_mode = MEASURE_DISABLED;
 #define RADIXSORT 50
 #define MTROBINHOOD 51
 #define MTRADIXSORT 52
+#define DIRECT 53
 
 #define SINGLE 61
 #define CANONICAL 62
@@ -239,7 +240,7 @@ using KmerType = bliss::common::Kmer<31, Alphabet, uint64_t>;
 
 
 	// distribution hash
-	#if (pMAP == MTRADIXSORT) || (pMAP == RADIXSORT) || (pMAP == MTROBINHOOD) || (pMAP == BROBINHOOD)
+	#if (pMAP == MTRADIXSORT) || (pMAP == RADIXSORT) || (pMAP == MTROBINHOOD) || (pMAP == BROBINHOOD) || (pMAP == DIRECT)
 	#if (pDistHash == IDEN)
 		template <typename KM>
 	//	using DistHash = bliss::kmer::hash::identity<KM, true>;
@@ -296,7 +297,7 @@ using KmerType = bliss::common::Kmer<31, Alphabet, uint64_t>;
 	#endif
 
 	// storage hash type
-	#if (pMAP == MTRADIXSORT) || (pMAP == RADIXSORT) || (pMAP == MTROBINHOOD) || (pMAP == BROBINHOOD)
+	#if (pMAP == MTRADIXSORT) || (pMAP == RADIXSORT) || (pMAP == MTROBINHOOD) || (pMAP == BROBINHOOD) || (pMAP == DIRECT)
 	#if (pStoreHash == IDEN)
 		template <typename KM>
 	//	using StoreHash = bliss::kmer::hash::identity<KM, false>;
@@ -478,6 +479,9 @@ using KmerType = bliss::common::Kmer<31, Alphabet, uint64_t>;
 #elif (pMAP == RADIXSORT)
   using MapType = ::dsc::counting_batched_radixsort_map<
       KmerType, ValType, MapParams>;
+#elif (pMAP == DIRECT)
+  using MapType = ::dsc::counting_direct_address_map<
+      KmerType, ValType, MapParams>;
 #elif (pMAP == UNORDERED)
   using MapType = ::dsc::counting_unordered_map<
     KmerType, ValType, MapParams>;
@@ -1517,7 +1521,7 @@ int main(int argc, char** argv) {
         kmer_est = static_cast<size_t>(static_cast<float>(file_size) / chars_per_kmer);
 
         // estimate free memory usage.
-#if (pMAP == BROBINHOOD) || (pMAP == MTROBINHOOD) || (pMAP == RADIXSORT) || (pMAP == MTRADIXSORT)
+#if (pMAP == BROBINHOOD) || (pMAP == MTROBINHOOD) || (pMAP == RADIXSORT) || (pMAP == MTRADIXSORT) || (pMAP == DIRECT)
         mem_use_est += kmer_est * 5UL * sizeof(typename IndexType::KmerParserType::value_type) +
             file_size * 2UL;
 #else
@@ -1611,7 +1615,7 @@ int main(int argc, char** argv) {
 //	    	idx.get_map().local_reserve(avg_distinct_count + delta_distinct);
 	    // do nothing, since on insertion we reserve.
 	    if (comm.rank() == 0) std::cout << " buckets " << idx.get_map().local_capacity() << std::endl;
-#elif (pMAP == BROBINHOOD) || (pMAP == MTROBINHOOD)
+#elif (pMAP == BROBINHOOD) || (pMAP == MTROBINHOOD) || (pMAP == DIRECT)
 
 #else
 	    if ((idx.get_map().local_capacity() * idx.get_map().get_local_container().get_max_load_factor()) < (avg_distinct_count + delta_distinct))
@@ -1700,10 +1704,16 @@ int main(int argc, char** argv) {
       // don't estimate...
       //idx.get_map().insert_no_finalize<false>(temp);  // should be insert_no_finalize but just to be safe don't do it right now...
       idx.get_map().insert_no_finalize<true>(temp);  // should be insert_no_finalize but just to be safe don't do it right now...
-#elif (pMAP == BROBINHOOD)  || (pMAP == MTROBINHOOD)
+#elif (pMAP == BROBINHOOD)  || (pMAP == MTROBINHOOD) || (pMAP == DIRECT)
       // don't estimate...
 	    //idx.get_map().insert<false>(temp);
+#if defined(PIPELINED_INSERT) && (pMAP != MTROBINHOOD)
+	    // exchange of this batch overlaps with reading the next files.  flush after the last one.
+	    idx.get_map().insert_submit<true>(temp);
+	    if (i >= filenames.size()) idx.get_map().insert_wait<true>();
+#else
 	    idx.get_map().insert<true>(temp);
+#endif
 #else
 	    idx.insert(temp);
 #endif
@@ -564,7 +564,15 @@ int main(int argc, char** argv) {
 
   //////////////// initialize MPI and openMP
 
+#if defined(MT_ENDPOINTS)
+  // the hybrid maps communicate from all threads only with MPI_THREAD_MULTIPLE, which mxx::env does not request.
+  // finalized after comm goes out of scope.
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  struct mpi_finalizer { ~mpi_finalizer() { MPI_Finalize(); } } finalizer;
+#else
   mxx::env e(argc, argv);
+#endif
   mxx::comm comm;
 
   if (comm.rank() == 0) printf("EXECUTING %s\n", argv[0]);
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * blocked_bloom_filter.hpp
+ *
+ * cache blocked Bloom filter (Putze et al. 2007).  all bits of a key are set in one 64 byte block, so a test is
+ * one cache miss.  the false positive rate is a little higher than a standard Bloom filter of the same size.
+ *
+ * the filter takes 64 bit hash values, and remixes them, so the hash used for rank assignment can be reused.
+ * two filters of the same size are combined by OR-ing their words, e.g. in an allreduce.
+ */
+
+#ifndef KMERHASH_BLOCKED_BLOOM_FILTER_HPP_
+#define KMERHASH_BLOCKED_BLOOM_FILTER_HPP_
+
+#include <vector>
+#include <cstdint>  // uint64_t
+#include <cmath>  // log
+
+namespace fsc {
+
+class blocked_bloom_filter {
+
+public:
+	static constexpr size_t block_words = 8;   // 512 bits, one cacheline.
+
+protected:
+	static constexpr size_t block_bits = block_words * 64;
+
+	std::vector<uint64_t> words;
+	size_t num_blocks;
+	unsigned int num_probes;
+
+	/// murmur3 64 bit finalizer.
+	static inline uint64_t mix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	/// block from the high 32 bits, by multiply-shift instead of modulus.
+	inline uint64_t * block_of(uint64_t const & h) const {
+		return const_cast<uint64_t *>(words.data()) + ((h >> 32) * num_blocks >> 32) * block_words;
+	}
+
+public:
+	blocked_bloom_filter() : num_blocks(0), num_probes(0) {}
+
+	/// size for count keys at bits_per_key.  the number of probes is the optimum for that density.
+	blocked_bloom_filter(size_t const & count, double const & bits_per_key) : num_blocks(0), num_probes(0) {
+		resize(count, bits_per_key);
+	}
+
+	/// clear and resize.
+	void resize(size_t const & count, double const & bits_per_key) {
+		num_blocks = (static_cast<size_t>(static_cast<double>(count) * bits_per_key) + block_bits - 1) / block_bits;
+		if (num_blocks == 0) num_blocks = 1;
+		if (num_blocks > (1ULL << 32)) num_blocks = (1ULL << 32);
+		num_probes = static_cast<unsigned int>(bits_per_key * std::log(2.0) + 0.5);
+		if (num_probes < 1) num_probes = 1;
+		if (num_probes > 16) num_probes = 16;
+		words.assign(num_blocks * block_words, 0);
+	}
+
+	/// drop all storage.  an empty filter is not active.
+	void reset() {
+		std::vector<uint64_t>().swap(words);
+		num_blocks = 0;
+		num_probes = 0;
+	}
+
+	inline bool active() const { return num_blocks > 0; }
+
+	inline void insert(uint64_t h) {
+		h = mix(h);
+		uint64_t * block = block_of(h);
+		uint64_t bits = h;
+		for (unsigned int i = 0; i < num_probes; ++i) {
+			if ((i % 7) == 0) bits = mix(bits + i);   // 9 bits per probe.
+			block[(bits & (block_bits - 1)) >> 6] |= 1ULL << (bits & 63);
+			bits >>= 9;
+		}
+	}
+
+	/// false if the key was definitely not inserted.
+	inline bool contains(uint64_t h) const {
+		h = mix(h);
+		uint64_t const * block = block_of(h);
+		uint64_t bits = h;
+		for (unsigned int i = 0; i < num_probes; ++i) {
+			if ((i % 7) == 0) bits = mix(bits + i);
+			if ((block[(bits & (block_bits - 1)) >> 6] & (1ULL << (bits & 63))) == 0) return false;
+			bits >>= 9;
+		}
+		return true;
+	}
+
+	/// raw words, for combining filters.
+	inline uint64_t * data() { return words.data(); }
+	inline uint64_t const * data() const { return words.data(); }
+	inline size_t word_count() const { return words.size(); }
+
+	inline size_t probes() const { return num_probes; }
+	inline size_t size_in_bytes() const { return words.size() * sizeof(uint64_t); }
+};
+
+}  // namespace fsc
+
+#endif /* KMERHASH_BLOCKED_BLOOM_FILTER_HPP_ */
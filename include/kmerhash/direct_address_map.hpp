@@ -0,0 +1,628 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * direct_address_map.hpp
+ *
+ * direct-indexed counting table for small key spaces, e.g. k-mers with k <= 14 (4^k <= 2^28 counters).
+ * the key bits are the array index, so there is no hashing, no probing, and no key storage.
+ * presence is count != 0.
+ *
+ * satisfies the local Container interface used by dsc::batched_robinhood_map_base, so it can be dropped in
+ * as the local container of a counting map.  the hash and equal template parameters are accepted but unused.
+ *
+ * memory is (1 << key bits) * sizeof(T) regardless of the number of distinct keys, so this is only worthwhile
+ * when the key space is small or densely populated.  as the local container of a distributed map, EVERY rank
+ * allocates the full table, not 1/p of it: with 32 bit counts that is 4^k * 4 bytes per rank, i.e. 1 GiB at k = 14,
+ * 64 MiB at k = 12.  size k (and the number of ranks per node) accordingly.
+ *
+ * insertion with more than one openmp thread uses atomic adds on the counters.
+ */
+
+#ifndef KMERHASH_DIRECT_ADDRESS_MAP_HPP_
+#define KMERHASH_DIRECT_ADDRESS_MAP_HPP_
+
+#include <vector>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <cstring>  // memset, memcpy
+#include <functional>  // std::plus
+
+#include "containers/fsc_container_utils.hpp"
+#include "utils/filter_utils.hpp"
+#include "kmerhash/mem_utils.hpp"
+
+#if defined(_OPENMP)
+#include "omp.h"
+#endif
+
+namespace fsc {
+
+/// maps a key to and from its array index.  integral keys use their value.
+template <typename Key, typename = void>
+struct direct_address_traits;
+
+template <typename Key>
+struct direct_address_traits<Key, typename ::std::enable_if<::std::is_integral<Key>::value>::type> {
+	static constexpr unsigned int bits = sizeof(Key) * 8U;
+
+	static inline size_t index(Key const & k) {
+		return static_cast<size_t>(static_cast<typename ::std::make_unsigned<Key>::type>(k));
+	}
+	static inline Key key(size_t const & i) {
+		return static_cast<Key>(i);
+	}
+};
+
+/// k-mers: single word, index is the packed bits.
+template <typename Key>
+struct direct_address_traits<Key, typename ::std::enable_if<(Key::nBits > 0)>::type> {
+	static_assert(Key::nWords == 1, "direct address table requires single word kmers.");
+	static constexpr unsigned int bits = Key::nBits;
+
+	static inline size_t index(Key const & k) {
+		return static_cast<size_t>(k.getData()[0]);
+	}
+	static inline Key key(size_t const & i) {
+		Key k;
+		typename Key::KmerWordType w = static_cast<typename Key::KmerWordType>(i);
+		memset(reinterpret_cast<void*>(&k), 0, sizeof(Key));
+		memcpy(reinterpret_cast<void*>(&k), &w, sizeof(w));
+		return k;
+	}
+};
+
+
+/**
+ * @brief direct address counting table.
+ * @tparam Reducer  has to be std::plus, i.e. counting.
+ */
+template <typename Key, typename T,
+		template <typename> class Hash = ::std::hash,
+		template <typename> class Equal = ::std::equal_to,
+		typename Reducer = ::std::plus<T>,
+		typename Allocator = ::std::allocator<std::pair<const Key, T> >
+>
+class direct_address_counting_map {
+
+public:
+	using key_type              = Key;
+	using mapped_type           = T;
+	using value_type            = ::std::pair<Key, T>;
+	using hasher                = Hash<Key>;
+	using key_equal             = Equal<Key>;
+	using reducer               = Reducer;
+	using allocator_type        = Allocator;
+	using reference 			= value_type;   // proxy, entries are synthesized from index and count.
+	using const_reference	    = value_type;
+	using pointer				= value_type *;
+	using const_pointer		    = value_type const *;
+	using size_type             = size_t;
+	using difference_type       = ptrdiff_t;
+
+	using traits = direct_address_traits<Key>;
+
+	static_assert(::std::is_integral<T>::value, "direct address counting table requires integral counts.");
+	static_assert(::std::is_same<Reducer, ::std::plus<T> >::value, "direct address counting table only supports std::plus reduction.");
+	static_assert(traits::bits <= 28, "direct address table limited to 2^28 entries (k <= 14 for DNA).");
+
+	static constexpr size_t table_size = 0x1ULL << traits::bits;
+
+	/// forward iterator over non-zero counters.  dereference returns a key-count pair by value.
+	class const_iterator : public ::std::iterator<::std::forward_iterator_tag, value_type, difference_type, const_pointer, value_type> {
+		T const * counts;
+		size_t pos;
+
+		inline void skip_empty() {
+			while ((pos < table_size) && (counts[pos] == 0)) ++pos;
+		}
+
+	public:
+		const_iterator(T const * _counts, size_t const & _pos) : counts(_counts), pos(_pos) {
+			skip_empty();
+		}
+
+		inline value_type operator*() const {
+			return value_type(traits::key(pos), counts[pos]);
+		}
+		inline const_iterator & operator++() {
+			++pos;
+			skip_empty();
+			return *this;
+		}
+		inline const_iterator operator++(int) {
+			const_iterator out(*this);
+			++(*this);
+			return out;
+		}
+		inline bool operator==(const_iterator const & other) const {
+			return (pos == other.pos) && (counts == other.counts);
+		}
+		inline bool operator!=(const_iterator const & other) const {
+			return !(*this == other);
+		}
+	};
+	using iterator = const_iterator;
+
+protected:
+	T* counts;
+	size_t lsize;
+
+	// minimum batch size for multithreaded insert.
+	static constexpr size_t parallel_threshold = 1ULL << 16;
+	// bytes before the counts in an export_to snapshot.
+	static constexpr size_t snapshot_header_bytes = 64;
+
+	/// add val to key's counter.  returns 1 if the counter was 0 before.
+	inline uint8_t add(size_t const & idx, T const & val) {
+		T old = counts[idx];
+		counts[idx] = old + val;
+		return (old == 0) && (val != 0);
+	}
+	inline uint8_t atomic_add(size_t const & idx, T const & val) {
+		return (__atomic_fetch_add(counts + idx, val, __ATOMIC_RELAXED) == 0) && (val != 0);
+	}
+
+	inline key_type const & get_key(key_type const & k) const { return k; }
+	inline key_type const & get_key(value_type const & v) const { return v.first; }
+	inline T get_val(key_type const &, T const & default_val) const { return default_val; }
+	inline T get_val(value_type const & v, T const &) const { return v.second; }
+
+	template <typename IT>
+	void insert_impl(IT begin, IT end, T const & default_val) {
+		size_t input_size = ::std::distance(begin, end);
+		size_t added = 0;
+
+#if defined(_OPENMP)
+		if ((input_size >= parallel_threshold) && (omp_get_max_threads() > 1)) {
+#pragma omp parallel for reduction(+:added)
+			for (size_t i = 0; i < input_size; ++i) {
+				added += atomic_add(traits::index(get_key(begin[i])), get_val(begin[i], default_val));
+			}
+			lsize += added;
+			return;
+		}
+#endif
+		for (; begin != end; ++begin) {
+			added += add(traits::index(get_key(*begin)), get_val(*begin, default_val));
+		}
+		lsize += added;
+	}
+
+	template <typename IN>
+	inline void copy_value(IN const & val, IN* it) const {
+		*it = val;
+	}
+
+public:
+
+	direct_address_counting_map(size_t const & _capacity = 0,
+			double const & _min_load_factor = 0.0,
+			double const & _max_load_factor = 1.0) :
+		counts(::utils::mem::aligned_alloc<T>(table_size)), lsize(0) {
+		memset(counts, 0, table_size * sizeof(T));
+	}
+
+	direct_address_counting_map(direct_address_counting_map const & other) :
+		counts(::utils::mem::aligned_alloc<T>(table_size)), lsize(other.lsize) {
+		if (other.counts == nullptr) memset(counts, 0, table_size * sizeof(T));
+		else memcpy(counts, other.counts, table_size * sizeof(T));
+	}
+
+	direct_address_counting_map(direct_address_counting_map && other) :
+		counts(other.counts), lsize(other.lsize) {
+		other.counts = nullptr;
+		other.lsize = 0;
+	}
+
+	direct_address_counting_map& operator=(direct_address_counting_map const & other) {
+		if (this == &other) return *this;
+		// either side may have been moved from.
+		if (counts == nullptr) counts = ::utils::mem::aligned_alloc<T>(table_size);
+		if (other.counts == nullptr) memset(counts, 0, table_size * sizeof(T));
+		else memcpy(counts, other.counts, table_size * sizeof(T));
+		lsize = other.lsize;
+		return *this;
+	}
+
+	direct_address_counting_map& operator=(direct_address_counting_map && other) {
+		swap(other);
+		return *this;
+	}
+
+	~direct_address_counting_map() {
+		if (counts != nullptr) ::utils::mem::aligned_free(counts);
+	}
+
+	void swap(direct_address_counting_map && other) {
+		::std::swap(counts, other.counts);
+		::std::swap(lsize, other.lsize);
+	}
+	void swap(direct_address_counting_map & other) {
+		::std::swap(counts, other.counts);
+		::std::swap(lsize, other.lsize);
+	}
+
+	/// fixed size, no resize.
+	inline double get_load_factor() const {
+		return static_cast<double>(lsize) / static_cast<double>(table_size);
+	}
+	inline double get_min_load_factor() const {
+		return 0.0;
+	}
+	inline double get_max_load_factor() const {
+		return 1.0;
+	}
+	size_t capacity() const {
+		return table_size;
+	}
+	void reserve(size_type) {}
+	void rehash(size_type const &) {}
+
+	/// no hyperloglog needed, so ignored bits are irrelevant.
+	inline void set_ignored_msb(uint8_t const &) {}
+
+	iterator begin() { return iterator(counts, 0); }
+	iterator end() { return iterator(counts, table_size); }
+	const_iterator cbegin() const { return const_iterator(counts, 0); }
+	const_iterator cend() const { return const_iterator(counts, table_size); }
+
+	std::vector<std::pair<key_type, mapped_type> > to_vector() const {
+		std::vector<std::pair<key_type, mapped_type> > output;
+		output.reserve(lsize);
+		for (size_t i = 0; i < table_size; ++i) {
+			if (counts[i] != 0) output.emplace_back(traits::key(i), counts[i]);
+		}
+		return output;
+	}
+
+	std::vector<key_type > keys() const {
+		std::vector<key_type > output;
+		output.reserve(lsize);
+		for (size_t i = 0; i < table_size; ++i) {
+			if (counts[i] != 0) output.emplace_back(traits::key(i));
+		}
+		return output;
+	}
+
+	size_t size() const {
+		return this->lsize;
+	}
+
+	void clear() {
+		this->lsize = 0;
+		memset(counts, 0, table_size * sizeof(T));
+	}
+
+	//============ insert.  estimate and no_estimate are the same since there is no resizing.
+
+	std::pair<iterator, bool> insert(value_type const & vv) {
+		size_t idx = traits::index(vv.first);
+		bool added = add(idx, vv.second);
+		lsize += added;
+		return std::make_pair(iterator(counts, idx), added);
+	}
+
+	std::pair<iterator, bool> insert(key_type const & key, mapped_type const & val) {
+		return insert(value_type(key, val));
+	}
+
+	template <typename IT>
+	void insert(IT begin, IT end) {
+		insert_impl(begin, end, mapped_type(1));
+	}
+	template <typename IT>
+	void insert(IT begin, IT end, mapped_type const & default_val) {
+		insert_impl(begin, end, default_val);
+	}
+
+	void insert_no_estimate(key_type const * begin, key_type const * end, mapped_type const & default_val) {
+		insert_impl(begin, end, default_val);
+	}
+	void insert_no_estimate(value_type const * begin, value_type const * end) {
+		insert_impl(begin, end, mapped_type(1));
+	}
+
+	void insert(::std::vector<value_type> const & input) {
+		insert(input.data(), input.data() + input.size());
+	}
+	void insert(::std::vector<key_type> const & input, mapped_type const & default_val) {
+		insert(input.data(), input.data() + input.size(), default_val);
+	}
+	void insert_no_estimate(::std::vector<value_type> const & input) {
+		insert_no_estimate(input.data(), input.data() + input.size());
+	}
+	void insert_no_estimate(::std::vector<key_type> const & input, mapped_type const & default_val) {
+		insert_no_estimate(input.data(), input.data() + input.size(), default_val);
+	}
+
+	//============ queries.  in_pred filters the query key, out_pred filters the stored entry.
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	inline bool exists( key_type const & k,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate()  ) const {
+		if (!in_pred(k)) return false;
+		T c = counts[traits::index(k)];
+		return (c != 0) && out_pred(value_type(k, c));
+	}
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	inline uint8_t count( key_type const & k,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate()  ) const {
+		return exists(k, out_pred, in_pred);
+	}
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	std::vector<uint8_t> count(key_type* begin, key_type* end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) const {
+		std::vector<uint8_t> results;
+		results.reserve(std::distance(begin, end));
+		for (; begin != end; ++begin) {
+			results.emplace_back(exists(*begin, out_pred, in_pred));
+		}
+		return results;
+	}
+
+	/// out receives uint8_t, or (key, uint8_t) pairs.
+	template <typename OITER,
+			typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	size_t count(OITER out, key_type* begin, key_type* end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) const {
+		size_t cnt = 0;
+		uint8_t rs;
+		for (; begin != end; ++begin, ++out) {
+			rs = exists(*begin, out_pred, in_pred);
+			assign(out, *begin, rs);
+			cnt += rs;
+		}
+		return cnt;
+	}
+
+	const_iterator find(key_type const & k) const {
+		size_t idx = traits::index(k);
+		return (counts[idx] == 0) ? cend() : const_iterator(counts, idx);
+	}
+
+	template <typename OT,
+			typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate,
+			typename std::enable_if<std::is_constructible<OT, mapped_type>::value ||
+				::std::is_constructible<OT, value_type>::value, int>::type = 1 >
+	std::vector<OT> find(key_type* begin, key_type* end,
+			mapped_type const & nonexistent = mapped_type(),
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) const {
+		std::vector<OT> results(std::distance(begin, end));
+		find(results.data(), begin, end, nonexistent, out_pred, in_pred);
+		return results;
+	}
+
+	/// returns value (or key-value pair) for all, nonexistent for missing.
+	template <typename OIter,
+			typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate,
+			typename std::enable_if<
+				::std::is_constructible<typename ::std::iterator_traits<OIter>::value_type, value_type>::value ||
+				::std::is_constructible<typename ::std::iterator_traits<OIter>::value_type, mapped_type>::value,
+				int>::type = 1 >
+	size_t find(OIter out, key_type* begin, key_type* end,
+			mapped_type const & nonexistent = mapped_type(),
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) const {
+		size_t cnt = 0;
+		bool found;
+		for (; begin != end; ++begin, ++out) {
+			found = exists(*begin, out_pred, in_pred);
+			assign(out, *begin, found ? counts[traits::index(*begin)] : nonexistent);
+			cnt += found;
+		}
+		return cnt;
+	}
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	std::vector<value_type> find_existing(key_type* begin, key_type* end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) const {
+		std::vector<value_type> results;
+		results.reserve(std::distance(begin, end));
+		::fsc::back_emplace_iterator<::std::vector<value_type> > emplace_iter(results);
+		find_existing(emplace_iter, begin, end, out_pred, in_pred);
+		return results;
+	}
+
+	/// output only existing entries, as key-value pairs.
+	template <typename OIter,
+			typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	size_t find_existing(OIter out, key_type* begin, key_type* end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) const {
+		size_t cnt = 0;
+		for (; begin != end; ++begin) {
+			if (exists(*begin, out_pred, in_pred)) {
+				*out = value_type(*begin, counts[traits::index(*begin)]);
+				++out;
+				++cnt;
+			}
+		}
+		return cnt;
+	}
+
+	//============ read-only snapshot, e.g. for the other ranks on the node via an mpi-3 shared window.
+	// layout: [lsize | pad to 64 bytes] [counts]
+
+	/// bytes needed by export_to.
+	size_t export_size() const {
+		return snapshot_header_bytes + table_size * sizeof(T);
+	}
+
+	/// copy the table into out, which should have export_size() bytes and be 64-byte aligned.
+	void export_to(void * out) const {
+		*(reinterpret_cast<size_t *>(out)) = lsize;
+		memcpy(reinterpret_cast<unsigned char *>(out) + snapshot_header_bytes, counts, table_size * sizeof(T));
+	}
+
+	/// count and find on a snapshot written by export_to.  does not own the memory.  outputs values only.
+	class shared_view {
+	protected:
+		T const * counts;
+		size_t lsize;
+
+		template <typename OutPredicate, typename InPredicate>
+		inline T get(key_type const & k, OutPredicate const & out_pred, InPredicate const & in_pred) const {
+			if (!in_pred(k)) return 0;
+			T c = counts[traits::index(k)];
+			return ((c != 0) && out_pred(value_type(k, c))) ? c : 0;
+		}
+
+	public:
+		explicit shared_view(void const * snapshot = nullptr) : counts(nullptr), lsize(0) {
+			if (snapshot == nullptr) return;
+			lsize = *(reinterpret_cast<size_t const *>(snapshot));
+			counts = reinterpret_cast<T const *>(reinterpret_cast<unsigned char const *>(snapshot) + snapshot_header_bytes);
+		}
+
+		inline size_t size() const { return lsize; }
+
+		template <typename OIter,
+				typename OutPredicate = ::bliss::filter::TruePredicate,
+				typename InPredicate = ::bliss::filter::TruePredicate >
+		size_t count(OIter out, key_type const * begin, key_type const * end,
+				OutPredicate const & out_pred = OutPredicate(),
+				InPredicate const & in_pred = InPredicate() ) const {
+			size_t cnt = 0;
+			uint8_t rs;
+			for (; begin != end; ++begin, ++out) {
+				rs = (get(*begin, out_pred, in_pred) != 0);
+				*out = rs;
+				cnt += rs;
+			}
+			return cnt;
+		}
+
+		template <typename OIter,
+				typename OutPredicate = ::bliss::filter::TruePredicate,
+				typename InPredicate = ::bliss::filter::TruePredicate >
+		size_t find(OIter out, key_type const * begin, key_type const * end,
+				mapped_type const & nonexistent = mapped_type(),
+				OutPredicate const & out_pred = OutPredicate(),
+				InPredicate const & in_pred = InPredicate() ) const {
+			size_t cnt = 0;
+			T c;
+			for (; begin != end; ++begin, ++out) {
+				c = get(*begin, out_pred, in_pred);
+				*out = (c == 0) ? nonexistent : c;
+				cnt += (c != 0);
+			}
+			return cnt;
+		}
+	};
+
+	/// updates existing entries only.
+	void update(key_type const & k, mapped_type const & val) {
+		size_t idx = traits::index(k);
+		if (counts[idx] != 0) counts[idx] += val;
+	}
+	void update(value_type const & vv) {
+		update(vv.first, vv.second);
+	}
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	size_t update(value_type* begin, value_type* end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate() ) {
+		size_t cnt = 0;
+		for (; begin != end; ++begin) {
+			if (exists(begin->first, out_pred, in_pred)) {
+				counts[traits::index(begin->first)] += begin->second;
+				++cnt;
+			}
+		}
+		return cnt;
+	}
+
+	//============ erase.  zero the counter.
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	size_type erase(key_type const & k,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate()) {
+		if (!exists(k, out_pred, in_pred)) return 0;
+		counts[traits::index(k)] = 0;
+		--lsize;
+		return 1;
+	}
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	size_type erase(key_type const * begin, key_type const * end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate()) {
+		size_type erased = 0;
+		for (; begin != end; ++begin) {
+			erased += erase(*begin, out_pred, in_pred);
+		}
+		return erased;
+	}
+
+	template <typename OutPredicate = ::bliss::filter::TruePredicate,
+			typename InPredicate = ::bliss::filter::TruePredicate >
+	size_type erase_no_resize(key_type const * begin, key_type const * end,
+			OutPredicate const & out_pred = OutPredicate(),
+			InPredicate const & in_pred = InPredicate()) {
+		return erase(begin, end, out_pred, in_pred);
+	}
+
+protected:
+	/// write a query result, as value or (key, value) pair depending on the output type.
+	template <typename OIter, typename V, typename std::enable_if<
+		std::is_constructible<typename std::iterator_traits<OIter>::value_type, std::pair<Key, V> >::value &&
+		!std::is_constructible<typename std::iterator_traits<OIter>::value_type, V>::value,
+		int >::type = 1>
+	inline void assign(OIter & it, key_type const & k, V const & v) const {
+		*it = std::make_pair(k, v);
+	}
+	template <typename OIter, typename V, typename std::enable_if<
+		std::is_constructible<typename std::iterator_traits<OIter>::value_type, V>::value,
+		int >::type = 1>
+	inline void assign(OIter & it, key_type const &, V const & v) const {
+		*it = v;
+	}
+
+};
+
+template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
+constexpr size_t direct_address_counting_map<Key, T, Hash, Equal, Reducer, Allocator>::table_size;
+template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
+constexpr size_t direct_address_counting_map<Key, T, Hash, Equal, Reducer, Allocator>::parallel_threshold;
+template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
+constexpr size_t direct_address_counting_map<Key, T, Hash, Equal, Reducer, Allocator>::snapshot_header_bytes;
+
+}  // namespace fsc
+
+#endif /* KMERHASH_DIRECT_ADDRESS_MAP_HPP_ */
@@ -414,9 +414,8 @@ namespace dsc  // distributed std container
         		  //this->key_to_rank.hash(&(*it), block_size, hashvals);
         		  this->key_to_hash(&(*it), block_size, hashvals);
 
+        		  hll.update_via_hashval(hashvals, block_size);
         		  for (j = 0; j < block_size; ++j, ++it, ++output) {
-        			  hll.update_via_hashval(hashvals[j]);
-
         			  *output = *it;
         		  }
         	  }
@@ -427,9 +426,8 @@ namespace dsc  // distributed std container
     		  this->key_to_hash(&(*it), rem, hashvals);
     		  //this->key_to_rank.hash(&(*it), rem, hashvals);
 
+    		  hll.update_via_hashval(hashvals, rem);
     		  for (j = 0; j < rem; ++j, ++it, ++output) {
-    			  hll.update_via_hashval(hashvals[j]);
-
     			  *output = *it;
     		  }
 
@@ -487,9 +485,8 @@ namespace dsc  // distributed std container
 //						  }
 //						  std::cout << std::endl;
 //					  }
+					  hll.update_via_hashval(hashvals, block_size);
 					  for (j = 0; j < block_size; ++j) {
-						  hll.update_via_hashval(hashvals[j]);
-
 						  rank = hashvals[j] & bucket_mask; // really (p-1)
 						  *i2o_it = rank;
 						  ++i2o_it;
@@ -502,9 +499,8 @@ namespace dsc  // distributed std container
 
 				  this->key_to_hash(&(*it), rem, hashvals);
 
+				  hll.update_via_hashval(hashvals, rem);
 				  for (j = 0; j < rem; ++j) {
-					  hll.update_via_hashval(hashvals[j]);
-
 					  rank = hashvals[j] & bucket_mask;  // really (p-1)
 					  *i2o_it = rank;
 					  ++i2o_it;
@@ -516,9 +512,8 @@ namespace dsc  // distributed std container
 				  for (; i < max; i += block_size, it += block_size) {
 					  this->key_to_hash(&(*it), block_size, hashvals);
 
+					  hll.update_via_hashval(hashvals, block_size);
 					  for (j = 0; j < block_size; ++j) {
-						  hll.update_via_hashval(hashvals[j]);
-
 						  rank = hashvals[j] % num_buckets;
 						  *i2o_it = rank;
 						  ++i2o_it;
@@ -531,9 +526,8 @@ namespace dsc  // distributed std container
 
 				  this->key_to_hash(&(*it), rem, hashvals);
 
+				  hll.update_via_hashval(hashvals, rem);
 				  for (j = 0; j < rem; ++j) {
-					  hll.update_via_hashval(hashvals[j]);
-
 					  rank = hashvals[j] % num_buckets;
 					  *i2o_it = rank;
 					  ++i2o_it;
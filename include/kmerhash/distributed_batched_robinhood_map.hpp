@@ -44,17 +44,29 @@
 
 
 #include "kmerhash/robinhood_offset_hashmap_ptr.hpp"  // local storage hash table  // for multimap
+#include "kmerhash/direct_address_map.hpp"  // local storage for small key space
+#include "kmerhash/heavy_hitters.hpp"  // for pre-combining frequent keys
+#include "kmerhash/streaming_combiner.hpp"  // combining counting inserts
+#include "kmerhash/super_kmer.hpp"  // minimizer partitioning
+#include "kmerhash/blocked_bloom_filter.hpp"  // screening out absent query keys
+#include "kmerhash/query_cache.hpp"  // hot query keys
+#include "kmerhash/splitters.hpp"  // range partitioning
 #include <utility> 			  // for std::pair
 
 //#include <sparsehash/dense_hash_map>  // not a multimap, where we need it most.
 #include <functional> 		// for std::function and std::hash
 #include <algorithm> 		// for sort, stable_sort, unique, is_sorted
+#include <numeric>  // iota
 #include <iterator>  // advance, distance
 #include <sstream>  // stringstream for filea.  for debugging...
+#include <fstream>  // ifstream, checkpoint
+#include <string>
+#include <stdexcept>  // invalid_argument, logic_error
 #include <cstdint>  // for uint8, etc.
 #include <ostream>  // std::flush
 
 #include <type_traits>
+#include <memory>  // unique_ptr
 
 #include <mxx/collective.hpp>
 #include <mxx/reduction.hpp>
@@ -96,6 +108,8 @@ namespace dsc  // distributed std container
    *
    *         Note that "communication" is a weak concept here meaning that we are accessing a different local container.
    *         as such, communicator may be defined for MPI, UPC, OpenMP, etc.
+   *         in practice this map holds an ::mxx::comm and calls mxx collectives and BL_BENCH timers directly, so it runs
+   *         on MPI ranks only.  the exchanges it uses (exchange.hpp) run on any communicator, e.g. khmxx::thread_comm.
    *
    *         This allows the possibility of using distributed robinhood map as local storage for coarser grain distributed container.
    *
@@ -129,6 +143,10 @@ namespace dsc  // distributed std container
    *
    * This version is the hash-hash.
    *
+   * not thread safe, const queries included:  count and find update the query caches, find_range the sorted
+   *  snapshot, and the first operations the splitters, all without locks.  and every operation is collective.  so use
+   *  a map from one thread per rank, e.g. the driver thread of a query_batcher.
+   *
    * @tparam Key
    * @tparam T
    * @tparam Container  default to batched_robinhood_map and robinhood multimap, requiring 5 template params.
@@ -197,6 +215,123 @@ namespace dsc  // distributed std container
     // own hyperloglog definition.  separate from the local container's.  this estimates using the transformed distribute hash.
     hyperloglog64<Key, InternalHash, 12> hll;
 
+#if defined(MINIMIZER_PARTITION) && defined(SPLITTER_PARTITION)
+#error "MINIMIZER_PARTITION and SPLITTER_PARTITION are exclusive."
+#endif
+
+#if defined(MINIMIZER_PARTITION)
+    // ranks are assigned by the minimizer of the key instead of its hash, so that the counting insert can send runs
+    // of consecutive kmers as super-k-mers.  all operations use it, so they agree on the owner.
+    // the minimizer is strand independent, so a raw kmer and its canonical form have the same owner:  the insert
+    // assigns and forms runs on the raw kmers, the queries assign on the transformed ones.  this requires a
+    // DistTrans that maps a kmer to itself or its reverse complement, e.g. identity or lex_less.
+    // longer minimizers balance better, shorter ones give longer runs.  k if k is shorter.
+    static constexpr unsigned int max_minimizer_length = 13;
+    static constexpr unsigned int minimizer_length = (Key::size < max_minimizer_length) ? Key::size : max_minimizer_length;
+    ::fsc::minimizer_hash<Key, minimizer_length, true> key_to_minimizer;
+
+    /// minimizer based bucket id of each element, and bucket sizes.
+    template <typename IT, typename ASSIGN_TYPE>
+    void assign_by_key(IT _begin, IT _end, ASSIGN_TYPE const num_buckets,
+    		std::vector<size_t> & bucket_sizes, ASSIGN_TYPE * bucketIds) const {
+    	bucket_sizes.assign(num_buckets, 0);
+
+    	bool is_pow2 = (num_buckets & (num_buckets - 1)) == 0;
+    	uint64_t bucket_mask = num_buckets - 1;
+    	uint64_t h;
+    	for (; _begin != _end; ++_begin, ++bucketIds) {
+    		h = this->key_to_minimizer(*_begin);
+    		*bucketIds = static_cast<ASSIGN_TYPE>(is_pow2 ? (h & bucket_mask) : (h % num_buckets));
+    		++bucket_sizes[*bucketIds];
+    	}
+    }
+#endif
+
+#if defined(SPLITTER_PARTITION)
+    // ranks own sorted ranges of the transformed keys:  rank i has (splitters[i-1], splitters[i]].  the splitters
+    // are sampled from the keys of the distributed operations, so skewed key sets still split evenly, and each
+    // rank's local entries, sorted, follow the previous rank's.
+    mutable std::vector<Key> splitters;
+    mutable bool has_splitters;
+    /// no more resampling.  set once the sample was large enough, or once any rank holds entries.
+    mutable bool splitters_final;
+
+    /// sorted local entries as of epoch sorted_epoch, reused until the next local change.  epochs start at 1.
+    mutable std::vector<std::pair<Key, T> > sorted_cache;
+    mutable size_t sorted_epoch;
+
+    /// keys sampled per rank, per destination rank, for picking the splitters.
+    static constexpr size_t splitter_oversample = 16;
+
+    static inline Key const & key_of(Key const & x) { return x; }
+    template <typename V>
+    static inline Key const & key_of(::std::pair<Key, V> const & x) { return x.first; }
+
+    inline size_t key_to_rank(Key const & k) const {
+    	return ::std::lower_bound(this->splitters.begin(), this->splitters.end(), k) - this->splitters.begin();
+    }
+
+    /// local entries sorted by key.  sorted again only after a local change.
+    std::vector<std::pair<Key, T> > const & sorted_local() const {
+    	if (this->sorted_epoch != this->epoch) {
+    		this->c.to_vector().swap(this->sorted_cache);
+    		std::sort(this->sorted_cache.begin(), this->sorted_cache.end(),
+    				[](std::pair<Key, T> const & x, std::pair<Key, T> const & y){
+    			return x.first < y.first;
+    		});
+    		this->sorted_epoch = this->epoch;
+    	}
+    	return this->sorted_cache;
+    }
+
+    /**
+     * @brief pick the splitters from a regular sample of every rank's keys, if not yet final.  collective.
+     * @details a small first operation, e.g. a few queries, gives too few samples for even ranges.  then the
+     *          splitters are picked again from the next operations, as long as every rank is still empty.  entries
+     *          stay where the splitters put them, so the first insert always fixes the splitters.
+     */
+    template <typename IT>
+    void prepare_assign(IT _begin, IT _end, size_t const & num_buckets) const {
+    	if (this->splitters_final) return;
+    	if (num_buckets == 1) {
+    		this->has_splitters = true;
+    		this->splitters_final = true;
+    		return;
+    	}
+    	if (this->has_splitters && !::mxx::all_of(this->c.size() == 0, this->comm)) {
+    		this->splitters_final = true;
+    		return;
+    	}
+
+    	std::vector<Key> samples;
+    	samples.reserve(std::min(static_cast<size_t>(std::distance(_begin, _end)), splitter_oversample * num_buckets));
+    	::fsc::regular_sample(_begin, _end, splitter_oversample * num_buckets,
+    			[&samples](typename std::iterator_traits<IT>::value_type const & x) {
+    		samples.emplace_back(key_of(x));
+    	});
+
+    	std::vector<Key> all_samples = ::mxx::allgatherv(samples, this->comm);
+    	std::vector<Key> picked;
+    	if (!::fsc::pick_splitters(all_samples, num_buckets, picked)) return;   // nothing yet.  try again with the next batch.
+
+    	this->splitters.swap(picked);
+    	this->has_splitters = true;
+    	this->splitters_final = (all_samples.size() >= splitter_oversample * num_buckets);
+    }
+
+    /// splitter based bucket id of each element, and bucket sizes.
+    template <typename IT, typename ASSIGN_TYPE>
+    void assign_by_key(IT _begin, IT _end, ASSIGN_TYPE const num_buckets,
+    		std::vector<size_t> & bucket_sizes, ASSIGN_TYPE * bucketIds) const {
+    	bucket_sizes.assign(num_buckets, 0);
+
+    	for (; _begin != _end; ++_begin, ++bucketIds) {
+    		*bucketIds = static_cast<ASSIGN_TYPE>(this->key_to_rank(key_of(*_begin)));
+    		++bucket_sizes[*bucketIds];
+    	}
+    }
+#endif
+
 
 	template <typename K>
 	using StoreHash = typename MapParams<K>::template StorageFunction<K>;
@@ -233,10 +368,244 @@ namespace dsc  // distributed std container
                                                                                            ::std::declval<::bliss::filter::TruePredicate>()));
 
     protected:
+      // insert_fused updates another map's local container.
+      template<typename, typename,
+        template <typename, typename, template <typename> class, template <typename> class, typename...> class,
+        template <typename> class, typename, class>
+      friend class batched_robinhood_map_base;
+
       local_container_type c;
 
       mutable bool local_changed;
 
+      /// exchange strategy for the distributed insert, count, find and erase.  see set_overlap_mode().
+      ::khmxx::incremental::overlap_strategy overlap;
+
+      /// count and find query each distinct key once when the batch has at least this many keys per distinct key.  0 disables.
+      double query_dedup_ratio;
+
+      /// replicated filter of all keys, see build_query_filter().  inactive when empty.
+      ::fsc::blocked_bloom_filter query_filter;
+
+      /// bumped by every local modification.  cached query results are tagged with it.
+      size_t epoch;
+
+      /// per rank caches of count and find results, see set_query_cache_size().  find caches found keys only.
+      mutable ::fsc::query_cache<Key, count_result_type, StoreTransHash<Key>, StoreTransEqual<Key> > count_cache;
+      mutable ::fsc::query_cache<Key, mapped_type, StoreTransHash<Key>, StoreTransEqual<Key> > find_cache;
+
+      /// file format of checkpoint().
+      static constexpr size_t checkpoint_version = 1;
+
+      /// compile time choice of exchange:  OVERLAPPED_COMM* macros, else the blocking alltoallv.
+      static constexpr ::khmxx::incremental::overlap_mode default_overlap_mode =
+#if defined(OVERLAPPED_COMM)
+    		  ::khmxx::incremental::overlap_mode::pairwise;
+#elif defined(OVERLAPPED_COMM_BATCH)
+    		  ::khmxx::incremental::overlap_mode::batch;
+#elif defined(OVERLAPPED_COMM_FULLBUFFER)
+    		  ::khmxx::incremental::overlap_mode::fullbuffer;
+#elif defined(OVERLAPPED_COMM_2P)
+    		  ::khmxx::incremental::overlap_mode::two_phase;
+#elif defined(AUTO_OVERLAPPED_COMM)
+    		  ::khmxx::incremental::overlap_mode::automatic;
+#else
+    		  ::khmxx::incremental::overlap_mode::none;
+#endif
+
+      /// persistent exchanges for queries in overlap_mode::persistent, set up on first use.  insert and erase use pairwise.
+      mutable std::unique_ptr<::khmxx::incremental::persistent_exchange<Key, count_result_type> > count_exchange;
+      mutable std::unique_ptr<::khmxx::incremental::persistent_exchange<Key, mapped_type> > find_exchange;
+
+      ::khmxx::incremental::persistent_exchange<Key, count_result_type> & persistent_count() const {
+    	  if (!count_exchange)
+    		  count_exchange.reset(new ::khmxx::incremental::persistent_exchange<Key, count_result_type>(
+    				  this->overlap.get_persistent_capacity(), this->comm));
+    	  return *count_exchange;
+      }
+      ::khmxx::incremental::persistent_exchange<Key, mapped_type> & persistent_find() const {
+    	  if (!find_exchange)
+    		  find_exchange.reset(new ::khmxx::incremental::persistent_exchange<Key, mapped_type>(
+    				  this->overlap.get_persistent_capacity(), this->comm));
+    	  return *find_exchange;
+      }
+
+#if defined(SHARED_WINDOW_QUERY)
+      /// read-only copies of the local containers on this node, see share_local().
+      ::khmxx::node_shared_window shared;
+      std::vector<typename local_container_type::shared_view> shared_views;   // by node rank.
+
+      /**
+       * @brief answer the keys owned by ranks on this node from their shared copies.  collective on the node.
+       * @details input is grouped by rank per send_counts.  on return input holds only the keys owned by other nodes,
+       *          send_counts is 0 for ranks on this node, and results has the answers for the rest in place.
+       *          all_input and all_counts keep the originals for shared_merge.
+       * @return false, with nothing changed, if any rank on the node has no current copy.
+       */
+      template <typename R, typename Query>
+      bool shared_split(std::vector<Key> & input, std::vector<size_t> & send_counts, R * results,
+    		  std::vector<Key> & all_input, std::vector<size_t> & all_counts, Query const & query) const {
+    	  if (!mxx::all_of(this->shared.active() && !this->local_changed,
+    			  ::khmxx::get_hierarchical_comm(this->comm).node_comm)) return false;
+
+    	  all_counts = send_counts;
+
+    	  size_t remote_total = 0;
+    	  for (size_t r = 0; r < send_counts.size(); ++r) {
+    		  if (this->shared.node_rank_of(r) < 0) remote_total += send_counts[r];
+    	  }
+    	  std::vector<Key> remote;
+    	  remote.reserve(remote_total);
+
+    	  size_t offset = 0;
+    	  int nr;
+    	  for (size_t r = 0; r < send_counts.size(); offset += all_counts[r], ++r) {
+    		  nr = this->shared.node_rank_of(r);
+    		  if (nr < 0) {
+    			  remote.insert(remote.end(), input.begin() + offset, input.begin() + offset + all_counts[r]);
+    		  } else {
+    			  query(this->shared_views[nr], input.data() + offset, input.data() + offset + all_counts[r], results + offset);
+    			  send_counts[r] = 0;
+    		  }
+    	  }
+
+    	  all_input.swap(input);
+    	  input.swap(remote);
+    	  return true;
+      }
+
+      /// scatter the results for the other nodes' keys back to their place, and restore the input.
+      template <typename R>
+      void shared_merge(std::vector<Key> & input, std::vector<Key> & all_input, std::vector<size_t> const & all_counts,
+    		  R const * remote_results, R * results) const {
+    	  size_t offset = 0;
+    	  for (size_t r = 0; r < all_counts.size(); offset += all_counts[r], ++r) {
+    		  if (this->shared.node_rank_of(r) >= 0) continue;
+    		  ::std::copy(remote_results, remote_results + all_counts[r], results + offset);
+    		  remote_results += all_counts[r];
+    	  }
+    	  input.swap(all_input);
+      }
+#endif
+
+      /**
+       * @brief replace repeated query keys with one copy each, if the batch repeats keys often enough.
+       * @details input is grouped by rank per send_counts, and distinct is an estimate of its distinct keys.  on
+       *          success input holds the distinct keys, grouped the same way, send_counts their counts, and
+       *          slots[i] the position of original key i among them.  all_input and all_counts keep the originals
+       *          for dedup_merge.
+       * @return false, with nothing changed, if deduplication is not expected to pay off.
+       */
+      bool dedup_split(std::vector<Key> & input, std::vector<size_t> & send_counts, double const & distinct,
+    		  std::vector<Key> & all_input, std::vector<size_t> & all_counts, std::vector<uint32_t> & slots) const {
+    	  if ((this->query_dedup_ratio <= 0.0) || (input.size() == 0) ||
+    			  (input.size() > ::std::numeric_limits<uint32_t>::max()) ||
+    			  (static_cast<double>(input.size()) < this->query_dedup_ratio * distinct)) return false;
+
+    	  StoreTransHash<Key> hash;
+    	  StoreTransEqual<Key> eq;
+
+    	  // linear probing table of (position in uniq + 1).  0 is empty.  grows at half full.
+    	  size_t capacity = 64;
+    	  while (static_cast<double>(capacity) < 2.5 * distinct) capacity <<= 1;
+    	  size_t mask = capacity - 1;
+    	  std::vector<uint32_t> table(capacity, 0);
+
+    	  std::vector<Key> uniq;
+    	  uniq.reserve(static_cast<size_t>(distinct * 1.1));
+    	  std::vector<size_t> uniq_counts(send_counts.size(), 0);
+    	  slots.resize(input.size());
+
+    	  size_t i = 0, pos;
+    	  for (size_t r = 0; r < send_counts.size(); ++r) {
+    		  for (size_t end = i + send_counts[r]; i < end; ++i) {
+    			  pos = hash(input[i]) & mask;
+    			  while ((table[pos] != 0) && !eq(uniq[table[pos] - 1], input[i])) pos = (pos + 1) & mask;
+    			  if (table[pos] != 0) {
+    				  slots[i] = table[pos] - 1;
+    				  continue;
+    			  }
+
+    			  uniq.emplace_back(input[i]);
+    			  table[pos] = uniq.size();
+    			  slots[i] = uniq.size() - 1;
+    			  ++uniq_counts[r];
+
+    			  if ((uniq.size() << 1) > capacity) {
+    				  capacity <<= 1;
+    				  mask = capacity - 1;
+    				  table.assign(capacity, 0);
+    				  for (size_t j = 0; j < uniq.size(); ++j) {
+    					  pos = hash(uniq[j]) & mask;
+    					  while (table[pos] != 0) pos = (pos + 1) & mask;
+    					  table[pos] = j + 1;
+    				  }
+    			  }
+    		  }
+    	  }
+
+    	  all_input.swap(input);
+    	  input.swap(uniq);
+    	  all_counts.swap(send_counts);
+    	  send_counts.swap(uniq_counts);
+    	  return true;
+      }
+
+      /// copy the answers for the distinct keys out to every original key, and restore the original input.
+      template <typename R>
+      void dedup_merge(std::vector<Key> & input, std::vector<Key> & all_input, std::vector<uint32_t> const & slots,
+    		  R const * uniq_results, R * results) const {
+    	  for (size_t i = 0; i < slots.size(); ++i) {
+    		  results[i] = uniq_results[slots[i]];
+    	  }
+    	  input.swap(all_input);
+      }
+
+      /**
+       * @brief take out the query keys that can be answered on this rank.  buffer holds the transformed input.
+       * @details answer(key, result) returns true if it answered key.  the others are compacted to the front of
+       *          buffer, and input is resized to their number.  answered and answers get the rest.  if positions
+       *          is given, it gets the input position of the kept keys, then of the answered ones.
+       */
+      template <typename R, typename Answer>
+      void local_split(std::vector<Key> & input, Key * buffer, std::vector<Key> & answered, std::vector<R> & answers,
+    		  std::vector<size_t> * positions, Answer const & answer) const {
+    	  answered.clear();
+    	  answers.clear();
+    	  std::vector<size_t> answered_positions;
+    	  if (positions) positions->resize(input.size());
+
+    	  size_t m = 0;
+    	  R r;
+    	  for (size_t i = 0; i < input.size(); ++i) {
+    		  if (answer(buffer[i], r)) {
+    			  answered.emplace_back(buffer[i]);
+    			  answers.emplace_back(r);
+    			  if (positions) answered_positions.emplace_back(i);
+    		  } else {
+    			  if (positions) (*positions)[m] = i;
+    			  buffer[m] = buffer[i];
+    			  ++m;
+    		  }
+    	  }
+    	  if (positions) ::std::copy(answered_positions.begin(), answered_positions.end(), positions->begin() + m);
+
+    	  input.resize(m);
+      }
+
+      /// append the locally answered keys and their answers after the permuted input, and map order back to the input.
+      template <typename R>
+      void local_merge(std::vector<Key> & input, std::vector<Key> const & answered, std::vector<R> const & answers,
+    		  std::vector<size_t> const & positions, R * results, size_t * order) const {
+    	  size_t m = input.size();
+    	  input.insert(input.end(), answered.begin(), answered.end());
+    	  ::std::copy(answers.begin(), answers.end(), results + m);
+
+    	  if (order == nullptr) return;
+    	  for (size_t j = 0; j < m; ++j) order[j] = positions[order[j]];
+    	  for (size_t j = m; j < input.size(); ++j) order[j] = positions[j];
+      }
+
       /// local reduction via a copy of local container type (i.e. batched_robinhood_map).
       /// this takes quite a bit of memory due to use of batched_robinhood_map, but is significantly faster than sorting.
       virtual void local_reduction(::std::vector<::std::pair<Key, T> >& input, bool & sorted_input) {
@@ -283,14 +652,14 @@ namespace dsc  // distributed std container
 
 
       /// permute, given the assignment array and bucket counts.
-      /// this is the second pass only.
+      /// this is the second pass only.  if order is given, order[j] is set to the input position of results[j].
       template <uint8_t prefetch_dist = 8, typename IT, typename MT, typename OT,
       typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<OT>::iterator_category,
                                                ::std::random_access_iterator_tag >::value, int>::type = 1  >
       void
       permute_by_bucketid(IT _begin, IT _end, MT bucketIds,
 			 std::vector<size_t> & bucket_sizes,
-			 OT results) const {
+			 OT results, size_t * order = nullptr) const {
 
       	static_assert(std::is_same<typename std::iterator_traits<IT>::value_type,
       			typename std::iterator_traits<OT>::value_type>::value,
@@ -311,6 +680,7 @@ namespace dsc  // distributed std container
           if (num_buckets == 1) {
         	  // copy input to output and be done.
         	  ::std::copy(_begin, _end, results);
+        	  if (order) ::std::iota(order, order + std::distance(_begin, _end), static_cast<size_t>(0));
 
         	  return;
           }
@@ -357,10 +727,12 @@ namespace dsc  // distributed std container
           constexpr size_t mask = prefetch_dist - 1;
           IT it = _begin;
           i = 0;
+          size_t j = 0;   // input position of it.
           i2o_eit = bucketIds + input_size;
-          for (; i2o_it != i2o_eit; ++it, ++i2o_it) {
+          for (; i2o_it != i2o_eit; ++it, ++i2o_it, ++j) {
             *(results + offsets[i]) = *it;   // offset decremented by 1 before use.
                 // bucekted filled from back to front for each bucket, hence iterators are pre-decremented.
+            if (order) order[offsets[i]] = j;
 
             bid = bucket_offsets[*i2o_it]++;
             offsets[i] = bid;
@@ -370,9 +742,10 @@ namespace dsc  // distributed std container
           }
 
           // and finally, finish the last part.
-          for (; it != _end; ++it) {
+          for (; it != _end; ++it, ++j) {
             *(results + offsets[i]) = *it;   // offset decremented by 1 before use.
                 // bucekted filled from back to front for each bucket, hence iterators are pre-decremented.
+            if (order) order[offsets[i]] = j;
             i = (i+1) & mask;
           }
 
@@ -399,7 +772,7 @@ namespace dsc  // distributed std container
                              ASSIGN_TYPE const num_buckets,
                              std::vector<size_t> & bucket_sizes,
                              OT output,
-							 HLL & hll) const {
+							 HLL & hll, size_t * order = nullptr) const {
 
         static_assert(::std::is_integral<ASSIGN_TYPE>::value,
         		"ASSIGN_TYPE should be integral, preferably unsigned");
@@ -407,6 +780,10 @@ namespace dsc  // distributed std container
         // no bucket.
         if (num_buckets == 0) throw std::invalid_argument("ERROR: number of buckets is 0");
 
+#if defined(SPLITTER_PARTITION)
+        this->prepare_assign(_begin, _end, num_buckets);
+#endif
+
         bucket_sizes.clear();
 
 //        BL_BENCH_INIT(permute_est);
@@ -435,6 +812,7 @@ namespace dsc  // distributed std container
 
           // set output buckets sizes
           bucket_sizes[0] = input_size;
+          if (order) ::std::iota(order, order + input_size, static_cast<size_t>(0));
 
           // and compute the hll.
     	  IT it = _begin;
@@ -448,9 +826,8 @@ namespace dsc  // distributed std container
         		  //this->key_to_rank.hash(&(*it), block_size, hashvals);
         		  this->key_to_hash(&(*it), block_size, hashvals);
 
+        		  hll.update_via_hashval(hashvals, block_size);
         		  for (j = 0; j < block_size; ++j, ++it, ++output) {
-        			  hll.update_via_hashval(hashvals[j]);
-
         			  *output = *it;
         		  }
         	  }
@@ -461,9 +838,8 @@ namespace dsc  // distributed std container
     		  this->key_to_hash(&(*it), rem, hashvals);
     		  //this->key_to_rank.hash(&(*it), rem, hashvals);
 
+    		  hll.update_via_hashval(hashvals, rem);
     		  for (j = 0; j < rem; ++j, ++it, ++output) {
-    			  hll.update_via_hashval(hashvals[j]);
-
     			  *output = *it;
     		  }
 
@@ -485,6 +861,19 @@ namespace dsc  // distributed std container
         }
 
 
+#if defined(MINIMIZER_PARTITION) || defined(SPLITTER_PARTITION)
+        {
+          ASSIGN_TYPE* bucketIds = ::utils::mem::aligned_alloc<ASSIGN_TYPE>(input_size + InternalHash::batch_size);
+          this->assign_by_key(_begin, _end, num_buckets, bucket_sizes, bucketIds);
+          for (IT it = _begin; it != _end; ++it) {
+        	  hll.update_via_hashval(this->key_to_hash(*it));
+          }
+          permute_by_bucketid(_begin, _end, bucketIds, bucket_sizes, output, order);
+          ::utils::mem::aligned_free(bucketIds);
+          return;
+        }
+#endif
+
           bool is_pow2 = (num_buckets & (num_buckets - 1)) == 0;
         
 //        BL_BENCH_START(permute_est);
@@ -523,9 +912,8 @@ namespace dsc  // distributed std container
 //						  }
 //						  std::cout << std::endl;
 //					  }
+					  hll.update_via_hashval(hashvals, block_size);
 					  for (j = 0; j < block_size; ++j) {
-						  hll.update_via_hashval(hashvals[j]);
-
 						  rank = hashvals[j] & bucket_mask; // really (p-1)
 						  *i2o_it = rank;
 						  ++i2o_it;
@@ -538,9 +926,8 @@ namespace dsc  // distributed std container
 
 				  this->key_to_hash(&(*it), rem, hashvals);
 
+				  hll.update_via_hashval(hashvals, rem);
 				  for (j = 0; j < rem; ++j) {
-					  hll.update_via_hashval(hashvals[j]);
-
 					  rank = hashvals[j] & bucket_mask;  // really (p-1)
 					  *i2o_it = rank;
 					  ++i2o_it;
@@ -552,9 +939,8 @@ namespace dsc  // distributed std container
 				  for (; i < max; i += block_size, it += block_size) {
 					  this->key_to_hash(&(*it), block_size, hashvals);
 
+					  hll.update_via_hashval(hashvals, block_size);
 					  for (j = 0; j < block_size; ++j) {
-						  hll.update_via_hashval(hashvals[j]);
-
 						  rank = hashvals[j] % num_buckets;
 						  *i2o_it = rank;
 						  ++i2o_it;
@@ -567,9 +953,8 @@ namespace dsc  // distributed std container
 
 				  this->key_to_hash(&(*it), rem, hashvals);
 
+				  hll.update_via_hashval(hashvals, rem);
 				  for (j = 0; j < rem; ++j) {
-					  hll.update_via_hashval(hashvals[j]);
-
 					  rank = hashvals[j] % num_buckets;
 					  *i2o_it = rank;
 					  ++i2o_it;
@@ -612,7 +997,7 @@ namespace dsc  // distributed std container
 
 //          BL_BENCH_START(permute_est);
           // pass 2, do the actual permute
-          permute_by_bucketid(_begin, _end, bucketIds, bucket_sizes, output );
+          permute_by_bucketid(_begin, _end, bucketIds, bucket_sizes, output, order);
 //          BL_BENCH_END(permute_est, "permute", input_size);
 
 //          BL_BENCH_START(permute_est);
@@ -632,12 +1017,16 @@ namespace dsc  // distributed std container
       assign_count_permute(IT _begin, IT _end,
     		  ASSIGN_TYPE const num_buckets,
                              std::vector<size_t> & bucket_sizes,
-							 OT output) const {
+							 OT output, size_t * order = nullptr) const {
 
 
         // no bucket.
         if (num_buckets == 0) throw std::invalid_argument("ERROR: number of buckets is 0");
 
+#if defined(SPLITTER_PARTITION)
+        this->prepare_assign(_begin, _end, num_buckets);
+#endif
+
         bucket_sizes.clear();
 
         if (_begin == _end) return;  // no data in question.
@@ -672,6 +1061,7 @@ namespace dsc  // distributed std container
 
           // set all of bucketIds to 0
           std::copy(_begin, _end, output);
+          if (order) ::std::iota(order, order + input_size, static_cast<size_t>(0));
 //          BL_BENCH_END(permute_est, "permute", input_size);
 
 //          BL_BENCH_REPORT_NAMED(permute_est, "count_permute");
@@ -685,6 +1075,12 @@ namespace dsc  // distributed std container
         ASSIGN_TYPE* bucketIds = ::utils::mem::aligned_alloc<ASSIGN_TYPE>(input_size + InternalHash::batch_size);
 //        BL_BENCH_END(permute_est, "alloc", input_size);
 
+#if defined(MINIMIZER_PARTITION) || defined(SPLITTER_PARTITION)
+        this->assign_by_key(_begin, _end, num_buckets, bucket_sizes, bucketIds);
+        permute_by_bucketid(_begin, _end, bucketIds, bucket_sizes, output, order);
+        ::utils::mem::aligned_free(bucketIds);
+        return;
+#endif
 
           // 1st pass of 2 pass algo.
 
@@ -729,7 +1125,7 @@ namespace dsc  // distributed std container
 //          BL_BENCH_END(permute_est, "count", input_size);
 
 //          BL_BENCH_START(permute_est);
-          permute_by_bucketid(_begin, _end, bucketIds, bucket_sizes, output);
+          permute_by_bucketid(_begin, _end, bucketIds, bucket_sizes, output, order);
 //          BL_BENCH_END(permute_est, "permiute", input_size);
 
 //          BL_BENCH_START(permute_est);
@@ -746,7 +1142,11 @@ namespace dsc  // distributed std container
     public:
 
       batched_robinhood_map_base(const mxx::comm& _comm) : Base(_comm),
-		  key_to_hash(DistHash<trans_val_type>(9876543), DistTrans<Key>(), ::bliss::transform::identity<hash_val_type>())
+		  key_to_hash(DistHash<trans_val_type>(9876543), DistTrans<Key>(), ::bliss::transform::identity<hash_val_type>()),
+#if defined(SPLITTER_PARTITION)
+		  has_splitters(false), splitters_final(false), sorted_epoch(0),
+#endif
+		  local_changed(true), overlap(default_overlap_mode), query_dedup_ratio(2.0), epoch(1)
 		  //hll(ceilLog2(_comm.size()))  // top level hll. no need to ignore bits.
     //	don't bother initializing c.
     {
@@ -763,16 +1163,293 @@ namespace dsc  // distributed std container
       local_container_type& get_local_container() { return c; }
       local_container_type const & get_local_container() const { return c; }
 
+      /// set the exchange strategy.  must be the same on all ranks.  automatic chooses per operation from the message sizes.
+      void set_overlap_mode(::khmxx::incremental::overlap_mode const & mode) {
+    	  overlap.set_mode(mode);
+      }
+      ::khmxx::incremental::overlap_mode get_overlap_mode() const {
+    	  return overlap.get_mode();
+      }
+
+      /// count and find query each distinct key once when a batch has at least ratio keys per distinct key.  0 disables.
+      void set_query_dedup_ratio(double const & ratio) {
+    	  query_dedup_ratio = ratio;
+      }
+
+      /**
+       * @brief build a Bloom filter of all keys, replicated on every rank.  collective.
+       * @details count and find then answer the keys it rules out locally, and send only the rest.  it takes
+       *          bits_per_key bits per key in the whole map on every rank, ~1% false positives at 10.  an insert
+       *          drops it, erase only makes it less selective.  call again to rebuild.
+       */
+      void build_query_filter(double const & bits_per_key = 10.0) {
+    	  this->check_no_pending_insert();
+    	  size_t total = ::mxx::allreduce(this->c.size(), this->comm);
+    	  this->query_filter.resize(total, bits_per_key);
+
+    	  std::vector<Key> local_keys;
+    	  this->keys(local_keys);
+    	  for (size_t i = 0; i < local_keys.size(); ++i) {
+    		  this->query_filter.insert(static_cast<uint64_t>(this->key_to_hash(local_keys[i])));
+    	  }
+
+    	  // or the local filters together, in chunks that fit an int count.
+    	  constexpr size_t max_words = 1UL << 30;
+    	  for (size_t offset = 0; offset < this->query_filter.word_count(); offset += max_words) {
+    		  MPI_Allreduce(MPI_IN_PLACE, this->query_filter.data() + offset,
+    				  static_cast<int>(::std::min(max_words, this->query_filter.word_count() - offset)),
+    				  MPI_UINT64_T, MPI_BOR, this->comm);
+    	  }
+      }
+
+      /// drop the query filter.
+      void drop_query_filter() {
+    	  this->query_filter.reset();
+      }
+
+      /**
+       * @brief cache up to entries count and find results on this rank, for keys queried again and again.  0 disables.
+       * @details consulted before bucketing, for queries without a predicate.  any insert, erase or clear
+       *          invalidates it.  not collective.  the caches are not locked, see the thread safety note above.
+       */
+      void set_query_cache_size(size_t const & entries) {
+    	  this->count_cache.resize(entries);
+    	  this->find_cache.resize(entries);
+      }
+
+      /// max keys per peer per query in persistent mode.  larger queries use pairwise.  must be the same on all ranks.
+      void set_persistent_capacity(size_t const & capacity) {
+    	  overlap.set_persistent_capacity(capacity);
+    	  count_exchange.reset();
+    	  find_exchange.reset();
+      }
+
+      /// time the exchange strategies on this communicator, and switch to automatic selection using the measurements.  collective.
+      void calibrate_overlap() {
+    	  overlap.calibrate(this->comm);
+    	  overlap.set_mode(::khmxx::incremental::overlap_mode::automatic);
+      }
+
+#if defined(SHARED_WINDOW_QUERY)
+      /**
+       * @brief publish a read-only copy of the local container to the other ranks on this node.  collective.
+       * @details count and find then read the copies of same-node ranks directly, and exchange only the keys owned
+       *          by other nodes.  any insert, erase or clear makes the copy stale, and queries go back to the all2all
+       *          for every key until share_local is called again.
+       */
+      void share_local() {
+    	  this->check_no_pending_insert();
+    	  this->shared_views.clear();
+    	  this->shared.publish(this->c.export_size(), [this](void * out){ this->c.export_to(out); }, this->comm);
+    	  for (size_t i = 0; i < this->shared.node_size(); ++i) {
+    		  this->shared_views.emplace_back(this->shared.peer(i));
+    	  }
+    	  this->local_changed = false;
+      }
+
+      /// drop the shared copies.  collective.
+      void unshare_local() {
+    	  this->shared_views.clear();
+    	  this->shared.release();
+      }
+#endif
+
+#if defined(SPLITTER_PARTITION)
+      /// set the splitters instead of sampling them.  comm.size() - 1 sorted keys, the same on all ranks.  call before the first insert.
+      void set_splitters(std::vector<Key> const & _splitters) {
+    	  if (_splitters.size() + 1 != static_cast<size_t>(this->comm.size()))
+    		  throw std::invalid_argument("ERROR: need comm.size() - 1 splitters.");
+    	  this->splitters = _splitters;
+    	  this->has_splitters = true;
+    	  this->splitters_final = true;
+      }
+      std::vector<Key> const & get_splitters() const {
+    	  return this->splitters;
+      }
+
+      /// local entries sorted by key.  concatenated in rank order, they are the globally sorted entries.
+      void to_sorted_vector(std::vector<std::pair<Key, T> > & result) const {
+    	  this->check_no_pending_insert();
+    	  result = this->sorted_local();
+      }
+
+      /**
+       * @brief all entries with lo <= key < hi for each (lo, hi) in ranges, on the transformed keys.  collective, and
+       *        each rank may ask for different ranges.
+       * @details a range is sent to every rank that owns part of it, which answers from its sorted local entries.
+       *          an entry in several overlapping ranges is returned once per range.
+       * @return number of entries in results, sorted by key.
+       */
+      size_t find_range(std::vector<std::pair<Key, Key> > const & ranges, std::vector<std::pair<Key, T> > & results) const {
+    	  this->check_no_pending_insert();
+    	  BL_BENCH_INIT(find_range);
+
+    	  int comm_size = this->comm.size();
+
+    	  BL_BENCH_START(find_range);
+    	  std::vector<size_t> send_counts(comm_size, 0);
+    	  for (auto const & r : ranges) {
+    		  if (!(r.first < r.second)) continue;
+    		  for (size_t i = this->key_to_rank(r.first), e = this->key_to_rank(r.second); i <= e; ++i) ++send_counts[i];
+    	  }
+    	  std::vector<size_t> offsets(comm_size, 0);
+    	  for (int i = 1; i < comm_size; ++i) offsets[i] = offsets[i - 1] + send_counts[i - 1];
+    	  std::vector<std::pair<Key, Key> > permuted(offsets[comm_size - 1] + send_counts[comm_size - 1]);
+    	  for (auto const & r : ranges) {
+    		  if (!(r.first < r.second)) continue;
+    		  for (size_t i = this->key_to_rank(r.first), e = this->key_to_rank(r.second); i <= e; ++i) permuted[offsets[i]++] = r;
+    	  }
+    	  BL_BENCH_END(find_range, "permute", permuted.size());
+
+    	  BL_BENCH_START(find_range);
+    	  std::vector<std::pair<Key, T> > const & local = this->sorted_local();
+    	  BL_BENCH_END(find_range, "sort_local", local.size());
+
+    	  auto before = [](std::pair<Key, T> const & x, Key const & k){ return x.first < k; };
+
+    	  ::khmxx::incremental::overlap_mode mode = this->overlap.select(permuted.size() * sizeof(std::pair<Key, Key>), this->comm);
+    	  if (mode != ::khmxx::incremental::overlap_mode::none) {
+    		  // pipelined:  answer each peer's ranges while the next peer's arrive.
+    		  BL_BENCH_COLLECTIVE_START(find_range, "a2av_query", this->comm);
+    		  std::vector<size_t> range_counts;
+    		  ::khmxx::incremental::ialltoallv_and_query_one_to_many(permuted.begin(), permuted.end(), send_counts,
+    				  [&local, &before](int rank, std::pair<Key, Key> * b, std::pair<Key, Key> * e, size_t * counts,
+    						  std::vector<std::pair<Key, T> > & out){
+    			  for (; b != e; ++b, ++counts) {
+    				  auto lo = std::lower_bound(local.begin(), local.end(), b->first, before);
+    				  auto hi = std::lower_bound(lo, local.end(), b->second, before);
+    				  out.insert(out.end(), lo, hi);
+    				  *counts = std::distance(lo, hi);
+    			  }
+    		  }, range_counts, results, this->comm);
+    		  BL_BENCH_END(find_range, "a2av_query", results.size());
+    	  } else {
+
+    	  BL_BENCH_COLLECTIVE_START(find_range, "a2a_ranges", this->comm);
+    	  std::vector<size_t> recv_counts = ::mxx::all2all(send_counts, this->comm);
+    	  std::vector<std::pair<Key, Key> > queries(std::accumulate(recv_counts.begin(), recv_counts.end(), static_cast<size_t>(0)));
+    	  ::mxx::all2allv(permuted.data(), send_counts, queries.data(), recv_counts, this->comm);
+    	  BL_BENCH_END(find_range, "a2a_ranges", queries.size());
+
+    	  BL_BENCH_START(find_range);
+    	  std::vector<std::pair<Key, T> > answers;
+    	  std::vector<size_t> answer_counts(comm_size, 0);
+    	  size_t q = 0;
+    	  for (int i = 0; i < comm_size; ++i) {
+    		  for (size_t j = 0; j < recv_counts[i]; ++j, ++q) {
+    			  auto lo = std::lower_bound(local.begin(), local.end(), queries[q].first, before);
+    			  auto hi = std::lower_bound(lo, local.end(), queries[q].second, before);
+    			  answers.insert(answers.end(), lo, hi);
+    			  answer_counts[i] += std::distance(lo, hi);
+    		  }
+    	  }
+    	  BL_BENCH_END(find_range, "answer", answers.size());
+
+    	  BL_BENCH_COLLECTIVE_START(find_range, "a2a_results", this->comm);
+    	  std::vector<size_t> result_counts = ::mxx::all2all(answer_counts, this->comm);
+    	  results.resize(std::accumulate(result_counts.begin(), result_counts.end(), static_cast<size_t>(0)));
+    	  ::mxx::all2allv(answers.data(), answer_counts, results.data(), result_counts, this->comm);
+    	  BL_BENCH_END(find_range, "a2a_results", results.size());
+    	  }
+
+    	  BL_BENCH_START(find_range);
+    	  std::stable_sort(results.begin(), results.end(), [](std::pair<Key, T> const & x, std::pair<Key, T> const & y){
+    		  return x.first < y.first;
+    	  });
+    	  BL_BENCH_END(find_range, "sort_results", results.size());
+
+    	  BL_BENCH_REPORT_MPI_NAMED(find_range, "hashmap:find_range", this->comm);
+
+    	  return results.size();
+      }
+#endif
+
+      /**
+       * @brief save the map as one file per rank, prefix.<rank>, plus prefix.parts.  collective.
+       * @details the parts hold the stored (transformed) entries, see restore().
+       */
+      void checkpoint(std::string const & prefix) const {
+    	  this->check_no_pending_insert();
+    	  std::vector<std::pair<Key, T> > entries = this->c.to_vector();
+    	  std::stringstream ss;
+    	  ss << prefix << "." << this->comm.rank();
+    	  serialize_vector(entries, ss.str());
+
+    	  size_t total = ::mxx::allreduce(entries.size(), this->comm);
+    	  if (this->comm.rank() == 0) {
+    		  std::vector<size_t> parts = { checkpoint_version, static_cast<size_t>(this->comm.size()), total };
+    		  serialize_vector(parts, prefix + ".parts");
+    	  }
+    	  this->comm.barrier();
+      }
+
+      /**
+       * @brief replace the contents with a checkpoint written on any number of ranks.  collective.
+       * @details parts are read round robin by rank, then inserted, so entries go to their owners on this
+       *          communicator and each local container is loaded in bulk, with a size estimate.  the key transform
+       *          is applied again, so it has to be idempotent, as the kmer transforms are.
+       *          all parts are read before anything is changed.  if any rank fails, or the parts do not add up to
+       *          the saved total, every rank throws std::invalid_argument and keeps its current contents.
+       * @return number of entries loaded on this rank.
+       */
+      size_t restore(std::string const & prefix) {
+    	  this->check_no_pending_insert();
+    	  std::string error;
+    	  std::vector<std::pair<Key, T> > entries;
+    	  size_t total = 0;
+    	  try {
+    		  if (!std::ifstream(prefix + ".parts").good())
+    			  throw std::invalid_argument("ERROR: checkpoint not found.");
+    		  std::vector<size_t> parts = deserialize_vector<size_t>(prefix + ".parts");
+    		  if ((parts.size() != 3) || (parts[0] != checkpoint_version))
+    			  throw std::invalid_argument("ERROR: unsupported checkpoint version.");
+    		  total = parts[2];
+
+    		  for (size_t i = this->comm.rank(); i < parts[1]; i += this->comm.size()) {
+    			  std::stringstream ss;
+    			  ss << prefix << "." << i;
+    			  if (!std::ifstream(ss.str()).good())
+    				  throw std::invalid_argument("ERROR: checkpoint part " + ss.str() + " not found.");
+    			  std::vector<std::pair<Key, T> > part = deserialize_vector<std::pair<Key, T> >(ss.str());
+    			  entries.insert(entries.end(), part.begin(), part.end());
+    		  }
+    	  } catch (std::exception const & e) {
+    		  error = e.what();
+    	  }
+
+    	  // agree before touching the map, so no rank is left waiting in insert.
+    	  bool ok = ::mxx::all_of(error.empty(), this->comm);
+    	  if (ok && (::mxx::allreduce(entries.size(), this->comm) != total)) {
+    		  error = "ERROR: checkpoint is incomplete.";
+    		  ok = false;
+    	  }
+    	  if (!ok) throw std::invalid_argument(error.empty() ? "ERROR: checkpoint could not be read on another rank." : error);
+
+    	  this->local_reset();
+    	  this->insert(entries);
+    	  return this->c.size();
+      }
+
       // ================ local overrides
 
       /// clears the batched_robinhood_map
       virtual void local_reset() noexcept {
+    	  this->local_changed = true;
+    	  ++this->epoch;
     	  this->c.clear();
     	  this->c.rehash(128);
+#if defined(SPLITTER_PARTITION)
+    	  std::vector<std::pair<Key, T> >().swap(this->sorted_cache);
+#endif
       }
 
       virtual void local_clear() noexcept {
+        this->local_changed = true;
+        ++this->epoch;
         this->c.clear();
+#if defined(SPLITTER_PARTITION)
+        std::vector<std::pair<Key, T> >().swap(this->sorted_cache);
+#endif
       }
 
       /// reserve space.  n is the local container size.  this allows different processes to individually adjust its own size.
@@ -809,6 +1486,17 @@ namespace dsc  // distributed std container
         return this->local_size();
       }
 
+      /// true if a pipelined insert batch is still in flight.  see counting_batched_robinhood_map::insert_submit.
+      virtual bool insert_pending() const {
+    	  return false;
+      }
+
+      /// reads and modifications other than insert_submit/insert_wait would miss or reorder the batch in flight.  not collective.
+      inline void check_no_pending_insert() const {
+    	  if (this->insert_pending())
+    		  throw std::logic_error("ERROR: insert_submit batch in flight.  call insert_wait() first.");
+      }
+
 
 
       const_iterator cbegin() const {
@@ -825,6 +1513,7 @@ namespace dsc  // distributed std container
 
       /// convert the map to a vector
       virtual void to_vector(std::vector<std::pair<Key, T> > & result) const {
+        this->check_no_pending_insert();
         this->c.to_vector().swap(result);
       }
       /// extract the unique keys of a map.
@@ -842,6 +1531,9 @@ namespace dsc  // distributed std container
       size_t insert_1(std::vector<::std::pair<Key, T> >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
         BL_BENCH_INIT(insert);
+        this->local_changed = true;
+        ++this->epoch;
+        this->query_filter.reset();
 
         if (input.size() == 0) {
           BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert", this->comm);
@@ -910,6 +1602,9 @@ namespace dsc  // distributed std container
       size_t insert_p(std::vector<::std::pair<Key, T> >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
         BL_BENCH_INIT(insert);
+        this->local_changed = true;
+        ++this->epoch;
+        this->query_filter.reset();
 
         if (::dsc::empty(input, this->comm)) {
           BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert", this->comm);
@@ -968,6 +1663,10 @@ namespace dsc  // distributed std container
 //            hash is needed.
 //       non-overlap comm can estimate just before insertion for more accurate estimate based on actual input received.
 //          so 32 bit hashes are sufficient.
+        // pick the exchange now:  overlapped exchanges estimate the table size during the permute.
+        ::khmxx::incremental::overlap_mode mode = this->overlap.select(input.size() * sizeof(::std::pair<Key, T>), this->comm);
+        bool overlapped = (mode != ::khmxx::incremental::overlap_mode::none);
+
         // count and estimate and save the bucket ids.
         BL_BENCH_COLLECTIVE_START(insert, "permute_estimate", this->comm);
 #ifdef VTUNE_ANALYSIS
@@ -978,8 +1677,7 @@ namespace dsc  // distributed std container
     	// allocate the bucket sizes array
     std::vector<size_t> send_counts(comm_size, 0);
 
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
-    if (estimate) {
+    if (estimate && overlapped) {
 		  if (comm_size <= std::numeric_limits<uint8_t>::max())
 			  this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
 		    			input.data(), this->hll );
@@ -990,7 +1688,6 @@ namespace dsc  // distributed std container
 		    	this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
 		    			input.data(), this->hll );
       } else {
-#endif
           if (comm_size <= std::numeric_limits<uint8_t>::max())
               this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
                         input.data());
@@ -1001,9 +1698,7 @@ namespace dsc  // distributed std container
                 this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
                         input.data());
 
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
       }
-#endif
 
 #ifdef VTUNE_ANALYSIS
     if (measure_mode == MEASURE_TRANSFORM)
@@ -1030,8 +1725,7 @@ namespace dsc  // distributed std container
   	  	  	  BL_BENCH_END(insert, "a2a_count", recv_counts.size());
 
 
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
-  	  	  	  if (estimate) {
+  	  	  	  if (estimate && overlapped) {
   	        BL_BENCH_COLLECTIVE_START(insert, "alloc_hashtable", this->comm);
   			size_t est = this->hll.estimate_average_per_rank(this->comm);
   			if (est > (this->c.get_max_load_factor() * this->c.capacity()))
@@ -1040,61 +1734,20 @@ namespace dsc  // distributed std container
   	        if (this->comm.rank() == 0) std::cout << "rank " << this->comm.rank() << " estimated size " << est << std::endl;
   	        BL_BENCH_END(insert, "alloc_hashtable", est);
   	  	  	  }
-#endif
 
   	        size_t before = this->c.size();
 
-#if defined(OVERLAPPED_COMM)
-
+        if (overlapped) {
   	      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert", this->comm);
 
-  	      ::khmxx::incremental::ialltoallv_and_modify(input.data(), input.data() + input.size(), send_counts,
+  	      ::khmxx::incremental::ialltoallv_and_modify(mode, input.data(), input.data() + input.size(), send_counts,
   	                                                  [this](int rank, ::std::pair<Key, T>* b, ::std::pair<Key, T>* e){
   	                                                     this->c.insert_no_estimate(b, e);
   	                                                  },
   	                                                  this->comm);
 
   	      BL_BENCH_END(insert, "a2av_insert", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_BATCH)
-
-          BL_BENCH_COLLECTIVE_START(insert, "a2av_insert", this->comm);
-
-          ::khmxx::incremental::ialltoallv_and_modify_batch(input.data(), input.data() + input.size(), send_counts,
-                                                      [this](int rank, ::std::pair<Key, T>* b, ::std::pair<Key, T>* e){
-                                                         this->c.insert_no_estimate(b, e);
-                                                      },
-                                                      this->comm);
-
-          BL_BENCH_END(insert, "a2av_insert", this->c.size());
-
-
-#elif defined(OVERLAPPED_COMM_FULLBUFFER)
-
-  	      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert_fullbuf", this->comm);
-
-  	      ::khmxx::incremental::ialltoallv_and_modify_fullbuffer(input.data(), input.data() + input.size(), send_counts,
-  	                                                  [this](int rank, ::std::pair<Key, T>* b, ::std::pair<Key, T>* e){
-  	                                                     this->c.insert_no_estimate(b, e);
-  	                                                  },
-  	                                                  this->comm);
-
-  	      BL_BENCH_END(insert, "a2av_insert_fullbuf", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_2P)
-
-  	      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert_2pass", this->comm);
-
-  	      ::khmxx::incremental::ialltoallv_and_modify_2phase(input.data(), input.data() + input.size(), send_counts,
-  	                                                  [this](int rank, ::std::pair<Key, T>* b, ::std::pair<Key, T>* e){
-  	                                                     this->c.insert_no_estimate(b, e);
-  	                                                  },
-  	                                                  this->comm);
-
-  	      BL_BENCH_END(insert, "a2av_insert_2pass", this->c.size());
-
-
-#else
+        } else {
 
   	  	  	  BL_BENCH_START(insert);
 #ifdef VTUNE_ANALYSIS
@@ -1171,7 +1824,7 @@ namespace dsc  // distributed std container
     	::utils::mem::aligned_free(distributed);
         BL_BENCH_END(insert, "clean up", recv_total);
 
-#endif // non overlap
+        }  // non overlap
 
         BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_p", this->comm);
 
@@ -1185,6 +1838,7 @@ namespace dsc  // distributed std container
        */
       template <bool estimate = true, typename Predicate = ::bliss::filter::TruePredicate>
       size_t insert(std::vector<::std::pair<Key, T> >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
+    	  this->check_no_pending_insert();
 
     	  if (this->comm.size() == 1) {
     		  return this->template insert_1<estimate>(input, sorted_input, pred);
@@ -1193,8 +1847,239 @@ namespace dsc  // distributed std container
     	  }
       }
 
+      /**
+       * @brief insert into this map and into other in one round:  one transform, one bucketing pass and one exchange.
+       * @details input[i] = (k, (v, w)) inserts (k, v) here and (k, w) into other, e.g. k-mer counts and adjacency
+       *          from the same k-mer stream.  other has to be a map with the same Key and MapParams on the same
+       *          communicator, so that both assign k to the same rank.  both maps' hll see the keys.
+       *          input is permuted.  collective.
+       * @return new entries in this map, and in other.
+       */
+      template <bool estimate = true, typename OtherMap, typename U>
+      ::std::pair<size_t, size_t> insert_fused(OtherMap & other,
+    		  std::vector<::std::pair<Key, ::std::pair<T, U> > >& input) {
+        static_assert(::std::is_same<Key, typename OtherMap::key_type>::value, "fused maps need the same key type.");
+        static_assert(::std::is_same<InternalHash, typename OtherMap::InternalHash>::value,
+        		"fused maps need the same MapParams distribution hash and transform.");
+        if (other.comm.size() != this->comm.size())
+        	throw std::invalid_argument("ERROR: fused maps need communicators of the same size.");
+        this->check_no_pending_insert();
+        other.check_no_pending_insert();
+
+        using fused_type = ::std::pair<Key, ::std::pair<T, U> >;
+
+        BL_BENCH_INIT(insert);
+        this->local_changed = true;
+        ++this->epoch;
+        this->query_filter.reset();
+        other.local_changed = true;
+        ++other.epoch;
+        other.query_filter.reset();
+
+        size_t before = this->c.size();
+        size_t other_before = other.c.size();
+
+        // split received tuples between the two local containers.
+        auto local_insert = [this, &other](fused_type * b, fused_type * e, bool const est) {
+        	size_t n = ::std::distance(b, e);
+        	::std::pair<Key, T>* mine = ::utils::mem::aligned_alloc<::std::pair<Key, T> >(n + InternalHash::batch_size);
+        	::std::pair<Key, U>* theirs = ::utils::mem::aligned_alloc<::std::pair<Key, U> >(n + InternalHash::batch_size);
+        	for (size_t i = 0; i < n; ++i, ++b) {
+        		mine[i].first = b->first;
+        		mine[i].second = b->second.first;
+        		theirs[i].first = b->first;
+        		theirs[i].second = b->second.second;
+        	}
+        	if (est) {
+        		this->c.insert(mine, mine + n);
+        		other.c.insert(theirs, theirs + n);
+        	} else {
+        		this->c.insert_no_estimate(mine, mine + n);
+        		other.c.insert_no_estimate(theirs, theirs + n);
+        	}
+        	::utils::mem::aligned_free(mine);
+        	::utils::mem::aligned_free(theirs);
+        };
+
+        int comm_size = this->comm.size();
+        if (comm_size == 1) {
+        	BL_BENCH_START(insert);
+        	this->transform_input(input);
+        	local_insert(input.data(), input.data() + input.size(), estimate);
+        	BL_BENCH_END(insert, "insert", input.size());
+
+        	BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_fused_1", this->comm);
+        	return ::std::make_pair(this->c.size() - before, other.c.size() - other_before);
+        }
+
+        if (::dsc::empty(input, this->comm)) {
+        	BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_fused", this->comm);
+        	return ::std::make_pair(static_cast<size_t>(0), static_cast<size_t>(0));
+        }
+
+        BL_BENCH_COLLECTIVE_START(insert, "transform", this->comm);
+        fused_type* buffer = ::utils::mem::aligned_alloc<fused_type>(input.size() + InternalHash::batch_size);
+        this->transform_input(input.begin(), input.end(), buffer);
+        BL_BENCH_END(insert, "transform", input.size());
+
+        ::khmxx::incremental::overlap_mode mode = this->overlap.select(input.size() * sizeof(fused_type), this->comm);
+        bool overlapped = (mode != ::khmxx::incremental::overlap_mode::none);
+
+#if defined(SPLITTER_PARTITION)
+        // the splitters decide the owner, so both maps have to use the same ones.
+        if (this->has_splitters && other.has_splitters && (this->splitters != other.splitters))
+        	throw std::invalid_argument("ERROR: fused maps have different splitters.");
+        if (!this->has_splitters && other.has_splitters) {
+        	this->splitters = other.splitters;
+        	this->has_splitters = true;
+        	this->splitters_final = other.splitters_final;
+        }
+        // other's entries fix the splitters as well.
+        if (this->has_splitters && !this->splitters_final && !::mxx::all_of(other.c.size() == 0, this->comm))
+        	this->splitters_final = true;
+#endif
+
+        // one bucketing pass for both maps.  the keys' estimate goes into both maps' hll.
+        BL_BENCH_COLLECTIVE_START(insert, "permute_estimate", this->comm);
+        std::vector<size_t> send_counts(comm_size, 0);
+        if (estimate && overlapped) {
+        	auto fused_hll = this->hll.make_empty_copy();
+        	if (comm_size <= std::numeric_limits<uint8_t>::max())
+        		this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
+        				input.data(), fused_hll);
+        	else if (comm_size <= std::numeric_limits<uint16_t>::max())
+        		this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
+        				input.data(), fused_hll);
+        	else
+        		this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
+        				input.data(), fused_hll);
+        	this->hll.merge(fused_hll);
+        	other.hll.merge(fused_hll);
+        } else {
+        	if (comm_size <= std::numeric_limits<uint8_t>::max())
+        		this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
+        				input.data());
+        	else if (comm_size <= std::numeric_limits<uint16_t>::max())
+        		this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
+        				input.data());
+        	else
+        		this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
+        				input.data());
+        }
+        ::utils::mem::aligned_free(buffer);
+#if defined(SPLITTER_PARTITION)
+        other.splitters = this->splitters;
+        other.has_splitters = this->has_splitters;
+        other.splitters_final = this->splitters_final;
+#endif
+        BL_BENCH_END(insert, "permute_estimate", input.size());
+
+        BL_BENCH_COLLECTIVE_START(insert, "a2a_count", this->comm);
+        std::vector<size_t> recv_counts(comm_size);
+        mxx::all2all(send_counts.data(), 1, recv_counts.data(), this->comm);
+        BL_BENCH_END(insert, "a2a_count", recv_counts.size());
+
+        if (estimate && overlapped) {
+        	// each map by its own hll, since their earlier inserts may differ.
+        	BL_BENCH_COLLECTIVE_START(insert, "alloc_hashtable", this->comm);
+        	size_t est = this->hll.estimate_average_per_rank(this->comm);
+        	if (est > (this->c.get_max_load_factor() * this->c.capacity()))
+        		this->c.reserve(static_cast<size_t>(static_cast<double>(est) * (1.0 + this->hll.est_error_rate + 0.1)));
+        	size_t other_est = other.hll.estimate_average_per_rank(this->comm);
+        	if (other_est > (other.c.get_max_load_factor() * other.c.capacity()))
+        		other.c.reserve(static_cast<size_t>(static_cast<double>(other_est) * (1.0 + other.hll.est_error_rate + 0.1)));
+        	BL_BENCH_END(insert, "alloc_hashtable", est);
+        }
+
+        if (overlapped) {
+        	BL_BENCH_COLLECTIVE_START(insert, "a2av_insert", this->comm);
+        	::khmxx::incremental::ialltoallv_and_modify(mode, input.data(), input.data() + input.size(), send_counts,
+        			[&local_insert](int rank, fused_type* b, fused_type* e){
+        		local_insert(b, e, false);
+        	},
+        	this->comm);
+        	BL_BENCH_END(insert, "a2av_insert", this->c.size());
+        } else {
+        	BL_BENCH_START(insert);
+        	size_t recv_total = std::accumulate(recv_counts.begin(), recv_counts.end(), static_cast<size_t>(0));
+        	fused_type* distributed = ::utils::mem::aligned_alloc<fused_type>(recv_total + InternalHash::batch_size);
+        	BL_BENCH_END(insert, "alloc_output", recv_total);
+
+        	BL_BENCH_COLLECTIVE_START(insert, "a2a", this->comm);
+        	::khmxx::distribute_permuted(input.data(), input.data() + input.size(),
+        			send_counts, distributed, recv_counts, this->comm);
+        	BL_BENCH_END(insert, "a2a", input.size());
+
+        	BL_BENCH_COLLECTIVE_START(insert, "insert", this->comm);
+        	local_insert(distributed, distributed + recv_total, estimate);
+        	BL_BENCH_END(insert, "insert", this->c.size());
+
+        	::utils::mem::aligned_free(distributed);
+        }
+
+        BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_fused", this->comm);
+
+        return ::std::make_pair(this->c.size() - before, other.c.size() - other_before);
+      }
+
     protected:
 
+      /**
+       * @brief small batch query.  keys are bucketed into a copy and exchanged with sparse_query_one_to_one, so
+       *        there is no collective, and only the owners of the keys are contacted.  results are in input order.
+       * @details compute(int src_rank, Key* begin, Key* end, V* out).  tag has to differ between kinds of queries.
+       */
+      template <typename V, typename OP>
+      void query_small(std::vector<Key > const & keys, V * results, OP compute, int const tag) const {
+        BL_BENCH_INIT(query_small);
+
+        int comm_size = this->comm.size();
+        size_t input_size = keys.size();
+
+        BL_BENCH_START(query_small);
+        Key* buffer = ::utils::mem::aligned_alloc<Key>(input_size + InternalHash::batch_size);
+        this->transform_input(keys.begin(), keys.end(), buffer);
+
+        Key* permuted = ::utils::mem::aligned_alloc<Key>(input_size + 1);
+        std::vector<size_t> order(input_size);
+        std::vector<size_t> send_counts(comm_size, 0);
+#if defined(SPLITTER_PARTITION)
+        if (!this->has_splitters) {
+        	// nothing was ever distributed, so every rank is empty.  sampling splitters would be collective.
+        	std::copy(buffer, buffer + input_size, permuted);
+        	::std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+        	send_counts[this->comm.rank()] = input_size;
+        } else
+#endif
+        if (comm_size <= std::numeric_limits<uint8_t>::max())
+        	this->assign_count_permute(buffer, buffer + input_size, static_cast<uint8_t>(comm_size), send_counts,
+        			permuted, order.data());
+        else if (comm_size <= std::numeric_limits<uint16_t>::max())
+        	this->assign_count_permute(buffer, buffer + input_size, static_cast<uint16_t>(comm_size), send_counts,
+        			permuted, order.data());
+        else
+        	this->assign_count_permute(buffer, buffer + input_size, static_cast<uint32_t>(comm_size), send_counts,
+        			permuted, order.data());
+        send_counts.resize(comm_size, 0);   // empty input clears it.
+        ::utils::mem::aligned_free(buffer);
+        BL_BENCH_END(query_small, "permute", input_size);
+
+        BL_BENCH_START(query_small);
+        V* permuted_results = ::utils::mem::aligned_alloc<V>(input_size + 1);
+        ::khmxx::incremental::sparse_query_one_to_one(permuted, send_counts, compute, permuted_results, this->comm, tag);
+        BL_BENCH_END(query_small, "sparse_query", input_size);
+
+        BL_BENCH_START(query_small);
+        for (size_t j = 0; j < input_size; ++j) {
+        	results[order[j]] = permuted_results[j];
+        }
+        ::utils::mem::aligned_free(permuted_results);
+        ::utils::mem::aligned_free(permuted);
+        BL_BENCH_END(query_small, "unpermute", input_size);
+
+        BL_BENCH_REPORT_NAMED(query_small, "hashmap:query_small");
+      }
+
       /**
        * @brief count new elements in the distributed batched_robinhood_multimap.
        * @param input  vector.  will be permuted.
@@ -1258,7 +2143,8 @@ namespace dsc  // distributed std container
       size_t count_p(std::vector<Key >& input,
     		  count_result_type * results,
     		  bool sorted_input = false,
-    		  Predicate const & pred = Predicate()) const {
+    		  Predicate const & pred = Predicate(),
+    		  size_t * order = nullptr) const {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
         BL_BENCH_INIT(count);
 
@@ -1284,7 +2170,7 @@ namespace dsc  // distributed std container
 
             BL_BENCH_COLLECTIVE_START(count, "alloc", this->comm);
           // get mapping to proc
-          // TODO: keep unique only may not be needed - comm speed may be faster than we can compute unique.
+          // repeated keys are dropped after bucketing if the estimate says it pays, see dedup_split.
 //          auto recv_counts(::dsc::distribute(input, this->key_to_rank, sorted_input, this->comm));
 //          BLISS_UNUSED(recv_counts);
 #ifdef VTUNE_ANALYSIS
@@ -1316,6 +2202,26 @@ namespace dsc  // distributed std container
 #endif
   	        BL_BENCH_END(count, "transform", input.size());
 
+  	        // keys that the replicated filter rules out, and cached keys, are answered here.
+  	        BL_BENCH_START(count);
+  	        std::vector<Key> local_keys;
+  	        std::vector<count_result_type> local_answers;
+  	        std::vector<size_t> local_positions;
+  	        count_result_type * local_results = results;
+  	        bool use_cache = ::std::is_same<Predicate, ::bliss::filter::TruePredicate>::value && this->count_cache.active();
+  	        bool use_local = use_cache || this->query_filter.active();
+  	        if (use_local)
+  	        	this->local_split(input, buffer, local_keys, local_answers, order ? &local_positions : nullptr,
+  	        			[this, use_cache](Key const & k, count_result_type & r) -> bool {
+  	        		if (this->query_filter.active() &&
+  	        				!this->query_filter.contains(static_cast<uint64_t>(this->key_to_hash(k)))) {
+  	        			r = static_cast<count_result_type>(0);
+  	        			return true;
+  	        		}
+  	        		return use_cache && this->count_cache.find(k, this->epoch, r);
+  	        	});
+  	        BL_BENCH_END(count, "local", input.size());
+
 
 
         // count and estimate and save the bucket ids.
@@ -1327,16 +2233,30 @@ namespace dsc  // distributed std container
     	// allocate an HLL
     	// allocate the bucket sizes array
     std::vector<size_t> send_counts(comm_size, 0);
+    // estimate the distinct keys too, to decide on deduplication.
+    hyperloglog64<Key, InternalHash, 12> query_hll;
 
+    if (this->query_dedup_ratio > 0.0) {
+		  if (comm_size <= std::numeric_limits<uint8_t>::max())
+			  this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
+		    			input.data(), query_hll, order );
+		  else if (comm_size <= std::numeric_limits<uint16_t>::max())
+	    	  this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
+	    			  input.data(), query_hll, order );
+		  else    // mpi supports only 31 bit worth of ranks.
+		    	this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
+		    			input.data(), query_hll, order );
+    } else {
 		  if (comm_size <= std::numeric_limits<uint8_t>::max())
 			  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
-		    			input.data() );
+		    			input.data(), order );
 		  else if (comm_size <= std::numeric_limits<uint16_t>::max())
 	    	  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
-	    			  input.data() );
+	    			  input.data(), order );
 		  else    // mpi supports only 31 bit worth of ranks.
 		    	this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
-		    			input.data());
+		    			input.data(), order);
+    }
 
 #ifdef VTUNE_ANALYSIS
     if (measure_mode == MEASURE_TRANSFORM)
@@ -1347,6 +2267,30 @@ namespace dsc  // distributed std container
         BL_BENCH_END(count, "permute", input.size());
 
 
+#if defined(SHARED_WINDOW_QUERY)
+        // keys owned on this node: read the owner's shared copy.  only the rest go through the all2all.
+        BL_BENCH_COLLECTIVE_START(count, "shared_local", this->comm);
+        std::vector<Key> all_input;
+        std::vector<size_t> all_counts;
+        count_result_type * all_results = results;
+        bool use_shared = this->shared_split(input, send_counts, results, all_input, all_counts,
+        		[&pred](typename local_container_type::shared_view const & view, Key const * b, Key const * e, count_result_type * out){
+        	view.count(out, b, e, pred, pred);
+        });
+        if (use_shared) results = ::utils::mem::aligned_alloc<count_result_type>(input.size() + 1);
+        BL_BENCH_END(count, "shared_local", all_input.size() - input.size());
+#endif
+
+        // repeated keys:  query each distinct key once, and copy the answers back out.
+        BL_BENCH_START(count);
+        std::vector<Key> dup_input;
+        std::vector<size_t> dup_counts;
+        std::vector<uint32_t> dup_slots;
+        count_result_type * dup_results = results;
+        bool deduped = this->dedup_split(input, send_counts, query_hll.estimate(), dup_input, dup_counts, dup_slots);
+        if (deduped) results = ::utils::mem::aligned_alloc<count_result_type>(input.size() + 1);
+        BL_BENCH_END(count, "dedup", input.size());
+
 
   	BL_BENCH_COLLECTIVE_START(count, "a2a_count", this->comm);
 #ifdef VTUNE_ANALYSIS
@@ -1367,50 +2311,22 @@ namespace dsc  // distributed std container
 
 
 
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH)
-
+        ::khmxx::incremental::overlap_mode mode = this->overlap.select(input.size() * sizeof(Key), this->comm);
+        if (mode != ::khmxx::incremental::overlap_mode::none) {
   	      BL_BENCH_COLLECTIVE_START(count, "a2av_count", this->comm);
 
-  	      ::khmxx::incremental::ialltoallv_and_query_one_to_one(
-  	    		  input.data(), input.data() + input.size(), send_counts,
-  	                                                  [this, &pred](int rank, Key* b, Key* e, count_result_type * out){
-  	                                                     this->c.count(out, b, e, pred, pred);
-  	                                                  },
-													  results,
-  	                                                  this->comm);
+  	      auto count_op = [this, &pred](int rank, Key* b, Key* e, count_result_type * out){
+  	    	  this->c.count(out, b, e, pred, pred);
+  	      };
+  	      if (mode == ::khmxx::incremental::overlap_mode::persistent)
+  	    	  this->persistent_count().query_one_to_one(input.data(), input.data() + input.size(), send_counts,
+  	    			  count_op, results);
+  	      else
+  	    	  ::khmxx::incremental::ialltoallv_and_query_one_to_one(mode, input.data(), input.data() + input.size(), send_counts,
+  	    			  count_op, results, this->comm);
 
   	      BL_BENCH_END(count, "a2av_count", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_FULLBUFFER)
-
-	      BL_BENCH_COLLECTIVE_START(count, "a2av_count_fullbuf", this->comm);
-
-	      ::khmxx::incremental::ialltoallv_and_query_one_to_one_fullbuffer(
-	    		  input.data(), input.data() + input.size(), send_counts,
-	                                                  [this, &pred](int rank, Key* b, Key* e, count_result_type * out){
-	                                                     this->c.count(out, b, e, pred, pred);
-	                                                  },
-												  results,
-	                                                  this->comm);
-
-	      BL_BENCH_END(count, "a2av_count_fullbuf", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_2P)
-
-	      BL_BENCH_COLLECTIVE_START(count, "a2av_count", this->comm);
-
-	      ::khmxx::incremental::ialltoallv_and_query_one_to_one_2phase(
-	    		  input.data(), input.data() + input.size(), send_counts,
-	                                                  [this, &pred](int rank, Key* b, Key* e, count_result_type * out){
-	                                                     this->c.count(out, b, e, pred, pred);
-	                                                  },
-												  results,
-	                                                  this->comm);
-
-	      BL_BENCH_END(count, "a2av_count", this->c.size());
-
-
-#else
+        } else {
 
   	  	  	  BL_BENCH_START(count);
 #ifdef VTUNE_ANALYSIS
@@ -1508,7 +2424,27 @@ if (measure_mode == MEASURE_A2A)
         BL_BENCH_END(count, "a2a2", input.size());
 
 
-#endif // non overlap
+        }  // non overlap
+
+        if (deduped) {
+        	this->dedup_merge(input, dup_input, dup_slots, results, dup_results);
+        	::utils::mem::aligned_free(results);
+        	results = dup_results;
+        }
+
+#if defined(SHARED_WINDOW_QUERY)
+        if (use_shared) {
+        	this->shared_merge(input, all_input, all_counts, results, all_results);
+        	::utils::mem::aligned_free(results);
+        }
+#endif
+
+        if (use_cache) {
+        	for (size_t j = 0; j < input.size(); ++j) {
+        		this->count_cache.insert(input[j], this->epoch, local_results[j]);
+        	}
+        }
+        if (use_local) this->local_merge(input, local_keys, local_answers, local_positions, local_results, order);
 
         BL_BENCH_REPORT_MPI_NAMED(count, "hashmap:count_p", this->comm);
 
@@ -1522,6 +2458,7 @@ if (measure_mode == MEASURE_A2A)
       ::std::vector<count_result_type > count(::std::vector<Key>& keys, bool sorted_input = false,
                                                         Predicate const& pred = Predicate() ) const {
 
+    	  this->check_no_pending_insert();
     	  ::std::vector<count_result_type > results(keys.size(), 0);
         if (this->comm.size() == 1) {
           count_1(keys, results.data(), sorted_input, pred);
@@ -1537,6 +2474,7 @@ if (measure_mode == MEASURE_A2A)
     		  bool sorted_input = false,
 			Predicate const& pred = Predicate() ) const {
 
+    	  this->check_no_pending_insert();
     	  size_t res = 0;
         if (this->comm.size() == 1) {
           res = count_1(keys, results, sorted_input, pred);
@@ -1546,6 +2484,46 @@ if (measure_mode == MEASURE_A2A)
         return res;
       }
 
+      /**
+       * @brief count, and report where each result came from instead of restoring input order.
+       * @details keys are permuted in place and results[j] is for keys[j] as permuted.  order[j] is the position
+       *          of keys[j] in the input, so callers that tag their queries can scatter results themselves.
+       */
+      template <class Predicate = ::bliss::filter::TruePredicate>
+      size_t count(::std::vector<Key>& keys,
+    		  count_result_type * results,
+    		  ::std::vector<size_t> & order,
+			Predicate const& pred = Predicate() ) const {
+
+    	  this->check_no_pending_insert();
+    	  order.resize(keys.size());
+    	  size_t res = 0;
+        if (this->comm.size() == 1) {
+          res = count_1(keys, results, false, pred);
+          ::std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+        } else {
+          res = count_p(keys, results, false, pred, order.data());
+        }
+        return res;
+      }
+
+      /**
+       * @brief count for a few keys, with low latency.  results are in input order and keys are not changed.
+       * @details no collectives:  only the ranks owning the keys are contacted, see query_small.  every rank has to
+       *          call it, possibly with no keys.  for interactive lookups.  large batches are faster with count.
+       */
+      template <class Predicate = ::bliss::filter::TruePredicate>
+      void count_small(::std::vector<Key> const & keys,
+    		  count_result_type * results,
+			Predicate const& pred = Predicate() ) const {
+
+    	  this->check_no_pending_insert();
+    	  this->query_small(keys, results,
+    			  [this, &pred](int, Key* b, Key* e, count_result_type * out) {
+    		  this->c.count(out, b, e, pred, pred);
+    	  }, 1821);
+      }
+
 
 //      template <typename Predicate = ::bliss::filter::TruePredicate>
 //      ::std::vector<::std::pair<Key, size_type> > count(Predicate const & pred = Predicate()) const {
@@ -1619,7 +2597,8 @@ if (measure_mode == MEASURE_A2A)
       size_t find_p(std::vector<Key >& input, mapped_type* results,
     		  mapped_type const & nonexistent = mapped_type(),
     		  bool sorted_input = false,
-    		  Predicate const & pred = Predicate()) const {
+    		  Predicate const & pred = Predicate(),
+    		  size_t * order = nullptr) const {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
         BL_BENCH_INIT(find);
 
@@ -1645,7 +2624,7 @@ if (measure_mode == MEASURE_A2A)
 
             BL_BENCH_COLLECTIVE_START(find, "alloc", this->comm);
           // get mapping to proc
-          // TODO: keep unique only may not be needed - comm speed may be faster than we can compute unique.
+          // repeated keys are dropped after bucketing if the estimate says it pays, see dedup_split.
 //          auto recv_counts(::dsc::distribute(input, this->key_to_rank, sorted_input, this->comm));
 //          BLISS_UNUSED(recv_counts);
 #ifdef VTUNE_ANALYSIS
@@ -1677,6 +2656,26 @@ if (measure_mode == MEASURE_A2A)
 #endif
   	        BL_BENCH_END(find, "transform", input.size());
 
+  	        // keys that the replicated filter rules out, and cached keys, are answered here.
+  	        BL_BENCH_START(find);
+  	        std::vector<Key> local_keys;
+  	        std::vector<mapped_type> local_answers;
+  	        std::vector<size_t> local_positions;
+  	        mapped_type * local_results = results;
+  	        bool use_cache = ::std::is_same<Predicate, ::bliss::filter::TruePredicate>::value && this->find_cache.active();
+  	        bool use_local = use_cache || this->query_filter.active();
+  	        if (use_local)
+  	        	this->local_split(input, buffer, local_keys, local_answers, order ? &local_positions : nullptr,
+  	        			[this, use_cache, &nonexistent](Key const & k, mapped_type & r) -> bool {
+  	        		if (this->query_filter.active() &&
+  	        				!this->query_filter.contains(static_cast<uint64_t>(this->key_to_hash(k)))) {
+  	        			r = nonexistent;
+  	        			return true;
+  	        		}
+  	        		return use_cache && this->find_cache.find(k, this->epoch, r);
+  	        	});
+  	        BL_BENCH_END(find, "local", input.size());
+
 
 
         // count and estimate and save the bucket ids.
@@ -1688,16 +2687,30 @@ if (measure_mode == MEASURE_A2A)
     	// allocate an HLL
     	// allocate the bucket sizes array
     std::vector<size_t> send_counts(comm_size, 0);
+    // estimate the distinct keys too, to decide on deduplication.
+    hyperloglog64<Key, InternalHash, 12> query_hll;
 
+    if (this->query_dedup_ratio > 0.0) {
+		  if (comm_size <= std::numeric_limits<uint8_t>::max())
+			  this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
+		    			input.data(), query_hll, order );
+		  else if (comm_size <= std::numeric_limits<uint16_t>::max())
+	    	  this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
+	    			  input.data(), query_hll, order );
+		  else    // mpi supports only 31 bit worth of ranks.
+		    	this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
+		    			input.data(), query_hll, order );
+    } else {
 		  if (comm_size <= std::numeric_limits<uint8_t>::max())
 			  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
-		    			input.data() );
+		    			input.data(), order );
 		  else if (comm_size <= std::numeric_limits<uint16_t>::max())
 	    	  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
-	    			  input.data() );
+	    			  input.data(), order );
 		  else    // mpi supports only 31 bit worth of ranks.
 		    	this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
-		    			input.data());
+		    			input.data(), order);
+    }
 
 #ifdef VTUNE_ANALYSIS
     if (measure_mode == MEASURE_TRANSFORM)
@@ -1708,6 +2721,30 @@ if (measure_mode == MEASURE_A2A)
         BL_BENCH_END(find, "permute", input.size());
 
 
+#if defined(SHARED_WINDOW_QUERY)
+        // keys owned on this node: read the owner's shared copy.  only the rest go through the all2all.
+        BL_BENCH_COLLECTIVE_START(find, "shared_local", this->comm);
+        std::vector<Key> all_input;
+        std::vector<size_t> all_counts;
+        mapped_type * all_results = results;
+        bool use_shared = this->shared_split(input, send_counts, results, all_input, all_counts,
+        		[&pred, &nonexistent](typename local_container_type::shared_view const & view, Key const * b, Key const * e, mapped_type * out){
+        	view.find(out, b, e, nonexistent, pred, pred);
+        });
+        if (use_shared) results = ::utils::mem::aligned_alloc<mapped_type>(input.size() + 1);
+        BL_BENCH_END(find, "shared_local", all_input.size() - input.size());
+#endif
+
+        // repeated keys:  query each distinct key once, and copy the answers back out.
+        BL_BENCH_START(find);
+        std::vector<Key> dup_input;
+        std::vector<size_t> dup_counts;
+        std::vector<uint32_t> dup_slots;
+        mapped_type * dup_results = results;
+        bool deduped = this->dedup_split(input, send_counts, query_hll.estimate(), dup_input, dup_counts, dup_slots);
+        if (deduped) results = ::utils::mem::aligned_alloc<mapped_type>(input.size() + 1);
+        BL_BENCH_END(find, "dedup", input.size());
+
 
   	BL_BENCH_COLLECTIVE_START(find, "a2a_count", this->comm);
 #ifdef VTUNE_ANALYSIS
@@ -1728,51 +2765,22 @@ if (measure_mode == MEASURE_A2A)
 
 
 
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH)
-
+        ::khmxx::incremental::overlap_mode mode = this->overlap.select(input.size() * sizeof(Key), this->comm);
+        if (mode != ::khmxx::incremental::overlap_mode::none) {
   	      BL_BENCH_COLLECTIVE_START(find, "a2av_find", this->comm);
 
-  	      ::khmxx::incremental::ialltoallv_and_query_one_to_one(
-  	    		  input.data(), input.data() + input.size(), send_counts,
-  	                                                  [this, &pred, &nonexistent](int rank, Key* b, Key* e, mapped_type * out){
-  	                                                     this->c.find(out, b, e, nonexistent, pred, pred);
-  	                                                  },
-													  results,
-  	                                                  this->comm);
+  	      auto find_op = [this, &pred, &nonexistent](int rank, Key* b, Key* e, mapped_type * out){
+  	    	  this->c.find(out, b, e, nonexistent, pred, pred);
+  	      };
+  	      if (mode == ::khmxx::incremental::overlap_mode::persistent)
+  	    	  this->persistent_find().query_one_to_one(input.data(), input.data() + input.size(), send_counts,
+  	    			  find_op, results);
+  	      else
+  	    	  ::khmxx::incremental::ialltoallv_and_query_one_to_one(mode, input.data(), input.data() + input.size(), send_counts,
+  	    			  find_op, results, this->comm);
 
   	      BL_BENCH_END(find, "a2av_find", this->c.size());
-
-
-#elif defined(OVERLAPPED_COMM_FULLBUFFER)
-
-	      BL_BENCH_COLLECTIVE_START(find, "a2av_find_fullbuf", this->comm);
-
-	      ::khmxx::incremental::ialltoallv_and_query_one_to_one_fullbuffer(
-	    		  input.data(), input.data() + input.size(), send_counts,
-	                                                  [this, &pred, &nonexistent](int rank, Key* b, Key* e, mapped_type * out){
-	                                                     this->c.find(out, b, e, nonexistent, pred, pred);
-	                                                  },
-												  results,
-	                                                  this->comm);
-
-	      BL_BENCH_END(find, "a2av_find_fullbuf", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_2P)
-
-	      BL_BENCH_COLLECTIVE_START(find, "a2av_find_2p", this->comm);
-
-	      ::khmxx::incremental::ialltoallv_and_query_one_to_one_2phase(
-	    		  input.data(), input.data() + input.size(), send_counts,
-	                                                  [this, &pred, &nonexistent](int rank, Key* b, Key* e, mapped_type * out){
-	                                                     this->c.find(out, b, e, nonexistent, pred, pred);
-	                                                  },
-												  results,
-	                                                  this->comm);
-
-	      BL_BENCH_END(find, "a2av_find_2p", this->c.size());
-
-
-#else
+        } else {
 
   	  	  	  BL_BENCH_START(find);
 #ifdef VTUNE_ANALYSIS
@@ -1870,7 +2878,27 @@ if (measure_mode == MEASURE_A2A)
         BL_BENCH_END(find, "a2a2", input.size());
 
 
-#endif // non overlap
+        }  // non overlap
+
+        if (deduped) {
+        	this->dedup_merge(input, dup_input, dup_slots, results, dup_results);
+        	::utils::mem::aligned_free(results);
+        	results = dup_results;
+        }
+
+#if defined(SHARED_WINDOW_QUERY)
+        if (use_shared) {
+        	this->shared_merge(input, all_input, all_counts, results, all_results);
+        	::utils::mem::aligned_free(results);
+        }
+#endif
+
+        if (use_cache) {
+        	for (size_t j = 0; j < input.size(); ++j) {
+        		if (!(local_results[j] == nonexistent)) this->find_cache.insert(input[j], this->epoch, local_results[j]);
+        	}
+        }
+        if (use_local) this->local_merge(input, local_keys, local_answers, local_positions, local_results, order);
 
         BL_BENCH_REPORT_MPI_NAMED(find, "hashmap:find_p", this->comm);
 
@@ -1887,6 +2915,7 @@ if (measure_mode == MEASURE_A2A)
     		  bool sorted_input = false,
 			  Predicate const& pred = Predicate() ) const {
 
+    	  this->check_no_pending_insert();
     	  ::std::vector<mapped_type > results(keys.size(), 0);
 
     	  if (this->comm.size() == 1) {
@@ -1904,6 +2933,7 @@ if (measure_mode == MEASURE_A2A)
     		  bool sorted_input = false,
 			Predicate const& pred = Predicate() ) const {
 
+    	  this->check_no_pending_insert();
     	  size_t res = 0;
         if (this->comm.size() == 1) {
           res = find_1(keys, results, nonexistent, sorted_input, pred);
@@ -1913,6 +2943,38 @@ if (measure_mode == MEASURE_A2A)
         return res;
       }
 
+      /// find, and report the input position of each result.  see count(keys, results, order, pred).
+      template <class Predicate = ::bliss::filter::TruePredicate>
+      size_t find(::std::vector<Key>& keys, mapped_type * results,
+    		  ::std::vector<size_t> & order,
+    		  mapped_type const & nonexistent = mapped_type(),
+			Predicate const& pred = Predicate() ) const {
+
+    	  this->check_no_pending_insert();
+    	  order.resize(keys.size());
+    	  size_t res = 0;
+        if (this->comm.size() == 1) {
+          res = find_1(keys, results, nonexistent, false, pred);
+          ::std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+        } else {
+          res = find_p(keys, results, nonexistent, false, pred, order.data());
+        }
+        return res;
+      }
+
+      /// find for a few keys, with low latency.  see count_small.
+      template <class Predicate = ::bliss::filter::TruePredicate>
+      void find_small(::std::vector<Key> const & keys, mapped_type * results,
+    		  mapped_type const & nonexistent = mapped_type(),
+			Predicate const& pred = Predicate() ) const {
+
+    	  this->check_no_pending_insert();
+    	  this->query_small(keys, results,
+    			  [this, &nonexistent, &pred](int, Key* b, Key* e, mapped_type * out) {
+    		  this->c.find(out, b, e, nonexistent, pred, pred);
+    	  }, 1831);
+      }
+
 
 #if 0  // TODO: temporarily retired.
       /**
@@ -2113,6 +3175,8 @@ if (measure_mode == MEASURE_A2A)
       size_t erase_1(std::vector<Key >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
         BL_BENCH_INIT(erase);
+        this->local_changed = true;
+        ++this->epoch;
 
         if (::dsc::empty(input, this->comm)) {
           BL_BENCH_REPORT_MPI_NAMED(erase, "base_batched_robinhood_map:erase", this->comm);
@@ -2170,6 +3234,8 @@ if (measure_mode == MEASURE_A2A)
     		  Predicate const & pred = Predicate()) {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
         BL_BENCH_INIT(erase);
+        this->local_changed = true;
+        ++this->epoch;
 
 
 
@@ -2279,12 +3345,11 @@ if (measure_mode == MEASURE_A2A)
 
 
 
-#if defined(OVERLAPPED_COMM) 
-
-
+        ::khmxx::incremental::overlap_mode mode = this->overlap.select(input.size() * sizeof(Key), this->comm);
+        if (mode != ::khmxx::incremental::overlap_mode::none) {
   	      BL_BENCH_COLLECTIVE_START(erase, "a2av_erase", this->comm);
 
-  	      ::khmxx::incremental::ialltoallv_and_modify(
+  	      ::khmxx::incremental::ialltoallv_and_modify(mode,
   	    		  input.data(), input.data() + input.size(), send_counts,
   	                                                  [this, &pred](int rank, Key* b, Key* e){
   	                                                     this->c.erase(b, e, pred, pred);
@@ -2292,55 +3357,7 @@ if (measure_mode == MEASURE_A2A)
   	                                                  this->comm);
 
   	      BL_BENCH_END(erase, "a2av_erase", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_BATCH)
-
-
-          BL_BENCH_COLLECTIVE_START(erase, "a2av_erase_batch", this->comm);
-
-          ::khmxx::incremental::ialltoallv_and_modify_batch(
-              input.data(), input.data() + input.size(), send_counts,
-                                                      [this, &pred](int rank, Key* b, Key* e){
-                                                         this->c.erase(b, e, pred, pred);
-                                                      },
-                                                      this->comm);
-
-          BL_BENCH_END(erase, "a2av_erase_batch", this->c.size());
-
-
-
-#elif defined(OVERLAPPED_COMM_FULLBUFFER)
-
-
-  	      	      BL_BENCH_COLLECTIVE_START(erase, "a2av_erase_fullbuf", this->comm);
-
-  	      ::khmxx::incremental::ialltoallv_and_modify_fullbuffer(
-  	    		  input.data(), input.data() + input.size(), send_counts,
-  	                                                  [this, &pred](int rank, Key* b, Key* e){
-  	                                                     this->c.erase(b, e, pred, pred);
-  	                                                  },
-  	                                                  this->comm);
-
-  	      BL_BENCH_END(erase, "a2av_erase_fullbuf", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_2P)
-
-
-  	      BL_BENCH_COLLECTIVE_START(erase, "a2av_erase_2phase", this->comm);
-
-  	      ::khmxx::incremental::ialltoallv_and_modify_2phase(
-  	    		  input.data(), input.data() + input.size(), send_counts,
-  	                                                  [this, &pred](int rank, Key* b, Key* e){
-  	                                                     this->c.erase(b, e, pred, pred);
-  	                                                  },
-  	                                                  this->comm);
-
-  	      BL_BENCH_END(erase, "a2av_erase_2phase", this->c.size());
-
-
-
-
-#else
+        } else {
 
   	  	  	  BL_BENCH_START(erase);
 #ifdef VTUNE_ANALYSIS
@@ -2406,7 +3423,7 @@ if (measure_mode == MEASURE_A2A)
     ::utils::mem::aligned_free(distributed);
         BL_BENCH_END(erase, "clean up", recv_total);
 
-#endif // non overlap
+        }  // non overlap
 
         BL_BENCH_REPORT_MPI_NAMED(erase, "hashmap:erase_p", this->comm);
 
@@ -2427,6 +3444,7 @@ if (measure_mode == MEASURE_A2A)
       template <typename Predicate = ::bliss::filter::TruePredicate>
       size_t erase(std::vector<Key>& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
 
+    	  this->check_no_pending_insert();
     	  if (this->comm.size() == 1) {
     		  return erase_1(input, sorted_input, pred);
     	  } else {
@@ -2438,6 +3456,38 @@ if (measure_mode == MEASURE_A2A)
 
   };
 
+  template<typename Key, typename T,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container,
+  template <typename> class MapParams, typename Reducer, class Alloc>
+  constexpr ::khmxx::incremental::overlap_mode
+  batched_robinhood_map_base<Key, T, Container, MapParams, Reducer, Alloc>::default_overlap_mode;
+
+  template<typename Key, typename T,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container,
+  template <typename> class MapParams, typename Reducer, class Alloc>
+  constexpr size_t
+  batched_robinhood_map_base<Key, T, Container, MapParams, Reducer, Alloc>::checkpoint_version;
+
+#if defined(MINIMIZER_PARTITION)
+  template<typename Key, typename T,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container,
+  template <typename> class MapParams, typename Reducer, class Alloc>
+  constexpr unsigned int
+  batched_robinhood_map_base<Key, T, Container, MapParams, Reducer, Alloc>::max_minimizer_length;
+  template<typename Key, typename T,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container,
+  template <typename> class MapParams, typename Reducer, class Alloc>
+  constexpr unsigned int
+  batched_robinhood_map_base<Key, T, Container, MapParams, Reducer, Alloc>::minimizer_length;
+#endif
+#if defined(SPLITTER_PARTITION)
+  template<typename Key, typename T,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container,
+  template <typename> class MapParams, typename Reducer, class Alloc>
+  constexpr size_t
+  batched_robinhood_map_base<Key, T, Container, MapParams, Reducer, Alloc>::splitter_oversample;
+#endif
+
 
   /**
    * @brief  distributed robinhood map following std robinhood map's interface.
@@ -2534,17 +3584,20 @@ if (measure_mode == MEASURE_A2A)
    * @tparam Hash   hash function for local and distribution.  requires a template arugment (Key), and a bool (prefix, chooses the MSBs of hash instead of LSBs)
    * @tparam Equal   default to ::std::equal_to<Key>   equal function for the local storage.
    * @tparam Alloc  default to ::std::allocator< ::std::pair<const Key, T> >    allocator for local storage.
+   * @tparam Container  default to ::fsc::hashmap_robinhood_offsets_reduction   local counting storage.
    */
   template<typename Key, typename T,
   template <typename> class MapParams,
-  class Alloc = ::std::allocator< ::std::pair<const Key, T> >
+  class Alloc = ::std::allocator< ::std::pair<const Key, T> >,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container =
+		  ::fsc::hashmap_robinhood_offsets_reduction
   >
-  class counting_batched_robinhood_map : public reduction_batched_robinhood_map<Key, T,
-  	  MapParams, ::std::plus<T>, Alloc > {
+  class counting_batched_robinhood_map : public batched_robinhood_map_base<Key, T,
+  	  Container, MapParams, ::std::plus<T>, Alloc > {
       static_assert(::std::is_integral<T>::value, "count type has to be integral");
 
     protected:
-      using Base = reduction_batched_robinhood_map<Key, T, MapParams, ::std::plus<T>, Alloc>;
+      using Base = batched_robinhood_map_base<Key, T, Container, MapParams, ::std::plus<T>, Alloc>;
 
     public:
       using local_container_type = typename Base::local_container_type;
@@ -2567,9 +3620,17 @@ if (measure_mode == MEASURE_A2A)
 
 
 
-      counting_batched_robinhood_map(const mxx::comm& _comm) : Base(_comm) {}
+      counting_batched_robinhood_map(const mxx::comm& _comm) : Base(_comm), stream_combine(false)
+#if defined(HEAVY_HITTER_COMBINE)
+		, heavy_sampled(false), heavy_batches(0), heavy_share(0.0)
+#endif
+	  {}
 
-      virtual ~counting_batched_robinhood_map() {};
+      /// a batch still in flight is completed and dropped, not inserted.
+      virtual ~counting_batched_robinhood_map() {
+    	  pending.wait();
+    	  pending.clear();
+      };
 
       using Base::insert;
       using Base::count;
@@ -2579,6 +3640,193 @@ if (measure_mode == MEASURE_A2A)
 
 protected:
 
+  // streaming combine:  duplicates that are close together in the input are counted in a small, L2 resident table.
+  // keys seen once go back into the input and are sent as is.  keys with count > 1 are sent as (key, count) pairs.
+  static constexpr size_t stream_combine_probe = 1UL << 16;
+  bool stream_combine;
+
+  using stream_combiner_type = ::fsc::streaming_combiner<Key, T,
+		  typename Base::template StoreTransHash<Key>, typename Base::template StoreTransEqual<Key>, ::std::plus<T> >;
+
+  /// combine input in place, appending keys with count > 1 to counts.  see fsc::combine_keys.
+  void stream_combine_input(std::vector<Key> & input, std::vector<::std::pair<Key, T> > & counts) {
+	  stream_combiner_type comb;
+	  ::fsc::combine_keys(comb, input, counts, stream_combine_probe);
+  }
+
+public:
+  /**
+   * @brief enable or disable combining duplicate keys before distribution.  off by default.  must be the same on all ranks.
+   * @details combining sends fewer keys when duplicates are close together in the input, e.g. high coverage reads.
+   *          the keys and the (key, count) pairs then go in one blocking exchange, so the overlapped and persistent
+   *          exchanges of set_overlap_mode, and the table reserve from the estimate before the exchange, are not used.
+   *          better when the input has many nearby duplicates and the network is slow relative to the insert.
+   */
+  void set_stream_combine(bool enable) {
+	  stream_combine = enable;
+  }
+
+protected:
+
+#if defined(HEAVY_HITTER_COMBINE)
+  // heavy hitters:  keys frequent enough to flood their owner rank are counted in a small per-rank combiner,
+  // and sent as (key, count) pairs with the rest of each distributed insert.
+  static constexpr size_t heavy_sketch_capacity = 1024;
+  static constexpr size_t heavy_sample_size = 1UL << 20;
+  // batches between samples.  input changes character over a stream, e.g. from file to file.
+  static constexpr size_t heavy_resample_period = 16;
+
+  using combiner_type = ::fsc::hashmap_robinhood_offsets_reduction<Key, T,
+		  Base::template StoreTransHash, Base::template StoreTransEqual, ::std::plus<T>, Alloc>;
+  combiner_type combiner;
+  std::vector<Key> heavy_keys;
+  bool heavy_sampled;
+  size_t heavy_batches;   // since the last sample.
+  double heavy_share;     // fraction of the sample that was heavy keys.
+
+  /// sample input for heavy hitters, and reset the combiner to them.  not collective, each rank has its own.
+  void sample_heavy(std::vector<Key> const & input) {
+	  heavy_sampled = true;
+	  heavy_batches = 0;
+
+	  ::fsc::space_saving<Key, typename Base::template StoreTransHash<Key>,
+		  typename Base::template StoreTransEqual<Key> > sketch(heavy_sketch_capacity);
+	  size_t stride = std::max(static_cast<size_t>(1), input.size() / heavy_sample_size);
+	  for (size_t i = 0; i < input.size(); i += stride) {
+		  sketch.update(input[i]);
+	  }
+	  size_t threshold = std::max(std::max(sketch.size() / (8 * this->comm.size()),
+			  2 * sketch.size() / heavy_sketch_capacity), static_cast<size_t>(2));
+
+	  heavy_keys.clear();
+	  size_t heavy_count = 0;
+	  for (auto const & x : sketch.counters()) {
+		  if (x.count < threshold) continue;
+		  heavy_keys.emplace_back(x.key);
+		  heavy_count += x.count - x.error;
+	  }
+	  heavy_share = static_cast<double>(heavy_count) / static_cast<double>(sketch.size());
+
+	  combiner.clear();
+	  combiner.insert_no_estimate(heavy_keys, T(0));
+  }
+
+  /**
+   * @brief move the occurrences of heavy hitters from input into the combiner.
+   * @details heavy: alone adds at least 1/8 of an average rank's share to the owner, or the sketch's
+   *          resolution (2 / capacity) if that is coarser.  the sample is taken from the first non-empty batch,
+   *          then again every heavy_resample_period batches, or on the next batch when the heavy keys cover less
+   *          than half the share they had in the sample.
+   */
+  void combine_heavy(std::vector<Key> & input) {
+	  if (input.size() == 0) return;
+
+	  if (!heavy_sampled || (heavy_batches >= heavy_resample_period)) sample_heavy(input);
+	  ++heavy_batches;
+
+	  // nothing heavy in the sample, so no probe.
+	  if (heavy_keys.size() == 0) return;
+
+	  std::vector<uint8_t> hot(input.size());
+	  combiner.count(hot.data(), input.data(), input.data() + input.size());
+
+	  std::vector<Key> hot_keys;
+	  size_t j = 0;
+	  for (size_t i = 0; i < input.size(); ++i) {
+		  if (hot[i]) hot_keys.emplace_back(input[i]);
+		  else input[j++] = input[i];
+	  }
+
+	  // skew moved:  the heavy keys went cold.
+	  if ((2.0 * static_cast<double>(hot_keys.size())) < (heavy_share * static_cast<double>(input.size())))
+		  heavy_batches = heavy_resample_period;
+
+	  input.resize(j);
+	  combiner.insert_no_estimate(hot_keys, T(1));
+  }
+
+  /// append the combined counts to counts, and reset the combiner.
+  void flush_heavy(std::vector<::std::pair<Key, T> > & counts) {
+	  if (heavy_keys.size() == 0) return;
+
+	  std::vector<::std::pair<Key, T> > heavy_counts = combiner.to_vector();
+	  for (auto const & x : heavy_counts) {
+		  if (x.second != 0) counts.emplace_back(x);
+	  }
+	  combiner.clear();
+	  combiner.insert_no_estimate(heavy_keys, T(0));
+  }
+
+public:
+  /// sample again on the next distributed insert, e.g. when the input changes character.
+  void reset_heavy_hitters() {
+	  heavy_keys.clear();
+	  combiner.clear();
+	  heavy_sampled = false;
+	  heavy_batches = 0;
+  }
+
+protected:
+#endif
+
+  /// transform and bucket by owner rank.  output is the permuted, transformed input.
+  template <typename V>
+  void owner_permute(V* input, size_t const & count, std::vector<size_t> & send_counts) {
+	  int comm_size = this->comm.size();
+	  V* buffer = ::utils::mem::aligned_alloc<V>(count + Base::InternalHash::batch_size);
+	  this->transform_input(input, input + count, buffer);
+	  if (comm_size <= std::numeric_limits<uint8_t>::max())
+		  this->assign_count_permute(buffer, buffer + count, static_cast<uint8_t>(comm_size), send_counts, input);
+	  else if (comm_size <= std::numeric_limits<uint16_t>::max())
+		  this->assign_count_permute(buffer, buffer + count, static_cast<uint16_t>(comm_size), send_counts, input);
+	  else    // mpi supports only 31 bit worth of ranks.
+		  this->assign_count_permute(buffer, buffer + count, static_cast<uint32_t>(comm_size), send_counts, input);
+	  ::utils::mem::aligned_free(buffer);
+  }
+
+  /**
+   * @brief distribute the uncombined keys and the combined (key, count) pairs in the same exchange, then insert both.
+   * @details one count all2all and one alltoallv, instead of a second full round for the pairs.  input and combined
+   *          are transformed and permuted.
+   */
+  template <bool estimate>
+  void insert_combined_p(std::vector<Key> & input, std::vector<::std::pair<Key, T> > & combined) {
+	  BL_BENCH_INIT(insert_combined);
+
+	  BL_BENCH_START(insert_combined);
+	  std::vector<size_t> key_counts(this->comm.size(), 0);
+	  std::vector<size_t> pair_counts(this->comm.size(), 0);
+	  this->owner_permute(input.data(), input.size(), key_counts);
+	  this->owner_permute(combined.data(), combined.size(), pair_counts);
+	  // empty input leaves the counts cleared.
+	  key_counts.resize(this->comm.size(), 0);
+	  pair_counts.resize(this->comm.size(), 0);
+	  BL_BENCH_END(insert_combined, "permute", input.size() + combined.size());
+
+	  BL_BENCH_COLLECTIVE_START(insert_combined, "a2a", this->comm);
+	  std::vector<Key> keys;
+	  std::vector<::std::pair<Key, T> > pairs;
+	  ::khmxx::distribute_permuted_joint(input.data(), key_counts, combined.data(), pair_counts,
+			  keys, pairs, this->comm);
+	  BL_BENCH_END(insert_combined, "a2a", keys.size() + pairs.size());
+
+	  // one insert, so the table is estimated and resized once for both.
+	  BL_BENCH_START(insert_combined);
+	  pairs.reserve(pairs.size() + keys.size());
+	  for (size_t i = 0; i < keys.size(); ++i) pairs.emplace_back(keys[i], T(1));
+	  std::vector<Key>().swap(keys);
+	  BL_BENCH_END(insert_combined, "merge", pairs.size());
+
+	  BL_BENCH_COLLECTIVE_START(insert_combined, "insert", this->comm);
+	  if (estimate)
+		  this->c.insert(pairs.data(), pairs.data() + pairs.size());
+	  else
+		  this->c.insert_no_estimate(pairs.data(), pairs.data() + pairs.size());
+	  BL_BENCH_END(insert_combined, "insert", this->c.size());
+
+	  BL_BENCH_REPORT_MPI_NAMED(insert_combined, "hashmap:insert_combined_p", this->comm);
+  }
+
   /**
    * @brief insert new elements in the distributed batched_robinhood_multimap.
    * @param input  vector.  will be permuted.
@@ -2587,6 +3835,9 @@ protected:
   size_t insert_1(std::vector<Key >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
     // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
     BL_BENCH_INIT(insert);
+    this->local_changed = true;
+    ++this->epoch;
+    this->query_filter.reset();
 
     if (::dsc::empty(input, this->comm)) {
       BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert", this->comm);
@@ -2652,12 +3903,42 @@ if (measure_mode == MEASURE_INSERT)
   size_t insert_p(std::vector<Key >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
     // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
     BL_BENCH_INIT(insert);
+    this->local_changed = true;
+    ++this->epoch;
+    this->query_filter.reset();
 
     if (::dsc::empty(input, this->comm)) {
       BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert", this->comm);
       return 0;
     }
 
+#if defined(HEAVY_HITTER_COMBINE)
+    BL_BENCH_START(insert);
+    this->combine_heavy(input);
+    BL_BENCH_END(insert, "combine_heavy", input.size());
+#endif
+
+    // pre-combined (key, count) pairs, sent with the keys.
+    std::vector<::std::pair<Key, T> > combined;
+    if (this->stream_combine) {
+      BL_BENCH_START(insert);
+      this->stream_combine_input(input, combined);
+      BL_BENCH_END(insert, "stream_combine", combined.size());
+    }
+#if defined(HEAVY_HITTER_COMBINE)
+    this->flush_heavy(combined);
+#endif
+
+    if (mxx::any_of(combined.size() > 0, this->comm)) {
+      BL_BENCH_COLLECTIVE_START(insert, "insert_combined", this->comm);
+      size_t before = this->c.size();
+      this->template insert_combined_p<estimate>(input, combined);
+      BL_BENCH_END(insert, "insert_combined", combined.size());
+
+      BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_p", this->comm);
+      return this->c.size() - before;
+    }
+
     // alloc buffer
     // transform  input->buffer
     // hash, count, estimate, permute -> hll, count, permuted input.  buffer linear read, i2o linear r/w, rand r/w hll, count, and output
@@ -2710,6 +3991,10 @@ if (measure_mode == MEASURE_TRANSFORM)
 //            hash is needed.
 //       non-overlap comm can estimate just before insertion for more accurate estimate based on actual input received.
 //          so 32 bit hashes are sufficient.
+    // pick the exchange now:  overlapped exchanges estimate the table size during the permute.
+    ::khmxx::incremental::overlap_mode mode = this->overlap.select(input.size() * sizeof(Key), this->comm);
+    bool overlapped = (mode != ::khmxx::incremental::overlap_mode::none);
+
             // count and estimate and save the bucket ids.
     BL_BENCH_COLLECTIVE_START(insert, "permute_estimate", this->comm);
     #ifdef VTUNE_ANALYSIS
@@ -2720,8 +4005,7 @@ if (measure_mode == MEASURE_TRANSFORM)
         // allocate the bucket sizes array
     std::vector<size_t> send_counts(comm_size, 0);
     
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
-    if (estimate) {
+    if (estimate && overlapped) {
 	  if (comm_size <= std::numeric_limits<uint8_t>::max())
 		  this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
 	    			input.data(), this->hll );
@@ -2732,7 +4016,6 @@ if (measure_mode == MEASURE_TRANSFORM)
 	    	this->assign_count_estimate_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
 	    			input.data(), this->hll );
     } else {
-#endif
       if (comm_size <= std::numeric_limits<uint8_t>::max())
           this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
                     input.data() );
@@ -2742,9 +4025,7 @@ if (measure_mode == MEASURE_TRANSFORM)
       else    // mpi supports only 31 bit worth of ranks.
             this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
                     input.data() );
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
     }
-#endif
     #ifdef VTUNE_ANALYSIS
     if (measure_mode == MEASURE_TRANSFORM)
         __itt_pause();
@@ -2771,9 +4052,8 @@ if (measure_mode == MEASURE_A2A)
 	  	  	  BL_BENCH_END(insert, "a2a_count", recv_counts.size());
 
 
-#if defined(OVERLAPPED_COMM) || defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
 
-	  	  	  if (estimate) {
+	  	  	  if (estimate && overlapped) {
 	  	        BL_BENCH_COLLECTIVE_START(insert, "alloc_hashtable", this->comm);
 	  	        size_t est = this->hll.estimate_average_per_rank(this->comm);
 	  			if (est > (this->c.get_max_load_factor() * this->c.capacity()))
@@ -2782,61 +4062,19 @@ if (measure_mode == MEASURE_A2A)
 	  	        if (this->comm.rank() == 0) std::cout << "rank " << this->comm.rank() << " estimated size " << est << std::endl;
 	  	        BL_BENCH_END(insert, "alloc_hashtable", est);
 	  	  	  }
-#endif
 	        size_t before = this->c.size();
 
-#if defined(OVERLAPPED_COMM)
-
+        if (overlapped) {
 	      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert", this->comm);
 
-	      ::khmxx::incremental::ialltoallv_and_modify(input.data(), input.data() + input.size(), send_counts,
+	      ::khmxx::incremental::ialltoallv_and_modify(mode, input.data(), input.data() + input.size(), send_counts,
 	                                                  [this](int rank, Key* b, Key* e){
 	                                                     this->c.insert_no_estimate(b, e, T(1));
 	                                                  },
 	                                                  this->comm);
 
 	      BL_BENCH_END(insert, "a2av_insert", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_BATCH)
-
-        BL_BENCH_COLLECTIVE_START(insert, "a2av_insert", this->comm);
-
-        ::khmxx::incremental::ialltoallv_and_modify_batch(input.data(), input.data() + input.size(), send_counts,
-                                                    [this](int rank, Key* b, Key* e){
-                                                       this->c.insert_no_estimate(b, e, T(1));
-                                                    },
-                                                    this->comm);
-
-        BL_BENCH_END(insert, "a2av_insert", this->c.size());
-
-
-#elif defined(OVERLAPPED_COMM_FULLBUFFER)
-
-	      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert_fullbuf", this->comm);
-
-	      ::khmxx::incremental::ialltoallv_and_modify_fullbuffer(input.data(), input.data() + input.size(), send_counts,
-	                                                  [this](int rank, Key* b, Key* e){
-	                                                     this->c.insert_no_estimate(b, e, T(1));
-	                                                  },
-	                                                  this->comm);
-
-	      BL_BENCH_END(insert, "a2av_insert_fullbuf", this->c.size());
-
-#elif defined(OVERLAPPED_COMM_2P)
-
-	      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert_2phase", this->comm);
-
-	      ::khmxx::incremental::ialltoallv_and_modify_2phase(input.data(), input.data() + input.size(), send_counts,
-	                                                  [this](int rank, Key* b, Key* e){
-	                                                     this->c.insert_no_estimate(b, e, T(1));
-	                                                  },
-	                                                  this->comm);
-
-	      BL_BENCH_END(insert, "a2av_insert_2phase", this->c.size());
-
-
-
-#else
+        } else {
 
 	  	  	  BL_BENCH_START(insert);
 #ifdef VTUNE_ANALYSIS
@@ -2916,13 +4154,118 @@ BL_BENCH_START(insert);
 #endif
 
 
-#endif // non overlap
+        }  // non overlap
 
     BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_p", this->comm);
 
     return this->c.size() - before;
   }
 
+#if defined(MINIMIZER_PARTITION)
+  /**
+   * @brief distributed insert that sends runs of consecutive kmers as super-k-mers.
+   * @details input has to be in read order for runs to form.  owners and runs both come from the original kmers,
+   *          which the receiver transforms after decoding.  the strand independent minimizer gives the same owner
+   *          as the transformed kmer.  the heavy hitter and streaming combiners and sorted_input are not used, since
+   *          the runs need the input in read order.  the exchange follows the overlap mode:  overlapped modes
+   *          decode and insert each peer's runs as they arrive, into a table reserved from the global estimate.
+   *          two_phase splits a peer's bytes across runs, so it uses pairwise.
+   * @param input  vector.  unchanged.
+   */
+  template <bool estimate>
+  size_t insert_superkmer(std::vector<Key >& input) {
+    BL_BENCH_INIT(insert);
+    this->local_changed = true;
+    ++this->epoch;
+    this->query_filter.reset();
+
+    if (::dsc::empty(input, this->comm)) {
+      BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert", this->comm);
+      return 0;
+    }
+
+    int comm_size = this->comm.size();
+
+    BL_BENCH_COLLECTIVE_START(insert, "assign", this->comm);
+    std::vector<uint32_t> ranks(input.size());
+    {
+      std::vector<size_t> bucket_sizes;
+      this->assign_by_key(input.data(), input.data() + input.size(), static_cast<uint32_t>(comm_size),
+    		  bucket_sizes, ranks.data());
+    }
+    BL_BENCH_END(insert, "assign", input.size());
+
+    BL_BENCH_START(insert);
+    std::vector<uint8_t> encoded;
+    std::vector<size_t> send_counts;
+    size_t runs = ::fsc::super_kmer_codec<Key>::encode(input.data(), input.size(), ranks.data(), comm_size,
+    		encoded, send_counts);
+    BL_BENCH_END(insert, "encode", runs);
+
+    ::khmxx::incremental::overlap_mode mode = this->overlap.select(encoded.size(), this->comm);
+    if (mode == ::khmxx::incremental::overlap_mode::two_phase) mode = ::khmxx::incremental::overlap_mode::pairwise;
+
+    size_t before = this->c.size();
+    if (mode != ::khmxx::incremental::overlap_mode::none) {
+      if (estimate) {
+        // inserted as they arrive, so reserve from the global estimate of the transformed kmers first.
+        BL_BENCH_COLLECTIVE_START(insert, "alloc_hashtable", this->comm);
+        Key* buffer = ::utils::mem::aligned_alloc<Key>(input.size() + Base::InternalHash::batch_size);
+        this->transform_input(input.begin(), input.end(), buffer);
+        this->hll.update(buffer, input.size());
+        ::utils::mem::aligned_free(buffer);
+        size_t est = this->hll.estimate_average_per_rank(this->comm);
+        if (est > (this->c.get_max_load_factor() * this->c.capacity()))
+          this->c.reserve(static_cast<size_t>(static_cast<double>(est) * (1.0 + this->hll.est_error_rate + 0.1)));
+        BL_BENCH_END(insert, "alloc_hashtable", est);
+      }
+
+      BL_BENCH_COLLECTIVE_START(insert, "a2av_insert", this->comm);
+      std::vector<Key> distributed;
+      ::khmxx::incremental::ialltoallv_and_modify(mode, encoded.data(), encoded.data() + encoded.size(), send_counts,
+                                                  [this, &distributed](int rank, uint8_t* b, uint8_t* e){
+                                                     distributed.clear();
+                                                     ::fsc::super_kmer_codec<Key>::decode(b, e, distributed);
+                                                     this->transform_input(distributed);
+                                                     this->c.insert_no_estimate(distributed, T(1));
+                                                  },
+                                                  this->comm);
+      BL_BENCH_END(insert, "a2av_insert", this->c.size());
+
+      BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_superkmer", this->comm);
+      return this->c.size() - before;
+    }
+
+    BL_BENCH_COLLECTIVE_START(insert, "a2a_count", this->comm);
+    std::vector<size_t> recv_counts(comm_size);
+    mxx::all2all(send_counts.data(), 1, recv_counts.data(), this->comm);
+    size_t recv_total = std::accumulate(recv_counts.begin(), recv_counts.end(), static_cast<size_t>(0));
+    BL_BENCH_END(insert, "a2a_count", recv_total);
+
+    BL_BENCH_COLLECTIVE_START(insert, "a2a", this->comm);
+    std::vector<uint8_t> received(recv_total);
+    ::khmxx::distribute_permuted(encoded.data(), encoded.data() + encoded.size(),
+    		send_counts, received.data(), recv_counts, this->comm);
+    BL_BENCH_END(insert, "a2a", encoded.size());
+
+    BL_BENCH_START(insert);
+    std::vector<Key> distributed;
+    ::fsc::super_kmer_codec<Key>::decode(received.data(), received.data() + recv_total, distributed);
+    this->transform_input(distributed);
+    BL_BENCH_END(insert, "decode", distributed.size());
+
+    BL_BENCH_COLLECTIVE_START(insert, "insert", this->comm);
+    if (estimate)
+    	this->c.insert(distributed, T(1));
+    else
+    	this->c.insert_no_estimate(distributed, T(1));
+    BL_BENCH_END(insert, "insert", this->c.size());
+
+    BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_superkmer", this->comm);
+
+    return this->c.size() - before;
+  }
+#endif
 
 
 public:
@@ -2934,16 +4277,133 @@ public:
       template <bool estimate = true, typename Predicate = ::bliss::filter::TruePredicate>
       size_t insert(std::vector<Key >& input, bool sorted_input = false, Predicate const & pred = Predicate()) {
         // even if count is 0, still need to participate in mpi calls.  if (input.size() == 0) return;
+    	  size_t count = insert_wait<estimate>();  // keep batches in order.
     	  if (this->comm.size() == 1) {
-    		  return this->template insert_1<estimate>(input, sorted_input, pred);
+    		  return count + this->template insert_1<estimate>(input, sorted_input, pred);
     	  } else {
-    		  return this->template insert_p<estimate>(input, sorted_input, pred);
+#if defined(MINIMIZER_PARTITION)
+    		  return count + this->template insert_superkmer<estimate>(input);
+#else
+    		  return count + this->template insert_p<estimate>(input, sorted_input, pred);
+#endif
     	  }
       }
 
+      /**
+       * @brief pipelined insert of one batch from a stream.  transforms, buckets, and posts the exchange of this batch,
+       *        then inserts the previous batch while this batch is in transit.
+       * @details collective: all ranks must submit the same number of batches.  input is consumed (empty on return).
+       *          the last batch stays in flight until insert_wait(), the next insert_submit() or insert().  all other
+       *          collective reads and modifications, e.g. count, find, erase, to_vector, checkpoint and restore, throw
+       *          std::logic_error while a batch is in flight, so call insert_wait() first.
+       * @return  number of new entries from the previous batch.
+       */
+      template <bool estimate = true>
+      size_t insert_submit(std::vector<Key >& input) {
+    	  if (this->comm.size() == 1) {
+    		  size_t count = this->template insert_1<estimate>(input);
+    		  std::vector<Key>().swap(input);
+    		  return count;
+    	  }
+
+    	  BL_BENCH_INIT(insert);
+
+    	  BL_BENCH_START(insert);
+    	  int comm_size = this->comm.size();
+    	  Key* buffer = ::utils::mem::aligned_alloc<Key>(input.size() + Base::InternalHash::batch_size);
+
+    	  this->transform_input(input.begin(), input.end(), buffer);
+    	  BL_BENCH_END(insert, "transform", input.size());
+
+    	  // previous batch may be in flight.  help it along.
+    	  pending.test();
+
+    	  BL_BENCH_START(insert);
+    	  std::vector<size_t> send_counts(comm_size, 0);
+    	  if (comm_size <= std::numeric_limits<uint8_t>::max())
+    		  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint8_t>(comm_size), send_counts,
+    				  input.data() );
+    	  else if (comm_size <= std::numeric_limits<uint16_t>::max())
+    		  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint16_t>(comm_size), send_counts,
+    				  input.data() );
+    	  else    // mpi supports only 31 bit worth of ranks.
+    		  this->assign_count_permute(buffer, buffer + input.size(), static_cast<uint32_t>(comm_size), send_counts,
+    				  input.data() );
+    	  ::utils::mem::aligned_free(buffer);
+    	  BL_BENCH_END(insert, "permute", input.size());
+
+    	  // post this batch, then insert the previous one while this one is in transit.
+    	  BL_BENCH_START(insert);
+    	  ::khmxx::incremental::ialltoallv_post(input, send_counts, next, this->comm);
+    	  BL_BENCH_END(insert, "post", next.recv_total);
+
+    	  BL_BENCH_START(insert);
+    	  size_t count = insert_wait<estimate>();
+    	  pending.swap(next);
+    	  BL_BENCH_END(insert, "insert_prev", count);
+
+    	  BL_BENCH_REPORT_MPI_NAMED(insert, "hashmap:insert_submit", this->comm);
+
+    	  return count;
+      }
+
+      /**
+       * @brief complete and insert the batch in flight, if any.  not collective.
+       * @return  number of new entries.
+       */
+      template <bool estimate = true>
+      size_t insert_wait() {
+    	  if (!pending.active()) return 0;
+
+    	  this->local_changed = true;
+    	  ++this->epoch;
+    	  this->query_filter.reset();
+    	  size_t before = this->c.size();
+    	  ::khmxx::incremental::ialltoallv_complete(pending, [this](Key* b, Key* e){
+    		  if (estimate)
+    			  this->c.insert(b, e, T(1));
+    		  else
+    			  this->c.insert_no_estimate(b, e, T(1));
+    	  });
+    	  return this->c.size() - before;
+      }
+
+    protected:
+      /// batch in flight for insert_submit.  next is only used during insert_submit.
+      ::khmxx::incremental::ialltoallv_handle<Key> pending;
+      ::khmxx::incremental::ialltoallv_handle<Key> next;
+
+      virtual bool insert_pending() const {
+    	  return pending.active();
+      }
+
   };
 
+  template<typename Key, typename T, template <typename> class MapParams, class Alloc,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container>
+  constexpr size_t counting_batched_robinhood_map<Key, T, MapParams, Alloc, Container>::stream_combine_probe;
 
+#if defined(HEAVY_HITTER_COMBINE)
+  template<typename Key, typename T, template <typename> class MapParams, class Alloc,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container>
+  constexpr size_t counting_batched_robinhood_map<Key, T, MapParams, Alloc, Container>::heavy_sketch_capacity;
+  template<typename Key, typename T, template <typename> class MapParams, class Alloc,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container>
+  constexpr size_t counting_batched_robinhood_map<Key, T, MapParams, Alloc, Container>::heavy_sample_size;
+  template<typename Key, typename T, template <typename> class MapParams, class Alloc,
+  template <typename, typename, template <typename> class, template <typename> class, typename...> class Container>
+  constexpr size_t counting_batched_robinhood_map<Key, T, MapParams, Alloc, Container>::heavy_resample_period;
+#endif
+
+
+  /**
+   * @brief  distributed counting map backed by a direct address table per rank.  for small k (k <= 14), where 4^k counters fit in memory.
+   */
+  template<typename Key, typename T,
+  template <typename> class MapParams,
+  class Alloc = ::std::allocator< ::std::pair<const Key, T> >
+  >
+  using counting_direct_address_map = counting_batched_robinhood_map<Key, T, MapParams, Alloc, ::fsc::direct_address_counting_map>;
 
 
 
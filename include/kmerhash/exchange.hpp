@@ -0,0 +1,293 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * exchange.hpp
+ *
+ * the exchanges of the distributed maps, for any communicator with the interface of khmxx::thread_comm:
+ *   size, rank, barrier, all2all, all2allv, allreduce, and isend/issend/irsend/irecv returning a Comm::request
+ *   with test() and wait().
+ * khmxx::mpi_comm in incremental_mxx.hpp wraps an ::mxx::comm this way, and the ::mxx::comm versions of these
+ * functions there call the ones here.  thread_comm runs them on threads of one process.
+ *
+ * no mxx or MPI here, and no BL_BENCH timing, since the timers report through mxx.
+ *
+ * the distributed and hybrid maps themselves still hold an ::mxx::comm, and call mxx collectives (hll estimates,
+ * splitters, checkpoint, empty checks) and the mxx timers directly, so they do not run on a thread_comm.  only these
+ * exchanges, the bulk of their communication, are communicator independent.
+ */
+
+#ifndef KMERHASH_EXCHANGE_HPP_
+#define KMERHASH_EXCHANGE_HPP_
+
+#include <vector>
+#include <iterator>  // iterator_traits, distance
+#include <type_traits>  // enable_if
+#include <algorithm>  // max, swap
+#include <functional>  // logical_and
+#include <cassert>
+
+#include "kmerhash/mem_utils.hpp"
+
+namespace khmxx {
+
+  /// true if x is true on all ranks.  collective.
+  template <typename Comm>
+  inline bool all_of(bool const & x, Comm const & _comm) {
+    return _comm.allreduce(x, ::std::logical_and<bool>());
+  }
+
+  /// distribute data that has been permuted and the counts are in send_counts.  recv_counts should contain the target counts
+  template <typename T, typename Comm>
+  void distribute_permuted(T* _begin, T* _end,
+                   ::std::vector<size_t> const & send_counts,
+                   T* output,
+                   ::std::vector<size_t> & recv_counts,
+                   Comm const &_comm) {
+    if (::khmxx::all_of(_begin == _end, _comm)) return;
+
+    _comm.all2allv(_begin, send_counts, output, recv_counts);
+  }
+
+  namespace incremental {
+
+    /// incremental alltoallv and compute.  Assume the input is already permuted.
+    /// uses the pairwise exchange algorithm.  for power of 2, use xor to find peer.
+    /// for non-power of 2, send and receive with rank + i.
+    /// use issend to avoid buffering.  post all send at once since input is not changing
+    /// operator should have the form op(int rank, V* start, V* end), where V is type of input (same as IT value type.)
+    template <typename IT, typename SIZE, typename OP, typename Comm,
+        typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
+                                                 ::std::random_access_iterator_tag >::value, int>::type = 1 >
+    void ialltoallv_and_modify(IT permuted, IT permuted_end,
+                               ::std::vector<SIZE> const & send_counts,
+                               OP compute,
+                               Comm const &_comm) {
+      int comm_size = _comm.size();
+      int comm_rank = _comm.rank();
+
+      size_t input_size = ::std::distance(permuted, permuted_end);
+
+      assert((static_cast<int>(send_counts.size()) == comm_size) && "send_count size not same as _comm size.");
+
+      // make sure there is something to do.
+      if (::khmxx::all_of(input_size == 0, _comm)) return;
+
+      if (comm_size == 1) {
+        compute(0, permuted, permuted_end);
+        return;
+      }
+
+      // get the recv counts.
+      ::std::vector<SIZE> recv_counts(send_counts.size(), 0);
+      _comm.all2all(send_counts.data(), 1, recv_counts.data());
+
+      // compute displacement for send, also compute the max buffer size needed
+      ::std::vector<size_t> send_displs;
+      send_displs.reserve(send_counts.size() + 1);
+      SIZE buffer_max = 0;
+      send_displs.emplace_back(0UL);
+      for (int i = 0; i < comm_size; ++i) {
+        buffer_max = ::std::max(buffer_max, recv_counts[i]);
+        send_displs.emplace_back(send_displs.back() + send_counts[i]);
+      }
+
+      // double buffered receive.
+      using V = typename ::std::iterator_traits<IT>::value_type;
+      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max << 1, 64);
+      V* recving = buffers;
+      V* computing = buffers + buffer_max;
+
+      const int ialltoallv_tag = 1773;
+      using request = typename Comm::request;
+      ::std::vector<request> reqs(comm_size - 1);
+
+      // process self data
+      compute(comm_rank, &(*(permuted + send_displs[comm_rank])),
+              &(*(permuted + send_displs[comm_rank] + send_counts[comm_rank])));
+
+      bool is_pow2 = (comm_size & (comm_size - 1)) == 0;
+      int step;
+      int curr_peer;
+
+      // issend all, avoids buffering.
+      for (step = 1; step < comm_size; ++step) {
+        curr_peer = is_pow2 ? (comm_rank ^ step) : ((comm_rank + comm_size - step) % comm_size);
+        reqs[step - 1] = _comm.issend(&(*(permuted + send_displs[curr_peer])), send_counts[curr_peer],
+                                      curr_peer, ialltoallv_tag);
+      }
+      // kick start send.
+      for (auto & r : reqs) r.test();
+
+      // receive one peer while computing on the previous one.
+      int prev_peer = comm_rank;
+      request req;
+      int step2;
+      for (step = 1, step2 = 0; step2 < comm_size; ++step, ++step2) {
+        // receive peer.  note that this is diff than send peer.
+        curr_peer = is_pow2 ? (comm_rank ^ step) : ((comm_rank + step) % comm_size);
+
+        if (step < comm_size) {
+          req = _comm.irecv(recving, recv_counts[curr_peer], curr_peer, ialltoallv_tag);
+        }
+
+        // process previously received. note: delayed by 1 cycle.
+        if (step2 > 0) {
+          compute(prev_peer, computing, computing + recv_counts[prev_peer]);
+        }
+
+        if (step < comm_size) {
+          req.wait();
+        }
+
+        ::std::swap(recving, computing);
+        prev_peer = curr_peer;
+      }
+
+      for (auto & r : reqs) r.wait();
+
+      ::utils::mem::aligned_free(buffers);
+    }
+
+    /// incremental ialltoallv, compute, and respond.  Assume the input is already permuted.
+    /// this version requires one-to-one input/output mapping.
+    /// uses pairwise exchange.  use isend for queries, and irsend for responses since their receives are posted first.
+    /// operator should have the form op(int rank, V* start, V* end, U* out).
+    template <typename IT, typename SIZE, typename OP, typename OT, typename Comm,
+        typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
+                                                 ::std::random_access_iterator_tag >::value &&
+                                  ::std::is_same<typename ::std::iterator_traits<OT>::iterator_category,
+                                                 ::std::random_access_iterator_tag >::value, int>::type = 1>
+    void ialltoallv_and_query_one_to_one(IT permuted, IT permuted_end,
+                                         ::std::vector<SIZE> const & send_counts,
+                                         OP compute,
+                                         OT result,
+                                         Comm const &_comm) {
+      int comm_size = _comm.size();
+      int comm_rank = _comm.rank();
+
+      size_t input_size = ::std::distance(permuted, permuted_end);
+
+      assert((send_counts.size() == static_cast<size_t>(comm_size)) && "send_count size not same as _comm size.");
+
+      // make sure there is something to do.
+      if (::khmxx::all_of(input_size == 0, _comm)) return;
+
+      if (comm_size == 1) {
+        compute(0, permuted, permuted_end, result);
+        return;
+      }
+
+      // get the recv counts.
+      ::std::vector<SIZE> recv_counts(send_counts.size(), 0);
+      _comm.all2all(send_counts.data(), 1, recv_counts.data());
+
+      ::std::vector<size_t> send_displs;
+      send_displs.reserve(send_counts.size() + 1);
+      SIZE buffer_max = 0;
+      send_displs.emplace_back(0UL);
+      for (int i = 0; i < comm_size; ++i) {
+        buffer_max = ::std::max(buffer_max, recv_counts[i]);
+        send_displs.emplace_back(send_displs.back() + send_counts[i]);
+      }
+
+      // double buffered queries and responses.
+      using V = typename ::std::iterator_traits<IT>::value_type;
+      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max << 1);
+      V* recving = buffers;
+      V* computing = buffers + buffer_max;
+
+      using U = typename ::std::iterator_traits<OT>::value_type;
+      U* out_buffers = ::utils::mem::aligned_alloc<U>(buffer_max << 1);
+      U* storing = out_buffers;
+      U* sending = out_buffers + buffer_max;
+
+      const int query_tag = 1773;
+      const int resp_tag = 1779;
+
+      using request = typename Comm::request;
+      ::std::vector<request> q_reqs(comm_size - 1);
+      ::std::vector<request> r_reqs(comm_size - 1);
+
+      // PIPELINE:  send_q, recv_q, compute, send_r, recv_r.
+      // send_q and recv_r are posted before the main loop.
+      bool is_pow2 = (comm_size & (comm_size - 1)) == 0;
+      int step;
+      int curr_peer;
+
+      for (step = 1; step < comm_size; ++step) {
+        // source of result and target of query are same.
+        curr_peer = is_pow2 ? (comm_rank ^ step) : ((comm_rank + comm_size - step) % comm_size);
+
+        r_reqs[step - 1] = _comm.irecv(&(*(result + send_displs[curr_peer])), send_counts[curr_peer],
+                                       curr_peer, resp_tag);
+        q_reqs[step - 1] = _comm.isend(&(*(permuted + send_displs[curr_peer])), send_counts[curr_peer],
+                                       curr_peer, query_tag);
+      }
+      _comm.barrier();  // all response receives are posted, for irsend.
+
+      // compute for self rank.
+      compute(comm_rank, &(*(permuted + send_displs[comm_rank])),
+              &(*(permuted + send_displs[comm_rank] + send_counts[comm_rank])),
+              &(*(result + send_displs[comm_rank])));
+
+      int prev_peer = comm_rank, prev_peer2 = comm_rank;
+      request q_req, r_req;
+      int step2, step3;
+
+      // 3 overlapped loops:  receive queries, compute, send responses.
+      for (step = 1, step2 = 0, step3 = -1; step3 < comm_size; ++step, ++step2, ++step3) {
+        // source of query, and target of result
+        curr_peer = is_pow2 ? (comm_rank ^ step) : ((comm_rank + step) % comm_size);
+
+        if (step < comm_size) {
+          q_req = _comm.irecv(recving, recv_counts[curr_peer], curr_peer, query_tag);
+        }
+
+        if (step3 > 0) {
+          r_req = _comm.irsend(sending, recv_counts[prev_peer2], prev_peer2, resp_tag);
+        }
+
+        if ((step2 > 0) && (step2 < comm_size)) {
+          compute(prev_peer, computing, computing + recv_counts[prev_peer], storing);
+        }
+
+        if (step < comm_size) {
+          q_req.wait();
+        }
+        if (step3 > 0) {
+          r_req.wait();
+        }
+
+        ::std::swap(recving, computing);
+        ::std::swap(storing, sending);
+
+        prev_peer2 = prev_peer;
+        prev_peer = curr_peer;
+      }
+
+      for (auto & r : q_reqs) r.wait();
+      for (auto & r : r_reqs) r.wait();
+
+      ::utils::mem::aligned_free(buffers);
+      ::utils::mem::aligned_free(out_buffers);
+    }
+
+  }  // namespace incremental
+
+}  // namespace khmxx
+
+#endif /* KMERHASH_EXCHANGE_HPP_ */
@@ -16,6 +16,7 @@
 #include "math_utils.hpp"
 #include "mem_utils.hpp"
 #include "hash_new.hpp"
+#include "wide_key_equal.hpp"
 
 #include "iterators/transform_iterator.hpp"
 
@@ -282,7 +283,7 @@ public:
     uint16_t *countSortBuf;
     int16_t *info_container;
 
-    Equal<Key> eq;
+    ::fsc::wide_key_equal<Key, Equal<Key> > eq;  // simd compare for 2 and 4 word kmers.
     Hash<Key> hash;
 	hyperloglog64<Key, Hash<Key>, 12> hll;  // precision of 12bits  error rate : 1.04/(2^6)
 
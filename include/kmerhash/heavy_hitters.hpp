@@ -0,0 +1,156 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * heavy_hitters.hpp
+ *
+ * space-saving sketch (Metwally et al. 2005) for finding the most frequent keys in a stream with a fixed number
+ * of counters.  every key with frequency > n / capacity is guaranteed to be tracked, and each tracked count
+ * overestimates the true count by at most its error.
+ *
+ * counters are kept in a min-heap by count, with a hash map from key to heap position, so update is
+ * O(log capacity).
+ */
+
+#ifndef KMERHASH_HEAVY_HITTERS_HPP_
+#define KMERHASH_HEAVY_HITTERS_HPP_
+
+#include <vector>
+#include <unordered_map>
+#include <functional>  // std::hash, std::equal_to
+#include <utility>  // std::swap
+
+namespace fsc {
+
+/**
+ * @brief space-saving top-k sketch.
+ * @tparam Hash   hash functor, any integral result.
+ * @tparam Equal  must be consistent with Hash.
+ */
+template <typename Key, typename Hash = ::std::hash<Key>, typename Equal = ::std::equal_to<Key> >
+class space_saving {
+
+public:
+	struct counter {
+		Key key;
+		size_t count;
+		size_t error;   // count - error is a lower bound of the true count.
+	};
+
+protected:
+	/// unordered_map wants size_t.
+	struct hash_adapter {
+		Hash h;
+		inline size_t operator()(Key const & k) const { return static_cast<size_t>(h(k)); }
+	};
+
+	size_t capacity;
+	size_t total;
+	std::vector<counter> heap;   // min-heap by count.
+	std::unordered_map<Key, size_t, hash_adapter, Equal> pos;   // key -> heap index.
+
+	inline void place(size_t i) {
+		pos[heap[i].key] = i;
+	}
+
+	void sift_down(size_t i) {
+		size_t n = heap.size();
+		size_t c;
+		while ((c = 2 * i + 1) < n) {
+			if ((c + 1 < n) && (heap[c + 1].count < heap[c].count)) ++c;
+			if (heap[i].count <= heap[c].count) break;
+			std::swap(heap[i], heap[c]);
+			place(i);
+			place(c);
+			i = c;
+		}
+	}
+
+	void sift_up(size_t i) {
+		size_t p;
+		while (i > 0) {
+			p = (i - 1) >> 1;
+			if (heap[p].count <= heap[i].count) break;
+			std::swap(heap[i], heap[p]);
+			place(i);
+			place(p);
+			i = p;
+		}
+	}
+
+public:
+	explicit space_saving(size_t const & _capacity = 1024) : capacity(_capacity), total(0) {
+		heap.reserve(capacity);
+		pos.reserve(capacity);
+	}
+
+	/// add one occurrence of k.
+	void update(Key const & k) {
+		++total;
+
+		auto it = pos.find(k);
+		if (it != pos.end()) {
+			++(heap[it->second].count);
+			sift_down(it->second);
+			return;
+		}
+
+		if (heap.size() < capacity) {
+			heap.push_back(counter{k, 1, 0});
+			pos[k] = heap.size() - 1;
+			sift_up(heap.size() - 1);
+			return;
+		}
+
+		// replace the minimum.  the new key inherits its count as error.
+		pos.erase(heap[0].key);
+		heap[0].key = k;
+		heap[0].error = heap[0].count;
+		++(heap[0].count);
+		pos[k] = 0;
+		sift_down(0);
+	}
+
+	template <typename Iter>
+	void update(Iter begin, Iter end) {
+		for (; begin != end; ++begin) update(*begin);
+	}
+
+	/// number of updates so far.
+	inline size_t size() const { return total; }
+
+	/// keys with estimated count >= threshold.  may include keys with true count down to threshold - error.
+	std::vector<Key> heavy(size_t const & threshold) const {
+		std::vector<Key> result;
+		for (size_t i = 0; i < heap.size(); ++i) {
+			if (heap[i].count >= threshold) result.emplace_back(heap[i].key);
+		}
+		return result;
+	}
+
+	/// tracked counters, in heap order.
+	std::vector<counter> const & counters() const { return heap; }
+
+	void clear() {
+		heap.clear();
+		pos.clear();
+		total = 0;
+	}
+};
+
+}  // namespace fsc
+
+#endif /* KMERHASH_HEAVY_HITTERS_HPP_ */
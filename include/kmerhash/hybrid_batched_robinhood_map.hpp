@@ -239,6 +239,20 @@ namespace hsc  // hybrid std container
     protected:
       std::vector<local_container_type> c;
 
+#if defined(MT_ENDPOINTS)
+      /// one dup of comm per thread, so that every thread can run its own exchange.  empty unless the MPI library
+      /// provides MPI_THREAD_MULTIPLE on all ranks.
+      std::vector<mxx::comm> thread_comms;
+      bool mt_endpoints;
+
+      /// one comm per thread, added when there are more threads than at construction.  collective:  as for the
+      /// bucketing, all ranks have to run the same number of threads.
+      void size_thread_comms() {
+        for (int i = this->thread_comms.size(); i < omp_get_max_threads(); ++i)
+          this->thread_comms.emplace_back(this->comm.copy());
+      }
+#endif
+
 
       /// local reduction via a copy of local container type (i.e. batched_robinhood_map).
       /// this takes quite a bit of memory due to use of batched_robinhood_map, but is significantly faster than sorting.
@@ -569,9 +583,8 @@ namespace hsc  // hybrid std container
 //						  }
 //						  std::cout << std::endl;
 //					  }
+					  hll.update_via_hashval(hashvals, block_size);
 					  for (j = 0; j < block_size; ++j) {
-						  hll.update_via_hashval(hashvals[j]);
-
 						  rank = hashvals[j] & bucket_mask; // really (p-1)
 						  *i2o_it = rank;
 						  ++i2o_it;
@@ -584,9 +597,8 @@ namespace hsc  // hybrid std container
 
 				  this->key_to_hash(&(*it), rem, hashvals);
 
+				  hll.update_via_hashval(hashvals, rem);
 				  for (j = 0; j < rem; ++j) {
-					  hll.update_via_hashval(hashvals[j]);
-
 					  rank = hashvals[j] & bucket_mask;  // really (p-1)
 					  *i2o_it = rank;
 					  ++i2o_it;
@@ -598,9 +610,8 @@ namespace hsc  // hybrid std container
 				  for (; i < max; i += block_size, it += block_size) {
 					  this->key_to_hash(&(*it), block_size, hashvals);
 
+					  hll.update_via_hashval(hashvals, block_size);
 					  for (j = 0; j < block_size; ++j) {
-						  hll.update_via_hashval(hashvals[j]);
-
 						  rank = hashvals[j] % num_buckets;
 						  *i2o_it = rank;
 						  ++i2o_it;
@@ -613,9 +624,8 @@ namespace hsc  // hybrid std container
 
 				  this->key_to_hash(&(*it), rem, hashvals);
 
+				  hll.update_via_hashval(hashvals, rem);
 				  for (j = 0; j < rem; ++j) {
-					  hll.update_via_hashval(hashvals[j]);
-
 					  rank = hashvals[j] % num_buckets;
 					  *i2o_it = rank;
 					  ++i2o_it;
@@ -769,6 +779,18 @@ namespace hsc  // hybrid std container
   	  c.resize(omp_get_max_threads());
   	  hlls.resize(omp_get_max_threads());
 
+#if defined(MT_ENDPOINTS)
+  	  int provided;
+  	  MPI_Query_thread(&provided);
+  	  mt_endpoints = mxx::all_of(provided == MPI_THREAD_MULTIPLE, _comm);
+  	  if (mt_endpoints) {
+  		  for (int i = 0; i < omp_get_max_threads(); ++i) {
+  			  thread_comms.emplace_back(_comm.copy());
+  		  }
+  	  } else if (_comm.rank() == 0)
+  		  printf("rank %d MT_ENDPOINTS needs MPI_THREAD_MULTIPLE.  communicating from 1 thread.\n", _comm.rank());
+#endif
+
  //   	  this->c.set_ignored_msb(ceilLog2(_comm.size()));   // NOTE THAT THIS SHOULD MATCH KEY_TO_RANK use of bits in hash table.
 
 	#pragma omp parallel
@@ -1454,8 +1476,13 @@ namespace hsc  // hybrid std container
     
         uint32_t* bid_buf = ::utils::mem::aligned_alloc<uint32_t>(r_end - r_start + batch_size);
 
-    #if defined(OVERLAPPED_COMM) //|| defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
+    #if defined(OVERLAPPED_COMM) || defined(MT_ENDPOINTS) //|| defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
+    #if defined(OVERLAPPED_COMM)
         if (estimate) {
+    #else
+        // the per thread exchange inserts without estimate, so the tables are reserved from the hlls beforehand.
+        if (estimate && this->mt_endpoints) {
+    #endif
             if ( nthreads_global <= std::numeric_limits<uint8_t>::max()) {
             
                 this->assign_count_estimate(buffer, buffer + block, static_cast<uint8_t>(nthreads_global), thread_bucket_sizes[tid],
@@ -1494,7 +1521,7 @@ namespace hsc  // hybrid std container
                     this->assign_count(buffer, buffer + block, static_cast<uint32_t>(nthreads_global), thread_bucket_sizes[tid],
                             reinterpret_cast<uint32_t*>(bid_buf) );
             }
-    #if defined(OVERLAPPED_COMM) //|| defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
+    #if defined(OVERLAPPED_COMM) || defined(MT_ENDPOINTS) //|| defined(OVERLAPPED_COMM_BATCH) || defined(OVERLAPPED_COMM_FULLBUFFER) || defined(OVERLAPPED_COMM_2P)
         }
     #endif
         // do some calc with thread_bucket_sizes to get offsets for each bucket for each thread in node-wide permuted input array.
@@ -1828,6 +1855,50 @@ namespace hsc  // hybrid std container
     BL_BENCH_END(modify, "a2av_modify", after);
 
 #else
+
+#if defined(MT_ENDPOINTS)
+    if (this->mt_endpoints) {
+        // every thread exchanges its own buckets, and inserts blocks as they arrive.
+        if (estimate) {
+            BL_BENCH_COLLECTIVE_START(modify, "alloc_hashtable", this->comm);
+            size_t est = this->hlls[0].estimate_average_per_rank(this->comm);
+
+            #pragma omp parallel
+            {
+                int tid = omp_get_thread_num();
+                int tcnt = omp_get_num_threads();
+
+                size_t lest = (est + tcnt - 1) / tcnt;
+                if (lest > (this->c[tid].get_max_load_factor() * this->c[tid].capacity()))
+                    this->c[tid].reserve(static_cast<size_t>(static_cast<double>(lest) * (1.0 + this->hlls[tid].est_error_rate + 0.1)));
+            }
+            BL_BENCH_END(modify, "alloc_hashtable", est);
+        }
+
+        this->size_thread_comms();
+        BL_BENCH_COLLECTIVE_START(modify, "a2av_modify_mt", this->comm);
+        #pragma omp parallel reduction(+: after)
+        {
+            int tid = omp_get_thread_num();
+            int tcnt = omp_get_num_threads();
+
+            ::khmxx::incremental::thread_alltoallv_and_modify(input.data(),
+                node_bucket_offsets, node_bucket_sizes, rnode_bucket_sizes, tid, tcnt,
+                [tid, &c2](int rank, V* b, V* e){
+                    c2(tid, b, e); // this->c[tid].insert_no_estimate(b, e, T(1));
+                },
+                this->thread_comms[tid]);
+
+            after = this->c[tid].size();
+        }
+        BL_BENCH_END(modify, "a2av_modify_mt", after);
+
+        BL_BENCH_REPORT_MPI_NAMED(modify, "hashmap:modify_p", this->comm);
+
+        return static_cast<int64_t>(after) - static_cast<int64_t>(before);
+    }
+#endif
+
     size_t recv_total = recv_offset;  // for overlap, this would be incorrect but that is okay.
 
     BL_BENCH_START(modify);
@@ -2661,6 +2732,31 @@ namespace hsc  // hybrid std container
     BL_BENCH_END(query, "a2av_query", input.size());
 
 #else
+
+#if defined(MT_ENDPOINTS)
+    if (this->mt_endpoints) {
+        // every thread exchanges its own buckets, answers query blocks as they arrive, and gets its results in place.
+        this->size_thread_comms();
+        BL_BENCH_COLLECTIVE_START(query, "a2av_query_mt", this->comm);
+        #pragma omp parallel
+        {
+            int tid = omp_get_thread_num();
+            int tcnt = omp_get_num_threads();
+
+            ::khmxx::incremental::thread_alltoallv_and_query_one_to_one(input.data(),
+                node_bucket_offsets, node_bucket_sizes, rnode_bucket_sizes, tid, tcnt,
+                [tid, &compute](int rank, Key* b, Key* e, V* r){
+                    compute(tid, b, e, r);
+                },
+                results, this->thread_comms[tid]);
+        }
+        BL_BENCH_END(query, "a2av_query_mt", input.size());
+
+        BL_BENCH_REPORT_MPI_NAMED(query, "hashmap:query_p", this->comm);
+        return;
+    }
+#endif
+
     size_t recv_total = recv_offset;  // for overlap, this would be incorrect but that is okay.
 
     BL_BENCH_START(query);
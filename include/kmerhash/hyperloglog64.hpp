@@ -27,13 +27,16 @@
  *
  * Since this is for a hash table, several modifications were made that are appropriate for hash tables only.
  * 	1. incorporates 64 bit hash values, allowing bypass of large cardinality correction factor (based on hyperloglog++)
- * 	2. bypass bias corrected estimation, and just do linear counting as needed, for 2 reasons below.  note that this can be turned on later for accuracy.
- * 		a. for small cardinality, overestimating cardinality is not significantly costly.
- * 		b. the hash table's load factor provides a buffer that allows real cardinality to be measured for the final resizing.
+ * 	2. bias correction uses Ertl's improved estimator (arXiv:1702.01284) instead of the hyperloglog++ empirical tables.
+ * 	   it is table free and unbiased over the full range, including the small range where linear counting was used.
+ * 	3. sparse mode as in hyperloglog++: small cardinalities are kept as a sorted (index, rank) list at precision 25
+ * 	   and estimated by linear counting.  converts to dense registers once the list exceeds the size of the registers.
+ * 	   this keeps per-thread/per-container instances small.
  *
  * this is structured as a class because we want to be able to merge instances
  *
  * the precision is a function of the number of buckets, 1.04/sqrt(m), where m = 2^precision.
+ * precision is a template parameter for the default, and can be overridden at runtime via the constructor.
  *
  * TODO:
  * [ ] distributed estimation of global count
@@ -41,7 +44,8 @@
  * [ ] distributed estimation of local count from global hash bins - scan input, estimate local.
  * [X] exclude some leading bits (for use e.g. after data is distributed.)
  * [ ] exclude some trailing bits....
- * [ ] batch processing (to allow prefetching later.)  - not needed for now since 2^12 fits in cache well.
+ * [X] batch processing.  AVX2 kernels for register index/rank and merge.  the estimate needs a register histogram, not the
+ *     harmonic sum, so the 2^-r gather kernel of the sum was dropped with the switch to Ertl's estimator.
  *
  *  Created on: Mar 1, 2017
  *      Author: tpan
@@ -54,9 +58,16 @@
 #include <stdint.h>
 #include <iostream> // std::cout
 #include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <limits>
 
 #include "kmerhash/mem_utils.hpp"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #ifdef USE_MPI
 #include <mxx/comm.hpp>
 #include <mxx/collective.hpp>
@@ -124,6 +135,31 @@ inline uint8_t leftmost_set_bit(uint32_t x) {
 #endif /* defined(__GNUC__) */
 
 
+#if defined(__AVX2__)
+/// leftmost_set_bit for 8 uint32 lanes.  zero -> 33, else lzcnt + 1.
+inline __m256i leftmost_set_bit_epi32(__m256i x) {
+	// keep only set bits whose left neighbor is clear.  the leading 1 is preserved, and the
+	// float mantissa cannot be all 1s, so int->float rounding never carries into the exponent.
+	__m256i y = _mm256_andnot_si256(_mm256_srli_epi32(x, 1), x);
+	__m256i e = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(y)), 23);
+	// positive: e = 127 + bitpos, so lzcnt = 158 - e.  zero: e = 0 -> clamp to 32.
+	__m256i lz = _mm256_min_epi32(_mm256_sub_epi32(_mm256_set1_epi32(158), e), _mm256_set1_epi32(32));
+	// msb set: cvt gives a negative float.  lzcnt is 0.
+	lz = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lz), _mm256_setzero_ps(), _mm256_castsi256_ps(x)));
+	return _mm256_add_epi32(lz, _mm256_set1_epi32(1));
+}
+
+/// leftmost_set_bit for 4 uint64 lanes.  zero -> 65, else lzcnt + 1.
+inline __m256i leftmost_set_bit_epi64(__m256i x) {
+	__m256i lz = _mm256_sub_epi32(leftmost_set_bit_epi32(x), _mm256_set1_epi32(1));
+	__m256i hi = _mm256_srli_epi64(lz, 32);
+	__m256i lo = _mm256_add_epi64(_mm256_and_si256(lz, _mm256_set1_epi64x(0xFFFFFFFFLL)), _mm256_set1_epi64x(32));
+	lz = _mm256_blendv_epi8(hi, lo, _mm256_cmpeq_epi64(hi, _mm256_set1_epi64x(32)));
+	return _mm256_add_epi64(lz, _mm256_set1_epi64x(1));
+}
+#endif
+
+
 
 //========= general
 //   for all hash functions (assume good uniform distribution), the msb are used for register indexing,
@@ -154,24 +190,51 @@ public:
 		static_assert(hvt_size == 32 || hvt_size == 64, "Only allow 4 or 8 byte hash values");
 
 protected:
-		static constexpr uint32_t nRegisters = 0x1U << precision;   // e.g. 0x00000100
 		static constexpr uint8_t unused_msb =
 				(std::is_same<::std::hash<T>, Hash>::value) ?
 				((sizeof(T) >= sizeof(HVT)) ? 0U : (sizeof(HVT) - sizeof(T)) * 8U) :   // if std::hash then via input size.
 				0U;
 				//(64U - (sizeof(decltype(::std::declval<Hash>().operator()(::std::declval<T>()))) << 3));   // if not, check Hash operator return type.
+
+		// sparse mode register index precision (hyperloglog++ uses 25).
+		static constexpr uint8_t max_sparse_precision = 25U;
+		// sparse entries: (index << 6) | rank
+		static constexpr uint8_t sparse_rank_bits = 6U;
+
+		uint8_t prec;       // runtime precision, [4, 18]
+		uint32_t nRegisters;   // e.g. 0x00000100
 		// 64 bit.  0xIIRRVVVVVV  // MSB: ignored bits II,  high bits: reg, RR.  low: values, VVVVVV
-		static constexpr uint8_t no_ignore_value_bits = hvt_size - precision;  // e.g. 0x00FFFFFF
+		uint8_t no_ignore_value_bits;  // e.g. 0x00FFFFFF
 			// assumes that ignored part has be left shifted out, so no_ignore_value_bits is basically all bits except precision.
 
-		mutable ::std::vector<REG_T> registers;  // stores count of leading zeros
+		mutable ::std::vector<REG_T> registers;  // stores count of leading zeros.  empty while sparse.
 
-	mutable double amm;
 	mutable HVT lzc_mask;   // lowest bits set to 1 to prevent counting into that region.
 
 	mutable uint8_t ignored_msb; // MSB to ignore.
+
+	// sparse representation.  sorted by index, one entry per index, plus an unsorted insertion buffer.
+	bool use_sparse;
+	uint8_t sparse_prec;   // 0 if sparse mode not possible (too few hash bits)
+	HVT sparse_lzc_mask;
+	mutable ::std::vector<uint32_t> sparse;
+	mutable ::std::vector<uint32_t> sparse_buf;
+
 	Hash h;
 
+	/// compute the masks from precision and ignored bits.
+	void init_masks() {
+		lzc_mask = (~(static_cast<HVT>(0))) >> (hvt_size - prec - ignored_msb);
+
+		// sparse precision needs at least 1 value bit left after the index.
+		sparse_prec = ::std::min(static_cast<int>(max_sparse_precision), static_cast<int>(hvt_size) - static_cast<int>(ignored_msb) - 1);
+		if (sparse_prec <= prec) sparse_prec = 0;
+		sparse_lzc_mask = (sparse_prec == 0) ? 0 : ((~(static_cast<HVT>(0))) >> (hvt_size - sparse_prec - ignored_msb));
+	}
+
+	inline bool is_sparse_impl() const {
+		return registers.empty();
+	}
 
   inline void internal_update(REG_T* regs, HVT const & no_ignore) {
     // no_ignore has bits 0xRRVVVVVV00, not that the II bits had already been shifted away.
@@ -179,7 +242,7 @@ protected:
         HVT i = no_ignore >> no_ignore_value_bits;   // first precision bits are for register id
         // next count:  want to count 0xVVVVVV1111.
         // compute lzcnt +1 from VVVVVV
-        REG_T rank = leftmost_set_bit((no_ignore << precision) | lzc_mask);  // then find leading 1 in remaining
+        REG_T rank = leftmost_set_bit((no_ignore << prec) | lzc_mask);  // then find leading 1 in remaining
         if (rank > regs[i]) {
             regs[i] = rank;
         }
@@ -190,155 +253,293 @@ protected:
 		internal_update(regs.data(), no_ignore);
 	}
 
-  inline void internal_merge(REG_T * target, const REG_T* src) {
-    // precisions identical, so don't need to check number of registers either.
+  /// batch update from (not yet shifted) hash values.  indices and ranks are computed in SIMD,
+  /// then applied sequentially so that duplicate register indices in a vector are handled correctly.
+  inline void internal_update_batch(REG_T* regs, HVT const * hashes, size_t const & count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    constexpr size_t lanes = 32 / sizeof(HVT);
+    size_t max = count - (count & (lanes - 1));
+
+    HVT idx[lanes] __attribute__((aligned(32)));
+    HVT rank[lanes] __attribute__((aligned(32)));
+
+    __m128i shift = _mm_cvtsi32_si128(ignored_msb);
+    __m128i idx_shift = _mm_cvtsi32_si128(no_ignore_value_bits);
+    __m128i val_shift = _mm_cvtsi32_si128(prec);
+    __m256i mask = (hvt_size == 64) ? _mm256_set1_epi64x(static_cast<long long>(lzc_mask)) :
+    		_mm256_set1_epi32(static_cast<int>(lzc_mask));
+    __m256i h, v;
+
+    for (; i < max; i += lanes) {
+      h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes + i));
+      if (hvt_size == 64) {
+        h = _mm256_sll_epi64(h, shift);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(idx), _mm256_srl_epi64(h, idx_shift));
+        v = _mm256_or_si256(_mm256_sll_epi64(h, val_shift), mask);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(rank), leftmost_set_bit_epi64(v));
+      } else {
+        h = _mm256_sll_epi32(h, shift);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(idx), _mm256_srl_epi32(h, idx_shift));
+        v = _mm256_or_si256(_mm256_sll_epi32(h, val_shift), mask);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(rank), leftmost_set_bit_epi32(v));
+      }
 
-    // iterate over both, merge, and update the zero count.
-    for (size_t i = 0; i < nRegisters; ++i) {
-      target[i] = ::std::max(target[i], src[i]);
+      for (size_t j = 0; j < lanes; ++j) {
+        if (static_cast<REG_T>(rank[j]) > regs[idx[j]]) regs[idx[j]] = static_cast<REG_T>(rank[j]);
+      }
+    }
+#endif
+    for (; i < count; ++i) {
+      internal_update(regs, hashes[i] << ignored_msb);
     }
   }
 
+  //============ sparse mode
 
-  double internal_estimate(const REG_T* regs) const {
-        double est = static_cast<double>(0.0);
-        double sum = static_cast<double>(0.0);
+  /// encode a (shifted) hash value as a sparse entry at sparse_prec.
+  inline uint32_t sparse_encode(HVT const & no_ignore) const {
+	  uint32_t i = static_cast<uint32_t>(no_ignore >> (hvt_size - sparse_prec));
+	  uint32_t rank = leftmost_set_bit((no_ignore << sparse_prec) | sparse_lzc_mask);
+	  return (i << sparse_rank_bits) | rank;
+  }
 
-        // compute the denominator of the harmonic mean
-        for (size_t i = 0; i < nRegisters; i++) {
-            sum += static_cast<double>(1.0) / static_cast<double>(1ULL << regs[i]);
-        }
-        est = amm / sum; // E in the original paper
-//        std::cout << static_cast<size_t>(hvt_size) << " bit, mask " << lzc_mask << " ignored " << static_cast<size_t>(ignored_msb)
-//            << " no ignore " << static_cast<size_t>(no_ignore_value_bits) << " unused " << static_cast<size_t>(unused_msb) 
-////            << " estimate " << est
-//            << std::endl;
-
-        if (est <= static_cast<double>(5ULL * (nRegisters >> 1ULL))) {  // 5m/2
-          size_t zeros = count_zeros(regs);
-          if (zeros > 0ULL) {
-//              std::cout << "linear_count: zero: " << zeros << " estimate " << est << " linear count " << linear_count(zeros) << std::endl;
-        	  return linear_count(zeros);
-          } else {
-//        	   std::cout << "linear_count: no zero: " << zeros << " estimate " << est << std::endl;
-        	   return est;
-          }
-        } else if ((hvt_size == 32) && (est > (static_cast<double>(1ULL << 31U) / static_cast<double>(15.0)))) {
-          // don't need this because of 64bit.
-        	est = - ::std::log(static_cast<double>(1.0) - (est / static_cast<double>(1ULL << 32U))) * static_cast<double>(1ULL << 32U);
-//            std::cout << "32bit large estimate: " 
-//            << est << std::endl;
-            return est;
-        } else {
-//        	   std::cout << "normal estimate: " << est << std::endl;
-        	          return est;
-        }
+  /// dense register index and rank from a sparse entry.  exact, since the sparse index contains the
+  /// dense index plus the first (sparse_prec - prec) value bits.
+  inline void sparse_decode(uint32_t const & e, uint32_t & i, REG_T & rank) const {
+	  uint32_t si = e >> sparse_rank_bits;
+	  uint8_t extra = sparse_prec - prec;
+	  uint32_t low = si & ((0x1U << extra) - 1);
+	  i = si >> extra;
+	  rank = (low == 0) ?
+			  static_cast<REG_T>(extra + (e & ((0x1U << sparse_rank_bits) - 1))) :
+			  static_cast<REG_T>(leftmost_set_bit(low) - (32 - extra));
   }
 
+  /// merge a sorted list into the sparse list, keeping max rank per index.  (entries sort by index then rank).
+  void sparse_merge(::std::vector<uint32_t> const & sorted) const {
+	  ::std::vector<uint32_t> merged;
+	  merged.reserve(sparse.size() + sorted.size());
+	  auto it1 = sparse.cbegin();
+	  auto it2 = sorted.cbegin();
+	  uint32_t e;
+	  while ((it1 != sparse.end()) || (it2 != sorted.end())) {
+		  if ((it2 == sorted.end()) || ((it1 != sparse.end()) && (*it1 < *it2))) {
+			  e = *it1; ++it1;
+		  } else {
+			  e = *it2; ++it2;
+		  }
+		  // same index as last: e is larger, so keep it.
+		  if (!merged.empty() && ((merged.back() >> sparse_rank_bits) == (e >> sparse_rank_bits)))
+			  merged.back() = e;
+		  else
+			  merged.emplace_back(e);
+	  }
+	  sparse.swap(merged);
+  }
 
-  double internal_estimate(::std::vector<REG_T> const & regs) const {
-	  return internal_estimate(regs.data());
+  /// move buffered entries into the sorted sparse list.  may convert to dense.
+  void sparse_flush() const {
+	  if (sparse_buf.empty()) return;
+	  ::std::sort(sparse_buf.begin(), sparse_buf.end());
+	  sparse_merge(sparse_buf);
+	  sparse_buf.clear();
+	  if (sparse.size() > sparse_limit()) to_dense();
   }
 
-  inline uint32_t count_zeros(const REG_T* regs) const {
-    uint32_t zeros = 0;
-    for (size_t i = 0; i < nRegisters; i++) {
-      if (regs[i] == 0) ++zeros;
-    }
-    return zeros;
+  /// sparse list costs more memory than registers when it exceeds m/4 entries.
+  inline size_t sparse_limit() const {
+	  return nRegisters >> 2;
   }
 
+  void sparse_to_registers(REG_T* regs, ::std::vector<uint32_t> const & entries) const {
+	  uint32_t i;
+	  REG_T rank;
+	  for (auto e : entries) {
+		  sparse_decode(e, i, rank);
+		  if (rank > regs[i]) regs[i] = rank;
+	  }
+  }
 
-  inline uint32_t count_zeros(::std::vector<REG_T> const & regs) const {
-	  return count_zeros(regs.data());
+  /// convert to dense mode.
+  void to_dense() const {
+	  if (!is_sparse_impl()) return;
+	  registers.assign(nRegisters, static_cast<REG_T>(0));
+	  sparse_to_registers(registers.data(), sparse);
+	  sparse_to_registers(registers.data(), sparse_buf);
+	  ::std::vector<uint32_t>().swap(sparse);
+	  ::std::vector<uint32_t>().swap(sparse_buf);
   }
 
-  inline double linear_count(uint32_t const & zeros) const {
-    return static_cast<double>(nRegisters) *
-        ::std::log(static_cast<double>(nRegisters)/ static_cast<double>(zeros));  //natural log
+  inline void sparse_update(HVT const & no_ignore) {
+	  sparse_buf.emplace_back(sparse_encode(no_ignore));
+	  if (sparse_buf.size() >= sparse_limit()) sparse_flush();
   }
 
+  inline void update_hashval_impl(HVT const & hval) {
+	  if (is_sparse_impl()) sparse_update(hval << ignored_msb);
+	  else internal_update(this->registers, hval << ignored_msb);
+  }
 
-public:
+  inline void update_hashval_impl(HVT const * hashes, size_t const & count) {
+	  size_t i = 0;
+	  for (; (i < count) && is_sparse_impl(); ++i) {
+		  sparse_update(hashes[i] << ignored_msb);
+	  }
+	  if (i < count) internal_update_batch(this->registers.data(), hashes + i, count - i);
+  }
 
-  static constexpr double est_error_rate = static_cast<double>(1.04) / static_cast<double>(0x1U << (precision >> 1U));   // avoid std::sqrt in constexpr.
+  /// linear counting at sparse precision.  buffer should be flushed.
+  double sparse_estimate() const {
+	  double m = static_cast<double>(0x1ULL << sparse_prec);
+	  return m * ::std::log(m / (m - static_cast<double>(sparse.size())));
+  }
 
-  	/// constructor.  ignore_leading does not count the leading bits.  ignore_trailing does not count the trailing bits.
-  	  /// these are for use when the leading and/or trailing bits are identical in an input set.
-	hyperloglog64(uint8_t const & ignore_msb = 0) :
-		registers(nRegisters),
-		lzc_mask( (~(static_cast<HVT>(0))) >> (hvt_size - precision - ignore_msb - unused_msb)),
-		ignored_msb(ignore_msb + unused_msb)
-		{
+  //============ estimation
+
+  // Ertl, "New cardinality estimation algorithms for HyperLogLog sketches", 2017.
+  // table-free replacement for hyperloglog++ empirical bias correction, valid over the full range.
+  static double ertl_sigma(double x) {
+	  if (x == 1.0) return ::std::numeric_limits<double>::infinity();
+	  double y = 1.0, z = x, z_prev;
+	  do {
+		  x *= x;
+		  z_prev = z;
+		  z += x * y;
+		  y += y;
+	  } while (z_prev != z);
+	  return z;
+  }
 
-        switch (precision) {
-            case 4:
-                amm = static_cast<double>(0.673);
-                break;
-            case 5:
-                amm = static_cast<double>(0.697);
-                break;
-            case 6:
-                amm = static_cast<double>(0.709);
-                break;
-            default:
-                amm = static_cast<double>(0.7213) / (static_cast<double>(1.0) + (static_cast<double>(1.079) / static_cast<double>(nRegisters)));
-                break;
-        }
-        amm *= static_cast<double>(0x1ULL << (precision << 1U));  // 2^(2*precision)
+  static double ertl_tau(double x) {
+	  if ((x == 0.0) || (x == 1.0)) return 0.0;
+	  double y = 1.0, z = 1.0 - x, z_prev;
+	  do {
+		  x = ::std::sqrt(x);
+		  z_prev = z;
+		  y *= 0.5;
+		  z -= (1.0 - x) * (1.0 - x) * y;
+	  } while (z_prev != z);
+	  return z / 3.0;
+  }
 
-//        std::cout << " ignore msb = " << static_cast<size_t>(ignore_msb) <<
-//        		" unused_msb = " << static_cast<size_t>(unused_msb) << std::endl;
-//        std::cout << "unused msb = " << static_cast<size_t>(64U - (sizeof(decltype(::std::declval<Hash>().operator()(::std::declval<T>()))) << 3)) << std::endl;
-//        std::cout << "unused msb2 = " << static_cast<size_t>(64U - (sizeof(typename std::result_of<Hash&(const T &)>::type) << 3)) << std::endl;
-//        std::cout << "unused msb3 = " << static_cast<size_t>(64U - (sizeof(typename std::result_of<Hash(const T &)>::type) << 3)) << std::endl;
-//        std::cout << "unused msb3 = " << static_cast<size_t>(64U - (sizeof(typename std::result_of<decltype(&Hash::operator())(Hash, const T &)>::type) << 3)) << std::endl;
+  double internal_estimate(const REG_T* regs) const {
+	  // histogram of register values.  max rank is q + 1, q is the number of value bits.
+	  // this pass replaces the AVX2 harmonic sum (a gather from a 2^-r table):  Ertl's estimator uses the counts per
+	  // value, and has no sum to gather.  4 interleaved tables, so runs of equal values do not serialize on 1 counter.
+	  uint8_t q = hvt_size - prec - ignored_msb;
+	  uint32_t counts[66] = {0};
+	  uint32_t counts1[66] = {0};
+	  uint32_t counts2[66] = {0};
+	  uint32_t counts3[66] = {0};
+	  size_t i = 0;
+	  for (; (i + 4) <= nRegisters; i += 4) {
+		  ++counts[regs[i]];
+		  ++counts1[regs[i + 1]];
+		  ++counts2[regs[i + 2]];
+		  ++counts3[regs[i + 3]];
+	  }
+	  for (; i < nRegisters; ++i) {
+		  ++counts[regs[i]];
+	  }
+	  for (int k = 0; k < 66; ++k) {
+		  counts[k] += counts1[k] + counts2[k] + counts3[k];
+	  }
+
+	  double m = static_cast<double>(nRegisters);
+	  double z = m * ertl_tau(1.0 - static_cast<double>(counts[q + 1]) / m);
+	  for (int k = q; k > 0; --k) {
+		  z = 0.5 * (z + static_cast<double>(counts[k]));
+	  }
+	  z += m * ertl_sigma(static_cast<double>(counts[0]) / m);
+
+	  return (m * m * static_cast<double>(0.5 / ::std::log(2.0))) / z;   // alpha_inf * m^2 / z
+  }
 
-	}
 
-	hyperloglog64(hyperloglog64 const & other) :
-		registers(other.registers), amm(other.amm), lzc_mask(other.lzc_mask), ignored_msb(other.ignored_msb) {
-	}
+  double internal_estimate(::std::vector<REG_T> const & regs) const {
+	  return internal_estimate(regs.data());
+  }
 
-	hyperloglog64(hyperloglog64 && other) :
-		registers(std::move(other.registers)), amm(other.amm), lzc_mask(other.lzc_mask), ignored_msb(other.ignored_msb)  {
-	}
+  inline void internal_merge(REG_T * target, const REG_T* src) {
+    // precisions identical, so don't need to check number of registers either.
+
+    // iterate over both, merge, and update the zero count.
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; (i + 32) <= nRegisters; i += 32) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i),
+    		  _mm256_max_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(target + i)),
+    				  	  	  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))));
+    }
+#endif
+    for (; i < nRegisters; ++i) {
+      target[i] = ::std::max(target[i], src[i]);
+    }
+  }
 
-	hyperloglog64& operator=(hyperloglog64 const & other) {
-		registers = other.registers;
-		amm = other.amm;
-		ignored_msb = other.ignored_msb;
-		lzc_mask = other.lzc_mask;
 
-		return *this;
-	}
+public:
 
-	hyperloglog64& operator=(hyperloglog64 && other) {
-		registers.swap(other.registers);
-		amm = other.amm;
-		//registers.swap(other.registers);
-		ignored_msb = other.ignored_msb;
-		lzc_mask = other.lzc_mask;
+  static constexpr double est_error_rate = static_cast<double>(1.04) / static_cast<double>(0x1U << (precision >> 1U));   // avoid std::sqrt in constexpr.
+
+  	/// constructor.  ignore_msb does not count the leading bits, for use when the leading bits are identical in an input set.
+  	/// _precision overrides the template default at runtime.  use_sparse starts in sparse mode for small cardinalities
+	hyperloglog64(uint8_t const & ignore_msb = 0, uint8_t const & _precision = precision, bool const & _use_sparse = true) :
+		prec(_precision),
+		nRegisters(0x1U << _precision),
+		no_ignore_value_bits(hvt_size - _precision),
+		ignored_msb(ignore_msb + unused_msb),
+		use_sparse(_use_sparse)
+		{
+		assert((prec >= 4U) && (prec <= 18U) && "ERROR: precision for hyperloglog should be in [4, 18].");
 
-		return *this;
+		init_masks();
+		if (!use_sparse || (sparse_prec == 0)) registers.assign(nRegisters, static_cast<REG_T>(0));
 	}
 
+	hyperloglog64(hyperloglog64 const & other) = default;
+	hyperloglog64(hyperloglog64 && other) = default;
+	hyperloglog64& operator=(hyperloglog64 const & other) = default;
+	hyperloglog64& operator=(hyperloglog64 && other) = default;
 
 	void swap(hyperloglog64 && other) {
+		std::swap(prec, other.prec);
+		std::swap(nRegisters, other.nRegisters);
+		std::swap(no_ignore_value_bits, other.no_ignore_value_bits);
 		std::swap(registers, other.registers);
-		std::swap(amm, other.amm);
 		std::swap(ignored_msb, other.ignored_msb);
 		std::swap(lzc_mask, other.lzc_mask);
+		std::swap(use_sparse, other.use_sparse);
+		std::swap(sparse_prec, other.sparse_prec);
+		std::swap(sparse_lzc_mask, other.sparse_lzc_mask);
+		std::swap(sparse, other.sparse);
+		std::swap(sparse_buf, other.sparse_buf);
 	}
 
 	inline void set_ignored_msb(uint8_t const & ignore_msb) {
+		// sparse entries depend on the ignored bits.
+		if (!sparse.empty() || !sparse_buf.empty()) to_dense();
 		this->ignored_msb = ignore_msb + unused_msb;
+		init_masks();
+		if (is_sparse_impl() && (sparse_prec == 0)) registers.assign(nRegisters, static_cast<REG_T>(0));
 	}
 	inline uint8_t get_ignored_msb() {
 		return this->ignored_msb - unused_msb;
 	}
+	inline uint8_t get_precision() const {
+		return prec;
+	}
+	inline bool is_sparse() const {
+		return is_sparse_impl();
+	}
+	/// expected relative error at the runtime precision.
+	inline double error_rate() const {
+		return static_cast<double>(1.04) / ::std::sqrt(static_cast<double>(nRegisters));
+	}
+
 	hyperloglog64 make_empty_copy() {
-		return hyperloglog64(this->ignored_msb - unused_msb);
+		return hyperloglog64(this->ignored_msb - unused_msb, prec, use_sparse);
 	}
 	hyperloglog64 make_copy() {
 		return hyperloglog64(*this);
@@ -347,13 +548,13 @@ public:
 
 	inline HVT update(T const & val) {
     HVT hval = h(val);
-      internal_update(this->registers, hval << ignored_msb);
+      update_hashval_impl(hval);
       return hval;
 	}
 
 	inline void update_via_hashval(HVT const & hval) {
 	//	::std::cout << ::std::hex << static_cast<uint64_t>(hval) << ", unused msb " << static_cast<size_t>(unused_msb) << " ignored msb  " << static_cast<size_t>(ignored_msb) << " val " <<  (static_cast<uint64_t>(hval) << ignored_msb) << std::endl;
-      internal_update(this->registers, hval << ignored_msb);
+      update_hashval_impl(hval);
 	}
 
   //BATCH INTERFACE
@@ -366,7 +567,7 @@ public:
   -> decltype(::std::declval<H>()(::std::declval<TT>()), void()) {
 //	  printf("UPDATE_IMPL:  discard hash val, singleton\n");
     for (size_t i = 0; i < count; ++i) {
-      internal_update(this->registers, h(vals[i]) << ignored_msb);
+      update_hashval_impl(h(vals[i]));
     }
   }
 
@@ -378,23 +579,19 @@ public:
     assert(((h.batch_size & (h.batch_size - 1)) == 0) && "batch size should be power of 2.");
 
     size_t max = count - (count & (h.batch_size - 1) );
-    size_t i = 0, j = 0;
+    size_t i = 0;
 
     HVT* buf = ::utils::mem::aligned_alloc<HVT>(h.batch_size);  // 64 byte alignment.
 
     for (; i < max; i += h.batch_size ) {
       h(vals + i, h.batch_size, buf);
 
-      for (j = 0; j < h.batch_size; ++j) {
-        internal_update(this->registers, buf[j] << ignored_msb);
-      }
+      update_hashval_impl(buf, h.batch_size);
     }
     // last part, do linearly.
     if (count > max) {
 		h(vals + i, count - max, buf);
-		for (j = 0; j < (count - max); ++j) {
-		  internal_update(this->registers, buf[j] << ignored_msb);
-		}
+		update_hashval_impl(buf, count - max);
     }
     free(buf);
   }
@@ -413,8 +610,8 @@ public:
 //	  printf("UPDATE_IMPL:  return hash val, singleton\n");
     HVT hv;
     for (size_t i = 0; i < count; ++i) {
-      hv = h(vals[i]); 
-      internal_update(this->registers, hv << ignored_msb);
+      hv = h(vals[i]);
+      update_hashval_impl(hv);
       hvals[i] = hv;
     }
   }
@@ -427,20 +624,15 @@ public:
     assert(((h.batch_size & (h.batch_size - 1)) == 0) && "batch size should be power of 2.");
 
     size_t max = count - (count & (h.batch_size - 1) );
-    size_t i = 0, j = 0, jmax;
+    size_t i = 0;
 
     for (; i < max; i += h.batch_size ) {
       h(vals + i, h.batch_size, hvals + i);
-
-      for (j = i, jmax = i + h.batch_size; j < jmax; ++j) {
-        internal_update(this->registers, hvals[j] << ignored_msb);
-      }
     }
     // last part, do linearly.
     h(vals + i, count - max, hvals + i);
-    for (; i < count; ++i) {
-      internal_update(this->registers, hvals[i] << ignored_msb);
-    }
+
+    update_hashval_impl(hvals, count);
   }
 
 
@@ -453,29 +645,47 @@ public:
   // =============== update when we already have hash values.
   inline void update_via_hashval(HVT const * hashes, size_t const & count) {
 //  	std::cout << "h0: " << hashes[0] << std::endl;
-    for (size_t i = 0; i < count; ++i) {
-      internal_update(this->registers, hashes[i] << ignored_msb);
-    }
+    update_hashval_impl(hashes, count);
   }
 
 
 
 	double estimate() const {
-	  return internal_estimate(this->registers);
+	  if (is_sparse_impl()) sparse_flush();
+	  return is_sparse_impl() ? sparse_estimate() : internal_estimate(this->registers);
 	}
 
 	void merge(hyperloglog64 const & other) {
-	  internal_merge(this->registers.data(), other.registers.data());
+	  assert((prec == other.prec) && (ignored_msb == other.ignored_msb) && "merging hyperloglog with different precision or ignored bits.");
+
+	  if (other.is_sparse_impl()) other.sparse_flush();
+	  if (is_sparse_impl()) sparse_flush();
+
+	  if (other.is_sparse_impl()) {
+		  if (is_sparse_impl()) {
+			  sparse_merge(other.sparse);
+			  if (sparse.size() > sparse_limit()) to_dense();
+		  } else {
+			  sparse_to_registers(this->registers.data(), other.sparse);
+		  }
+	  } else {
+		  to_dense();
+		  internal_merge(this->registers.data(), other.registers.data());
+	  }
 	}
 
 	void clear() {
-		registers.assign(nRegisters, static_cast<REG_T>(0));
+		::std::vector<uint32_t>().swap(sparse);
+		::std::vector<uint32_t>().swap(sparse_buf);
+		if (use_sparse && (sparse_prec > 0)) ::std::vector<REG_T>().swap(registers);
+		else registers.assign(nRegisters, static_cast<REG_T>(0));
 	}
 
 
 #ifdef USE_MPI
 	// distributed merge, for estimating globally
 	::std::vector<REG_T> merge_distributed(::mxx::comm const & comm) const {
+	  to_dense();
 	  return ::mxx::allreduce(registers, ::mxx::max<REG_T>(), comm);
 	}
 
@@ -499,9 +709,7 @@ public:
     ::std::vector<REG_T> regs(nRegisters, static_cast<REG_T>(0));
 
     // perform updates on the registers.
-    for (; first != last; ++first) {
-      internal_update(regs, *first << ignored_msb);
-    }
+    internal_update_batch(regs.data(), first, ::std::distance(first, last));
 
     // now merge distributed and estimate
     return internal_estimate(regs);
@@ -515,9 +723,7 @@ public:
     ::std::vector<REG_T> regs(nRegisters, static_cast<REG_T>(0));
 
     // perform updates on the registers.
-    for (; first != last; ++first) {
-      internal_update(regs, *first << ignored_msb);
-    }
+    internal_update_batch(regs.data(), first, ::std::distance(first, last));
 
     // now merge distributed and estimate
     return internal_estimate(::mxx::allreduce(regs, ::mxx::max<REG_T>(), comm));
@@ -561,9 +767,7 @@ public:
     // if there is comm size is 1.
     if (comm.size() == 1) {
       // perform updates on the registers.
-      for (; first != last; ++first) {
-        internal_update(accumulating, *first << ignored_msb);
-      }
+      internal_update_batch(accumulating, first, input_size);
       return;
     }
 
@@ -595,11 +799,8 @@ public:
     bool is_pow2 = ( comm_size & (comm_size-1)) == 0;
 
     //===  for prev_peer:  first compute self estimate.
-    auto max = first + send_displs[prev_peer + 1];
     memset(recved, 0, nRegisters * sizeof(REG_T));
-    for (auto it = first + send_displs[prev_peer]; it != max; ++it) {
-      internal_update(recved, *it << ignored_msb);
-    }
+    internal_update_batch(recved, first + send_displs[prev_peer], send_counts[prev_peer]);
 
     //=== for curr_peer:
     if ( is_pow2 )  {  // power of 2
@@ -608,11 +809,8 @@ public:
       curr_peer = (comm_rank + 1) % comm_size;
     }
     // compute the array
-    max = first + send_displs[curr_peer + 1];
     memset(sending, 0, nRegisters * sizeof(REG_T));
-    for (auto it = first + send_displs[curr_peer]; it != max; ++it) {
-      internal_update(sending,  *it << ignored_msb);
-    }
+    internal_update_batch(sending, first + send_displs[curr_peer], send_counts[curr_peer]);
 
     size_t step;
 
@@ -642,10 +840,7 @@ public:
         next_peer = (comm_rank + step) % comm_size;
       }
       memset(updating, 0, nRegisters * sizeof(REG_T));
-      max = first + send_displs[next_peer + 1];
-      for (auto it = first + send_displs[next_peer]; it != max; ++it) {
-        internal_update(updating,  *it << ignored_msb);
-      }
+      internal_update_batch(updating, first + send_displs[next_peer], send_counts[next_peer]);
 
       //=== and accumulate
       internal_merge(accumulating, recved);
@@ -700,6 +895,7 @@ public:
   template <typename SIZE>
   void update_per_rank_by_hashval(HVT* first, HVT* last, std::vector<SIZE> const & send_counts,
                                       ::mxx::comm const & comm) {
+    to_dense();
     update_per_rank_by_hashval_internal(this->registers.data(), first, last, send_counts, comm);
   }
 
@@ -721,9 +917,7 @@ public:
     ::std::vector<REG_T> regs(nRegisters, static_cast<REG_T>(0));
 
     // perform updates on the registers.
-    for (; first != last; ++first) {
-      internal_update(regs, *first << ignored_msb);
-    }
+    internal_update_batch(regs.data(), first, ::std::distance(first, last));
 
     // now compute send counts.  each rank ends up with 2^precision number of entries.
     size_t count = 0;
@@ -752,11 +946,11 @@ public:
 
 };
 template <typename T, typename Hash, uint8_t precision>
-constexpr uint32_t hyperloglog64<T, Hash, precision>::nRegisters;
-template <typename T, typename Hash, uint8_t precision>
 constexpr uint8_t hyperloglog64<T, Hash, precision>::hvt_size;
 template <typename T, typename Hash, uint8_t precision>
-constexpr uint8_t hyperloglog64<T, Hash, precision>::no_ignore_value_bits;
+constexpr uint8_t hyperloglog64<T, Hash, precision>::max_sparse_precision;
+template <typename T, typename Hash, uint8_t precision>
+constexpr uint8_t hyperloglog64<T, Hash, precision>::sparse_rank_bits;
 template <typename T, typename Hash, uint8_t precision>
 constexpr uint8_t hyperloglog64<T, Hash, precision>::unused_msb;
 template <typename T, typename Hash, uint8_t precision>
@@ -37,6 +37,7 @@
 #include "utils/function_traits.hpp"
 
 #include "containers/fsc_container_utils.hpp"
+#include "kmerhash/exchange.hpp"
 
 #ifndef LZ4_H_2983827168210
 #include "lz4.c"
@@ -54,6 +55,89 @@
 namespace khmxx
 {
 
+  /// an ::mxx::comm with the interface of khmxx::thread_comm, for the exchanges in exchange.hpp.
+  /// holds a reference, so the ::mxx::comm has to outlive it.
+  class mpi_comm {
+    ::mxx::comm const & c;
+
+  public:
+    /// a nonblocking send or receive.  a default constructed request is complete.
+    class request {
+      friend class mpi_comm;
+      mutable MPI_Request req;
+
+    public:
+      request() : req(MPI_REQUEST_NULL) {}
+
+      inline bool test() const {
+        int flag;
+        MPI_Test(&req, &flag, MPI_STATUS_IGNORE);
+        return flag != 0;
+      }
+      inline void wait() const {
+        MPI_Wait(&req, MPI_STATUS_IGNORE);
+      }
+    };
+
+    explicit mpi_comm(::mxx::comm const & _c) : c(_c) {}
+
+    inline int size() const { return c.size(); }
+    inline int rank() const { return c.rank(); }
+    inline void barrier() const { c.barrier(); }
+
+    template <typename T>
+    inline void all2all(T const * send, size_t const & count, T * recv) const {
+      ::mxx::all2all(send, count, recv, c);
+    }
+    template <typename T>
+    inline void all2allv(T const * send, ::std::vector<size_t> const & send_counts,
+                         T * recv, ::std::vector<size_t> const & recv_counts) const {
+      ::mxx::all2allv(send, send_counts, recv, recv_counts, c);
+    }
+    template <typename T, typename Op>
+    inline T allreduce(T const & x, Op op) const {
+      return ::mxx::allreduce(x, op, c);
+    }
+    /// for khmxx::all_of
+    inline bool allreduce(bool const & x, ::std::logical_and<bool>) const {
+      return ::mxx::all_of(x, c);
+    }
+    template <typename T, typename Op>
+    inline T exscan(T const & x, Op op) const {
+      return ::mxx::exscan(x, op, c);
+    }
+
+    template <typename T>
+    request isend(T const * data, size_t const & count, int const & dest, int const & tag) const {
+      request r;
+      mxx::datatype dt = mxx::get_datatype<T>();
+      MPI_Isend(const_cast<T *>(data), count, dt.type(), dest, tag, c, &r.req);
+      return r;
+    }
+    template <typename T>
+    request issend(T const * data, size_t const & count, int const & dest, int const & tag) const {
+      request r;
+      mxx::datatype dt = mxx::get_datatype<T>();
+      MPI_Issend(const_cast<T *>(data), count, dt.type(), dest, tag, c, &r.req);
+      return r;
+    }
+    template <typename T>
+    request irsend(T const * data, size_t const & count, int const & dest, int const & tag) const {
+      request r;
+      mxx::datatype dt = mxx::get_datatype<T>();
+      MPI_Irsend(const_cast<T *>(data), count, dt.type(), dest, tag, c, &r.req);
+      return r;
+    }
+    template <typename T>
+    request irecv(T * data, size_t const & count, int const & src, int const & tag) const {
+      request r;
+      mxx::datatype dt = mxx::get_datatype<T>();
+      MPI_Irecv(data, count, dt.type(), src, tag, c, &r.req);
+      return r;
+    }
+  };
+
+
   // local version of MPI
   namespace local {
 
@@ -2573,6 +2657,267 @@ namespace khmxx
   }
 
 
+  /// two level view of a communicator:  ranks on the same shared memory node, and ranks with the same position
+  /// within their node, one per node.  used to aggregate messages within a node before crossing the network.
+  struct hierarchical_comm {
+	  mxx::comm node_comm;    // ranks on this node.
+	  mxx::comm core_comm;    // ranks with the same core_rank, ordered by node_rank.
+	  int node_count;
+	  int core_count;
+	  int node_rank;
+	  int core_rank;
+	  bool uniform;           // all nodes have the same number of ranks.  otherwise hierarchical exchange is not used.
+	  std::vector<int> global_ranks;   // [node * core_count + core] -> rank in the original communicator.
+
+	  hierarchical_comm(mxx::comm const & comm) :
+		  node_comm(comm.split_shared()),
+		  core_comm(), node_count(1), core_count(node_comm.size()), node_rank(0), core_rank(node_comm.rank()),
+		  uniform(mxx::all_same(core_count, comm)) {
+
+		  // node ids: order of the node leaders by global rank.
+		  {
+			  mxx::comm leaders = comm.split(core_rank == 0 ? 0 : 1);
+			  node_rank = leaders.rank();
+			  mxx::bcast(node_rank, 0, node_comm);
+		  }
+		  core_comm = comm.split(core_rank, node_rank);
+		  node_count = core_comm.size();
+		  uniform &= mxx::all_same(node_count, comm);
+
+		  if (!uniform) return;
+
+		  std::vector<std::pair<int, int> > coords = mxx::allgather(std::make_pair(node_rank, core_rank), comm);
+		  global_ranks.resize(coords.size());
+		  for (size_t r = 0; r < coords.size(); ++r) {
+			  global_ranks[coords[r].first * core_count + coords[r].second] = r;
+		  }
+	  }
+
+	  /// worth doing only with multiple nodes and multiple ranks per node.
+	  inline bool is_hierarchical() const {
+		  return uniform && (node_count > 1) && (core_count > 1);
+	  }
+  };
+
+  namespace local {
+	  inline int delete_hierarchical_comm(MPI_Comm, int, void* attr, void*) {
+		  delete static_cast<hierarchical_comm*>(attr);
+		  return MPI_SUCCESS;
+	  }
+  }
+
+  /// hierarchical view of comm, built on first use (collective) and cached as an mpi attribute of comm.
+  inline hierarchical_comm const & get_hierarchical_comm(mxx::comm const & comm) {
+	  static int keyval = MPI_KEYVAL_INVALID;
+	  if (keyval == MPI_KEYVAL_INVALID)
+		  MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, &local::delete_hierarchical_comm, &keyval, nullptr);
+
+	  void* attr = nullptr;
+	  int found = 0;
+	  MPI_Comm_get_attr(comm, keyval, &attr, &found);
+	  if (found) return *static_cast<hierarchical_comm*>(attr);
+
+	  hierarchical_comm* hc = new hierarchical_comm(comm);
+	  MPI_Comm_set_attr(comm, keyval, hc);
+	  return *hc;
+  }
+
+  /**
+   * @brief two phase all2allv with the same input and output layout as mxx::all2allv.
+   * @details  phase 1 exchanges within the node, so that the rank at core k collects everything going to core k of
+   *           every node.  phase 2 exchanges among the ranks with the same core index, one per node.  each rank then
+   *           sends node_count messages over the network instead of comm_size.
+   *           falls back to mxx::all2allv if the node layout is not uniform.
+   * @param send_counts  per destination rank, input grouped by destination rank.
+   * @param recv_counts  per source rank, as from all2all of send_counts.
+   */
+  template <typename T>
+  void hierarchical_all2allv(T const * input, ::std::vector<size_t> const & send_counts,
+		  T * output, ::std::vector<size_t> const & recv_counts,
+		  hierarchical_comm const & hc, ::mxx::comm const & _comm) {
+
+	  if (!hc.is_hierarchical()) {
+		  mxx::all2allv(input, send_counts, output, recv_counts, _comm);
+		  return;
+	  }
+
+	  BL_BENCH_INIT(hier_a2a);
+
+	  int N = hc.node_count;
+	  int C = hc.core_count;
+	  int comm_size = N * C;
+	  std::vector<int> const & R = hc.global_ranks;
+
+	  std::vector<size_t> send_displs(comm_size + 1, 0);
+	  std::vector<size_t> recv_displs(comm_size + 1, 0);
+	  for (int r = 0; r < comm_size; ++r) {
+		  send_displs[r + 1] = send_displs[r] + send_counts[r];
+		  recv_displs[r + 1] = recv_displs[r] + recv_counts[r];
+	  }
+
+	  // ---- phase 1: regroup by destination core, then destination node.  exchange the per node counts within the node.
+	  BL_BENCH_START(hier_a2a);
+	  T* buf1 = ::utils::mem::aligned_alloc<T>(send_displs[comm_size] + 1, 64);
+	  std::vector<size_t> counts1(C, 0);
+	  std::vector<size_t> cnt_out(comm_size);
+	  size_t pos = 0;
+	  int r;
+	  for (int k = 0; k < C; ++k) {
+		  for (int j = 0; j < N; ++j) {
+			  r = R[j * C + k];
+			  memcpy(buf1 + pos, input + send_displs[r], send_counts[r] * sizeof(T));
+			  pos += send_counts[r];
+			  counts1[k] += send_counts[r];
+			  cnt_out[k * N + j] = send_counts[r];
+		  }
+	  }
+	  std::vector<size_t> cnt_in(comm_size);
+	  mxx::all2all(cnt_out.data(), N, cnt_in.data(), hc.node_comm);
+
+	  std::vector<size_t> rcounts1(C, 0);
+	  for (int s = 0; s < C; ++s) {
+		  for (int j = 0; j < N; ++j) rcounts1[s] += cnt_in[s * N + j];
+	  }
+	  size_t total1 = ::std::accumulate(rcounts1.begin(), rcounts1.end(), static_cast<size_t>(0));
+	  T* buf2 = ::utils::mem::aligned_alloc<T>(total1 + 1, 64);
+	  BL_BENCH_END(hier_a2a, "permute1", send_displs[comm_size]);
+
+	  BL_BENCH_START(hier_a2a);
+	  mxx::all2allv(buf1, counts1, buf2, rcounts1, hc.node_comm);
+	  ::utils::mem::aligned_free(buf1);
+	  BL_BENCH_END(hier_a2a, "a2a_node", total1);
+
+	  // ---- phase 2: regroup by destination node, then source core.
+	  BL_BENCH_START(hier_a2a);
+	  std::vector<size_t> block_displs(comm_size + 1, 0);   // blocks in buf2, [s * N + j]
+	  for (int b = 0; b < comm_size; ++b) block_displs[b + 1] = block_displs[b] + cnt_in[b];
+	  std::vector<size_t> counts2(N, 0);
+	  buf1 = ::utils::mem::aligned_alloc<T>(total1 + 1, 64);
+	  pos = 0;
+	  for (int j = 0; j < N; ++j) {
+		  for (int s = 0; s < C; ++s) {
+			  memcpy(buf1 + pos, buf2 + block_displs[s * N + j], cnt_in[s * N + j] * sizeof(T));
+			  pos += cnt_in[s * N + j];
+			  counts2[j] += cnt_in[s * N + j];
+		  }
+	  }
+	  ::utils::mem::aligned_free(buf2);
+
+	  // data from node i arrives as blocks from its cores s, in order.
+	  std::vector<size_t> rcounts2(N, 0);
+	  bool contiguous = true;
+	  for (int i = 0; i < N; ++i) {
+		  for (int s = 0; s < C; ++s) {
+			  rcounts2[i] += recv_counts[R[i * C + s]];
+			  contiguous &= (R[i * C + s] == (i * C + s));
+		  }
+	  }
+	  BL_BENCH_END(hier_a2a, "permute2", pos);
+
+	  BL_BENCH_START(hier_a2a);
+	  if (contiguous) {
+		  // node major rank placement:  arrival order is rank order.
+		  mxx::all2allv(buf1, counts2, output, rcounts2, hc.core_comm);
+	  } else {
+		  T* buf3 = ::utils::mem::aligned_alloc<T>(recv_displs[comm_size] + 1, 64);
+		  mxx::all2allv(buf1, counts2, buf3, rcounts2, hc.core_comm);
+		  pos = 0;
+		  for (int i = 0; i < N; ++i) {
+			  for (int s = 0; s < C; ++s) {
+				  r = R[i * C + s];
+				  memcpy(output + recv_displs[r], buf3 + pos, recv_counts[r] * sizeof(T));
+				  pos += recv_counts[r];
+			  }
+		  }
+		  ::utils::mem::aligned_free(buf3);
+	  }
+	  ::utils::mem::aligned_free(buf1);
+	  BL_BENCH_END(hier_a2a, "a2a_net", recv_displs[comm_size]);
+
+	  BL_BENCH_REPORT_MPI_NAMED(hier_a2a, "khmxx:hierarchical_a2av", _comm);
+  }
+
+
+  /**
+   * @brief read-only buffers that the ranks on a node publish to each other via an mpi-3 shared window.
+   * @details publish() is collective over comm.  each rank writes its buffer into its own segment of the window,
+   *          after which peer(i) is readable with plain loads by every rank on the node until release(), also
+   *          collective.  node_rank_of() maps a rank in comm to its rank on this node, or -1 if on another node.
+   */
+  class node_shared_window {
+	  MPI_Win win;
+	  MPI_Comm node_comm;   // owned by the cached hierarchical_comm.
+	  std::vector<unsigned char const *> peers;
+	  std::vector<int> node_ranks;
+
+	  node_shared_window(node_shared_window const &) = delete;
+	  node_shared_window & operator=(node_shared_window const &) = delete;
+
+  public:
+	  node_shared_window() : win(MPI_WIN_NULL), node_comm(MPI_COMM_NULL) {}
+
+	  /// collective on the node.
+	  ~node_shared_window() { release(); }
+
+	  inline bool active() const { return win != MPI_WIN_NULL; }
+
+	  inline int node_rank_of(int rank) const { return node_ranks[rank]; }
+	  inline unsigned char const * peer(int node_rank) const { return peers[node_rank]; }
+	  inline size_t node_size() const { return peers.size(); }
+
+	  /**
+	   * @brief replace the published buffers.  write(void* out) fills this rank's bytes, 64-byte aligned.
+	   */
+	  template <typename Writer>
+	  void publish(size_t bytes, Writer const & write, ::mxx::comm const & comm) {
+		  release();
+
+		  hierarchical_comm const & hc = get_hierarchical_comm(comm);
+		  node_comm = hc.node_comm;
+
+		  std::vector<int> members = mxx::allgather(comm.rank(), hc.node_comm);
+		  node_ranks.assign(comm.size(), -1);
+		  for (size_t i = 0; i < members.size(); ++i) node_ranks[members[i]] = i;
+
+		  // non-contiguous so each segment starts on its own page.
+		  MPI_Info info;
+		  MPI_Info_create(&info);
+		  MPI_Info_set(info, const_cast<char*>("alloc_shared_noncontig"), const_cast<char*>("true"));
+		  void * base = nullptr;
+		  MPI_Win_allocate_shared(std::max(bytes, static_cast<size_t>(64)), 1, info, node_comm, &base, &win);
+		  MPI_Info_free(&info);
+
+		  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+		  write(base);
+		  MPI_Win_sync(win);
+		  MPI_Barrier(node_comm);
+		  MPI_Win_sync(win);
+
+		  peers.resize(members.size());
+		  MPI_Aint size;
+		  int disp_unit;
+		  void * ptr;
+		  for (size_t i = 0; i < members.size(); ++i) {
+			  MPI_Win_shared_query(win, i, &size, &disp_unit, &ptr);
+			  peers[i] = reinterpret_cast<unsigned char const *>(ptr);
+		  }
+	  }
+
+	  /// collective on the node.  no peer may be reading.
+	  void release() {
+		  if (!active()) return;
+
+		  MPI_Barrier(node_comm);
+		  MPI_Win_unlock_all(win);
+		  MPI_Win_free(&win);
+		  win = MPI_WIN_NULL;
+		  node_comm = MPI_COMM_NULL;
+		  peers.clear();
+		  node_ranks.clear();
+	  }
+  };
+
+
   //== get bucket assignment. - complete grouping by processors (for a2av), or grouping by processors in communication blocks (for a2a, followed by 1 a2av)
   // parameter: in block per bucket send count (each block is for an all2all operation.  max block size is capped by max int.
   // 2 sets of send counts
@@ -2994,6 +3339,7 @@ namespace khmxx
 
 
   /// distribute data that has been permuted and the counts are in send_counts.  recv_counts should contain the target counts
+  /// the ::mxx::comm version of the one in exchange.hpp.
   template <typename T>
   void distribute_permuted(T* _begin, T* _end,
                    ::std::vector<size_t> const & send_counts,
@@ -3002,34 +3348,102 @@ namespace khmxx
                   ::mxx::comm const &_comm) {
     BL_BENCH_INIT(distribute);
 
-    BL_BENCH_COLLECTIVE_START(distribute, "empty", _comm);
-    size_t input_size = std::distance(_begin, _end);
-    bool empty = (input_size == 0);
-    empty = mxx::all_of(empty);
-    BL_BENCH_END(distribute, "empty", input_size);
-
-    if (empty) {
-      BL_BENCH_REPORT_MPI_NAMED(distribute, "khmxx:distribute", _comm);
-      return;
-    }
-    // speed over mem use.  mxx all2allv already has to double memory usage. same as stable distribute.
-
     BL_BENCH_COLLECTIVE_START(distribute, "a2a", _comm);
 #ifdef VTUNE_ANALYSIS
   if (measure_mode == MEASURE_A2A)
       __itt_resume();
 #endif
-    mxx::all2allv(_begin, send_counts, output, recv_counts, _comm);
+#if defined(HIERARCHICAL_COMM)
+    if (!::mxx::all_of(_begin == _end, _comm))
+      hierarchical_all2allv(_begin, send_counts, output, recv_counts, get_hierarchical_comm(_comm), _comm);
+#else
+    ::khmxx::distribute_permuted(_begin, _end, send_counts, output, recv_counts, ::khmxx::mpi_comm(_comm));
+#endif
 #ifdef VTUNE_ANALYSIS
   if (measure_mode == MEASURE_A2A)
       __itt_pause();
 #endif
-    BL_BENCH_END(distribute, "a2a", input_size);
+    BL_BENCH_END(distribute, "a2a", std::distance(_begin, _end));
 
     BL_BENCH_REPORT_MPI_NAMED(distribute, "khmxx:distribute_permuted", _comm);
 
   }
 
+
+  /// distribute two permuted arrays of different types in one exchange, e.g. keys and (key, count) pairs.
+  /// the message to each rank is its a elements followed by its b elements, as bytes.  collective.
+  /// a_out and b_out are grouped by source rank.
+  template <typename A, typename B>
+  void distribute_permuted_joint(A const * a, ::std::vector<size_t> const & a_counts,
+		  B const * b, ::std::vector<size_t> const & b_counts,
+		  ::std::vector<A> & a_out, ::std::vector<B> & b_out,
+		  ::mxx::comm const &_comm) {
+    BL_BENCH_INIT(distribute);
+
+    int comm_size = _comm.size();
+    assert((a_counts.size() == static_cast<size_t>(comm_size)) && "a_counts size not same as _comm size.");
+    assert((b_counts.size() == static_cast<size_t>(comm_size)) && "b_counts size not same as _comm size.");
+
+    // both counts in one all2all.
+    BL_BENCH_COLLECTIVE_START(distribute, "a2a_count", _comm);
+    ::std::vector<size_t> send_counts(2 * comm_size), recv_counts(2 * comm_size);
+    for (int i = 0; i < comm_size; ++i) {
+      send_counts[2 * i] = a_counts[i];
+      send_counts[2 * i + 1] = b_counts[i];
+    }
+    mxx::all2all(send_counts.data(), 2, recv_counts.data(), _comm);
+    BL_BENCH_END(distribute, "a2a_count", comm_size);
+
+    BL_BENCH_START(distribute);
+    ::std::vector<size_t> send_bytes(comm_size), recv_bytes(comm_size);
+    size_t send_total = 0, recv_total = 0, a_total = 0, b_total = 0;
+    for (int i = 0; i < comm_size; ++i) {
+      send_bytes[i] = send_counts[2 * i] * sizeof(A) + send_counts[2 * i + 1] * sizeof(B);
+      recv_bytes[i] = recv_counts[2 * i] * sizeof(A) + recv_counts[2 * i + 1] * sizeof(B);
+      send_total += send_bytes[i];
+      recv_total += recv_bytes[i];
+      a_total += recv_counts[2 * i];
+      b_total += recv_counts[2 * i + 1];
+    }
+
+    uint8_t* sendbuf = ::utils::mem::aligned_alloc<uint8_t>(send_total + 1);
+    uint8_t* out = sendbuf;
+    for (int i = 0; i < comm_size; ++i) {
+      memcpy(out, a, a_counts[i] * sizeof(A));
+      out += a_counts[i] * sizeof(A);
+      a += a_counts[i];
+      memcpy(out, b, b_counts[i] * sizeof(B));
+      out += b_counts[i] * sizeof(B);
+      b += b_counts[i];
+    }
+    uint8_t* recvbuf = ::utils::mem::aligned_alloc<uint8_t>(recv_total + 1);
+    BL_BENCH_END(distribute, "pack", send_total);
+
+    BL_BENCH_COLLECTIVE_START(distribute, "a2a", _comm);
+    ::khmxx::distribute_permuted(sendbuf, sendbuf + send_total, send_bytes, recvbuf, recv_bytes, _comm);
+    ::utils::mem::aligned_free(sendbuf);
+    BL_BENCH_END(distribute, "a2a", recv_total);
+
+    BL_BENCH_START(distribute);
+    a_out.resize(a_total);
+    b_out.resize(b_total);
+    uint8_t const * in = recvbuf;
+    A* ao = a_out.data();
+    B* bo = b_out.data();
+    for (int i = 0; i < comm_size; ++i) {
+      memcpy(ao, in, recv_counts[2 * i] * sizeof(A));
+      in += recv_counts[2 * i] * sizeof(A);
+      ao += recv_counts[2 * i];
+      memcpy(bo, in, recv_counts[2 * i + 1] * sizeof(B));
+      in += recv_counts[2 * i + 1] * sizeof(B);
+      bo += recv_counts[2 * i + 1];
+    }
+    ::utils::mem::aligned_free(recvbuf);
+    BL_BENCH_END(distribute, "unpack", recv_total);
+
+    BL_BENCH_REPORT_MPI_NAMED(distribute, "khmxx:distribute_permuted_joint", _comm);
+  }
+
 #if 0
 
   template <typename V, typename SIZE>
@@ -3403,14 +3817,17 @@ namespace khmxx
   	// [ ] ialltoall_and_modify.  use pairwise exchange.  for equal number of entries.  input bucketed.  overlap comm and compute
     // [ ] batched_ialltoallv_modify.  use ialltoallv if available.  input unbuckted, so both bucketing AND computation can be overlapped with comm.
     // [X] ialltoallv_and_query_one_on_one.  use pairwise exchange.  for variable number of entries.  1 response per request. input bucketed.  overlap query comm, compute, and response comm
-    // [ ] ialltoallv_and_query.  use pairwise exchange.  for variable number of entries.  have responses. input bucketed.  overlap query comm, compute, and response comm
+    // [X] ialltoallv_and_query_one_to_many.  use pairwise exchange.  for variable number of entries.  0..n responses per request. input bucketed.  overlap query comm, compute, and response comm
+    // [X] thread_alltoallv_and_modify, thread_alltoallv_and_query_one_to_one.  MPI_THREAD_MULTIPLE, each thread exchanges its own buckets on its own communicator.
+    // [X] sparse_query_one_to_one.  issend to queried ranks only, nonblocking barrier for termination.  for small batches, no collectives.
     // [ ] ialltoall_and_query_one_on_one.  use pairwise exchange.  for equal number of entries.  1 response per request. input bucketed.  overlap query comm, compute, and response comm
     // [ ] ialltoall_and_query.  use pairwise exchange.  for equal number of entries.  have responses. input bucketed.  overlap query comm, compute, and response comm
     // [ ] batched_ialltoallv_query_one_on_one.  use ialltoallv if available.  input unbuckted, so both bucketing AND computation can be overlapped with comm.
     // [ ] batched_ialltoallv_query.  use ialltoallv if available.  input unbuckted, so both bucketing AND computation can be overlapped with comm.
-    // NOTE: currently, we support one-to-one query and response mapping, one-to-zero/one mapping, and not yet one-to-(0..n) mapping.
+    // NOTE: currently, we support one-to-one query and response mapping, one-to-zero/one mapping, and one-to-(0..n) mapping via ialltoallv_and_query_one_to_many.
     // NOTE: batch mode implies that input is part of larger input, and that it is not permuted (e.g. reading in input in batches).  In this case, we need to expose the request objects,
     //   so that consecutive batches can be overlapped.
+    //   see ialltoallv_handle, ialltoallv_post and ialltoallv_complete below.
     // NOTE: insert will become a dominant component once communication is overlapped.  so important to make it fast, and HLL is important.  need to figure out a way
     // to compute local HLL without waiting for complete distribution.
 
@@ -3431,10 +3848,41 @@ namespace khmxx
 
     // 	Profiling with Fvesca shows that some buckets get a lot more entries, up to 30% difference between min and max count in send buckets.
     // to address this, we can include a balance step
+    /// the ::mxx::comm version of the one in exchange.hpp.
     template <typename IT, typename SIZE, typename OP,
         typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
                                                  ::std::random_access_iterator_tag >::value, int>::type = 1 >
       void ialltoallv_and_modify(IT permuted, IT permuted_end,
+    		  	  	  	  	  	  ::std::vector<SIZE> const & send_counts,
+								  OP compute,
+								  ::mxx::comm const &_comm) {
+
+      BL_BENCH_INIT(idist);
+
+#if defined(DEBUG_COMM_VOLUME)
+    // DEBUG.  get the send counts.
+    {
+		std::stringstream ss;
+		ss << "ia2av_modify SEND_COUNT rank " << _comm.rank() << ": ";
+		for (int i = 0; i < _comm.size(); ++i) {
+			ss << send_counts[i] << ", ";
+		}
+		std::cout << ss.str() << std::endl;
+    }
+#endif
+
+      BL_BENCH_COLLECTIVE_START(idist, "a2av_modify", _comm);
+      ::khmxx::incremental::ialltoallv_and_modify(permuted, permuted_end, send_counts, compute, ::khmxx::mpi_comm(_comm));
+      BL_BENCH_END(idist, "a2av_modify", ::std::distance(permuted, permuted_end));
+
+      BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
+    }
+
+
+    template <int BATCH = 8, typename IT, typename SIZE, typename OP,
+        typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
+                                                 ::std::random_access_iterator_tag >::value, int>::type = 1 >
+      void ialltoallv_and_modify_batch(IT permuted, IT permuted_end,
     		  	  	  	  	  	  ::std::vector<SIZE> const & send_counts,
 								  OP compute,
 								  ::mxx::comm const &_comm) {//,
@@ -3444,11 +3892,12 @@ namespace khmxx
       int comm_size = _comm.size();
       int comm_rank = _comm.rank();
 
+
       size_t input_size = ::std::distance(permuted, permuted_end);
 
       assert((static_cast<int>(send_counts.size()) == comm_size) && "send_count size not same as _comm size.");
 
-      // make sure tehre is something to do.
+      // make sure there is something to do.
       BL_BENCH_COLLECTIVE_START(idist, "empty", _comm);
       bool empty = input_size == 0;
       empty = mxx::all_of(empty);
@@ -3506,11 +3955,14 @@ namespace khmxx
       using V = typename ::std::iterator_traits<IT>::value_type;
 
       // allocate recv_compressed
-      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max << 1, 64);
-      V* recving = buffers;
-      V* computing = buffers + buffer_max;
-
-      BL_BENCH_END(idist, "a2av_alloc", buffer_max << 1);
+      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max * BATCH * 2, 64);
+      V* recving[BATCH];
+      V* computing[BATCH];
+      for (int i = 0; i < BATCH; ++i) {
+    	recving[i] = buffers + i * buffer_max;
+    	computing[i] = recving[i] + BATCH * buffer_max;
+      }
+      BL_BENCH_END(idist, "a2av_alloc", buffer_max * BATCH * 2);
 
 
 
@@ -3525,8 +3977,6 @@ namespace khmxx
       mxx::datatype dt = mxx::get_datatype<V>();
       std::vector<MPI_Request> reqs(comm_size - 1);
 
-      // process self data
-      compute(comm_rank, &(*(permuted + send_displs[comm_rank])), &(*(permuted + send_displs[comm_rank] + send_counts[comm_rank])));
 
       bool is_pow2 = ( comm_size & (comm_size-1)) == 0;
       int step;
@@ -3563,298 +4013,82 @@ namespace khmxx
       MPI_Testall(comm_size - 1, reqs.data(), &completed, MPI_STATUSES_IGNORE);
       BL_BENCH_END(idist, "a2av_isend", comm_size);
 
-
-
       // loop and process each processor's assignment.  use isend and irecv.
       // don't use collective start because Issend before...
       BL_BENCH_LOOP_START(idist, 0);
       BL_BENCH_LOOP_START(idist, 1);
       BL_BENCH_LOOP_START(idist, 2);
 
+      // process self data
+      BL_BENCH_LOOP_RESUME(idist, 1);
+      compute(comm_rank, &(*(permuted + send_displs[comm_rank])), &(*(permuted + send_displs[comm_rank] + send_counts[comm_rank])));
+      BL_BENCH_LOOP_PAUSE(idist, 1);
+
+
       int prev_peer = comm_rank;
-      MPI_Request req;
-      int step2;
+      int stepMax;
       size_t total = 0;
 
-      for (step = 1, step2 = 0; step2 < comm_size; ++step, ++step2) {
-        //====  first setup send and recv.
-//          BL_BENCH_INIT(idist_loop);
-
-        // target rank
-        if ( is_pow2 )  {  // power of 2
-          curr_peer = comm_rank ^ step;
-        } else {
-          // receive peer.  note that this is diff than send peer.
-          curr_peer = (comm_rank + step) % comm_size;
-        }
+      std::vector<MPI_Request> r_reqs(BATCH);
 
-        BL_BENCH_LOOP_RESUME(idist, 0);
-//        BL_BENCH_START(idist_loop);
 
-        // send and recv next.  post recv first.
-        if (step < comm_size) {
-        	MPI_Irecv(recving, recv_counts[curr_peer], dt.type(),
-                  curr_peer, ialltoallv_tag, _comm, &req );
-        }
+      int i = 1;
+      for (; i < comm_size; i += BATCH ) {
 
-        BL_BENCH_LOOP_PAUSE(idist, 0);
-//        BL_BENCH_END(idist_loop, "irecv", curr_peer);
+    	// set up irecvs.
+		BL_BENCH_LOOP_RESUME(idist, 0);
+    	stepMax = std::min(comm_size - i, BATCH);
+    	  if (is_pow2) {
+    		  for (step = 0; step < stepMax; ++step) {
+    			  curr_peer = comm_rank ^ (step + i);
+  				MPI_Irecv(recving[step], recv_counts[curr_peer], dt.type(),
+  					  curr_peer, ialltoallv_tag, _comm, &r_reqs[step] );
+    		  }
+    	  } else {
+			  // receive peer.  note that this is diff than send peer.
+    		  for (step = 0; step < stepMax; ++step) {
+    			  curr_peer = (comm_rank + step + i) % comm_size;
+  				MPI_Irecv(recving[step], recv_counts[curr_peer], dt.type(),
+  					  curr_peer, ialltoallv_tag, _comm, &r_reqs[step] );
+    		  }
+    	  }
+		BL_BENCH_LOOP_PAUSE(idist, 0);
 
-        BL_BENCH_LOOP_RESUME(idist, 1);
-//        BL_BENCH_START(idist_loop);
-        // process previously received. note: delayed by 1 cycle.
-        if (step2 > 0) {
-        	compute(prev_peer, computing, computing + recv_counts[prev_peer]);
-  		    total += recv_counts[prev_peer];
-        }
 
-        // set up next iteration.
-        BL_BENCH_LOOP_PAUSE(idist, 1);
-//        BL_BENCH_END(idist_loop, "compute", recv_counts[prev_peer]);
+		// compute now.
+		BL_BENCH_LOOP_RESUME(idist, 1);
+		// process previously received. note: delayed by 1 cycle.
+		if (i > BATCH) {  // after the first batch is done
+			stepMax = std::min(comm_size - (i-BATCH), BATCH);
 
-        BL_BENCH_LOOP_RESUME(idist, 2);
-//        BL_BENCH_START(idist_loop);
-        // now wait for irecv from this iteration to complete, in order to continue.
-        if (step < comm_size) {
-        	MPI_Wait(&req, MPI_STATUS_IGNORE);
-        }
-        BL_BENCH_LOOP_PAUSE(idist, 2);
-//        BL_BENCH_END(idist_loop, "wait", prev_peer);
+	    	  if (is_pow2) {
+	    		  for (step = 0; step < stepMax; ++step) {
+	    			  prev_peer = comm_rank ^ (step + i - BATCH);
+	  				compute(prev_peer, computing[step], computing[step] + recv_counts[prev_peer]);
+	  				total += recv_counts[prev_peer];
+	    		  }
+	    	  } else {
+				  // receive peer.  note that this is diff than send peer.
+	    		  for (step = 0; step < stepMax; ++step) {
+	    			  prev_peer = (comm_rank + step + i - BATCH) % comm_size;
+		  				compute(prev_peer, computing[step], computing[step] + recv_counts[prev_peer]);
+		  				total += recv_counts[prev_peer];
+	    		  }
+	    	  }
+		}
+		BL_BENCH_LOOP_PAUSE(idist, 1);
 
-        ::std::swap(recving, computing);
+		// now wait for irecv from this iteration to complete, in order to continue.
+		BL_BENCH_LOOP_RESUME(idist, 2);
+    	stepMax = std::min(comm_size - i, BATCH);
+    	MPI_Waitall(stepMax, r_reqs.data(), MPI_STATUSES_IGNORE);
 
-        prev_peer = curr_peer;
-        // then swap pointer
+    	// swap the arrays.
+    	for (step = 0; step < BATCH; ++step) {
+    		::std::swap(recving[step], computing[step]);
+    	}
 
-//        BL_BENCH_REPORT_NAMED(idist_loop, "khmxx:exch_permute_mod local");
-
-      }
-		BL_BENCH_LOOP_END(idist, 0, "loop_irecv", total);
-		BL_BENCH_LOOP_END(idist, 1, "loop_compute", total);
-		BL_BENCH_LOOP_END(idist, 2, "loop_wait", total  );
-
-
-      BL_BENCH_START(idist);
-      MPI_Waitall(comm_size - 1, reqs.data(), MPI_STATUSES_IGNORE);
-
-      free(buffers);
-      BL_BENCH_END(idist, "waitall_cleanup", buffer_max);
-
-
-      BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
-    }
-
-
-    template <int BATCH = 8, typename IT, typename SIZE, typename OP,
-        typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
-                                                 ::std::random_access_iterator_tag >::value, int>::type = 1 >
-      void ialltoallv_and_modify_batch(IT permuted, IT permuted_end,
-    		  	  	  	  	  	  ::std::vector<SIZE> const & send_counts,
-								  OP compute,
-								  ::mxx::comm const &_comm) {//,
-//								   size_t batch_size = 1) {
-
-      BL_BENCH_INIT(idist);
-      int comm_size = _comm.size();
-      int comm_rank = _comm.rank();
-
-
-      size_t input_size = ::std::distance(permuted, permuted_end);
-
-      assert((static_cast<int>(send_counts.size()) == comm_size) && "send_count size not same as _comm size.");
-
-      // make sure there is something to do.
-      BL_BENCH_COLLECTIVE_START(idist, "empty", _comm);
-      bool empty = input_size == 0;
-      empty = mxx::all_of(empty);
-      BL_BENCH_END(idist, "empty", input_size);
-
-      if (empty) {
-        BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
-        return;
-      }
-
-      // if there is comm size is 1.
-      if (comm_size == 1) {
-        BL_BENCH_COLLECTIVE_START(idist, "compute_1", _comm);
-        compute(0, permuted, permuted_end);
-        BL_BENCH_END(idist, "compute_1", input_size);
-
-        BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
-        return;
-      }
-
-
-#if defined(DEBUG_COMM_VOLUME)
-    // DEBUG.  get the send counts.
-    {
-		std::stringstream ss;
-		ss << "ia2av_modify SEND_COUNT rank " << comm_rank << ": ";
-		for (int i = 0; i < comm_size; ++i) {
-			ss << send_counts[i] << ", ";
-		}
-		std::cout << ss.str() << std::endl;
-    }
-#endif
-
-      // get the recv counts.
-      BL_BENCH_COLLECTIVE_START(idist, "a2a_counts", _comm);
-      ::std::vector<SIZE> recv_counts(send_counts.size(), 0);
-      mxx::all2all(send_counts.data(), 1, recv_counts.data(), _comm);
-
-      ::std::vector<size_t> send_displs;
-      send_displs.reserve(send_counts.size() + 1);
-
-      // compute displacement for send and recv, also compute the max buffer size needed
-      SIZE buffer_max = 0;
-      send_displs.emplace_back(0UL);
-      for (int i = 0; i < comm_size; ++i) {
-        buffer_max = std::max(buffer_max, recv_counts[i]);
-
-        send_displs.emplace_back(send_displs.back() + send_counts[i]);
-      }
-      BL_BENCH_END(idist, "a2a_counts", buffer_max);
-
-
-      // setup the temporary storage.  double buffered.
-      BL_BENCH_COLLECTIVE_START(idist, "a2av_alloc", _comm);
-      using V = typename ::std::iterator_traits<IT>::value_type;
-
-      // allocate recv_compressed
-      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max * BATCH * 2, 64);
-      V* recving[BATCH];
-      V* computing[BATCH];
-      for (int i = 0; i < BATCH; ++i) {
-    	recving[i] = buffers + i * buffer_max;
-    	computing[i] = recving[i] + BATCH * buffer_max;
-      }
-      BL_BENCH_END(idist, "a2av_alloc", buffer_max * BATCH * 2);
-
-
-
-      // loop and process each processor's assignment.  use isend and irecv.
-      BL_BENCH_COLLECTIVE_START(idist, "a2av_isend", _comm);
-
-      const int ialltoallv_tag = 1773;
-
-      // local (step 0) - skip the send recv, just directly process.
-      int curr_peer = comm_rank;
-
-      mxx::datatype dt = mxx::get_datatype<V>();
-      std::vector<MPI_Request> reqs(comm_size - 1);
-
-
-      bool is_pow2 = ( comm_size & (comm_size-1)) == 0;
-      int step;
-
-
-      if (is_pow2) {
-          for (step = 1; step < comm_size; ++step) {
-            //====  first setup send and recv.
-
-            // target rank
-            curr_peer = comm_rank ^ step;
-
-            // issend all, avoids buffering.
-            MPI_Issend(&(*(permuted + send_displs[curr_peer])), send_counts[curr_peer], dt.type(),
-            			curr_peer, ialltoallv_tag, _comm, &reqs[step - 1] );
-          }
-      } else {
-          for (step = 1; step < comm_size; ++step) {
-            //====  first setup send and recv.
-
-            // target rank
-              curr_peer = (comm_rank + comm_size - step) % comm_size;
-
-            // issend all, avoids buffering.
-            MPI_Issend(&(*(permuted + send_displs[curr_peer])), send_counts[curr_peer], dt.type(),
-            			curr_peer, ialltoallv_tag, _comm, &reqs[step - 1] );
-          }
-
-      }
-
-      // kick start send.
-
-      int completed;
-      MPI_Testall(comm_size - 1, reqs.data(), &completed, MPI_STATUSES_IGNORE);
-      BL_BENCH_END(idist, "a2av_isend", comm_size);
-
-      // loop and process each processor's assignment.  use isend and irecv.
-      // don't use collective start because Issend before...
-      BL_BENCH_LOOP_START(idist, 0);
-      BL_BENCH_LOOP_START(idist, 1);
-      BL_BENCH_LOOP_START(idist, 2);
-
-      // process self data
-      BL_BENCH_LOOP_RESUME(idist, 1);
-      compute(comm_rank, &(*(permuted + send_displs[comm_rank])), &(*(permuted + send_displs[comm_rank] + send_counts[comm_rank])));
-      BL_BENCH_LOOP_PAUSE(idist, 1);
-
-
-      int prev_peer = comm_rank;
-      int stepMax;
-      size_t total = 0;
-
-      std::vector<MPI_Request> r_reqs(BATCH);
-
-
-      int i = 1;
-      for (; i < comm_size; i += BATCH ) {
-
-    	// set up irecvs.
-		BL_BENCH_LOOP_RESUME(idist, 0);
-    	stepMax = std::min(comm_size - i, BATCH);
-    	  if (is_pow2) {
-    		  for (step = 0; step < stepMax; ++step) {
-    			  curr_peer = comm_rank ^ (step + i);
-  				MPI_Irecv(recving[step], recv_counts[curr_peer], dt.type(),
-  					  curr_peer, ialltoallv_tag, _comm, &r_reqs[step] );
-    		  }
-    	  } else {
-			  // receive peer.  note that this is diff than send peer.
-    		  for (step = 0; step < stepMax; ++step) {
-    			  curr_peer = (comm_rank + step + i) % comm_size;
-  				MPI_Irecv(recving[step], recv_counts[curr_peer], dt.type(),
-  					  curr_peer, ialltoallv_tag, _comm, &r_reqs[step] );
-    		  }
-    	  }
-		BL_BENCH_LOOP_PAUSE(idist, 0);
-
-
-		// compute now.
-		BL_BENCH_LOOP_RESUME(idist, 1);
-		// process previously received. note: delayed by 1 cycle.
-		if (i > BATCH) {  // after the first batch is done
-			stepMax = std::min(comm_size - (i-BATCH), BATCH);
-
-	    	  if (is_pow2) {
-	    		  for (step = 0; step < stepMax; ++step) {
-	    			  prev_peer = comm_rank ^ (step + i - BATCH);
-	  				compute(prev_peer, computing[step], computing[step] + recv_counts[prev_peer]);
-	  				total += recv_counts[prev_peer];
-	    		  }
-	    	  } else {
-				  // receive peer.  note that this is diff than send peer.
-	    		  for (step = 0; step < stepMax; ++step) {
-	    			  prev_peer = (comm_rank + step + i - BATCH) % comm_size;
-		  				compute(prev_peer, computing[step], computing[step] + recv_counts[prev_peer]);
-		  				total += recv_counts[prev_peer];
-	    		  }
-	    	  }
-		}
-		BL_BENCH_LOOP_PAUSE(idist, 1);
-
-		// now wait for irecv from this iteration to complete, in order to continue.
-		BL_BENCH_LOOP_RESUME(idist, 2);
-    	stepMax = std::min(comm_size - i, BATCH);
-    	MPI_Waitall(stepMax, r_reqs.data(), MPI_STATUSES_IGNORE);
-
-    	// swap the arrays.
-    	for (step = 0; step < BATCH; ++step) {
-    		::std::swap(recving[step], computing[step]);
-    	}
-
-    	BL_BENCH_LOOP_PAUSE(idist, 2);
+    	BL_BENCH_LOOP_PAUSE(idist, 2);
 
       }
 
@@ -4031,10 +4265,10 @@ namespace khmxx
 
       }
 
-      // kick start send
+      // kick start send.  not the receives:  a completed receive would be freed here, and MPI_Waitany below would
+      // never report it.
       int completed;
       MPI_Testall(comm_size - 1, send_reqs.data(), &completed, MPI_STATUSES_IGNORE);
-      MPI_Testall(comm_size - 1, recv_reqs.data(), &completed, MPI_STATUSES_IGNORE);
 
       BL_BENCH_END(idist, "a2av_isend", comm_size);
 
@@ -4380,7 +4614,10 @@ namespace khmxx
       // and process
 
       BL_BENCH_START(idist);
-      compute(0, buffers, buffers + p2_max);   // dummy rank.
+      for (int i = 0; i < comm_size; ++i) {
+    	  if (p2_recv_counts[i] > 0)
+    		  compute(i, buffers + p2_recv_displs[i], buffers + p2_recv_displs[i] + p2_recv_counts[i]);
+      }
       BL_BENCH_END(idist, "compute_p2", p2_max);
 
       BL_BENCH_START(idist);
@@ -4394,271 +4631,38 @@ namespace khmxx
 
     /// incremental ialltoallv, compute, and respond.  Assume the input is already permuted.
     /// this version requires one-to-one input/output mapping.
-    /// uses pairwise exchange.  use issend for sending, and irsend for receive to avoid buffering.
+    /// the ::mxx::comm version of the one in exchange.hpp.
     template <typename IT, typename SIZE, typename OP, typename OT,
     typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
     ::std::random_access_iterator_tag >::value &&
      ::std::is_same<typename ::std::iterator_traits<OT>::iterator_category,
       ::std::random_access_iterator_tag >::value, int>::type = 1>
-    void ialltoallv_and_query_one_to_one(IT permuted, IT permuted_end,
-                                         ::std::vector<SIZE> const & send_counts,
-                                          OP compute,
-                                          OT result,
-                                          ::mxx::comm const &_comm) {
-
-      BL_BENCH_INIT(idist);
-
-      int comm_size = _comm.size();
-      int comm_rank = _comm.rank();
-
-      size_t input_size = std::distance(permuted, permuted_end);
-
-      assert((send_counts.size() == static_cast<size_t>(comm_size)) && "send_count size not same as _comm size.");
-
-      // make sure tehre is something to do.
-      BL_BENCH_COLLECTIVE_START(idist, "empty", _comm);
-      bool empty = input_size == 0;
-      empty = mxx::all_of(empty);
-      BL_BENCH_END(idist, "empty", input_size);
-
-      if (empty) {
-        BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
-        return;
-      }
-
-      // if there is comm size is 1.
-      if (comm_size == 1) {
-        BL_BENCH_COLLECTIVE_START(idist, "compute_1", _comm);
-        compute(0, permuted, permuted_end, result);
-        BL_BENCH_END(idist, "compute_1", input_size);
-
-        BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
-        return;
-      }
-
-
-#if defined(DEBUG_COMM_VOLUME)
-    // DEBUG.  get the send counts.
-    {
-		std::stringstream ss;
-		ss << "ia2av_query SEND_COUNT rank " << comm_rank << ": ";
-		for (int i = 0; i < comm_size; ++i) {
-			ss << send_counts[i] << ", ";
-		}
-		std::cout << ss.str() << std::endl;
-    }
-#endif
-
-      // get the recv counts.
-      BL_BENCH_COLLECTIVE_START(idist, "a2a_counts", _comm);
-
-      ::std::vector<SIZE> recv_counts(send_counts.size(), 0);
-      mxx::all2all(send_counts.data(), 1, recv_counts.data(), _comm);
-
-      ::std::vector<size_t> send_displs;
-      send_displs.reserve(send_counts.size() + 1);
-
-      // compute displacement for send and recv, also compute the max buffer size needed
-      SIZE buffer_max = 0;
-      send_displs.emplace_back(0UL);
-      for (int i = 0; i < comm_size; ++i) {
-        buffer_max = std::max(buffer_max, recv_counts[i]);
-
-        send_displs.emplace_back(send_displs.back() + send_counts[i]);
-      }
-      BL_BENCH_END(idist, "a2a_counts", buffer_max);
-
-      // TODO need to estimate total, else we'd see a lot of growth in the array.
-      // this could be a big problem.
-
-
-      // setup the temporary storage.  double buffered.
-      BL_BENCH_COLLECTIVE_START(idist, "a2av_alloc", _comm);
-      using V = typename ::std::iterator_traits<IT>::value_type;
-
-      // allocate recv_compressed
-      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max << 1);
-      V* recving = buffers;
-      V* computing = buffers + buffer_max;
-
-      using U = typename ::std::iterator_traits<OT>::value_type;
-
-      // allocate recv_compressed
-      U* out_buffers = ::utils::mem::aligned_alloc<U>(buffer_max << 1);
-      U* storing = out_buffers;
-      U* sending = out_buffers + buffer_max;
-
-      BL_BENCH_END(idist, "a2av_alloc", buffer_max << 1);
-
-      // loop and process each processor's assignment.  use isend and irecv.
-      BL_BENCH_COLLECTIVE_START(idist, "a2av_reqs", _comm);
-
-      const int query_tag = 1773;
-      const int resp_tag = 1779;
-
-      // local (step 0) - skip the send recv, just directly process.
-      int curr_peer = comm_rank;
-
-      mxx::datatype q_dt = mxx::get_datatype<V>();
-      std::vector<MPI_Request> q_reqs(comm_size - 1);
-
-      mxx::datatype r_dt = mxx::get_datatype<U>();
-      std::vector<MPI_Request> r_reqs(comm_size - 1);
-
-
-      // PIPELINE:  send_q, recv_q, compute, send_r, recv_r.
-      // note that send_q and recv_r are done in batch before the main loop, so that they are ready to go.
-      // so we have buffers query-> recving,  recving <-> computing, computing -> storing, storing <-> sending, sending->output
-      // also note, computing for own rank occurs locally at the beginning.
-
-      // COMPUTE SELF.  note that this is one to one, so dealing with send_displs on both permuted and result.
-
-      bool is_pow2 = ( comm_size & (comm_size-1)) == 0;
-      int step;
-
-      for (step = 1; step < comm_size; ++step) {
-        //====  first setup send and recv.
-
-        // target rank
-        if ( is_pow2 )  {  // power of 2
-          curr_peer = comm_rank ^ step;
-        } else {
-          curr_peer = (comm_rank + comm_size - step) % comm_size;  // source of result and target of query are same.
-        }
-
-        // irecv all
-        MPI_Irecv(&(*(result + send_displs[curr_peer])), send_counts[curr_peer], r_dt.type(),
-                  curr_peer, resp_tag, _comm, &r_reqs[step - 1] );
-
-        // issend all, avoids buffering (via ssend).
-        MPI_Isend(&(*(permuted + send_displs[curr_peer])), send_counts[curr_peer], q_dt.type(),
-                  curr_peer, query_tag, _comm, &q_reqs[step - 1] );
-
-
-      }
-      _comm.barrier();  // need to make sure all Irecv are posted in order for Irsend to work.
-      BL_BENCH_END(idist, "a2av_reqs", comm_size);
-
-      // loop and process each processor's assignment.  use isend and irecv.
-      BL_BENCH_LOOP_START(idist, 0);
-      BL_BENCH_LOOP_START(idist, 1);
-      BL_BENCH_LOOP_START(idist, 2);
-      BL_BENCH_LOOP_START(idist, 3);
-      BL_BENCH_LOOP_START(idist, 4);
-
-      // compute for self rank.
-        BL_BENCH_LOOP_RESUME(idist, 1);
-
-      compute(comm_rank, &(*(permuted + send_displs[comm_rank])),
-              &(*(permuted + send_displs[comm_rank ] + send_counts[comm_rank])),
-              &(*(result + send_displs[comm_rank])));
-        BL_BENCH_LOOP_PAUSE(idist, 1);
-
-
-      int prev_peer = comm_rank, prev_peer2 = comm_rank;
-      MPI_Request q_req, r_req;
-      size_t total = 0;
-      int step2, step3;
-
-      // iterate for the steps.  note that we are overlapping 3 loops in a pipelined way.
-      // assume that the conditionals are kind of cheap?
-      for (step = 1, step2 = 0, step3 = -1; step3 < comm_size; ++step, ++step2, ++step3) {
-        //====  first setup send and recv.
-
-        // target rank
-        if ( is_pow2 )  {  // power of 2
-          curr_peer = comm_rank ^ step;
-        } else {
-          curr_peer = (comm_rank + step) % comm_size;  // source of query, and target of result
-        }
-        BL_BENCH_LOOP_RESUME(idist, 0);
-
-        // 2nd stage of pipeline
-        if (step < comm_size) {
-          // send and recv next.  post recv first.
-          MPI_Irecv(recving, recv_counts[curr_peer], q_dt.type(),
-                    curr_peer, query_tag, _comm, &q_req );
-          // if (comm_rank == 0) std::cout << "step " << step << " rank " << comm_rank << " recv Q from " << curr_peer << std::endl;
-        }
-        BL_BENCH_LOOP_PAUSE(idist, 0);
-//        BL_BENCH_END(idist_loop, "irecv", curr_peer);
-
-        BL_BENCH_LOOP_RESUME(idist, 2);
-
-
-        // 4rd stage of pipeline
-        if (step3 > 0) {
-          // send results.  use rsend to avoid buffering
-          MPI_Irsend(sending, recv_counts[prev_peer2], r_dt.type(),
-                     prev_peer2, resp_tag, _comm, &r_req );
-          // if (comm_rank == 0) std::cout << "step " << step << " rank " << comm_rank << " send R to " << prev_peer2 << std::endl;
-        }
-        BL_BENCH_LOOP_PAUSE(idist, 2);
-//        BL_BENCH_END(idist_loop, "irecv", curr_peer);
-
-        BL_BENCH_LOOP_RESUME(idist, 1);
-
-        // process previously received.
-        if ((step2 > 0) && (step2 < comm_size)) {
-			compute(prev_peer, computing, computing + recv_counts[prev_peer], storing);
-			// if (comm_rank == 0) std::cout << "step " << step << " rank " << comm_rank << " compute for " << prev_peer << std::endl;
-			total += recv_counts[prev_peer];
-        }
-        BL_BENCH_LOOP_PAUSE(idist, 1);
-//        BL_BENCH_END(idist_loop, "irecv", curr_peer);
-
-        BL_BENCH_LOOP_RESUME(idist, 3);
-
-        // now wait for irecv from this iteration to complete, in order to continue.
-        if (step < comm_size) {
-        	MPI_Wait(&q_req, MPI_STATUS_IGNORE);
-        	// if (comm_rank == 0) std::cout << "step " << step << " rank " << comm_rank << " recved Q from " << curr_peer << std::endl;
-        }
-        BL_BENCH_LOOP_PAUSE(idist, 3);
-//        BL_BENCH_END(idist_loop, "irecv", curr_peer);
-
-        BL_BENCH_LOOP_RESUME(idist, 4);
-
-        if (step3 > 0) {
-        	MPI_Wait(&r_req, MPI_STATUS_IGNORE);
-        	// if (comm_rank == 0) std::cout << "step " << step << " rank " << comm_rank << " sent R to " << prev_peer2 << std::endl;
-        }
-        BL_BENCH_LOOP_PAUSE(idist, 4);
-//        BL_BENCH_END(idist_loop, "irecv", curr_peer);
-
-
-        // then swap pointer
-        ::std::swap(recving, computing);
-        ::std::swap(storing, sending);
-
-        // set up next iteration.
-        prev_peer2 = prev_peer;
-        prev_peer = curr_peer;
-      }
-
-		BL_BENCH_LOOP_END(idist, 0, "loop_irecv", total);
-		BL_BENCH_LOOP_END(idist, 1, "loop_compute", total);
-		BL_BENCH_LOOP_END(idist, 2, "loop_isend", total  );
-		BL_BENCH_LOOP_END(idist, 3, "loop_waitsend", total);
-		BL_BENCH_LOOP_END(idist, 4, "loop_waitrecv", total  );
-
-      BL_BENCH_COLLECTIVE_START(idist, "waitall_q", _comm);
-      MPI_Waitall(comm_size - 1, q_reqs.data(), MPI_STATUSES_IGNORE);
-      BL_BENCH_END(idist, "waitall_q", comm_size - 1);
+    void ialltoallv_and_query_one_to_one(IT permuted, IT permuted_end,
+                                         ::std::vector<SIZE> const & send_counts,
+                                          OP compute,
+                                          OT result,
+                                          ::mxx::comm const &_comm) {
 
-      BL_BENCH_COLLECTIVE_START(idist, "waitall_r", _comm);
-      MPI_Waitall(comm_size - 1, r_reqs.data(), MPI_STATUSES_IGNORE);
-      BL_BENCH_END(idist, "waitall_r", comm_size - 1);
+      BL_BENCH_INIT(idist);
 
-      BL_BENCH_COLLECTIVE_START(idist, "cleanup", _comm);
-      free(buffers);
-      free(out_buffers);
-      BL_BENCH_END(idist, "cleanup", buffer_max);
+#if defined(DEBUG_COMM_VOLUME)
+    // DEBUG.  get the send counts.
+    {
+		std::stringstream ss;
+		ss << "ia2av_query SEND_COUNT rank " << _comm.rank() << ": ";
+		for (int i = 0; i < _comm.size(); ++i) {
+			ss << send_counts[i] << ", ";
+		}
+		std::cout << ss.str() << std::endl;
+    }
+#endif
 
+      BL_BENCH_COLLECTIVE_START(idist, "a2av_query", _comm);
+      ::khmxx::incremental::ialltoallv_and_query_one_to_one(permuted, permuted_end, send_counts, compute, result,
+                                                            ::khmxx::mpi_comm(_comm));
+      BL_BENCH_END(idist, "a2av_query", ::std::distance(permuted, permuted_end));
 
       BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_permute_mod", _comm);
-
-
     }
 
     template <typename IT, typename SIZE, typename OP, typename OT,
@@ -5278,6 +5282,955 @@ namespace khmxx
     /// incremental distribute and compute.  Assume the input is already permuted.
     /// return size for the results.  this version allows missing results, so will compact.
 
+
+    //============= pipelined batches.  post the exchange for one batch, return, and complete it on a later call,
+    // so that the transform, bucketing and send of the next batch overlap with this batch's transfer.
+
+    /// in-flight alltoallv.  owns the permuted send data and the receive buffer until completed.
+    template <typename V>
+    class ialltoallv_handle {
+    	ialltoallv_handle(ialltoallv_handle const & other) = delete;
+    	ialltoallv_handle& operator=(ialltoallv_handle const & other) = delete;
+
+    public:
+    	::std::vector<V> send;
+    	V* recv;
+    	size_t recv_total;
+    	::std::vector<MPI_Request> reqs;
+
+    	ialltoallv_handle() : recv(nullptr), recv_total(0) {}
+    	~ialltoallv_handle() {
+    		wait();
+    		clear();
+    	}
+
+    	/// true if a batch has been posted and not yet completed.
+    	inline bool active() const { return recv != nullptr; }
+
+    	/// drive progress without blocking.  returns true if all transfers are done.
+    	bool test() {
+    		if (reqs.empty()) return true;
+    		int completed = 0;
+    		MPI_Testall(reqs.size(), reqs.data(), &completed, MPI_STATUSES_IGNORE);
+    		if (completed) reqs.clear();
+    		return completed;
+    	}
+    	void wait() {
+    		if (reqs.empty()) return;
+    		MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+    		reqs.clear();
+    	}
+    	void clear() {
+    		::std::vector<V>().swap(send);
+    		if (recv != nullptr) ::utils::mem::aligned_free(recv);
+    		recv = nullptr;
+    		recv_total = 0;
+    	}
+    	/// exchange batches.  posted requests stay valid, the buffers they refer to do not move.
+    	void swap(ialltoallv_handle & other) {
+    		send.swap(other.send);
+    		::std::swap(recv, other.recv);
+    		::std::swap(recv_total, other.recv_total);
+    		reqs.swap(other.reqs);
+    	}
+    };
+
+    /// post the exchange of a permuted batch.  permuted is swapped into the handle and is empty on return.
+    /// the count exchange is collective, so all ranks must post the same number of batches.
+    /// messages from consecutive batches share a tag;  mpi's non-overtaking order matches them to the right batch
+    /// since a batch's receives are all posted before the next batch's, also when the earlier batch is still in flight.
+    template <typename V, typename SIZE>
+    void ialltoallv_post(::std::vector<V> & permuted,
+    		::std::vector<SIZE> const & send_counts,
+			ialltoallv_handle<V> & handle,
+			::mxx::comm const & _comm) {
+
+    	assert(!handle.active() && "previous batch not completed.");
+
+    	BL_BENCH_INIT(ipost);
+    	int comm_size = _comm.size();
+    	int comm_rank = _comm.rank();
+
+    	assert((static_cast<int>(send_counts.size()) == comm_size) && "send_count size not same as _comm size.");
+
+    	BL_BENCH_START(ipost);
+    	::std::vector<SIZE> recv_counts(comm_size, 0);
+    	mxx::all2all(send_counts.data(), 1, recv_counts.data(), _comm);
+    	BL_BENCH_END(ipost, "a2a_counts", comm_size);
+
+    	BL_BENCH_START(ipost);
+    	handle.send.swap(permuted);
+    	handle.recv_total = ::std::accumulate(recv_counts.begin(), recv_counts.end(), static_cast<size_t>(0));
+    	handle.recv = ::utils::mem::aligned_alloc<V>(handle.recv_total + 1, 64);
+    	BL_BENCH_END(ipost, "alloc", handle.recv_total);
+
+    	BL_BENCH_START(ipost);
+    	const int ialltoallv_tag = 1777;
+    	mxx::datatype dt = mxx::get_datatype<V>();
+    	handle.reqs.reserve(2 * (comm_size - 1));
+
+    	size_t send_displ = 0, recv_displ = 0;
+    	for (int i = 0; i < comm_size; ++i) {
+    		if (i == comm_rank) {
+    			memcpy(handle.recv + recv_displ, handle.send.data() + send_displ, send_counts[i] * sizeof(V));
+    		} else {
+    			if (recv_counts[i] > 0) {
+    				handle.reqs.emplace_back();
+    				MPI_Irecv(handle.recv + recv_displ, recv_counts[i], dt.type(), i, ialltoallv_tag, _comm, &(handle.reqs.back()));
+    			}
+    			if (send_counts[i] > 0) {
+    				handle.reqs.emplace_back();
+    				MPI_Isend(handle.send.data() + send_displ, send_counts[i], dt.type(), i, ialltoallv_tag, _comm, &(handle.reqs.back()));
+    			}
+    		}
+    		send_displ += send_counts[i];
+    		recv_displ += recv_counts[i];
+    	}
+    	// kick start.
+    	handle.test();
+    	BL_BENCH_END(ipost, "isend_irecv", handle.reqs.size());
+
+    	BL_BENCH_REPORT_MPI_NAMED(ipost, "khmxx:ialltoallv_post", _comm);
+    }
+
+    /// wait for a posted batch, then call compute(V* begin, V* end) on everything received and release the buffers.
+    /// not collective.
+    template <typename V, typename OP>
+    void ialltoallv_complete(ialltoallv_handle<V> & handle, OP compute) {
+    	if (!handle.active()) return;
+
+    	handle.wait();
+    	compute(handle.recv, handle.recv + handle.recv_total);
+    	handle.clear();
+    }
+
+
+    /// incremental ialltoallv, query, and respond, with any number of results per query.  Assume the input is already permuted.
+    /// compute(int src_rank, V* begin, V* end, size_t* counts, std::vector<U> & out) appends the results of each query
+    /// to out, and sets counts[i] to the number of results of query i.  on return, result_counts[i] is the number of
+    /// results of permuted[i], and result has the results in the same order.
+    /// queries go by pairwise exchange as in ialltoallv_and_query_one_to_one.  each response is sent as the per query
+    /// counts, whose size the requester knows, then the results.  the requester posts the receive for the results as soon
+    /// as the counts are in, so the result transfer overlaps with the remaining lookups.
+    template <typename IT, typename SIZE, typename OP, typename U,
+    typename ::std::enable_if<::std::is_same<typename ::std::iterator_traits<IT>::iterator_category,
+    ::std::random_access_iterator_tag >::value, int>::type = 1>
+    void ialltoallv_and_query_one_to_many(IT permuted, IT permuted_end,
+                                          ::std::vector<SIZE> const & send_counts,
+                                          OP compute,
+                                          ::std::vector<size_t> & result_counts,
+                                          ::std::vector<U> & result,
+                                          ::mxx::comm const &_comm) {
+
+      BL_BENCH_INIT(idist);
+
+      int comm_size = _comm.size();
+      int comm_rank = _comm.rank();
+
+      size_t input_size = std::distance(permuted, permuted_end);
+
+      assert((send_counts.size() == static_cast<size_t>(comm_size)) && "send_count size not same as _comm size.");
+
+      result_counts.assign(input_size, 0);
+      result.clear();
+
+      // make sure tehre is something to do.
+      BL_BENCH_COLLECTIVE_START(idist, "empty", _comm);
+      bool empty = input_size == 0;
+      empty = mxx::all_of(empty, _comm);
+      BL_BENCH_END(idist, "empty", input_size);
+
+      if (empty) {
+        BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_query_many", _comm);
+        return;
+      }
+
+      using V = typename ::std::iterator_traits<IT>::value_type;
+
+      // if there is comm size is 1.
+      if (comm_size == 1) {
+        BL_BENCH_COLLECTIVE_START(idist, "compute_1", _comm);
+        compute(0, &(*permuted), &(*permuted) + input_size, result_counts.data(), result);
+        BL_BENCH_END(idist, "compute_1", result.size());
+
+        BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_query_many", _comm);
+        return;
+      }
+
+      // get the recv counts.
+      BL_BENCH_COLLECTIVE_START(idist, "a2a_counts", _comm);
+
+      ::std::vector<SIZE> recv_counts(send_counts.size(), 0);
+      mxx::all2all(send_counts.data(), 1, recv_counts.data(), _comm);
+
+      ::std::vector<size_t> send_displs;
+      send_displs.reserve(send_counts.size() + 1);
+
+      SIZE buffer_max = 0;
+      send_displs.emplace_back(0UL);
+      for (int i = 0; i < comm_size; ++i) {
+        buffer_max = std::max(buffer_max, recv_counts[i]);
+
+        send_displs.emplace_back(send_displs.back() + send_counts[i]);
+      }
+      BL_BENCH_END(idist, "a2a_counts", buffer_max);
+
+      // query receive buffers, double buffered.  responses are kept per peer until sent.
+      BL_BENCH_COLLECTIVE_START(idist, "a2av_alloc", _comm);
+      V* buffers = ::utils::mem::aligned_alloc<V>(buffer_max << 1);
+      V* recving = buffers;
+      V* computing = buffers + buffer_max;
+
+      ::std::vector<::std::vector<size_t> > resp_counts(comm_size);
+      ::std::vector<::std::vector<U> > resp(comm_size);
+      ::std::vector<::std::vector<U> > peer_results(comm_size);   // by peer, concatenated at the end.
+      BL_BENCH_END(idist, "a2av_alloc", buffer_max << 1);
+
+      BL_BENCH_COLLECTIVE_START(idist, "a2av_reqs", _comm);
+
+      const int query_tag = 1773;
+      const int count_tag = 1787;
+      const int resp_tag = 1789;
+
+      mxx::datatype q_dt = mxx::get_datatype<V>();
+      mxx::datatype c_dt = mxx::get_datatype<size_t>();
+      mxx::datatype r_dt = mxx::get_datatype<U>();
+
+      std::vector<MPI_Request> q_reqs(comm_size - 1);
+      std::vector<MPI_Request> c_reqs(comm_size - 1);
+      std::vector<MPI_Request> r_reqs(comm_size - 1, MPI_REQUEST_NULL);
+      std::vector<MPI_Request> s_reqs;
+      s_reqs.reserve(2 * (comm_size - 1));
+      std::vector<int> c_peers(comm_size - 1);
+
+      bool is_pow2 = ( comm_size & (comm_size-1)) == 0;
+      int step;
+      int curr_peer = comm_rank;
+
+      // send all queries, and post the receives for the per query counts, which go straight to result_counts.
+      for (step = 1; step < comm_size; ++step) {
+        if ( is_pow2 )  {  // power of 2
+          curr_peer = comm_rank ^ step;
+        } else {
+          curr_peer = (comm_rank + comm_size - step) % comm_size;  // source of result and target of query are same.
+        }
+        c_peers[step - 1] = curr_peer;
+
+        MPI_Irecv(result_counts.data() + send_displs[curr_peer], send_counts[curr_peer], c_dt.type(),
+                  curr_peer, count_tag, _comm, &c_reqs[step - 1] );
+
+        MPI_Isend(&(*(permuted + send_displs[curr_peer])), send_counts[curr_peer], q_dt.type(),
+                  curr_peer, query_tag, _comm, &q_reqs[step - 1] );
+      }
+      BL_BENCH_END(idist, "a2av_reqs", comm_size);
+
+      // counts from peer c_peers[i] are in:  post the receive for its results.
+      auto post_results = [&](int i) {
+    	  int peer = c_peers[i];
+    	  size_t n = ::std::accumulate(result_counts.begin() + send_displs[peer],
+    			  result_counts.begin() + send_displs[peer] + send_counts[peer], static_cast<size_t>(0));
+    	  peer_results[peer].resize(n);
+    	  MPI_Irecv(peer_results[peer].data(), n, r_dt.type(), peer, resp_tag, _comm, &r_reqs[i]);
+      };
+      std::vector<int> done(comm_size - 1);
+      int ndone;
+
+      BL_BENCH_START(idist);
+      // compute for self rank.
+      compute(comm_rank, &(*(permuted + send_displs[comm_rank])),
+              &(*(permuted + send_displs[comm_rank])) + send_counts[comm_rank],
+              result_counts.data() + send_displs[comm_rank], peer_results[comm_rank]);
+
+      // receive the queries of the next peer while answering the previous one.
+      MPI_Request q_req;
+      int prev_peer = comm_rank;
+      size_t total = 0;
+      for (step = 1; step <= comm_size; ++step) {
+        if (step < comm_size) {
+          if ( is_pow2 )  {  // power of 2
+            curr_peer = comm_rank ^ step;
+          } else {
+            curr_peer = (comm_rank + step) % comm_size;  // source of query, and target of result
+          }
+          MPI_Irecv(recving, recv_counts[curr_peer], q_dt.type(),
+                    curr_peer, query_tag, _comm, &q_req );
+        }
+
+        if (step > 1) {
+          resp_counts[prev_peer].resize(recv_counts[prev_peer]);
+          compute(prev_peer, computing, computing + recv_counts[prev_peer], resp_counts[prev_peer].data(), resp[prev_peer]);
+          total += resp[prev_peer].size();
+
+          s_reqs.emplace_back();
+          MPI_Isend(resp_counts[prev_peer].data(), recv_counts[prev_peer], c_dt.type(),
+                    prev_peer, count_tag, _comm, &(s_reqs.back()));
+          s_reqs.emplace_back();
+          MPI_Isend(resp[prev_peer].data(), resp[prev_peer].size(), r_dt.type(),
+                    prev_peer, resp_tag, _comm, &(s_reqs.back()));
+        }
+
+        MPI_Testsome(comm_size - 1, c_reqs.data(), &ndone, done.data(), MPI_STATUSES_IGNORE);
+        for (int i = 0; (ndone != MPI_UNDEFINED) && (i < ndone); ++i) post_results(done[i]);
+
+        if (step < comm_size) MPI_Wait(&q_req, MPI_STATUS_IGNORE);
+
+        ::std::swap(recving, computing);
+        prev_peer = curr_peer;
+      }
+      BL_BENCH_END(idist, "loop", total);
+
+      BL_BENCH_COLLECTIVE_START(idist, "waitall", _comm);
+      while (true) {
+        MPI_Waitsome(comm_size - 1, c_reqs.data(), &ndone, done.data(), MPI_STATUSES_IGNORE);
+        if (ndone == MPI_UNDEFINED) break;
+        for (int i = 0; i < ndone; ++i) post_results(done[i]);
+      }
+      MPI_Waitall(comm_size - 1, q_reqs.data(), MPI_STATUSES_IGNORE);
+      MPI_Waitall(comm_size - 1, r_reqs.data(), MPI_STATUSES_IGNORE);
+      MPI_Waitall(s_reqs.size(), s_reqs.data(), MPI_STATUSES_IGNORE);
+      BL_BENCH_END(idist, "waitall", comm_size - 1);
+
+      BL_BENCH_START(idist);
+      size_t result_total = 0;
+      for (int i = 0; i < comm_size; ++i) result_total += peer_results[i].size();
+      result.reserve(result_total);
+      for (int i = 0; i < comm_size; ++i) {
+        result.insert(result.end(), peer_results[i].begin(), peer_results[i].end());
+      }
+      free(buffers);
+      BL_BENCH_END(idist, "cleanup", result_total);
+
+      BL_BENCH_REPORT_MPI_NAMED(idist, "khmxx:exch_query_many", _comm);
+    }
+
+
+    /// per thread alltoallv and modify, for MPI_THREAD_MULTIPLE.  called by each thread of a parallel region with its own
+    /// communicator (one dup per thread, so threads never match each other's messages).
+    /// input is bucketed by (rank, thread):  bucket i * nthreads + tid, at offsets[..] with sizes[..], goes to thread tid
+    /// of rank i.  recv_sizes[i * nthreads + tid] is what this thread gets from rank i.  all blocks are posted at once,
+    /// and compute(int src_rank, V* begin, V* end) is called on each as soon as it arrives, the local block first.
+    /// returns the number of elements computed on.
+    template <typename V, typename SIZE, typename OP>
+    size_t thread_alltoallv_and_modify(V * input,
+                                       ::std::vector<SIZE> const & offsets,
+                                       ::std::vector<SIZE> const & sizes,
+                                       ::std::vector<SIZE> const & recv_sizes,
+                                       int tid, int nthreads,
+                                       OP compute,
+                                       ::mxx::comm const &_comm) {
+      int comm_size = _comm.size();
+      int comm_rank = _comm.rank();
+      const int ialltoallv_tag = 1801;
+
+      // receive displacements.  the local block is not received.
+      ::std::vector<size_t> recv_displs(comm_size + 1, 0);
+      for (int i = 0; i < comm_size; ++i) {
+        recv_displs[i + 1] = recv_displs[i] + ((i == comm_rank) ? 0 : recv_sizes[i * nthreads + tid]);
+      }
+      V* buffer = ::utils::mem::aligned_alloc<V>(recv_displs[comm_size] + 1, 64);
+
+      mxx::datatype dt = mxx::get_datatype<V>();
+      ::std::vector<MPI_Request> r_reqs;
+      ::std::vector<int> r_peers;
+      ::std::vector<MPI_Request> s_reqs;
+      r_reqs.reserve(comm_size);
+      r_peers.reserve(comm_size);
+      s_reqs.reserve(comm_size);
+
+      int peer;
+      for (int step = 1; step < comm_size; ++step) {
+        peer = (comm_rank + step) % comm_size;
+        if (recv_sizes[peer * nthreads + tid] == 0) continue;
+        r_reqs.emplace_back(MPI_REQUEST_NULL);
+        r_peers.emplace_back(peer);
+        MPI_Irecv(buffer + recv_displs[peer], recv_sizes[peer * nthreads + tid], dt.type(),
+                  peer, ialltoallv_tag, _comm, &(r_reqs.back()));
+      }
+      for (int step = 1; step < comm_size; ++step) {
+        peer = (comm_rank + comm_size - step) % comm_size;
+        if (sizes[peer * nthreads + tid] == 0) continue;
+        s_reqs.emplace_back(MPI_REQUEST_NULL);
+        MPI_Isend(input + offsets[peer * nthreads + tid], sizes[peer * nthreads + tid], dt.type(),
+                  peer, ialltoallv_tag, _comm, &(s_reqs.back()));
+      }
+
+      // local block while the rest are in flight.
+      size_t total = sizes[comm_rank * nthreads + tid];
+      compute(comm_rank, input + offsets[comm_rank * nthreads + tid], input + offsets[comm_rank * nthreads + tid] + total);
+
+      int idx;
+      for (size_t i = 0; i < r_reqs.size(); ++i) {
+        MPI_Waitany(r_reqs.size(), r_reqs.data(), &idx, MPI_STATUS_IGNORE);
+        if (idx == MPI_UNDEFINED) break;
+        peer = r_peers[idx];
+        compute(peer, buffer + recv_displs[peer], buffer + recv_displs[peer + 1]);
+        total += recv_displs[peer + 1] - recv_displs[peer];
+      }
+
+      MPI_Waitall(s_reqs.size(), s_reqs.data(), MPI_STATUSES_IGNORE);
+      ::utils::mem::aligned_free(buffer);
+
+      return total;
+    }
+
+    /// per thread alltoallv, query, and respond, for MPI_THREAD_MULTIPLE.  same layout and communicator requirements as
+    /// thread_alltoallv_and_modify.  compute(int src_rank, K* begin, K* end, V* out) is called on each query block as it
+    /// arrives, and its results are sent back right away.  results are received in place, i.e. results[j] is the answer
+    /// to input[j] for every j in this thread's buckets.
+    template <typename K, typename V, typename SIZE, typename OP>
+    void thread_alltoallv_and_query_one_to_one(K * input,
+                                               ::std::vector<SIZE> const & offsets,
+                                               ::std::vector<SIZE> const & sizes,
+                                               ::std::vector<SIZE> const & recv_sizes,
+                                               int tid, int nthreads,
+                                               OP compute,
+                                               V * results,
+                                               ::mxx::comm const &_comm) {
+      int comm_size = _comm.size();
+      int comm_rank = _comm.rank();
+      const int query_tag = 1801;
+      const int resp_tag = 1811;
+
+      ::std::vector<size_t> recv_displs(comm_size + 1, 0);
+      for (int i = 0; i < comm_size; ++i) {
+        recv_displs[i + 1] = recv_displs[i] + ((i == comm_rank) ? 0 : recv_sizes[i * nthreads + tid]);
+      }
+      K* queries = ::utils::mem::aligned_alloc<K>(recv_displs[comm_size] + 1, 64);
+      V* answers = ::utils::mem::aligned_alloc<V>(recv_displs[comm_size] + 1, 64);
+
+      mxx::datatype kdt = mxx::get_datatype<K>();
+      mxx::datatype vdt = mxx::get_datatype<V>();
+      ::std::vector<MPI_Request> q_reqs;
+      ::std::vector<int> q_peers;
+      ::std::vector<MPI_Request> reqs;   // everything else.
+      q_reqs.reserve(comm_size);
+      q_peers.reserve(comm_size);
+      reqs.reserve(3 * comm_size);
+
+      int peer;
+      // responses to our queries first, so they never arrive unexpected.
+      for (int step = 1; step < comm_size; ++step) {
+        peer = (comm_rank + comm_size - step) % comm_size;
+        if (sizes[peer * nthreads + tid] == 0) continue;
+        reqs.emplace_back(MPI_REQUEST_NULL);
+        MPI_Irecv(results + offsets[peer * nthreads + tid], sizes[peer * nthreads + tid], vdt.type(),
+                  peer, resp_tag, _comm, &(reqs.back()));
+      }
+      for (int step = 1; step < comm_size; ++step) {
+        peer = (comm_rank + step) % comm_size;
+        if (recv_sizes[peer * nthreads + tid] == 0) continue;
+        q_reqs.emplace_back(MPI_REQUEST_NULL);
+        q_peers.emplace_back(peer);
+        MPI_Irecv(queries + recv_displs[peer], recv_sizes[peer * nthreads + tid], kdt.type(),
+                  peer, query_tag, _comm, &(q_reqs.back()));
+      }
+      for (int step = 1; step < comm_size; ++step) {
+        peer = (comm_rank + comm_size - step) % comm_size;
+        if (sizes[peer * nthreads + tid] == 0) continue;
+        reqs.emplace_back(MPI_REQUEST_NULL);
+        MPI_Isend(input + offsets[peer * nthreads + tid], sizes[peer * nthreads + tid], kdt.type(),
+                  peer, query_tag, _comm, &(reqs.back()));
+      }
+
+      // local block.
+      compute(comm_rank, input + offsets[comm_rank * nthreads + tid],
+              input + offsets[comm_rank * nthreads + tid] + sizes[comm_rank * nthreads + tid],
+              results + offsets[comm_rank * nthreads + tid]);
+
+      int idx;
+      for (size_t i = 0; i < q_reqs.size(); ++i) {
+        MPI_Waitany(q_reqs.size(), q_reqs.data(), &idx, MPI_STATUS_IGNORE);
+        if (idx == MPI_UNDEFINED) break;
+        peer = q_peers[idx];
+        compute(peer, queries + recv_displs[peer], queries + recv_displs[peer + 1], answers + recv_displs[peer]);
+
+        reqs.emplace_back(MPI_REQUEST_NULL);
+        MPI_Isend(answers + recv_displs[peer], recv_displs[peer + 1] - recv_displs[peer], vdt.type(),
+                  peer, resp_tag, _comm, &(reqs.back()));
+      }
+
+      MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+      ::utils::mem::aligned_free(queries);
+      ::utils::mem::aligned_free(answers);
+    }
+
+
+    /// sparse query and respond for small batches.  no collective for counts or emptiness, and no messages to ranks
+    /// that are not queried.  every rank has to call it, with or without queries.
+    /// queries go by synchronous send to the ranks with nonzero send_counts.  a rank answers whatever arrives until
+    /// all of its own queries have been received, then joins a nonblocking barrier, and keeps answering until that
+    /// completes (the NBX consensus of Hoefler et al.).  compute(int src_rank, K* begin, K* end, V* out).
+    /// results[i] is the answer to permuted[i].
+    /// a rank that is still waiting on the barrier may answer a query from another rank's next call, so different
+    /// kinds of queries need different tags.  tag and tag + 1 are used.
+    template <typename K, typename SIZE, typename OP, typename V>
+    void sparse_query_one_to_one(K * permuted,
+                                 ::std::vector<SIZE> const & send_counts,
+                                 OP compute,
+                                 V * results,
+                                 ::mxx::comm const &_comm,
+                                 int const tag = 1821) {
+      int comm_size = _comm.size();
+      int comm_rank = _comm.rank();
+      const int query_tag = tag;
+      const int resp_tag = tag + 1;
+
+      ::std::vector<size_t> send_displs(comm_size + 1, 0);
+      for (int i = 0; i < comm_size; ++i) send_displs[i + 1] = send_displs[i] + send_counts[i];
+
+      mxx::datatype kdt = mxx::get_datatype<K>();
+      mxx::datatype vdt = mxx::get_datatype<V>();
+      ::std::vector<MPI_Request> q_reqs;   // own queries
+      ::std::vector<MPI_Request> r_reqs;   // own results, and answers to others.
+
+      for (int step = 1; step < comm_size; ++step) {
+        int peer = (comm_rank + step) % comm_size;
+        if (send_counts[peer] == 0) continue;
+        r_reqs.emplace_back(MPI_REQUEST_NULL);
+        MPI_Irecv(results + send_displs[peer], send_counts[peer], vdt.type(),
+                  peer, resp_tag, _comm, &(r_reqs.back()));
+        q_reqs.emplace_back(MPI_REQUEST_NULL);
+        MPI_Issend(permuted + send_displs[peer], send_counts[peer], kdt.type(),
+                   peer, query_tag, _comm, &(q_reqs.back()));
+      }
+
+      // local part.
+      compute(comm_rank, permuted + send_displs[comm_rank], permuted + send_displs[comm_rank + 1],
+              results + send_displs[comm_rank]);
+
+      // answer incoming queries until everyone's queries have been received.
+      ::std::vector<::std::pair<K*, V*> > buffers;
+      MPI_Request barrier_req = MPI_REQUEST_NULL;
+      bool in_barrier = false;
+      int flag, count;
+      MPI_Status status;
+      while (true) {
+        MPI_Iprobe(MPI_ANY_SOURCE, query_tag, _comm, &flag, &status);
+        if (flag) {
+          MPI_Get_count(&status, kdt.type(), &count);
+          K* queries = ::utils::mem::aligned_alloc<K>(count + 1, 64);
+          V* answers = ::utils::mem::aligned_alloc<V>(count + 1, 64);
+          buffers.emplace_back(queries, answers);
+
+          MPI_Recv(queries, count, kdt.type(), status.MPI_SOURCE, query_tag, _comm, MPI_STATUS_IGNORE);
+          compute(status.MPI_SOURCE, queries, queries + count, answers);
+
+          r_reqs.emplace_back(MPI_REQUEST_NULL);
+          MPI_Isend(answers, count, vdt.type(), status.MPI_SOURCE, resp_tag, _comm, &(r_reqs.back()));
+        }
+
+        if (in_barrier) {
+          MPI_Test(&barrier_req, &flag, MPI_STATUS_IGNORE);
+          if (flag) break;
+        } else {
+          MPI_Testall(q_reqs.size(), q_reqs.data(), &flag, MPI_STATUSES_IGNORE);
+          if (flag) {
+            MPI_Ibarrier(_comm, &barrier_req);
+            in_barrier = true;
+          }
+        }
+      }
+
+      MPI_Waitall(r_reqs.size(), r_reqs.data(), MPI_STATUSES_IGNORE);
+      for (size_t i = 0; i < buffers.size(); ++i) {
+        ::utils::mem::aligned_free(buffers[i].first);
+        ::utils::mem::aligned_free(buffers[i].second);
+      }
+    }
+
+
+    /// exchange strategies for the distributed maps.  none is the blocking alltoallv (khmxx::distribute_permuted),
+    /// the others are the incremental versions above.  automatic picks one per exchange, see overlap_strategy.
+    enum class overlap_mode : int {
+    	none = 0,
+    	pairwise = 1,     // ialltoallv_and_modify, ialltoallv_and_query_one_to_one
+    	batch = 2,        // ialltoallv_and_modify_batch.  query uses pairwise.
+    	fullbuffer = 3,   // *_fullbuffer
+    	two_phase = 4,    // *_2phase
+    	automatic = 5,
+    	persistent = 6    // persistent_exchange, held by the caller.  the functions below use pairwise.
+    };
+
+    /// incremental alltoallv and modify, with the strategy chosen at runtime.  mode should not be none or automatic.
+    template <typename IT, typename SIZE, typename OP>
+    void ialltoallv_and_modify(overlap_mode const & mode, IT permuted, IT permuted_end,
+    		::std::vector<SIZE> const & send_counts, OP compute, ::mxx::comm const &_comm) {
+    	switch (mode) {
+    	case overlap_mode::batch:
+    		ialltoallv_and_modify_batch(permuted, permuted_end, send_counts, compute, _comm);
+    		break;
+    	case overlap_mode::fullbuffer:
+    		ialltoallv_and_modify_fullbuffer(permuted, permuted_end, send_counts, compute, _comm);
+    		break;
+    	case overlap_mode::two_phase:
+    		ialltoallv_and_modify_2phase(permuted, permuted_end, send_counts, compute, _comm);
+    		break;
+    	default:
+    		ialltoallv_and_modify(permuted, permuted_end, send_counts, compute, _comm);
+    	}
+    }
+
+    /// incremental alltoallv, query, and respond, with the strategy chosen at runtime.
+    template <typename IT, typename SIZE, typename OP, typename OT>
+    void ialltoallv_and_query_one_to_one(overlap_mode const & mode, IT permuted, IT permuted_end,
+    		::std::vector<SIZE> const & send_counts, OP compute, OT result, ::mxx::comm const &_comm) {
+    	switch (mode) {
+    	case overlap_mode::fullbuffer:
+    		ialltoallv_and_query_one_to_one_fullbuffer(permuted, permuted_end, send_counts, compute, result, _comm);
+    		break;
+    	case overlap_mode::two_phase:
+    		ialltoallv_and_query_one_to_one_2phase(permuted, permuted_end, send_counts, compute, result, _comm);
+    		break;
+    	default:
+    		ialltoallv_and_query_one_to_one(permuted, permuted_end, send_counts, compute, result, _comm);
+    	}
+    }
+
+    /**
+     * @brief picks the exchange strategy for a distributed map operation.  fixed, or automatic per exchange.
+     * @details automatic uses the global send volume:  the blocking alltoallv for small per-peer messages, where
+     *          posting p nonblocking messages costs more than the overlap saves;  fullbuffer when some rank sends
+     *          much more than the average, as it computes on whichever peer's data arrives first;  pairwise otherwise.
+     *          calibrate() replaces these rules with the fastest measured strategy per message size.
+     *
+     *          all ranks must use the same strategy, so select() is collective in automatic mode.
+     */
+    class overlap_strategy {
+    public:
+    	/// per-peer message size below which automatic mode uses the blocking alltoallv.
+    	static constexpr size_t small_message_bytes = 16 * 1024;
+    	/// max / mean send volume above which automatic mode uses fullbuffer.
+    	static constexpr double skew_ratio = 1.5;
+
+    protected:
+    	overlap_mode mode;
+
+    	/// calibrated (per-peer bytes, mode), ascending.  each mode applies from its size up to the next.
+    	::std::vector<::std::pair<size_t, overlap_mode> > table;
+
+    	/// elements per peer for persistent mode.
+    	size_t persistent_capacity;
+
+    public:
+    	overlap_strategy(overlap_mode const & _mode = overlap_mode::none) : mode(_mode), persistent_capacity(4096) {}
+
+    	void set_mode(overlap_mode const & _mode) { mode = _mode; }
+    	overlap_mode get_mode() const { return mode; }
+
+    	void set_persistent_capacity(size_t const & capacity) { persistent_capacity = capacity; }
+    	size_t get_persistent_capacity() const { return persistent_capacity; }
+
+    	bool calibrated() const { return table.size() > 0; }
+
+    	/// strategy for an exchange in which this rank sends send_bytes.  collective if automatic.
+    	overlap_mode select(size_t const & send_bytes, ::mxx::comm const & _comm) const {
+    		if (mode != overlap_mode::automatic) return mode;
+    		if (_comm.size() == 1) return overlap_mode::none;
+
+    		::std::vector<size_t> all_bytes = ::mxx::allgather(send_bytes, _comm);
+    		size_t total = ::std::accumulate(all_bytes.begin(), all_bytes.end(), static_cast<size_t>(0));
+    		size_t max_bytes = *(::std::max_element(all_bytes.begin(), all_bytes.end()));
+    		size_t p = _comm.size();
+    		size_t per_peer = total / (p * p);
+
+    		if (calibrated()) {
+    			overlap_mode best = table.front().second;
+    			for (size_t i = 1; (i < table.size()) && (per_peer >= table[i].first); ++i) best = table[i].second;
+    			return best;
+    		}
+
+    		if (per_peer < small_message_bytes) return overlap_mode::none;
+    		if (static_cast<double>(max_bytes * p) > skew_ratio * static_cast<double>(total)) return overlap_mode::fullbuffer;
+    		return overlap_mode::pairwise;
+    	}
+
+    	/// time each strategy on synthetic exchanges of the given per-peer message sizes, and keep the fastest
+    	/// for each size.  collective.  all ranks get the same table.
+    	void calibrate(::mxx::comm const & _comm,
+    			::std::vector<size_t> const & sizes = ::std::vector<size_t>({1024, 16 * 1024, 256 * 1024}),
+    			int const & reps = 3) {
+    		table.clear();
+    		if (_comm.size() == 1) return;
+
+    		BL_BENCH_INIT(calibrate);
+
+    		overlap_mode const modes[] = { overlap_mode::none, overlap_mode::pairwise, overlap_mode::batch,
+    				overlap_mode::fullbuffer, overlap_mode::two_phase };
+
+    		size_t p = _comm.size();
+    		size_t sink = 0;   // touch the received data, as a map would.
+    		auto touch = [&sink](int, size_t* b, size_t* e) {
+    			for (; b != e; ++b) sink += *b;
+    		};
+
+    		for (size_t bytes : sizes) {
+    			BL_BENCH_COLLECTIVE_START(calibrate, "size", _comm);
+
+    			size_t n = ::std::max(bytes / sizeof(size_t), static_cast<size_t>(1));
+    			::std::vector<size_t> counts(p, n);
+    			::std::vector<size_t> recv_counts(p, n);
+    			::std::vector<size_t> data(n * p, _comm.rank());
+    			::std::vector<size_t> out(n * p);
+
+    			overlap_mode best = overlap_mode::none;
+    			double best_time = ::std::numeric_limits<double>::max();
+    			for (overlap_mode m : modes) {
+    				_comm.barrier();
+    				double start = MPI_Wtime();
+    				for (int r = 0; r < reps; ++r) {
+    					if (m == overlap_mode::none) {
+    						::khmxx::distribute_permuted(data.data(), data.data() + data.size(), counts, out.data(), recv_counts, _comm);
+    						touch(0, out.data(), out.data() + out.size());
+    					} else {
+    						ialltoallv_and_modify(m, data.data(), data.data() + data.size(), counts, touch, _comm);
+    					}
+    				}
+    				double elapsed = ::mxx::allreduce(MPI_Wtime() - start, mxx::max<double>(), _comm);
+    				if (elapsed < best_time) {
+    					best_time = elapsed;
+    					best = m;
+    				}
+    			}
+    			table.emplace_back(bytes, best);
+
+    			BL_BENCH_END(calibrate, "size", static_cast<int>(best));
+    		}
+
+    		BL_BENCH_REPORT_MPI_NAMED(calibrate, "khmxx:overlap_calibrate", _comm);
+    	}
+    };
+
+    /**
+     * @brief persistent pairwise exchange over pre-registered, per-peer buffers, for repeated small exchanges
+     *        such as the queries of a long running service.
+     * @details MPI_Send_init / MPI_Recv_init are called once per peer, and each exchange only does MPI_Startall and
+     *          waits, without the all2all of counts or posting new requests.  a persistent request has a fixed
+     *          message size, so every peer message is a fixed size slot:  the element count, then up to capacity
+     *          elements.  small batches pay for the padding in bandwidth, not latency.
+     *
+     *          an exchange in which some rank sends more than capacity elements to a peer falls back to the
+     *          non-persistent pairwise version.  the check is collective, so all ranks take the same path.
+     *
+     *          holds the MPI communicator handle, wrapped without ownership, not a reference to the caller's
+     *          ::mxx::comm, so moving or copying the object that owns both does not leave it dangling.  the MPI
+     *          communicator itself has to outlive the object.  not copyable or movable, since the persistent requests
+     *          point at its buffers.
+     * @tparam V  element type sent.
+     * @tparam R  result type sent back by query_one_to_one.
+     */
+    template <typename V, typename R = V>
+    class persistent_exchange {
+    protected:
+    	static constexpr int data_tag = 1791;
+    	static constexpr int result_tag = 1792;
+
+    	::mxx::comm comm;    // wraps the handle, does not free it.
+    	int comm_size;
+    	int comm_rank;
+
+    	size_t capacity;
+    	size_t header;       // bytes before the elements in a slot.  holds the count.
+    	size_t slot_bytes;
+
+    	unsigned char * send_slots;
+    	unsigned char * recv_slots;
+    	R * result_send;     // capacity per peer.  set up by the first query.
+    	R * result_recv;
+
+    	::std::vector<int> peers;    // for the requests below.  excludes self.
+    	::std::vector<MPI_Request> send_reqs;
+    	::std::vector<MPI_Request> recv_reqs;
+    	::std::vector<MPI_Request> result_send_reqs;
+    	::std::vector<MPI_Request> result_recv_reqs;
+
+    	inline V * slot_data(unsigned char * slots, int const & peer) const {
+    		return reinterpret_cast<V *>(slots + peer * slot_bytes + header);
+    	}
+    	inline size_t & slot_count(unsigned char * slots, int const & peer) const {
+    		return *(reinterpret_cast<size_t *>(slots + peer * slot_bytes));
+    	}
+
+    	void init_results() {
+    		if (result_send != nullptr) return;
+
+    		result_send = ::utils::mem::aligned_alloc<R>(capacity * comm_size, 64);
+    		result_recv = ::utils::mem::aligned_alloc<R>(capacity * comm_size, 64);
+    		mxx::datatype dt = mxx::get_datatype<R>();
+    		for (size_t i = 0; i < peers.size(); ++i) {
+    			MPI_Send_init(result_send + peers[i] * capacity, capacity, dt.type(), peers[i], result_tag, comm, &result_send_reqs[i]);
+    			MPI_Recv_init(result_recv + peers[i] * capacity, capacity, dt.type(), peers[i], result_tag, comm, &result_recv_reqs[i]);
+    		}
+    	}
+
+    	/// collective.  true if all ranks' messages fit in the slots.
+    	template <typename SIZE>
+    	bool fits(::std::vector<SIZE> const & send_counts) const {
+    		bool ok = true;
+    		for (int i = 0; i < comm_size; ++i) {
+    			if ((i != comm_rank) && (static_cast<size_t>(send_counts[i]) > capacity)) ok = false;
+    		}
+    		return ::mxx::all_of(ok, comm);
+    	}
+
+    	/// copy each peer's elements into its slot, and start the sends.
+    	template <typename IT, typename SIZE>
+    	void post_sends(IT permuted, ::std::vector<SIZE> const & send_counts) {
+    		size_t offset = 0;
+    		for (int i = 0; i < comm_size; offset += send_counts[i], ++i) {
+    			if (i == comm_rank) continue;
+    			slot_count(send_slots, i) = send_counts[i];
+    			::std::copy(permuted + offset, permuted + offset + send_counts[i], slot_data(send_slots, i));
+    		}
+    		MPI_Startall(send_reqs.size(), send_reqs.data());
+    	}
+
+    public:
+    	persistent_exchange(size_t const & _capacity, ::mxx::comm const & _comm) :
+    		comm(static_cast<MPI_Comm>(_comm)), comm_size(_comm.size()), comm_rank(_comm.rank()), capacity(_capacity),
+    		header(((sizeof(size_t) + alignof(V) - 1) / alignof(V)) * alignof(V)),
+    		slot_bytes(((header + _capacity * sizeof(V) + 63) / 64) * 64),
+    		result_send(nullptr), result_recv(nullptr),
+    		send_reqs(_comm.size() - 1), recv_reqs(_comm.size() - 1),
+    		result_send_reqs(_comm.size() - 1), result_recv_reqs(_comm.size() - 1) {
+
+    		send_slots = ::utils::mem::aligned_alloc<unsigned char>(slot_bytes * comm_size, 64);
+    		recv_slots = ::utils::mem::aligned_alloc<unsigned char>(slot_bytes * comm_size, 64);
+
+    		for (int step = 1; step < comm_size; ++step) {
+    			int peer = (comm_rank + step) % comm_size;
+    			peers.emplace_back(peer);
+    			MPI_Send_init(send_slots + peer * slot_bytes, slot_bytes, MPI_BYTE, peer, data_tag, comm, &send_reqs[step - 1]);
+    			MPI_Recv_init(recv_slots + peer * slot_bytes, slot_bytes, MPI_BYTE, peer, data_tag, comm, &recv_reqs[step - 1]);
+    		}
+    	}
+
+    	persistent_exchange(persistent_exchange const & other) = delete;
+    	persistent_exchange & operator=(persistent_exchange const & other) = delete;
+    	persistent_exchange(persistent_exchange && other) = delete;
+    	persistent_exchange & operator=(persistent_exchange && other) = delete;
+
+    	~persistent_exchange() {
+    		int finalized = 0;
+    		MPI_Finalized(&finalized);
+    		if (!finalized) {
+    			for (size_t i = 0; i < peers.size(); ++i) {
+    				MPI_Request_free(&send_reqs[i]);
+    				MPI_Request_free(&recv_reqs[i]);
+    				if (result_send != nullptr) {
+    					MPI_Request_free(&result_send_reqs[i]);
+    					MPI_Request_free(&result_recv_reqs[i]);
+    				}
+    			}
+    		}
+    		free(send_slots);
+    		free(recv_slots);
+    		if (result_send != nullptr) {
+    			free(result_send);
+    			free(result_recv);
+    		}
+    	}
+
+    	/// max elements per peer per exchange.
+    	size_t get_capacity() const { return capacity; }
+
+    	/// exchange, and call compute(rank, V* begin, V* end) on each peer's data as it arrives.  collective.
+    	template <typename IT, typename SIZE, typename OP>
+    	void modify(IT permuted, IT permuted_end, ::std::vector<SIZE> const & send_counts, OP compute) {
+    		if (comm_size == 1) {
+    			compute(0, &(*permuted), &(*permuted_end));
+    			return;
+    		}
+    		if (!fits(send_counts)) {
+    			ialltoallv_and_modify(permuted, permuted_end, send_counts, compute, comm);
+    			return;
+    		}
+
+    		BL_BENCH_INIT(pexch);
+
+    		BL_BENCH_START(pexch);
+    		MPI_Startall(recv_reqs.size(), recv_reqs.data());
+    		post_sends(permuted, send_counts);
+    		BL_BENCH_END(pexch, "start", comm_size);
+
+    		BL_BENCH_START(pexch);
+    		size_t self_offset = ::std::accumulate(send_counts.begin(), send_counts.begin() + comm_rank, static_cast<size_t>(0));
+    		compute(comm_rank, &(*(permuted + self_offset)), &(*(permuted + self_offset + send_counts[comm_rank])));
+
+    		int idx;
+    		for (size_t i = 0; i < peers.size(); ++i) {
+    			MPI_Waitany(recv_reqs.size(), recv_reqs.data(), &idx, MPI_STATUS_IGNORE);
+    			V * data = slot_data(recv_slots, peers[idx]);
+    			compute(peers[idx], data, data + slot_count(recv_slots, peers[idx]));
+    		}
+    		MPI_Waitall(send_reqs.size(), send_reqs.data(), MPI_STATUSES_IGNORE);
+    		BL_BENCH_END(pexch, "compute", comm_size);
+
+    		BL_BENCH_REPORT_MPI_NAMED(pexch, "khmxx:persistent_modify", comm);
+    	}
+
+    	/// exchange, call compute(rank, V* begin, V* end, R* out) on each peer's data as it arrives, and send the
+    	/// results back into result, in the order of the input.  collective.
+    	template <typename IT, typename SIZE, typename OP, typename OT>
+    	void query_one_to_one(IT permuted, IT permuted_end, ::std::vector<SIZE> const & send_counts,
+    			OP compute, OT result) {
+    		if (comm_size == 1) {
+    			compute(0, &(*permuted), &(*permuted_end), &(*result));
+    			return;
+    		}
+    		if (!fits(send_counts)) {
+    			ialltoallv_and_query_one_to_one(permuted, permuted_end, send_counts, compute, result, comm);
+    			return;
+    		}
+
+    		BL_BENCH_INIT(pexch);
+
+    		BL_BENCH_START(pexch);
+    		init_results();
+    		MPI_Startall(recv_reqs.size(), recv_reqs.data());
+    		MPI_Startall(result_recv_reqs.size(), result_recv_reqs.data());
+    		post_sends(permuted, send_counts);
+    		BL_BENCH_END(pexch, "start", comm_size);
+
+    		BL_BENCH_START(pexch);
+    		::std::vector<size_t> send_displs(comm_size + 1, 0);
+    		for (int i = 0; i < comm_size; ++i) send_displs[i + 1] = send_displs[i] + send_counts[i];
+
+    		compute(comm_rank, &(*(permuted + send_displs[comm_rank])), &(*(permuted + send_displs[comm_rank + 1])),
+    				&(*(result + send_displs[comm_rank])));
+
+    		int idx;
+    		for (size_t i = 0; i < peers.size(); ++i) {
+    			MPI_Waitany(recv_reqs.size(), recv_reqs.data(), &idx, MPI_STATUS_IGNORE);
+    			int peer = peers[idx];
+    			V * data = slot_data(recv_slots, peer);
+    			compute(peer, data, data + slot_count(recv_slots, peer), result_send + peer * capacity);
+    			MPI_Start(&result_send_reqs[idx]);
+    		}
+    		BL_BENCH_END(pexch, "compute", comm_size);
+
+    		BL_BENCH_START(pexch);
+    		for (size_t i = 0; i < peers.size(); ++i) {
+    			MPI_Waitany(result_recv_reqs.size(), result_recv_reqs.data(), &idx, MPI_STATUS_IGNORE);
+    			int peer = peers[idx];
+    			::std::copy(result_recv + peer * capacity, result_recv + peer * capacity + send_counts[peer],
+    					result + send_displs[peer]);
+    		}
+    		MPI_Waitall(send_reqs.size(), send_reqs.data(), MPI_STATUSES_IGNORE);
+    		MPI_Waitall(result_send_reqs.size(), result_send_reqs.data(), MPI_STATUSES_IGNORE);
+    		BL_BENCH_END(pexch, "results", comm_size);
+
+    		BL_BENCH_REPORT_MPI_NAMED(pexch, "khmxx:persistent_query", comm);
+    	}
+    };
+
+    template <typename V, typename R>
+    constexpr int persistent_exchange<V, R>::data_tag;
+    template <typename V, typename R>
+    constexpr int persistent_exchange<V, R>::result_tag;
+
+
+
+
   } // namespace incremental
 
 
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * query_batcher.hpp
+ *
+ * per rank submission queue that collects lookups from many threads into large batches for the collective count
+ * and find of the distributed maps.
+ *
+ * any thread submits keys, with a future or a callback.  one thread per rank drives the queue by calling flush()
+ * in a loop.  flush waits until max_batch keys are queued or max_delay has passed, then runs one collective query
+ * on everything queued, and hands out the results.  all ranks flush at most max_delay apart, so an idle rank joins
+ * the collective with an empty batch instead of blocking the others.
+ *
+ * only the batcher is thread safe, not the map.  the map's queries update its caches, so while the batcher runs,
+ * the driver thread has to be the only one using the map.  do inserts between flushes on the driver thread.
+ *
+ * usage, with a map's count(keys, results, order) overload:
+ *
+ *   fsc::query_batcher<Key, count_result_type> batcher(1 << 16, std::chrono::milliseconds(1));
+ *   // driver thread
+ *   while (batcher.flush(
+ *       [&map](std::vector<Key> & keys, count_result_type * results, std::vector<size_t> & order) {
+ *         map.count(keys, results, order);
+ *       },
+ *       [&comm](bool done) { return mxx::all_of(done, comm); })) {}
+ *   // any thread
+ *   std::future<count_result_type> f = batcher.submit(k);
+ *   // at shutdown, after the producers are done
+ *   batcher.close();
+ */
+
+#ifndef KMERHASH_QUERY_BATCHER_HPP_
+#define KMERHASH_QUERY_BATCHER_HPP_
+
+#include <vector>
+#include <memory>  // shared_ptr
+#include <functional>  // std::function
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>  // logic_error
+#include <utility>  // std::pair
+
+namespace fsc {
+
+/**
+ * @brief thread safe micro-batching queue for collective queries.
+ * @tparam R  result of one key.
+ */
+template <typename Key, typename R>
+class query_batcher {
+
+public:
+	/// called with the index of the key in its submission, and the key's result.
+	using callback_type = ::std::function<void(size_t, R const &)>;
+	using clock_type = ::std::chrono::steady_clock;
+
+protected:
+	size_t max_batch;
+	clock_type::duration max_delay;
+
+	::std::mutex mtx;
+	::std::condition_variable cv;
+
+	::std::vector<Key> keys;
+	::std::vector<::std::pair<::std::shared_ptr<callback_type>, size_t> > waiters;   // by key.
+	clock_type::time_point oldest;
+	bool closed;
+
+	size_t batches;
+	size_t flushed;
+
+public:
+	query_batcher(size_t const & _max_batch, clock_type::duration const & _max_delay) :
+		max_batch(_max_batch == 0 ? 1 : _max_batch), max_delay(_max_delay), closed(false), batches(0), flushed(0) {}
+
+	/// queue one key.  throws std::logic_error after close().
+	::std::future<R> submit(Key const & k) {
+		::std::shared_ptr<::std::promise<R> > p = ::std::make_shared<::std::promise<R> >();
+		::std::future<R> f = p->get_future();
+		submit(&k, 1, [p](size_t, R const & r) { p->set_value(r); });
+		return f;
+	}
+
+	/// queue count keys.  cb(i, result) is called for each key i, from the thread calling flush.
+	void submit(Key const * _keys, size_t const & count, callback_type cb) {
+		if (count == 0) return;
+		::std::shared_ptr<callback_type> shared_cb = ::std::make_shared<callback_type>(::std::move(cb));
+
+		bool full;
+		{
+			::std::lock_guard<::std::mutex> lock(mtx);
+			if (closed) throw ::std::logic_error("ERROR: submit to a closed query_batcher.");
+
+			if (keys.empty()) oldest = clock_type::now();
+			keys.insert(keys.end(), _keys, _keys + count);
+			for (size_t i = 0; i < count; ++i) waiters.emplace_back(shared_cb, i);
+			full = keys.size() >= max_batch;
+		}
+		if (full) cv.notify_one();
+	}
+
+	/// no more submissions.  flush returns false once every rank has closed and drained its queue.
+	void close() {
+		{
+			::std::lock_guard<::std::mutex> lock(mtx);
+			closed = true;
+		}
+		cv.notify_one();
+	}
+
+	/**
+	 * @brief wait for a batch, then run one collective query on it.  collective, from one thread per rank.
+	 * @param query   query(std::vector<Key> & keys, R * results, std::vector<size_t> & order).  results[j] is
+	 *                for the key that was at position order[j] of keys, as with the maps' order overloads.
+	 * @param all_of  all_of(bool) is true if it is true on every rank, e.g. mxx::all_of.
+	 * @return false when all ranks are closed and empty.  nothing was queried then.
+	 */
+	template <typename Query, typename AllOf>
+	bool flush(Query query, AllOf all_of) {
+		::std::vector<Key> batch;
+		::std::vector<::std::pair<::std::shared_ptr<callback_type>, size_t> > batch_waiters;
+		bool done;
+		{
+			::std::unique_lock<::std::mutex> lock(mtx);
+			// an empty queue waits from now, so idle ranks still join within max_delay.
+			clock_type::time_point deadline = (keys.empty() ? clock_type::now() : oldest) + max_delay;
+			while (!closed && (keys.size() < max_batch)) {
+				if (cv.wait_until(lock, deadline) == ::std::cv_status::timeout) break;
+			}
+			batch.swap(keys);
+			batch_waiters.swap(waiters);
+			done = closed && batch.empty();
+		}
+
+		if (all_of(done)) return false;
+
+		::std::vector<R> results(batch.size());
+		::std::vector<size_t> order;
+		query(batch, results.data(), order);
+
+		for (size_t j = 0; j < results.size(); ++j) {
+			::std::pair<::std::shared_ptr<callback_type>, size_t> const & w = batch_waiters[order[j]];
+			(*(w.first))(w.second, results[j]);
+		}
+
+		++batches;
+		flushed += results.size();
+		return true;
+	}
+
+	/// keys waiting for the next flush.
+	size_t pending() {
+		::std::lock_guard<::std::mutex> lock(mtx);
+		return keys.size();
+	}
+
+	/// flushes so far, and keys answered.  for the driver thread.
+	inline size_t batch_count() const { return batches; }
+	inline size_t flushed_count() const { return flushed; }
+};
+
+}  // namespace fsc
+
+#endif /* KMERHASH_QUERY_BATCHER_HPP_ */
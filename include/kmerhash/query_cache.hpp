@@ -0,0 +1,156 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * query_cache.hpp
+ *
+ * bounded cache of query results, for keys that are looked up over and over.  4-way set associative, with CLOCK
+ * replacement within a set:  a hit sets the entry's reference bit, and the hand skips (and clears) referenced
+ * entries, so hot keys survive a stream of cold ones.
+ *
+ * every entry is tagged with the epoch it was added in, and lookups only match entries of the current epoch.
+ * the owner bumps its epoch on any modification, which invalidates the whole cache in O(1).  epoch 0 is never
+ * current.
+ */
+
+#ifndef KMERHASH_QUERY_CACHE_HPP_
+#define KMERHASH_QUERY_CACHE_HPP_
+
+#include <vector>
+#include <functional>  // std::equal_to
+#include <cstdint>  // uint8_t
+
+namespace fsc {
+
+/**
+ * @brief set associative CLOCK cache of query results.
+ * @tparam Hash   hash functor on Key, any integral result.
+ * @tparam Equal  must be consistent with Hash.
+ */
+template <typename Key, typename V, typename Hash, typename Equal = ::std::equal_to<Key> >
+class query_cache {
+
+public:
+	static constexpr size_t ways = 4;
+
+protected:
+	struct entry {
+		Key key;
+		V val;
+		size_t epoch;   // 0 is empty.
+		uint8_t referenced;
+	};
+
+	Hash hash;
+	Equal eq;
+
+	size_t mask;   // sets - 1.
+	std::vector<entry> entries;
+	std::vector<uint8_t> hands;   // by set.
+
+	size_t lookups;
+	size_t hits;
+
+	inline entry * set_of(Key const & k) {
+		return entries.data() + (static_cast<size_t>(hash(k)) & mask) * ways;
+	}
+
+public:
+	/// at least capacity entries, rounded up to a power of 2 number of sets.  0 disables the cache.
+	explicit query_cache(size_t const & capacity = 0,
+			Hash const & _hash = Hash(), Equal const & _eq = Equal()) :
+		hash(_hash), eq(_eq), mask(0), lookups(0), hits(0) {
+		resize(capacity);
+	}
+
+	/// clear and resize.
+	void resize(size_t const & capacity) {
+		if (capacity == 0) {
+			std::vector<entry>().swap(entries);
+			std::vector<uint8_t>().swap(hands);
+			mask = 0;
+			return;
+		}
+		size_t sets = 1;
+		while (sets * ways < capacity) sets <<= 1;
+		mask = sets - 1;
+		entries.assign(sets * ways, entry());
+		hands.assign(sets, 0);
+	}
+
+	inline bool active() const { return entries.size() > 0; }
+	inline size_t capacity() const { return entries.size(); }
+
+	/// result for k cached in epoch, if any.
+	inline bool find(Key const & k, size_t const & epoch, V & val) {
+		++lookups;
+		entry * s = set_of(k);
+		for (size_t i = 0; i < ways; ++i) {
+			if ((s[i].epoch == epoch) && eq(s[i].key, k)) {
+				s[i].referenced = 1;
+				val = s[i].val;
+				++hits;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// add or update the result for k in epoch.  replaces a stale entry, else the first unreferenced one from the hand.
+	void insert(Key const & k, size_t const & epoch, V const & val) {
+		size_t set = static_cast<size_t>(hash(k)) & mask;
+		entry * s = entries.data() + set * ways;
+
+		size_t i = 0;
+		for (; i < ways; ++i) {
+			if ((s[i].epoch == epoch) && eq(s[i].key, k)) break;
+		}
+		if (i == ways) {
+			for (i = 0; i < ways; ++i) {
+				if (s[i].epoch != epoch) break;
+			}
+		}
+		if (i == ways) {
+			uint8_t & hand = hands[set];
+			while (s[hand].referenced) {
+				s[hand].referenced = 0;
+				hand = (hand + 1) & (ways - 1);
+			}
+			i = hand;
+			hand = (hand + 1) & (ways - 1);
+			s[i].referenced = 0;
+		} else if (s[i].epoch != epoch) {
+			s[i].referenced = 0;
+		}
+
+		s[i].key = k;
+		s[i].val = val;
+		s[i].epoch = epoch;
+	}
+
+	/// lookups so far, and how many of those hit.
+	inline size_t lookup_count() const { return lookups; }
+	inline size_t hit_count() const { return hits; }
+
+	void reset_stats() {
+		lookups = 0;
+		hits = 0;
+	}
+};
+
+}  // namespace fsc
+
+#endif /* KMERHASH_QUERY_CACHE_HPP_ */
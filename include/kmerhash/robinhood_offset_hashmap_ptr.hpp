@@ -60,6 +60,7 @@
 #include <stdexcept>
 
 #include "kmerhash/hyperloglog64.hpp"  // for size estimation.
+#include "kmerhash/wide_key_equal.hpp"  // for key comparison in probe loops.
 
 #include "utils/benchmark_utils.hpp"
 #include "kmerhash/mem_utils.hpp"
@@ -366,6 +367,9 @@ protected:
 
 	static constexpr uint32_t info_per_cacheline = 64 / sizeof(info_type);
 	static constexpr uint32_t value_per_cacheline = 64 / sizeof(value_type);
+
+	// bytes before the container in an export_to snapshot.
+	static constexpr size_t snapshot_header_bytes = 64;
 	// =========  END prefetech constants.
 
 
@@ -393,7 +397,7 @@ protected:
 	valid_entry_filter filter;
 	hasher hash;
 	InternalHash hash_mod2;
-	key_equal eq;
+	::fsc::wide_key_equal<Key, key_equal> eq;  // simd compare for 2 and 4 word kmers.
 	reducer reduc;
 
 	container_type container;
@@ -3454,6 +3458,138 @@ public:
 	}
 
 
+	/* ========================================================
+	 *  read-only snapshot, e.g. for the other ranks on the node via an mpi-3 shared window.
+	 *  layout: [buckets, mask, lsize | pad to 64 bytes] [container] [info_container]
+	 */
+
+	/// bytes needed by export_to.
+	size_t export_size() const {
+		return snapshot_header_bytes + (buckets + info_empty) * (sizeof(value_type) + sizeof(info_type));
+	}
+
+	/// copy the table into out, which should have export_size() bytes and be 64-byte aligned.
+	void export_to(void * out) const {
+		size_t * header = reinterpret_cast<size_t *>(out);
+		header[0] = buckets;
+		header[1] = mask;
+		header[2] = lsize;
+
+		unsigned char * data = reinterpret_cast<unsigned char *>(out) + snapshot_header_bytes;
+		memcpy(data, container, (buckets + info_empty) * sizeof(value_type));
+		memcpy(data + (buckets + info_empty) * sizeof(value_type), info_container.data(),
+				(buckets + info_empty) * sizeof(info_type));
+	}
+
+	/**
+	 * @brief count and find on a snapshot written by export_to.  does not own the memory.
+	 * @details same probe as find_pos_with_hint.  outputs values only (not key-value pairs).
+	 */
+	class shared_view {
+	protected:
+		static constexpr size_t lookahead = 8;
+		static constexpr size_t ring_mask = 2 * lookahead - 1;
+
+		value_type const * cont;
+		info_type const * info;
+		size_t mask;
+		size_t lsize;
+		hasher hash;
+		::fsc::wide_key_equal<Key, key_equal> eq;
+
+		/// entry for k in bucket bid, or nullptr.
+		template <typename OutPredicate, typename InPredicate>
+		inline value_type const * find_entry(key_type const & k, size_t const & bid,
+				OutPredicate const & out_pred, InPredicate const & in_pred) const {
+			if (! std::is_same<InPredicate, ::bliss::filter::TruePredicate>::value)
+				if (!in_pred(k)) return nullptr;
+
+			info_type offset = info[bid];
+			if (offset >= info_empty) return nullptr;
+
+			size_t end = bid + 1 + (info[bid + 1] & info_mask);
+			for (size_t pos = bid + offset; pos < end; ++pos) {
+				if (eq(k, cont[pos].first)) {
+					if (! std::is_same<OutPredicate, ::bliss::filter::TruePredicate>::value)
+						if (!out_pred(cont[pos])) return nullptr;
+					return cont + pos;
+				}
+			}
+			return nullptr;
+		}
+
+		/// hash lookahead keys ahead and prefetch their buckets.  ev(out, entry) writes one result.
+		template <typename OIter, typename OutPredicate, typename InPredicate, typename Eval>
+		size_t lookup(OIter out, key_type const * begin, key_type const * end,
+				OutPredicate const & out_pred, InPredicate const & in_pred, Eval const & ev) const {
+			size_t input_size = std::distance(begin, end);
+			size_t bids[2 * lookahead];
+
+			size_t i = 0;
+			size_t max_prefetch = std::min(input_size, lookahead);
+			for (; i < max_prefetch; ++i) {
+				bids[i] = hash(begin[i]) & mask;
+				KH_PREFETCH(info + bids[i], _MM_HINT_T0);
+				KH_PREFETCH(cont + bids[i], _MM_HINT_T0);
+			}
+
+			size_t cnt = 0;
+			for (i = 0; i < input_size; ++i, ++out) {
+				if ((i + lookahead) < input_size) {
+					size_t b = hash(begin[i + lookahead]) & mask;
+					bids[(i + lookahead) & ring_mask] = b;
+					KH_PREFETCH(info + b, _MM_HINT_T0);
+					KH_PREFETCH(cont + b, _MM_HINT_T0);
+				}
+				cnt += ev(out, find_entry(begin[i], bids[i & ring_mask], out_pred, in_pred));
+			}
+			return cnt;
+		}
+
+	public:
+		explicit shared_view(void const * snapshot = nullptr) : cont(nullptr), info(nullptr), mask(0), lsize(0) {
+			if (snapshot == nullptr) return;
+
+			size_t const * header = reinterpret_cast<size_t const *>(snapshot);
+			mask = header[1];
+			lsize = header[2];
+			cont = reinterpret_cast<value_type const *>(reinterpret_cast<unsigned char const *>(snapshot) + snapshot_header_bytes);
+			info = reinterpret_cast<info_type const *>(cont + header[0] + info_empty);
+		}
+
+		inline size_t size() const { return lsize; }
+
+		template <typename OIter,
+		typename OutPredicate = ::bliss::filter::TruePredicate,
+		typename InPredicate = ::bliss::filter::TruePredicate
+		>
+		size_t count(OIter out, key_type const * begin, key_type const * end,
+				OutPredicate const & out_pred = OutPredicate(),
+				InPredicate const & in_pred = InPredicate() ) const {
+			return lookup(out, begin, end, out_pred, in_pred,
+					[](OIter & it, value_type const * entry) -> uint8_t {
+				*it = (entry != nullptr);
+				return (entry != nullptr);
+			});
+		}
+
+		template <typename OIter,
+		typename OutPredicate = ::bliss::filter::TruePredicate,
+		typename InPredicate = ::bliss::filter::TruePredicate
+		>
+		size_t find(OIter out, key_type const * begin, key_type const * end,
+				mapped_type const & nonexistent = mapped_type(),
+				OutPredicate const & out_pred = OutPredicate(),
+				InPredicate const & in_pred = InPredicate() ) const {
+			return lookup(out, begin, end, out_pred, in_pred,
+					[&nonexistent](OIter & it, value_type const * entry) -> uint8_t {
+				*it = (entry == nullptr) ? nonexistent : entry->second;
+				return (entry != nullptr);
+			});
+		}
+	};
+
+
 
 	/* ========================================================
 	 *  update.  should only update existing entries
@@ -4084,6 +4220,12 @@ template <typename Key, typename T, template <typename> class Hash, template <ty
 constexpr uint32_t hashmap_robinhood_offsets_reduction<Key, T, Hash, Equal, Reducer, Allocator>::info_per_cacheline;
 template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
 constexpr uint32_t hashmap_robinhood_offsets_reduction<Key, T, Hash, Equal, Reducer, Allocator>::value_per_cacheline;
+template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
+constexpr size_t hashmap_robinhood_offsets_reduction<Key, T, Hash, Equal, Reducer, Allocator>::snapshot_header_bytes;
+template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
+constexpr size_t hashmap_robinhood_offsets_reduction<Key, T, Hash, Equal, Reducer, Allocator>::shared_view::lookahead;
+template <typename Key, typename T, template <typename> class Hash, template <typename> class Equal, typename Reducer, typename Allocator >
+constexpr size_t hashmap_robinhood_offsets_reduction<Key, T, Hash, Equal, Reducer, Allocator>::shared_view::ring_mask;
 
 
 //========== ALIASED TYPES
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * splitters.hpp
+ *
+ * regular sampling and splitter selection for the range (SPLITTER_PARTITION) ownership of the distributed maps.
+ * each rank samples its keys with regular_sample, the samples are gathered, and pick_splitters chooses the
+ * comm.size() - 1 keys that split the gathered samples into equal parts.
+ */
+
+#ifndef KMERHASH_SPLITTERS_HPP_
+#define KMERHASH_SPLITTERS_HPP_
+
+#include <vector>
+#include <iterator>  // std::distance
+#include <algorithm>  // std::sort
+
+namespace fsc {
+
+/// call f on count elements of [begin, end), evenly spaced, starting with the first.  at most all elements.
+template <typename IT, typename F>
+void regular_sample(IT begin, IT end, size_t count, F f) {
+	size_t n = ::std::distance(begin, end);
+	if (count > n) count = n;
+	for (size_t i = 0; i < count; ++i) f(*(begin + (i * n) / count));
+}
+
+/**
+ * @brief num_buckets - 1 splitters from the samples of all ranks.  bucket i then holds (splitters[i-1], splitters[i]].
+ * @details samples is sorted in place.  the splitters are the last sample of each of num_buckets equal parts.
+ * @return false, and no splitters, if there are no samples.
+ */
+template <typename Key>
+bool pick_splitters(::std::vector<Key> & samples, size_t const & num_buckets, ::std::vector<Key> & splitters) {
+	splitters.clear();
+	if (samples.size() == 0) return false;
+
+	::std::sort(samples.begin(), samples.end());
+	for (size_t i = 1; i < num_buckets; ++i) {
+		splitters.emplace_back(samples[(i * samples.size() - 1) / num_buckets]);
+	}
+	return true;
+}
+
+}  // namespace fsc
+
+#endif /* KMERHASH_SPLITTERS_HPP_ */
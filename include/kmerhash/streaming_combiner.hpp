@@ -0,0 +1,156 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * streaming_combiner.hpp
+ *
+ * fixed size, direct mapped combiner table for reducing duplicate (key, value) tuples in a stream before they are
+ * sent.  the table is sized to stay in L2.  a tuple whose slot holds a different key evicts that entry, so the
+ * output is only partially reduced, but memory is constant and every access hits cache.
+ *
+ * evicted and flushed entries are handed to an emit functor.  since an entry can only be emitted after at least
+ * one tuple has been absorbed, emit may write back into the input stream at or before the current read position,
+ * i.e. the reduction can be done in place.
+ */
+
+#ifndef KMERHASH_STREAMING_COMBINER_HPP_
+#define KMERHASH_STREAMING_COMBINER_HPP_
+
+#include <vector>
+#include <functional>  // std::equal_to, std::plus
+#include <cstdint>  // uint8_t
+#include <utility>  // std::pair
+#include <algorithm>  // std::copy
+
+namespace fsc {
+
+/**
+ * @brief bounded, cache resident combiner.
+ * @tparam Hash   hash functor on Key, any integral result.
+ * @tparam Equal  must be consistent with Hash.
+ * @tparam Reduc  called with (existing, new).
+ */
+template <typename Key, typename T, typename Hash,
+		typename Equal = ::std::equal_to<Key>, typename Reduc = ::std::plus<T> >
+class streaming_combiner {
+
+public:
+	/// typical per-core L2.
+	static constexpr size_t default_bytes = 256 * 1024;
+
+protected:
+	Hash hash;
+	Equal eq;
+	Reduc reduc;
+
+	size_t mask;
+	std::vector<Key> keys;
+	std::vector<T> vals;
+	std::vector<uint8_t> occupied;
+
+	size_t absorbed;
+	size_t hits;
+
+public:
+	/// largest power of 2 number of slots that fits in bytes.
+	explicit streaming_combiner(size_t const & bytes = default_bytes,
+			Hash const & _hash = Hash(), Equal const & _eq = Equal(), Reduc const & _reduc = Reduc()) :
+		hash(_hash), eq(_eq), reduc(_reduc), mask(0), absorbed(0), hits(0) {
+		size_t slots = 1;
+		while ((slots << 1) * (sizeof(Key) + sizeof(T) + 1) <= bytes) slots <<= 1;
+		mask = slots - 1;
+		keys.resize(slots);
+		vals.resize(slots);
+		occupied.resize(slots, 0);
+	}
+
+	/// add (k, v).  an entry displaced from k's slot is passed to emit(key, val).
+	template <typename Emit>
+	inline void absorb(Key const & k, T const & v, Emit && emit) {
+		++absorbed;
+		size_t i = static_cast<size_t>(hash(k)) & mask;
+
+		if (occupied[i]) {
+			if (eq(keys[i], k)) {
+				vals[i] = reduc(vals[i], v);
+				++hits;
+				return;
+			}
+			emit(keys[i], vals[i]);
+		}
+		keys[i] = k;
+		vals[i] = v;
+		occupied[i] = 1;
+	}
+
+	/// emit all entries still in the table, and empty it.
+	template <typename Emit>
+	void flush(Emit && emit) {
+		for (size_t i = 0; i <= mask; ++i) {
+			if (!occupied[i]) continue;
+			emit(keys[i], vals[i]);
+			occupied[i] = 0;
+		}
+	}
+
+	inline size_t capacity() const { return mask + 1; }
+
+	/// tuples absorbed, and how many of those were combined with an existing entry.
+	inline size_t absorbed_count() const { return absorbed; }
+	inline size_t hit_count() const { return hits; }
+
+	void reset_stats() {
+		absorbed = 0;
+		hits = 0;
+	}
+};
+
+template <typename Key, typename T, typename Hash, typename Equal, typename Reduc>
+constexpr size_t streaming_combiner<Key, T, Hash, Equal, Reduc>::default_bytes;
+
+/**
+ * @brief count duplicate keys in place.  keys seen once stay in input, in order of emission.  keys seen more than
+ *        once are appended to counts as (key, count).
+ * @details gives up after the first probe keys if fewer than 1/8 of them were combined, and leaves the rest of
+ *          input as is, as the pairs would then cost more to send than the keys they replace.
+ * @return true if the whole input was combined.
+ */
+template <typename Key, typename T, typename Hash, typename Equal>
+bool combine_keys(streaming_combiner<Key, T, Hash, Equal, ::std::plus<T> > & comb,
+		::std::vector<Key> & input, ::std::vector<::std::pair<Key, T> > & counts, size_t const & probe) {
+	size_t j = 0;
+	auto emit = [&input, &j, &counts](Key const & k, T const & v) {
+		if (v == 1) input[j++] = k;    // j is always behind the read position.
+		else counts.emplace_back(k, v);
+	};
+
+	size_t i = 0;
+	for (; i < input.size(); ++i) {
+		if ((i == probe) && ((comb.hit_count() << 3) < comb.absorbed_count())) break;
+		comb.absorb(input[i], T(1), emit);
+	}
+	comb.flush(emit);
+
+	// rest is not combined.
+	bool all = (i == input.size());
+	if (j < i) ::std::copy(input.begin() + i, input.end(), input.begin() + j);
+	input.resize(j + input.size() - i);
+	return all;
+}
+
+}  // namespace fsc
+
+#endif /* KMERHASH_STREAMING_COMBINER_HPP_ */
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * super_kmer.hpp
+ *
+ * minimizer based partitioning of k-mers, and a compact encoding of runs of overlapping k-mers (super-k-mers).
+ *
+ * a k-mer's minimizer is its m-mer with the smallest hash value, so consecutive k-mers of a read usually share it.
+ * if ranks are assigned by minimizer, a run of consecutive k-mers that go to the same rank can be sent as the
+ * first k-mer followed by 1 character per additional k-mer, instead of a full k-mer each.
+ *
+ * kmers are bliss kmers:  size, bitsPerChar, nWords, KmerWordType, getData(), nextFromChar().  the newest
+ * character is in the low bits of word 0.
+ */
+
+#ifndef KMERHASH_SUPER_KMER_HPP_
+#define KMERHASH_SUPER_KMER_HPP_
+
+#include <vector>
+#include <cstdint>  // uint8_t, uint32_t, uint64_t
+#include <cstring>  // memcpy
+#include <limits>
+#include <algorithm>  // std::min
+#include <utility>  // std::pair
+#include <type_traits>  // integral_constant
+
+namespace fsc {
+
+/// character i of a kmer, 0 is the oldest (leftmost) character.
+template <typename Kmer>
+inline uint8_t kmer_char(Kmer const & km, unsigned int const & i) {
+	using word_type = typename Kmer::KmerWordType;
+	constexpr unsigned int word_bits = sizeof(word_type) * 8;
+	constexpr word_type char_mask = (static_cast<word_type>(1) << Kmer::bitsPerChar) - 1;
+
+	unsigned int offset = (Kmer::size - 1 - i) * Kmer::bitsPerChar;
+	unsigned int w = offset / word_bits;
+	unsigned int s = offset % word_bits;
+
+	word_type c = km.getData()[w] >> s;
+	if ((s + Kmer::bitsPerChar > word_bits) && (w + 1 < Kmer::nWords))  // straddles 2 words.
+		c |= km.getData()[w + 1] << (word_bits - s);
+	return static_cast<uint8_t>(c & char_mask);
+}
+
+
+/**
+ * @brief hash of a kmer's minimizer, for assigning kmers to ranks.
+ * @details m-mers are ordered by a 64 bit mix of their bits rather than lexicographically, which avoids
+ *          piling the poly-A and other low complexity m-mers onto one rank.
+ *          canonical:  the minimum is over the m-mers of both the kmer and its reverse complement, so a kmer and
+ *          its reverse complement have the same minimizer.  needs Kmer::reverse_complement().
+ * @tparam M   minimizer length.  M * bitsPerChar has to fit in 64 bits.
+ */
+template <typename Kmer, unsigned int M, bool Canonical = false>
+class minimizer_hash {
+	static_assert(M > 0 && M <= Kmer::size, "minimizer length has to be between 1 and k");
+	static_assert(M * Kmer::bitsPerChar <= 64, "minimizer has to fit in 64 bits");
+
+	static constexpr uint64_t mmer_mask = (M * Kmer::bitsPerChar == 64) ? ~(0ULL) :
+			((1ULL << (M * Kmer::bitsPerChar)) - 1);
+
+	/// murmur3 64 bit finalizer.
+	static inline uint64_t mix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	/// smallest mixed m-mer of one strand.
+	static inline uint64_t strand_min(Kmer const & km) {
+		uint64_t mmer = 0;
+		uint64_t best = ::std::numeric_limits<uint64_t>::max();
+		unsigned int i = 0;
+		for (; i < M - 1; ++i) {
+			mmer = (mmer << Kmer::bitsPerChar) | kmer_char(km, i);
+		}
+		for (; i < Kmer::size; ++i) {
+			mmer = ((mmer << Kmer::bitsPerChar) | kmer_char(km, i)) & mmer_mask;
+			best = ::std::min(best, mix(mmer));
+		}
+		return best;
+	}
+
+	static inline uint64_t min_of(Kmer const & km, ::std::false_type) {
+		return strand_min(km);
+	}
+	static inline uint64_t min_of(Kmer const & km, ::std::true_type) {
+		return ::std::min(strand_min(km), strand_min(km.reverse_complement()));
+	}
+
+public:
+	using result_type = uint64_t;
+
+	inline uint64_t operator()(Kmer const & km) const {
+		return min_of(km, ::std::integral_constant<bool, Canonical>());
+	}
+
+	template <typename V>
+	inline uint64_t operator()(::std::pair<Kmer, V> const & x) const {
+		return this->operator()(x.first);
+	}
+};
+
+template <typename Kmer, unsigned int M, bool Canonical>
+constexpr uint64_t minimizer_hash<Kmer, M, Canonical>::mmer_mask;
+
+
+/**
+ * @brief packs kmers into super-k-mers by destination, and unpacks them.
+ * @details a run is a maximal sequence of kmers where each is the previous one shifted by 1 character, all with
+ *          the same destination.  it is encoded as
+ *            uint32_t  number of kmers n
+ *            Kmer      the first kmer
+ *            the last character of the other n - 1 kmers, packed at bitsPerChar each, padded to a byte.
+ *          runs are written unaligned, so memcpy in and out.
+ */
+template <typename Kmer>
+class super_kmer_codec {
+	static_assert(Kmer::bitsPerChar <= 8, "characters are packed into bytes");
+
+protected:
+	using count_type = uint32_t;
+
+	static constexpr size_t header_bytes = sizeof(count_type) + sizeof(Kmer);
+
+	static inline size_t run_bytes(size_t const & n) {
+		return header_bytes + ((n - 1) * Kmer::bitsPerChar + 7) / 8;
+	}
+
+	/// true if next is prev shifted left by 1 character.
+	static inline bool extends(Kmer const & prev, Kmer const & next) {
+		Kmer t = prev;
+		t.nextFromChar(kmer_char(next, Kmer::size - 1));
+		return t == next;
+	}
+
+	/// end of the run starting at kmers[s].
+	template <typename RankType>
+	static inline size_t run_end(Kmer const * kmers, RankType const * ranks, size_t const & s, size_t const & count) {
+		size_t e = s + 1;
+		size_t max_e = s + ::std::min(count - s, static_cast<size_t>(::std::numeric_limits<count_type>::max()));
+		while ((e < max_e) && (ranks[e] == ranks[s]) && extends(kmers[e - 1], kmers[e])) ++e;
+		return e;
+	}
+
+	static uint8_t * write_run(Kmer const * kmers, size_t const & n, uint8_t * out) {
+		count_type cnt = static_cast<count_type>(n);
+		memcpy(out, &cnt, sizeof(count_type));
+		memcpy(out + sizeof(count_type), kmers, sizeof(Kmer));
+		out += header_bytes;
+
+		uint32_t bits = 0;   // pending bits, LSB first.
+		unsigned int nbits = 0;
+		for (size_t i = 1; i < n; ++i) {
+			bits |= static_cast<uint32_t>(kmer_char(kmers[i], Kmer::size - 1)) << nbits;
+			nbits += Kmer::bitsPerChar;
+			while (nbits >= 8) {
+				*out = static_cast<uint8_t>(bits);
+				++out;
+				bits >>= 8;
+				nbits -= 8;
+			}
+		}
+		if (nbits > 0) {
+			*out = static_cast<uint8_t>(bits);
+			++out;
+		}
+		return out;
+	}
+
+public:
+
+	/**
+	 * @brief encode kmers, grouped by ranks[i] in [0, num_ranks).
+	 * @param out          bytes for rank r start at the sum of byte_counts[0..r).
+	 * @param byte_counts  resized to num_ranks.
+	 * @return number of runs.
+	 */
+	template <typename RankType>
+	static size_t encode(Kmer const * kmers, size_t const & count, RankType const * ranks, size_t const & num_ranks,
+			std::vector<uint8_t> & out, std::vector<size_t> & byte_counts) {
+		byte_counts.assign(num_ranks, 0);
+
+		std::vector<size_t> runs;   // start of each run, and count at the end.
+		for (size_t s = 0, e; s < count; s = e) {
+			e = run_end(kmers, ranks, s, count);
+			runs.emplace_back(s);
+			byte_counts[ranks[s]] += run_bytes(e - s);
+		}
+		runs.emplace_back(count);
+
+		std::vector<size_t> offsets(num_ranks, 0);
+		for (size_t r = 1; r < num_ranks; ++r) offsets[r] = offsets[r - 1] + byte_counts[r - 1];
+		out.resize(num_ranks == 0 ? 0 : offsets[num_ranks - 1] + byte_counts[num_ranks - 1]);
+
+		size_t s;
+		for (size_t i = 0; i + 1 < runs.size(); ++i) {
+			s = runs[i];
+			offsets[ranks[s]] = write_run(kmers + s, runs[i + 1] - s, out.data() + offsets[ranks[s]]) - out.data();
+		}
+		return runs.size() - 1;
+	}
+
+	/// number of kmers in an encoded buffer.
+	static size_t count(uint8_t const * begin, uint8_t const * end) {
+		size_t total = 0;
+		count_type n;
+		while (begin < end) {
+			memcpy(&n, begin, sizeof(count_type));
+			total += n;
+			begin += run_bytes(n);
+		}
+		return total;
+	}
+
+	/// append the kmers in an encoded buffer to output.
+	static void decode(uint8_t const * begin, uint8_t const * end, std::vector<Kmer> & output) {
+		output.reserve(output.size() + count(begin, end));
+
+		constexpr uint32_t char_mask = (1U << Kmer::bitsPerChar) - 1;
+		count_type n;
+		Kmer km;
+		while (begin < end) {
+			memcpy(&n, begin, sizeof(count_type));
+			memcpy(&km, begin + sizeof(count_type), sizeof(Kmer));
+			output.emplace_back(km);
+			begin += header_bytes;
+
+			uint32_t bits = 0;
+			unsigned int nbits = 0;
+			for (count_type i = 1; i < n; ++i) {
+				if (nbits < Kmer::bitsPerChar) {
+					bits |= static_cast<uint32_t>(*begin) << nbits;
+					++begin;
+					nbits += 8;
+				}
+				km.nextFromChar(static_cast<uint8_t>(bits & char_mask));
+				output.emplace_back(km);
+				bits >>= Kmer::bitsPerChar;
+				nbits -= Kmer::bitsPerChar;
+			}
+		}
+	}
+};
+
+template <typename Kmer>
+constexpr size_t super_kmer_codec<Kmer>::header_bytes;
+
+}  // namespace fsc
+
+#endif /* KMERHASH_SUPER_KMER_HPP_ */
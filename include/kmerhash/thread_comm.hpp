@@ -0,0 +1,301 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * thread_comm.hpp
+ *
+ * in-process communicator.  ranks are threads of one process, and data moves by a single memcpy from the sender's
+ * buffer to the receiver's, with no MPI staging.  supports the operations the distributed maps use:
+ *   barrier, all2all, all2allv, allreduce, exscan, and tagged isend/issend/irsend/irecv.
+ * the exchanges in exchange.hpp run on it as they do on an ::mxx::comm.  the distributed map classes do not:  they
+ * hold an ::mxx::comm, so a map cannot be constructed on a thread_comm.
+ *
+ * collectives publish a pointer per rank, synchronize, and let every rank read what it needs directly.  all ranks
+ * of a group have to call the same collectives in the same order, as with MPI.
+ *
+ * point to point messages match in order by (source, tag).  whichever of the send and the receive is posted second
+ * does the copy, so no progress thread is needed.  as with MPI, buffers have to stay valid until the request is
+ * complete.  a message larger than the receive buffer is not copied, and waiting on the receive throws
+ * std::length_error.  an all2allv whose recv_counts do not match the senders' throws the same on every rank.
+ *
+ * element types have to be trivially copyable.
+ */
+
+#ifndef KMERHASH_THREAD_COMM_HPP_
+#define KMERHASH_THREAD_COMM_HPP_
+
+#include <vector>
+#include <deque>
+#include <memory>  // shared_ptr
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <functional>  // logical_and
+#include <cstring>  // memcpy
+#include <stdexcept>  // length_error
+
+namespace khmxx {
+
+class thread_comm {
+
+protected:
+
+	/// state of one pending send or receive.
+	struct message {
+		int peer;   // source for receives, destination for sends.
+		int tag;
+		void * ptr;
+		size_t bytes;
+		bool truncated;  // receives only.  set before done.
+		std::atomic<bool> done;
+
+		message(int _peer, int _tag, void * _ptr, size_t _bytes) :
+			peer(_peer), tag(_tag), ptr(_ptr), bytes(_bytes), truncated(false), done(false) {}
+	};
+
+	/// unmatched sends to, and receives posted by, one rank.
+	struct mailbox {
+		std::mutex mtx;
+		std::deque<std::pair<int, std::shared_ptr<message> > > sends;   // (source, message)
+		std::deque<std::shared_ptr<message> > recvs;
+	};
+
+	/// shared by all ranks of a group.
+	struct group {
+		int size;
+
+		std::mutex mtx;
+		std::condition_variable cv;
+		int arrived;
+		size_t generation;
+
+		// published per rank during a collective.
+		std::vector<void const *> slots;
+		std::vector<void const *> aux;
+
+		std::vector<mailbox> mailboxes;
+
+		explicit group(int const & _size) :
+			size(_size), arrived(0), generation(0), slots(_size, nullptr), aux(_size, nullptr), mailboxes(_size) {}
+	};
+
+	std::shared_ptr<group> g;
+	int r;
+
+	thread_comm(std::shared_ptr<group> const & _g, int const & _rank) : g(_g), r(_rank) {}
+
+	static inline void copy(message & recv, void const * src, size_t const & bytes) {
+		if (bytes > recv.bytes) recv.truncated = true;
+		else memcpy(recv.ptr, src, bytes);
+	}
+
+public:
+
+	/// handle of a nonblocking send or receive.
+	class request {
+		friend class thread_comm;
+		std::shared_ptr<message> msg;
+
+	public:
+		request() {}
+
+		/// true if complete.  a default constructed request is complete.
+		inline bool test() const { return !msg || msg->done.load(std::memory_order_acquire); }
+
+		/// throws std::length_error if a received message did not fit.
+		void wait() const {
+			while (!test()) std::this_thread::yield();
+			if (msg && msg->truncated) throw std::length_error("message larger than the receive buffer.");
+		}
+	};
+
+	/// communicators for ranks 0 .. size-1 of a new group.  hand one to each thread.
+	static std::vector<thread_comm> create(int const & size) {
+		std::shared_ptr<group> g = std::make_shared<group>(size);
+		std::vector<thread_comm> comms;
+		comms.reserve(size);
+		for (int i = 0; i < size; ++i) comms.emplace_back(thread_comm(g, i));
+		return comms;
+	}
+
+	/// run f(thread_comm const &) on size threads, one per rank, and join them.
+	template <typename F>
+	static void run(int const & size, F f) {
+		std::vector<thread_comm> comms = create(size);
+		std::vector<std::thread> threads;
+		threads.reserve(size);
+		for (int i = 0; i < size; ++i) {
+			thread_comm const & c = comms[i];
+			threads.emplace_back([&f, &c](){ f(c); });
+		}
+		for (auto & t : threads) t.join();
+	}
+
+	inline int size() const { return g->size; }
+	inline int rank() const { return r; }
+
+	void barrier() const {
+		std::unique_lock<std::mutex> lock(g->mtx);
+		size_t gen = g->generation;
+		if (++(g->arrived) == g->size) {
+			g->arrived = 0;
+			++(g->generation);
+			g->cv.notify_all();
+		} else {
+			g->cv.wait(lock, [this, gen](){ return g->generation != gen; });
+		}
+	}
+
+	/// count elements to and from every rank.
+	template <typename T>
+	void all2all(T const * send, size_t const & count, T * recv) const {
+		g->slots[r] = send;
+		barrier();
+		for (int i = 0; i < g->size; ++i) {
+			memcpy(recv + i * count, static_cast<T const *>(g->slots[i]) + r * count, count * sizeof(T));
+		}
+		barrier();
+	}
+
+	/// send buffer is grouped by destination rank.  recv_counts has to match the senders' send_counts,
+	/// else nothing is copied from the mismatched senders and all ranks throw std::length_error.
+	template <typename T, typename SIZE>
+	void all2allv(T const * send, std::vector<SIZE> const & send_counts,
+			T * recv, std::vector<SIZE> const & recv_counts) const {
+		std::vector<size_t> send_displs(g->size + 1, 0);
+		for (int i = 0; i < g->size; ++i) send_displs[i + 1] = send_displs[i] + send_counts[i];
+
+		g->slots[r] = send;
+		g->aux[r] = send_displs.data();
+		barrier();
+		size_t const * displs;
+		bool match = true;
+		for (int i = 0; i < g->size; ++i) {
+			displs = static_cast<size_t const *>(g->aux[i]);
+			if (displs[r + 1] - displs[r] == static_cast<size_t>(recv_counts[i]))
+				memcpy(recv, static_cast<T const *>(g->slots[i]) + displs[r], (displs[r + 1] - displs[r]) * sizeof(T));
+			else match = false;
+			recv += recv_counts[i];
+		}
+		barrier();
+
+		if (!allreduce(match, std::logical_and<bool>())) throw std::length_error("all2allv recv count mismatch.");
+	}
+
+	/// same result on every rank.  ranks are combined in order, so op only has to be associative.
+	template <typename T, typename Op>
+	T allreduce(T const & x, Op op) const {
+		g->slots[r] = &x;
+		barrier();
+		T result = *static_cast<T const *>(g->slots[0]);
+		for (int i = 1; i < g->size; ++i) result = op(result, *static_cast<T const *>(g->slots[i]));
+		barrier();
+		return result;
+	}
+
+	/// combination of ranks 0 .. rank-1.  rank 0 gets T().
+	template <typename T, typename Op>
+	T exscan(T const & x, Op op) const {
+		g->slots[r] = &x;
+		barrier();
+		T result = T();
+		if (r > 0) {
+			result = *static_cast<T const *>(g->slots[0]);
+			for (int i = 1; i < r; ++i) result = op(result, *static_cast<T const *>(g->slots[i]));
+		}
+		barrier();
+		return result;
+	}
+
+	template <typename T>
+	request isend(T const * data, size_t const & count, int const & dest, int const & tag) const {
+		request req;
+		req.msg = std::make_shared<message>(dest, tag, const_cast<T *>(data), count * sizeof(T));
+
+		mailbox & box = g->mailboxes[dest];
+		std::shared_ptr<message> recv;
+		{
+			std::lock_guard<std::mutex> lock(box.mtx);
+			for (auto it = box.recvs.begin(); it != box.recvs.end(); ++it) {
+				if (((*it)->peer == r) && ((*it)->tag == tag)) {
+					recv = *it;
+					box.recvs.erase(it);
+					break;
+				}
+			}
+			if (!recv) box.sends.emplace_back(r, req.msg);
+		}
+		if (recv) {
+			copy(*recv, data, req.msg->bytes);
+			recv->done.store(true, std::memory_order_release);
+			req.msg->done.store(true, std::memory_order_release);
+		}
+		return req;
+	}
+
+	/// a send completes only when it is matched, so the synchronous send is the same.
+	template <typename T>
+	inline request issend(T const * data, size_t const & count, int const & dest, int const & tag) const {
+		return isend(data, count, dest, tag);
+	}
+
+	/// the caller guarantees the receive is posted.  the copy is the same.
+	template <typename T>
+	inline request irsend(T const * data, size_t const & count, int const & dest, int const & tag) const {
+		return isend(data, count, dest, tag);
+	}
+
+	template <typename T>
+	request irecv(T * data, size_t const & count, int const & src, int const & tag) const {
+		request req;
+		req.msg = std::make_shared<message>(src, tag, data, count * sizeof(T));
+
+		mailbox & box = g->mailboxes[r];
+		std::shared_ptr<message> send;
+		{
+			std::lock_guard<std::mutex> lock(box.mtx);
+			for (auto it = box.sends.begin(); it != box.sends.end(); ++it) {
+				if ((it->first == src) && (it->second->tag == tag)) {
+					send = it->second;
+					box.sends.erase(it);
+					break;
+				}
+			}
+			if (!send) box.recvs.emplace_back(req.msg);
+		}
+		if (send) {
+			copy(*(req.msg), send->ptr, send->bytes);
+			send->done.store(true, std::memory_order_release);
+			req.msg->done.store(true, std::memory_order_release);
+		}
+		return req;
+	}
+
+	template <typename T>
+	inline void send(T const * data, size_t const & count, int const & dest, int const & tag) const {
+		isend(data, count, dest, tag).wait();
+	}
+
+	template <typename T>
+	inline void recv(T * data, size_t const & count, int const & src, int const & tag) const {
+		irecv(data, count, src, tag).wait();
+	}
+};
+
+}  // namespace khmxx
+
+#endif /* KMERHASH_THREAD_COMM_HPP_ */
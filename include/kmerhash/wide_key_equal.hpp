@@ -0,0 +1,125 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * wide_key_equal.hpp
+ *
+ * key equality for the probe loops.  2-word (128 bit) and 4-word (256 bit) k-mers are compared with a single
+ * SSE / AVX test instead of the word-by-word loop in Kmer::operator==.  all other keys use the supplied Equal.
+ *
+ * the SIMD path is only taken when
+ *   1. the key's bytes are its value (integers, and kmers with no padding), see is_bitwise_comparable, and
+ *   2. Equal is plain equality, see is_bitwise_equal.  specialize it for other equality functors that are known
+ *      to be bitwise equality.
+ */
+
+#ifndef KMERHASH_WIDE_KEY_EQUAL_HPP_
+#define KMERHASH_WIDE_KEY_EQUAL_HPP_
+
+#include <type_traits>
+#include <functional>  // std::equal_to
+
+#include <x86intrin.h>
+
+namespace fsc {
+
+/// true if two keys are equal iff their bytes are equal.
+template <typename Key, typename = void>
+struct is_bitwise_comparable : public ::std::integral_constant<bool, ::std::is_integral<Key>::value> {};
+
+/// kmers:  an array of nWords words and nothing else.
+template <typename Key>
+struct is_bitwise_comparable<Key, typename ::std::enable_if<(Key::nWords > 0)>::type> :
+	public ::std::integral_constant<bool, (sizeof(Key) == Key::nWords * sizeof(typename Key::KmerWordType))> {};
+
+
+/// true if the equality functor is plain operator==.
+template <typename Equal>
+struct is_bitwise_equal : public ::std::false_type {};
+
+template <typename Key>
+struct is_bitwise_equal<::std::equal_to<Key> > : public ::std::true_type {};
+
+
+/**
+ * @brief wraps an equality functor, comparing 16 and 32 byte keys with SIMD when allowed.
+ */
+template <typename Key, typename Equal>
+class wide_key_equal {
+
+protected:
+	Equal eq;
+
+	static constexpr bool use_simd = is_bitwise_comparable<Key>::value && is_bitwise_equal<Equal>::value;
+
+public:
+	wide_key_equal(Equal const & _eq = Equal()) : eq(_eq) {}
+
+	/// general case.
+	template <size_t KEY_SIZE = sizeof(Key),
+			typename ::std::enable_if<!use_simd || ((KEY_SIZE != 16) && (KEY_SIZE != 32)), int>::type = 1>
+	inline bool operator()(Key const & x, Key const & y) const {
+		return eq(x, y);
+	}
+
+#if defined(__SSE2__)
+	/// 2 words.
+	template <size_t KEY_SIZE = sizeof(Key),
+			typename ::std::enable_if<use_simd && (KEY_SIZE == 16), int>::type = 1>
+	inline bool operator()(Key const & x, Key const & y) const {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&x));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&y));
+#if defined(__SSE4_1__)
+		a = _mm_xor_si128(a, b);
+		return _mm_testz_si128(a, a);
+#else
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+#endif
+	}
+
+	/// 4 words.
+	template <size_t KEY_SIZE = sizeof(Key),
+			typename ::std::enable_if<use_simd && (KEY_SIZE == 32), int>::type = 1>
+	inline bool operator()(Key const & x, Key const & y) const {
+#if defined(__AVX2__)
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&x));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&y));
+		a = _mm256_xor_si256(a, b);
+		return _mm256_testz_si256(a, a);
+#else
+		__m128i a0 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&x));
+		__m128i a1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&x) + 1);
+		__m128i b0 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&y));
+		__m128i b1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&y) + 1);
+		return _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a0, b0), _mm_cmpeq_epi8(a1, b1))) == 0xFFFF;
+#endif
+	}
+#else
+	template <size_t KEY_SIZE = sizeof(Key),
+			typename ::std::enable_if<use_simd && ((KEY_SIZE == 16) || (KEY_SIZE == 32)), int>::type = 1>
+	inline bool operator()(Key const & x, Key const & y) const {
+		return eq(x, y);
+	}
+#endif
+
+};
+
+template <typename Key, typename Equal>
+constexpr bool wide_key_equal<Key, Equal>::use_simd;
+
+}  // namespace fsc
+
+#endif /* KMERHASH_WIDE_KEY_EQUAL_HPP_ */
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * dist_map_test_utils.hpp
+ *
+ * shared by the distributed map mpi tests:  the kmer and map parameter types, test input, and gathering a map's
+ * entries.  partitioning macros such as SPLITTER_PARTITION have to be defined before this is included.
+ */
+
+#ifndef KMERHASH_DIST_MAP_TEST_UTILS_HPP_
+#define KMERHASH_DIST_MAP_TEST_UTILS_HPP_
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+
+#include "common/kmer.hpp"
+#include "common/alphabets.hpp"
+#include "index/kmer_index.hpp"  // map params
+#include "kmerhash/hash_new.hpp"
+#include "kmerhash/distributed_batched_robinhood_map.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <random>
+#include <algorithm>
+
+
+using KmerType = ::bliss::common::Kmer<21, ::bliss::common::DNA, uint64_t>;
+template <typename KM>
+using DistHash = ::fsc::hash::farm<KM>;
+template <typename KM>
+using StoreHash = ::fsc::hash::farm<KM>;
+template <typename KM>
+using DistTrans = ::bliss::transform::identity<KM>;
+template <typename Key>
+using MapParams = ::bliss::index::kmer::SingleStrandHashMapParams<Key, DistHash, StoreHash, DistTrans>;
+using MapType = ::dsc::counting_batched_robinhood_map<KmerType, uint32_t, MapParams>;
+
+
+/// random kmers.  if skewed, every other one is from a small set of hot kmers, so there are counts > 1.
+inline std::vector<KmerType> make_kmers(size_t count, int seed, bool skewed = false) {
+	std::default_random_engine generator(seed);
+	std::uniform_int_distribution<unsigned int> base(0, 3);
+	std::uniform_int_distribution<unsigned int> hot(0, 63);
+
+	std::vector<KmerType> kmers;
+	kmers.reserve(count);
+	KmerType kmer;
+	for (size_t i = 0; i < count; ++i) {
+		if (!skewed || (i & 1)) {
+			for (size_t j = 0; j < KmerType::size; ++j) kmer.nextFromChar(base(generator));
+		} else {
+			unsigned int h = hot(generator);
+			for (size_t j = 0; j < KmerType::size; ++j) kmer.nextFromChar((j < 3) ? ((h >> (2 * j)) & 3) : 0);
+		}
+		kmers.emplace_back(kmer);
+	}
+	return kmers;
+}
+
+/// all entries of the map, sorted by key, on every rank.
+template <typename Map>
+std::vector<std::pair<KmerType, typename Map::mapped_type> > gather_sorted(Map const & map, mxx::comm const & comm) {
+	using entry_type = std::pair<KmerType, typename Map::mapped_type>;
+	std::vector<entry_type> local;
+	map.to_vector(local);
+	std::vector<entry_type> all = mxx::allgatherv(local, comm);
+	std::sort(all.begin(), all.end(), [](entry_type const & x, entry_type const & y) {
+		return x.first < y.first;
+	});
+	return all;
+}
+
+#endif /* KMERHASH_DIST_MAP_TEST_UTILS_HPP_ */
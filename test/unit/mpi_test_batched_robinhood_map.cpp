@@ -0,0 +1,225 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// distributed counting map:  checkpoint and restore, fused insert.
+
+// include google test
+#include <gtest/gtest.h>
+
+#include <mxx/env.hpp>
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+
+#include "dist_map_test_utils.hpp"
+
+#include <cstdint>  // uint64_t
+#include <cstdio>  // remove
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <functional>  // bit_or
+
+
+// e.g. adjacency bits, filled by the same kmer stream as the counts.
+using EdgeMapType = ::dsc::reduction_batched_robinhood_map<KmerType, uint32_t, MapParams, ::std::bit_or<uint32_t> >;
+
+
+static void remove_checkpoint(std::string const & prefix, int parts) {
+	for (int i = 0; i < parts; ++i) {
+		std::stringstream ss;
+		ss << prefix << "." << i;
+		std::remove(ss.str().c_str());
+	}
+	std::remove((prefix + ".parts").c_str());
+}
+
+
+TEST(BatchedRobinhoodMapTest, checkpoint_round_trip)
+{
+	mxx::comm comm;
+	std::string prefix("kmerhash_checkpoint_test");
+
+	MapType map(comm);
+	std::vector<KmerType> kmers = make_kmers(10000, comm.rank(), true);
+	map.insert(kmers);
+	std::vector<std::pair<KmerType, uint32_t> > expected = gather_sorted(map, comm);
+	map.checkpoint(prefix);
+
+	// same communicator.
+	MapType same(comm);
+	same.restore(prefix);
+	EXPECT_TRUE(expected == gather_sorted(same, comm));
+
+	// fewer ranks, so some read several parts.
+	mxx::comm half = comm.split(comm.rank() < (comm.size() + 1) / 2);
+	if (comm.rank() < (comm.size() + 1) / 2) {
+		MapType fewer(half);
+		fewer.restore(prefix);
+		EXPECT_TRUE(expected == gather_sorted(fewer, half));
+	}
+	comm.barrier();
+
+	if (comm.rank() == 0) remove_checkpoint(prefix, comm.size());
+	comm.barrier();
+}
+
+TEST(BatchedRobinhoodMapTest, restore_failure_keeps_contents)
+{
+	mxx::comm comm;
+	std::string prefix("kmerhash_checkpoint_missing");
+
+	MapType map(comm);
+	std::vector<KmerType> kmers = make_kmers(1000, comm.rank(), true);
+	map.insert(kmers);
+	map.checkpoint(prefix);
+
+	// a missing part is seen by one rank only.  all ranks throw, and nothing is changed.
+	if (comm.rank() == 0) {
+		std::stringstream ss;
+		ss << prefix << "." << (comm.size() - 1);
+		std::remove(ss.str().c_str());
+	}
+	comm.barrier();
+
+	map.insert(kmers);
+	std::vector<std::pair<KmerType, uint32_t> > doubled = gather_sorted(map, comm);
+	EXPECT_THROW(map.restore(prefix), std::invalid_argument);
+	EXPECT_TRUE(doubled == gather_sorted(map, comm));
+	EXPECT_THROW(map.restore("kmerhash_checkpoint_none"), std::invalid_argument);
+	EXPECT_TRUE(doubled == gather_sorted(map, comm));
+
+	if (comm.rank() == 0) remove_checkpoint(prefix, comm.size());
+	comm.barrier();
+}
+
+TEST(BatchedRobinhoodMapTest, submit_then_checkpoint)
+{
+	mxx::comm comm;
+	std::string prefix("kmerhash_checkpoint_submit");
+
+	std::vector<KmerType> kmers = make_kmers(5000, comm.rank(), true);
+	MapType ref(comm);
+	std::vector<KmerType> input = kmers;
+	ref.insert(input);
+	std::vector<std::pair<KmerType, uint32_t> > expected = gather_sorted(ref, comm);
+
+	// with more than 1 rank the batch stays in flight, and the collective reads and writes refuse to run.
+	MapType map(comm);
+	input = kmers;
+	map.insert_submit(input);
+	if (comm.size() > 1) {
+		EXPECT_THROW(map.checkpoint(prefix), std::logic_error);
+		EXPECT_THROW(map.restore(prefix), std::logic_error);
+		std::vector<std::pair<KmerType, uint32_t> > local;
+		EXPECT_THROW(map.to_vector(local), std::logic_error);
+	}
+	map.insert_wait();
+
+	map.checkpoint(prefix);
+	MapType restored(comm);
+	restored.restore(prefix);
+	EXPECT_TRUE(expected == gather_sorted(restored, comm));
+
+	if (comm.rank() == 0) remove_checkpoint(prefix, comm.size());
+	comm.barrier();
+}
+
+TEST(BatchedRobinhoodMapTest, insert_fused)
+{
+	mxx::comm comm;
+	std::vector<KmerType> kmers = make_kmers(10000, comm.rank(), true);
+
+	// (k, (1, edge bit)), and the same pairs for separate inserts.
+	std::vector<std::pair<KmerType, std::pair<uint32_t, uint32_t> > > fused;
+	std::vector<std::pair<KmerType, uint32_t> > counts, edges;
+	for (size_t i = 0; i < kmers.size(); ++i) {
+		uint32_t bit = 1U << (i % 8);
+		fused.emplace_back(kmers[i], std::make_pair(1U, bit));
+		counts.emplace_back(kmers[i], 1U);
+		edges.emplace_back(kmers[i], bit);
+	}
+
+	MapType count_ref(comm);
+	EdgeMapType edge_ref(comm);
+	count_ref.insert(counts);
+	edge_ref.insert(edges);
+	std::vector<std::pair<KmerType, uint32_t> > expected_counts = gather_sorted(count_ref, comm);
+	std::vector<std::pair<KmerType, uint32_t> > expected_edges = gather_sorted(edge_ref, comm);
+
+	// overlapped with the size estimate, and the blocking exchange.  the second round adds to existing entries.
+	std::vector<::khmxx::incremental::overlap_mode> modes = {
+		::khmxx::incremental::overlap_mode::pairwise, ::khmxx::incremental::overlap_mode::none };
+	for (auto mode : modes) {
+		MapType count_map(comm);
+		EdgeMapType edge_map(comm);
+		count_map.set_overlap_mode(mode);
+
+		std::vector<std::pair<KmerType, std::pair<uint32_t, uint32_t> > > input = fused;
+		count_map.insert_fused(edge_map, input);
+		EXPECT_TRUE(expected_counts == gather_sorted(count_map, comm));
+		EXPECT_TRUE(expected_edges == gather_sorted(edge_map, comm));
+
+		input = fused;
+		std::pair<size_t, size_t> added = count_map.insert_fused(edge_map, input);
+		EXPECT_EQ(added.first, 0UL);
+		EXPECT_EQ(added.second, 0UL);
+		std::vector<std::pair<KmerType, uint32_t> > doubled = gather_sorted(count_map, comm);
+		ASSERT_EQ(doubled.size(), expected_counts.size());
+		for (size_t i = 0; i < doubled.size(); ++i) EXPECT_EQ(doubled[i].second, 2 * expected_counts[i].second);
+		EXPECT_TRUE(expected_edges == gather_sorted(edge_map, comm));
+	}
+}
+
+TEST(BatchedRobinhoodMapTest, count_small)
+{
+	mxx::comm comm;
+	std::vector<KmerType> kmers = make_kmers(10000, comm.rank(), true);
+
+	MapType map(comm);
+	std::vector<KmerType> input = kmers;
+	map.insert(input);
+
+	// a few present keys per rank, none on rank 0, and mostly absent ones.  then no keys anywhere.
+	std::vector<KmerType> few = make_kmers(comm.rank() == 0 ? 0 : 5 * comm.rank(), comm.rank(), true);
+	std::vector<KmerType> absent = make_kmers(comm.rank() == 0 ? 0 : 5, comm.rank() + comm.size());
+	few.insert(few.end(), absent.begin(), absent.end());
+
+	std::vector<std::vector<KmerType> > queries = { few, std::vector<KmerType>() };
+	for (auto const & query : queries) {
+		// count permutes the keys, order maps each result back to its query.
+		std::vector<KmerType> keys = query;
+		std::vector<MapType::count_result_type> permuted_results(keys.size());
+		std::vector<size_t> order;
+		map.count(keys, permuted_results.data(), order);
+		std::vector<MapType::count_result_type> expected(query.size());
+		for (size_t j = 0; j < order.size(); ++j) expected[order[j]] = permuted_results[j];
+
+		std::vector<MapType::count_result_type> results(query.size());
+		map.count_small(query, results.data());
+		EXPECT_EQ(expected, results);
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	::testing::InitGoogleTest(&argc, argv);
+	mxx::env e(argc, argv);
+
+	int result = RUN_ALL_TESTS();
+	return result;
+}
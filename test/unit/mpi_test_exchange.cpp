@@ -0,0 +1,287 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// the mpi exchanges of incremental_mxx.hpp, checked against plain mxx::all2allv on uneven and empty per rank input.
+
+// include google test
+#include <gtest/gtest.h>
+
+#include <mxx/env.hpp>
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+
+#include "kmerhash/incremental_mxx.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <random>
+#include <algorithm>
+
+
+/// keys of one rank.  every other one is from a small set shared by all ranks.
+static std::vector<uint64_t> make_keys(size_t count, int rank) {
+	std::default_random_engine generator(rank);
+	std::uniform_int_distribution<uint64_t> wide(0, 1UL << 40);
+	std::uniform_int_distribution<uint64_t> hot(0, 63);
+
+	std::vector<uint64_t> keys(count);
+	for (size_t i = 0; i < count; ++i) keys[i] = (i & 1) ? wide(generator) : hot(generator);
+	return keys;
+}
+
+/// uneven input:  none on rank 0, more on higher ranks.
+static std::vector<uint64_t> uneven_keys(mxx::comm const & comm) {
+	return make_keys(comm.rank() == 0 ? 0 : 100 * comm.rank(), comm.rank());
+}
+
+static inline int owner(uint64_t const & k, int const & p) {
+	return static_cast<int>((k * 0x9E3779B97F4A7C15ULL >> 32) % p);
+}
+
+/// group the keys by owner rank.
+static std::vector<uint64_t> permute(std::vector<uint64_t> const & keys, int const & p, std::vector<size_t> & send_counts) {
+	send_counts.assign(p, 0);
+	for (auto k : keys) ++send_counts[owner(k, p)];
+	std::vector<size_t> offsets(p, 0);
+	for (int i = 1; i < p; ++i) offsets[i] = offsets[i - 1] + send_counts[i - 1];
+	std::vector<uint64_t> permuted(keys.size());
+	for (auto k : keys) permuted[offsets[owner(k, p)]++] = k;
+	return permuted;
+}
+
+/// what mxx::all2allv delivers from each source rank, each sorted.
+static std::vector<std::vector<uint64_t> > expected_by_source(std::vector<uint64_t> const & input,
+		std::vector<size_t> const & send_counts, mxx::comm const & comm) {
+	std::vector<size_t> recv_counts = mxx::all2all(send_counts, comm);
+	std::vector<uint64_t> received = mxx::all2allv(input, send_counts, comm);
+
+	std::vector<std::vector<uint64_t> > by_source(comm.size());
+	size_t offset = 0;
+	for (int i = 0; i < comm.size(); offset += recv_counts[i], ++i) {
+		by_source[i].assign(received.begin() + offset, received.begin() + offset + recv_counts[i]);
+		std::sort(by_source[i].begin(), by_source[i].end());
+	}
+	return by_source;
+}
+
+static inline uint64_t respond(uint64_t const & k) {
+	return k * 3 + 1;
+}
+
+
+TEST(ExchangeTest, hierarchical_all2allv)
+{
+	mxx::comm comm;
+	int p = comm.size();
+	int r = comm.rank();
+
+	// 2 ranks per simulated node, so the two phase path runs on a single node too.
+	::khmxx::hierarchical_comm simulated(comm);
+	bool simulate = ((p & 1) == 0) && (p >= 4);
+	if (simulate) {
+		simulated.node_comm = comm.split(r / 2);
+		simulated.core_comm = comm.split(r % 2, r / 2);
+		simulated.node_count = p / 2;
+		simulated.core_count = 2;
+		simulated.node_rank = r / 2;
+		simulated.core_rank = r % 2;
+		simulated.uniform = true;
+		simulated.global_ranks.resize(p);
+		for (int i = 0; i < p; ++i) simulated.global_ranks[i] = i;
+		EXPECT_TRUE(simulated.is_hierarchical());
+	}
+
+	std::vector<std::vector<uint64_t> > inputs = { uneven_keys(comm), std::vector<uint64_t>() };
+	for (auto const & keys : inputs) {
+		std::vector<size_t> send_counts;
+		std::vector<uint64_t> input = permute(keys, p, send_counts);
+		std::vector<size_t> recv_counts = mxx::all2all(send_counts, comm);
+		std::vector<uint64_t> expected = mxx::all2allv(input, send_counts, comm);
+
+		std::vector<uint64_t> output(expected.size());
+		::khmxx::hierarchical_all2allv(input.data(), send_counts, output.data(), recv_counts,
+				::khmxx::get_hierarchical_comm(comm), comm);
+		EXPECT_EQ(expected, output);
+
+		if (simulate) {
+			std::fill(output.begin(), output.end(), 0);
+			::khmxx::hierarchical_all2allv(input.data(), send_counts, output.data(), recv_counts, simulated, comm);
+			EXPECT_EQ(expected, output);
+		}
+	}
+}
+
+TEST(ExchangeTest, overlap_modes)
+{
+	using ::khmxx::incremental::overlap_mode;
+
+	mxx::comm comm;
+	int p = comm.size();
+
+	// uneven, nonempty on all ranks so that two_phase has a first phase, and empty.
+	std::vector<std::vector<uint64_t> > inputs = {
+			uneven_keys(comm), make_keys(1000 + 100 * comm.rank(), comm.rank()), std::vector<uint64_t>() };
+	std::vector<overlap_mode> modes = {
+			overlap_mode::pairwise, overlap_mode::batch, overlap_mode::fullbuffer, overlap_mode::two_phase };
+
+	for (auto const & keys : inputs) {
+		std::vector<size_t> send_counts;
+		std::vector<uint64_t> input = permute(keys, p, send_counts);
+		std::vector<std::vector<uint64_t> > expected = expected_by_source(input, send_counts, comm);
+
+		for (auto mode : modes) {
+			// received in any order and in any number of pieces, but from the right source.
+			std::vector<std::vector<uint64_t> > received(p);
+			::khmxx::incremental::ialltoallv_and_modify(mode, input.data(), input.data() + input.size(), send_counts,
+					[&received](int src, uint64_t* b, uint64_t* e) {
+						received[src].insert(received[src].end(), b, e);
+					}, comm);
+			for (auto & r : received) std::sort(r.begin(), r.end());
+			EXPECT_EQ(expected, received) << "mode " << static_cast<int>(mode);
+
+			// one response per query, in query order.
+			std::vector<uint64_t> results(input.size(), 0);
+			::khmxx::incremental::ialltoallv_and_query_one_to_one(mode, input.data(), input.data() + input.size(), send_counts,
+					[](int src, uint64_t* b, uint64_t* e, uint64_t* out) {
+						for (; b != e; ++b, ++out) *out = respond(*b);
+					}, results.data(), comm);
+			for (size_t i = 0; i < input.size(); ++i) EXPECT_EQ(respond(input[i]), results[i]);
+		}
+
+		// automatic picks the same mode on all ranks, even when they send different amounts.
+		::khmxx::incremental::overlap_strategy strategy(overlap_mode::automatic);
+		overlap_mode selected = strategy.select(input.size() * sizeof(uint64_t), comm);
+		EXPECT_TRUE(mxx::all_same(static_cast<int>(selected), comm));
+		EXPECT_NE(overlap_mode::automatic, selected);
+	}
+}
+
+TEST(ExchangeTest, persistent_exchange)
+{
+	mxx::comm comm;
+	int p = comm.size();
+
+	std::vector<std::vector<uint64_t> > inputs = { uneven_keys(comm), std::vector<uint64_t>() };
+
+	// slots large enough for every peer message, and too small for the uneven input, which falls back to pairwise.
+	std::vector<size_t> capacities = { 4096, 8 };
+	for (size_t capacity : capacities) {
+		::khmxx::incremental::persistent_exchange<uint64_t, uint64_t> exchange(capacity, comm);
+
+		// twice each, to restart the same requests.
+		for (int rep = 0; rep < 2; ++rep) {
+			for (auto const & keys : inputs) {
+				std::vector<size_t> send_counts;
+				std::vector<uint64_t> input = permute(keys, p, send_counts);
+				std::vector<std::vector<uint64_t> > expected = expected_by_source(input, send_counts, comm);
+
+				std::vector<std::vector<uint64_t> > received(p);
+				exchange.modify(input.data(), input.data() + input.size(), send_counts,
+						[&received](int src, uint64_t* b, uint64_t* e) {
+							received[src].insert(received[src].end(), b, e);
+						});
+				for (auto & r : received) std::sort(r.begin(), r.end());
+				EXPECT_EQ(expected, received) << "capacity " << capacity;
+
+				std::vector<uint64_t> results(input.size(), 0);
+				exchange.query_one_to_one(input.data(), input.data() + input.size(), send_counts,
+						[](int src, uint64_t* b, uint64_t* e, uint64_t* out) {
+							for (; b != e; ++b, ++out) *out = respond(*b);
+						}, results.data());
+				for (size_t i = 0; i < input.size(); ++i) EXPECT_EQ(respond(input[i]), results[i]);
+			}
+		}
+	}
+}
+
+/// k % 3 results for query k, in order.
+static void check_one_to_many(mxx::comm const & comm) {
+	int p = comm.size();
+
+	std::vector<std::vector<uint64_t> > inputs = { uneven_keys(comm), std::vector<uint64_t>() };
+	for (auto const & keys : inputs) {
+		std::vector<size_t> send_counts;
+		std::vector<uint64_t> input = permute(keys, p, send_counts);
+
+		std::vector<size_t> result_counts;
+		std::vector<uint64_t> results;
+		::khmxx::incremental::ialltoallv_and_query_one_to_many(input.data(), input.data() + input.size(), send_counts,
+				[](int src, uint64_t* b, uint64_t* e, size_t* counts, std::vector<uint64_t> & out) {
+					for (; b != e; ++b, ++counts) {
+						*counts = *b % 3;
+						for (size_t j = 0; j < *counts; ++j) out.emplace_back(respond(*b) + j);
+					}
+				}, result_counts, results, comm);
+
+		ASSERT_EQ(input.size(), result_counts.size());
+		std::vector<uint64_t> expected;
+		for (size_t i = 0; i < input.size(); ++i) {
+			EXPECT_EQ(input[i] % 3, result_counts[i]);
+			for (size_t j = 0; j < input[i] % 3; ++j) expected.emplace_back(respond(input[i]) + j);
+		}
+		EXPECT_EQ(expected, results);
+	}
+}
+
+TEST(ExchangeTest, query_one_to_many)
+{
+	mxx::comm comm;
+	check_one_to_many(comm);
+
+	// on the lower half only, so any collective on the wrong communicator would hang.
+	mxx::comm half = comm.split(comm.rank() < (comm.size() + 1) / 2);
+	if (comm.rank() < (comm.size() + 1) / 2) check_one_to_many(half);
+}
+
+TEST(ExchangeTest, sparse_query_one_to_one)
+{
+	mxx::comm comm;
+	int p = comm.size();
+
+	// a few keys per rank and none on rank 0, then none anywhere.
+	std::vector<std::vector<uint64_t> > inputs = {
+			make_keys(comm.rank() == 0 ? 0 : 3 * comm.rank(), comm.rank()), std::vector<uint64_t>() };
+	for (auto const & keys : inputs) {
+		std::vector<size_t> send_counts;
+		std::vector<uint64_t> input = permute(keys, p, send_counts);
+
+		// back to back with different tags and different answers.  a rank still in the first call's barrier
+		// must not answer the second call's queries with the first call's compute.
+		std::vector<uint64_t> first(input.size(), 0), second(input.size(), 0);
+		::khmxx::incremental::sparse_query_one_to_one(input.data(), send_counts,
+				[](int src, uint64_t* b, uint64_t* e, uint64_t* out) {
+					for (; b != e; ++b, ++out) *out = respond(*b);
+				}, first.data(), comm, 1821);
+		::khmxx::incremental::sparse_query_one_to_one(input.data(), send_counts,
+				[](int src, uint64_t* b, uint64_t* e, uint64_t* out) {
+					for (; b != e; ++b, ++out) *out = ~(*b);
+				}, second.data(), comm, 1831);
+
+		for (size_t i = 0; i < input.size(); ++i) {
+			EXPECT_EQ(respond(input[i]), first[i]);
+			EXPECT_EQ(~input[i], second[i]);
+		}
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	::testing::InitGoogleTest(&argc, argv);
+	mxx::env e(argc, argv);
+
+	int result = RUN_ALL_TESTS();
+	return result;
+}
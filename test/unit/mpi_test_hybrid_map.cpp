@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// hybrid counting maps with MT_ENDPOINTS:  every thread exchanges on its own communicator, and inserts without
+// estimate into tables reserved from the per thread hlls.  run with MPI_THREAD_MULTIPLE, and more than 1 omp thread.
+#define MT_ENDPOINTS
+
+// include google test
+#include <gtest/gtest.h>
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+
+#include "dist_map_test_utils.hpp"
+#include "kmerhash/hybrid_batched_robinhood_map.hpp"
+#include "kmerhash/hybrid_batched_radixsort_map.hpp"
+
+#include <cstdint>  // uint64_t
+#include <cstdio>  // printf
+#include <vector>
+#include <map>
+#include <algorithm>
+
+
+template <typename Map>
+class HybridMapTest : public ::testing::Test {};
+
+using HybridMapTypes = ::testing::Types<
+		::hsc::counting_batched_robinhood_map<KmerType, uint32_t, MapParams>,
+		::hsc::counting_batched_radixsort_map<KmerType, uint32_t, MapParams> >;
+TYPED_TEST_CASE(HybridMapTest, HybridMapTypes);
+
+
+TYPED_TEST(HybridMapTest, count_mt_endpoints)
+{
+	mxx::comm comm;
+
+	// uneven input, and none on rank 0.
+	std::vector<KmerType> kmers = make_kmers(comm.rank() == 0 ? 0 : 3000 * comm.rank(), comm.rank(), true);
+
+	std::map<KmerType, uint32_t> counts;
+	for (auto const & k : mxx::allgatherv(kmers, comm)) ++counts[k];
+	std::vector<std::pair<KmerType, uint32_t> > expected(counts.begin(), counts.end());
+
+	TypeParam map(comm);
+	std::vector<KmerType> input = kmers;
+	map.insert(input);
+	EXPECT_TRUE(expected == gather_sorted(map, comm));
+
+	// again, the tables grow from the estimate.
+	input = kmers;
+	map.insert(input);
+	for (auto & kv : expected) kv.second <<= 1;
+	EXPECT_TRUE(expected == gather_sorted(map, comm));
+
+	// all inserted keys are found, in any order.
+	std::vector<KmerType> query = kmers;
+	auto found = map.count(query);
+	EXPECT_EQ(found.size(), kmers.size());
+	for (auto const & f : found) EXPECT_EQ(static_cast<size_t>(f), 1UL);
+}
+
+
+int main(int argc, char* argv[]) {
+	::testing::InitGoogleTest(&argc, argv);
+
+	// the per thread exchange needs MPI_THREAD_MULTIPLE, which mxx::env does not request.
+	int provided;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+	if (provided < MPI_THREAD_MULTIPLE) {
+		mxx::comm comm;
+		if (comm.rank() == 0) printf("MPI_THREAD_MULTIPLE not available.  the maps exchange from 1 thread.\n");
+	}
+
+	int result = RUN_ALL_TESTS();
+	MPI_Finalize();
+	return result;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// range partitioned counting map:  splitter sampling, sorted output and range queries.
+#define SPLITTER_PARTITION
+
+// include google test
+#include <gtest/gtest.h>
+
+#include <mxx/env.hpp>
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+
+#include "dist_map_test_utils.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <algorithm>
+
+
+/// all entries of the map, globally sorted by the splitters, on every rank.
+static std::vector<std::pair<KmerType, uint32_t> > gather_range_sorted(MapType const & map, mxx::comm const & comm) {
+	std::vector<std::pair<KmerType, uint32_t> > local;
+	map.to_sorted_vector(local);
+	return mxx::allgatherv(local, comm);
+}
+
+
+TEST(SplitterMapTest, resample_small_first_op)
+{
+	mxx::comm comm;
+	MapType map(comm);
+
+	// a tiny query first.  too few samples to fix the splitters.
+	std::vector<KmerType> probe = make_kmers(1, comm.rank() + 100);
+	map.find(probe);
+
+	std::vector<KmerType> kmers = make_kmers(20000, comm.rank());
+	map.insert(kmers);
+	std::vector<KmerType> splitters = map.get_splitters();
+	EXPECT_EQ(splitters.size(), static_cast<size_t>(comm.size() - 1));
+
+	// balanced by the insert's sample, not the probe's.
+	size_t local = map.local_size();
+	size_t largest = mxx::allreduce(local, mxx::max<size_t>(), comm);
+	size_t total = mxx::allreduce(local, comm);
+	EXPECT_LE(largest, 2 * total / comm.size() + 64);
+
+	// entries pin the splitters.
+	std::vector<KmerType> more = make_kmers(1000, comm.rank() + 1000);
+	map.insert(more);
+	EXPECT_TRUE(splitters == map.get_splitters());
+}
+
+TEST(SplitterMapTest, sorted_snapshot)
+{
+	mxx::comm comm;
+	MapType map(comm);
+
+	std::vector<KmerType> kmers = make_kmers(5000, comm.rank(), true);
+	map.insert(kmers);
+
+	// globally sorted, and the same when taken again without a change.
+	std::vector<std::pair<KmerType, uint32_t> > first = gather_range_sorted(map, comm);
+	for (size_t i = 1; i < first.size(); ++i) EXPECT_TRUE(first[i - 1].first < first[i].first);
+	std::vector<std::pair<KmerType, uint32_t> > second = gather_range_sorted(map, comm);
+	EXPECT_TRUE(first == second);
+
+	// [first, last) returns all but the last entry.
+	std::vector<std::pair<KmerType, KmerType> > ranges;
+	if (comm.rank() == 0 && first.size() > 1) ranges.emplace_back(first.front().first, first.back().first);
+	std::vector<std::pair<KmerType, uint32_t> > results;
+	map.find_range(ranges, results);
+	if (comm.rank() == 0) EXPECT_EQ(results.size(), first.size() - 1);
+
+	// a change is visible to the next snapshot and range query.
+	kmers = make_kmers(5000, comm.rank(), true);
+	map.insert(kmers);
+	std::vector<std::pair<KmerType, uint32_t> > third = gather_range_sorted(map, comm);
+	ASSERT_EQ(third.size(), first.size());
+	for (size_t i = 0; i < third.size(); ++i) EXPECT_EQ(third[i].second, 2 * first[i].second);
+
+	results.clear();
+	map.find_range(ranges, results);
+	if (comm.rank() == 0)
+		for (size_t i = 0; i < results.size(); ++i) EXPECT_EQ(results[i].second, third[i].second);
+}
+
+
+int main(int argc, char* argv[]) {
+	::testing::InitGoogleTest(&argc, argv);
+	mxx::env e(argc, argv);
+
+	int result = RUN_ALL_TESTS();
+	return result;
+}
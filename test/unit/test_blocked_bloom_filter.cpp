@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/blocked_bloom_filter.hpp"
+
+#include <random>
+#include <cstdint>  // uint64_t
+#include <vector>
+
+
+/*
+ * test class holding some information.
+ */
+class BlockedBloomFilterTest : public ::testing::Test
+{
+  protected:
+    ::std::vector<uint64_t> present;
+    ::std::vector<uint64_t> absent;
+
+    size_t iters = 100000;
+
+    virtual void SetUp()
+    { // sequential keys, as hash values often are not well mixed.
+      for (size_t i = 0; i < iters; ++i) {
+        present.emplace_back(i * 2);
+        absent.emplace_back(i * 2 + 1);
+      }
+    }
+};
+
+TEST_F(BlockedBloomFilterTest, no_false_negatives)
+{
+	::fsc::blocked_bloom_filter filter;
+	EXPECT_FALSE(filter.active());
+
+	filter.resize(this->iters, 10.0);
+	EXPECT_TRUE(filter.active());
+	EXPECT_EQ(filter.probes(), 7UL);
+
+	for (auto h : this->present) filter.insert(h);
+	for (auto h : this->present) EXPECT_TRUE(filter.contains(h));
+
+	// about 1% at 10 bits per key.  blocking costs a little.
+	size_t fp = 0;
+	for (auto h : this->absent) fp += filter.contains(h) ? 1 : 0;
+	EXPECT_LT(fp, this->iters / 50);
+
+	filter.reset();
+	EXPECT_FALSE(filter.active());
+}
+
+TEST_F(BlockedBloomFilterTest, combine)
+{
+	// two halves OR-ed together answer like one filter of all.
+	::fsc::blocked_bloom_filter lo(this->iters, 10.0), hi(this->iters, 10.0), all(this->iters, 10.0);
+	for (size_t i = 0; i < this->iters; ++i) {
+		((i < this->iters / 2) ? lo : hi).insert(this->present[i]);
+		all.insert(this->present[i]);
+	}
+	ASSERT_EQ(lo.word_count(), hi.word_count());
+	for (size_t i = 0; i < lo.word_count(); ++i) lo.data()[i] |= hi.data()[i];
+
+	for (size_t i = 0; i < lo.word_count(); ++i) EXPECT_EQ(lo.data()[i], all.data()[i]);
+	for (auto h : this->present) EXPECT_TRUE(lo.contains(h));
+}
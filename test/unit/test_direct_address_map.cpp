@@ -0,0 +1,203 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/direct_address_map.hpp"
+
+#include <unordered_map>
+#include <random>
+#include <algorithm>  // for sort.
+#include <cstdint>  // uint16_t
+#include <utility>  // pair
+#include <vector>
+
+#include "utils/filter_utils.hpp"
+#include "common/kmer.hpp"
+#include "common/alphabets.hpp"
+
+
+/*
+ * test class holding some information.  Also, needed for the typed tests
+ */
+template<typename T>
+class DirectAddressCountingTest : public ::testing::Test
+{
+    static_assert(std::is_integral<T>::value, "only supporting integral types in tests right now.");
+  protected:
+
+    using MAP = ::fsc::direct_address_counting_map<T, uint32_t>;
+    using value_type = ::std::pair<T, uint32_t>;
+
+    ::std::unordered_map<T, uint32_t> gold;
+    ::std::vector<T> keys;
+    ::std::vector<T> queries;
+
+    size_t iters = 100000;
+
+    virtual void SetUp()
+    { // generate some inputs, with lots of duplicates.
+      std::default_random_engine generator;
+      std::uniform_int_distribution<T> distribution(0, 4000);
+
+      for (size_t i=0; i< iters; ++i) {
+        T key = distribution(generator);
+        ++gold[key];
+        keys.emplace_back(key);
+      }
+      for (size_t i = 0; i < 5000; ++i) {
+    	  queries.emplace_back(i);
+      }
+    }
+
+    ::std::vector<value_type> sorted(::std::vector<value_type> vals) {
+    	::std::sort(vals.begin(), vals.end());
+    	return vals;
+    }
+
+    void check_counts(MAP const & test) {
+    	::std::vector<value_type > test_vals(sorted(test.to_vector()));
+    	::std::vector<value_type > gold_vals(sorted(::std::vector<value_type>(this->gold.begin(), this->gold.end())));
+
+    	EXPECT_EQ(test.size(), gold_vals.size());
+    	ASSERT_EQ(test_vals.size(), gold_vals.size());
+    	EXPECT_TRUE(::std::equal(test_vals.begin(), test_vals.end(), gold_vals.begin()));
+
+    	// iterator should visit the same entries.
+    	::std::vector<value_type > iter_vals(test.cbegin(), test.cend());
+    	EXPECT_TRUE(::std::equal(iter_vals.begin(), iter_vals.end(), test_vals.begin()));
+    }
+};
+
+// indicate this is a typed test
+TYPED_TEST_CASE_P(DirectAddressCountingTest);
+
+TYPED_TEST_P(DirectAddressCountingTest, insert)
+{
+	typename TestFixture::MAP test;
+	test.insert_no_estimate(this->keys.data(), this->keys.data() + this->keys.size(), 1);
+	this->check_counts(test);
+
+	// count pairs.  insert again should double.
+	::std::vector<typename TestFixture::value_type> pairs(this->gold.begin(), this->gold.end());
+	test.insert(pairs);
+	for (auto & g : this->gold) g.second <<= 1;
+	this->check_counts(test);
+}
+
+TYPED_TEST_P(DirectAddressCountingTest, find_count_erase)
+{
+	using T = TypeParam;
+	typename TestFixture::MAP test;
+	test.insert(this->keys, 1);
+
+	::std::vector<uint8_t> counts(this->queries.size());
+	size_t cnt = test.count(counts.data(), this->queries.data(), this->queries.data() + this->queries.size(),
+			::bliss::filter::TruePredicate(), ::bliss::filter::TruePredicate());
+	::std::vector<uint32_t> found(this->queries.size());
+	size_t fcnt = test.find(found.data(), this->queries.data(), this->queries.data() + this->queries.size(), 0,
+			::bliss::filter::TruePredicate(), ::bliss::filter::TruePredicate());
+	EXPECT_EQ(cnt, this->gold.size());
+	EXPECT_EQ(fcnt, this->gold.size());
+	for (size_t i = 0; i < this->queries.size(); ++i) {
+		auto it = this->gold.find(this->queries[i]);
+		EXPECT_EQ(counts[i], (it == this->gold.end()) ? 0 : 1);
+		EXPECT_EQ(found[i], (it == this->gold.end()) ? 0 : it->second);
+	}
+
+	// erase the even keys.
+	::std::vector<T> evens;
+	for (size_t i = 0; i < this->queries.size(); i += 2) evens.emplace_back(this->queries[i]);
+	size_t erased = test.erase(evens.data(), evens.data() + evens.size(),
+			::bliss::filter::TruePredicate(), ::bliss::filter::TruePredicate());
+	size_t gold_erased = 0;
+	for (auto k : evens) gold_erased += this->gold.erase(k);
+	EXPECT_EQ(erased, gold_erased);
+	this->check_counts(test);
+
+	test.clear();
+	EXPECT_EQ(test.size(), 0UL);
+	EXPECT_TRUE(test.cbegin() == test.cend());
+}
+
+TYPED_TEST_P(DirectAddressCountingTest, copy_after_move)
+{
+	typename TestFixture::MAP test;
+	test.insert(this->keys, 1);
+
+	// assigning into, and from, a moved-from table.
+	typename TestFixture::MAP moved(std::move(test));
+	this->check_counts(moved);
+
+	test = moved;
+	this->check_counts(test);
+
+	typename TestFixture::MAP empty(std::move(moved));
+	typename TestFixture::MAP other(empty);
+	other = moved;
+	EXPECT_EQ(other.size(), 0UL);
+	EXPECT_TRUE(other.cbegin() == other.cend());
+}
+
+
+REGISTER_TYPED_TEST_CASE_P(DirectAddressCountingTest, insert, find_count_erase, copy_after_move);
+
+typedef ::testing::Types<uint16_t, int16_t> DirectAddressCountingTestTypes;
+INSTANTIATE_TYPED_TEST_CASE_P(Bliss, DirectAddressCountingTest, DirectAddressCountingTestTypes);
+
+
+TEST(DirectAddressKmerTest, count_kmers)
+{
+	using KMER = ::bliss::common::Kmer<10, ::bliss::common::DNA, uint64_t>;
+	using MAP = ::fsc::direct_address_counting_map<KMER, uint32_t>;
+
+	EXPECT_EQ(MAP::table_size, 1UL << 20);
+
+	// kmers of a random read, packed bits as the gold key.
+	std::default_random_engine generator;
+	std::uniform_int_distribution<unsigned int> distribution(0, 3);
+	::std::unordered_map<uint64_t, uint32_t> gold;
+	::std::vector<KMER> kmers;
+	KMER kmer;
+	for (size_t i = 0; i < KMER::size - 1; ++i) kmer.nextFromChar(distribution(generator));
+	for (size_t i = 0; i < 100000; ++i) {
+		kmer.nextFromChar(distribution(generator));
+		kmers.emplace_back(kmer);
+		++gold[kmer.getData()[0]];
+	}
+
+	MAP test;
+	test.insert(kmers, 1);
+	EXPECT_EQ(test.size(), gold.size());
+
+	// keys come back out of the index.
+	::std::vector<::std::pair<KMER, uint32_t> > vals = test.to_vector();
+	ASSERT_EQ(vals.size(), gold.size());
+	for (auto const & v : vals) {
+		auto it = gold.find(v.first.getData()[0]);
+		ASSERT_TRUE(it != gold.end());
+		EXPECT_EQ(v.second, it->second);
+	}
+
+	::std::vector<uint32_t> found(kmers.size());
+	size_t fcnt = test.find(found.data(), kmers.data(), kmers.data() + kmers.size(), 0,
+			::bliss::filter::TruePredicate(), ::bliss::filter::TruePredicate());
+	EXPECT_EQ(fcnt, kmers.size());
+	for (size_t i = 0; i < kmers.size(); ++i) {
+		EXPECT_EQ(found[i], gold[kmers[i].getData()[0]]);
+	}
+}
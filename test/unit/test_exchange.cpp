@@ -0,0 +1,151 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// the exchanges of the distributed maps on thread_comm ranks, driven the way the counting map's
+// insert and count drive them:  bucket by owner, exchange and insert, then exchange, count and respond.
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/thread_comm.hpp"
+#include "kmerhash/exchange.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <atomic>
+#include <numeric>  // accumulate
+
+
+class ExchangeTest : public ::testing::TestWithParam<int> {};
+
+
+/// keys of one rank.  every other one is from a small set shared by all ranks, so counts are > 1.
+static std::vector<uint64_t> make_keys(size_t count, int rank) {
+	std::default_random_engine generator(rank);
+	std::uniform_int_distribution<uint64_t> wide(0, 1UL << 40);
+	std::uniform_int_distribution<uint64_t> hot(0, 63);
+
+	std::vector<uint64_t> keys(count);
+	for (size_t i = 0; i < count; ++i) keys[i] = (i & 1) ? wide(generator) : hot(generator);
+	return keys;
+}
+
+static inline int owner(uint64_t const & k, int const & p) {
+	return static_cast<int>((k * 0x9E3779B97F4A7C15ULL >> 32) % p);
+}
+
+/// group the keys by owner rank.
+static std::vector<uint64_t> permute(std::vector<uint64_t> const & keys, int const & p, std::vector<size_t> & send_counts) {
+	send_counts.assign(p, 0);
+	for (auto k : keys) ++send_counts[owner(k, p)];
+	std::vector<size_t> offsets(p, 0);
+	for (int i = 1; i < p; ++i) offsets[i] = offsets[i - 1] + send_counts[i - 1];
+	std::vector<uint64_t> permuted(keys.size());
+	for (auto k : keys) permuted[offsets[owner(k, p)]++] = k;
+	return permuted;
+}
+
+
+TEST_P(ExchangeTest, count_and_query)
+{
+	int p = GetParam();
+	size_t const count = 3000;
+
+	// the global counts, from every rank's input.
+	std::unordered_map<uint64_t, uint32_t> expected;
+	for (int i = 0; i < p; ++i)
+		for (auto k : make_keys(count, i)) ++expected[k];
+
+	std::atomic<int> errors(0);
+	::khmxx::thread_comm::run(p, [&errors, &expected, count](::khmxx::thread_comm const & comm) {
+		int p = comm.size();
+		int r = comm.rank();
+
+		std::vector<size_t> send_counts;
+		std::vector<uint64_t> input = permute(make_keys(count, r), p, send_counts);
+
+		// insert:  each owner counts the keys it receives.
+		std::unordered_map<uint64_t, uint32_t> local;
+		::khmxx::incremental::ialltoallv_and_modify(input.data(), input.data() + input.size(), send_counts,
+				[&local, &errors, p, r](int src, uint64_t* b, uint64_t* e) {
+					for (; b != e; ++b) {
+						if (owner(*b, p) != r) ++errors;
+						++local[*b];
+					}
+				}, comm);
+
+		// count:  one response per query, in query order.
+		std::vector<uint32_t> results(input.size(), 0);
+		::khmxx::incremental::ialltoallv_and_query_one_to_one(input.data(), input.data() + input.size(), send_counts,
+				[&local](int src, uint64_t* b, uint64_t* e, uint32_t* out) {
+					for (; b != e; ++b, ++out) {
+						auto it = local.find(*b);
+						*out = (it == local.end()) ? 0 : it->second;
+					}
+				}, results.data(), comm);
+		for (size_t i = 0; i < input.size(); ++i)
+			if (results[i] != expected.at(input[i])) ++errors;
+
+		// the blocking exchange delivers the same keys to the same owners.
+		std::vector<size_t> recv_counts(p);
+		comm.all2all(send_counts.data(), 1, recv_counts.data());
+		std::vector<uint64_t> distributed(std::accumulate(recv_counts.begin(), recv_counts.end(), static_cast<size_t>(0)));
+		::khmxx::distribute_permuted(input.data(), input.data() + input.size(), send_counts,
+				distributed.data(), recv_counts, comm);
+		std::unordered_map<uint64_t, uint32_t> again;
+		for (auto k : distributed) ++again[k];
+		if (again != local) ++errors;
+
+		// owned counts are global counts.
+		for (auto const & kv : local)
+			if (kv.second != expected.at(kv.first)) ++errors;
+	});
+	EXPECT_EQ(errors.load(), 0);
+}
+
+TEST_P(ExchangeTest, uneven_input)
+{
+	// rank 0 has no input, and all ranks empty is a no-op.
+	std::atomic<int> errors(0);
+	::khmxx::thread_comm::run(GetParam(), [&errors](::khmxx::thread_comm const & comm) {
+		int p = comm.size();
+		int r = comm.rank();
+
+		std::vector<size_t> send_counts;
+		std::vector<uint64_t> input = permute(make_keys(r == 0 ? 0 : 100 * r, r), p, send_counts);
+
+		size_t received = 0;
+		::khmxx::incremental::ialltoallv_and_modify(input.data(), input.data() + input.size(), send_counts,
+				[&received](int src, uint64_t* b, uint64_t* e) { received += (e - b); }, comm);
+		if (comm.allreduce(received, std::plus<size_t>()) != static_cast<size_t>(50 * p * (p - 1))) ++errors;
+
+		std::vector<uint64_t> echoed(input.size(), 0);
+		::khmxx::incremental::ialltoallv_and_query_one_to_one(input.data(), input.data() + input.size(), send_counts,
+				[](int src, uint64_t* b, uint64_t* e, uint64_t* out) { for (; b != e; ++b, ++out) *out = *b; },
+				echoed.data(), comm);
+		if (echoed != input) ++errors;
+
+		std::vector<size_t> none(p, 0);
+		int calls = 0;
+		::khmxx::incremental::ialltoallv_and_modify(input.data(), input.data(), none,
+				[&calls](int src, uint64_t* b, uint64_t* e) { ++calls; }, comm);
+		if (calls != 0) ++errors;
+	});
+	EXPECT_EQ(errors.load(), 0);
+}
+
+INSTANTIATE_TEST_CASE_P(Bliss, ExchangeTest, ::testing::Values(1, 2, 3, 4, 7));
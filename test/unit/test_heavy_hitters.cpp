@@ -0,0 +1,90 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/heavy_hitters.hpp"
+
+#include <unordered_map>
+#include <random>
+#include <algorithm>  // for sort.
+#include <cstdint>  // uint64_t
+#include <vector>
+
+
+/*
+ * test class holding some information.  Also, needed for the typed tests
+ */
+template<typename T>
+class SpaceSavingTest : public ::testing::Test
+{
+    static_assert(std::is_integral<T>::value, "only supporting integral types in tests right now.");
+  protected:
+
+    ::std::unordered_map<T, size_t> gold;
+    ::std::vector<T> keys;
+
+    size_t iters = 200000;
+
+    virtual void SetUp()
+    { // a few very frequent keys in a lot of uniform noise.
+      std::default_random_engine generator;
+      std::uniform_int_distribution<T> distribution(100, 100000);
+
+      for (size_t i=0; i< iters; ++i) {
+        T key = ((i % 4) == 0) ? static_cast<T>(i % 40) : distribution(generator);   // 10 keys with 1/40 each.
+        ++gold[key];
+        keys.emplace_back(key);
+      }
+    }
+};
+
+// indicate this is a typed test
+TYPED_TEST_CASE_P(SpaceSavingTest);
+
+TYPED_TEST_P(SpaceSavingTest, finds_heavy)
+{
+	::fsc::space_saving<TypeParam> sketch(256);
+	sketch.update(this->keys.begin(), this->keys.end());
+	EXPECT_EQ(sketch.size(), this->iters);
+
+	// every key above n / capacity has to be there.
+	size_t threshold = this->iters / 256;
+	::std::vector<TypeParam> heavy = sketch.heavy(threshold);
+	for (auto const & g : this->gold) {
+		if (g.second > threshold) {
+			EXPECT_TRUE(::std::find(heavy.begin(), heavy.end(), g.first) != heavy.end());
+		}
+	}
+
+	// counts are upper bounds, off by at most error.
+	for (auto const & c : sketch.counters()) {
+		size_t actual = this->gold[c.key];
+		EXPECT_GE(c.count, actual);
+		EXPECT_LE(c.count - c.error, actual);
+	}
+
+	sketch.clear();
+	EXPECT_EQ(sketch.size(), 0UL);
+	EXPECT_EQ(sketch.heavy(0).size(), 0UL);
+}
+
+
+REGISTER_TYPED_TEST_CASE_P(SpaceSavingTest, finds_heavy);
+
+typedef ::testing::Types<uint32_t, uint64_t> SpaceSavingTestTypes;
+INSTANTIATE_TYPED_TEST_CASE_P(Bliss, SpaceSavingTest, SpaceSavingTestTypes);
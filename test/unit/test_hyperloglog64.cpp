@@ -302,6 +302,64 @@ TYPED_TEST_P(HyperLogLog64Test, merge){
 
 }
 
+// batch (simd) register update should produce the same registers as the scalar one.
+TYPED_TEST_P(HyperLogLog64Test, batch_matches_scalar){
+
+    using HLL = hyperloglog64<
+    		typename TypeParam::Type,
+    		typename TypeParam::Hash,
+			TypeParam::precision>;
+	HLL lhll(TypeParam::ignore);
+	typename TypeParam::Hash hash;
+
+	this->hll.clear();
+	lhll.clear();
+
+	std::vector<typename HLL::HVT> hashes;
+	for (size_t i = 0; i < this->iterations; ++i) {
+		hashes.clear();
+		// odd sizes to exercise the remainder.
+		for (size_t s = 0; s < (this->step + i); ++s) {
+			hashes.emplace_back(hash(this->distribution(this->generator)));
+			this->hll.update_via_hashval(hashes.back());
+		}
+		lhll.update_via_hashval(hashes.data(), hashes.size());
+
+		EXPECT_EQ(this->hll.estimate(), lhll.estimate());
+	}
+	lhll.merge(this->hll);
+	EXPECT_EQ(this->hll.estimate(), lhll.estimate());
+}
+
+// sparse mode should estimate small sets well, and convert to the same registers as dense mode.
+TYPED_TEST_P(HyperLogLog64Test, sparse_matches_dense){
+
+    using HLL = hyperloglog64<
+    		typename TypeParam::Type,
+    		typename TypeParam::Hash,
+			TypeParam::precision>;
+	HLL dhll(TypeParam::ignore, TypeParam::precision, false);
+	typename TypeParam::Hash hash;
+
+	this->hll.clear();
+	this->uniq.clear();
+
+	typename HLL::HVT hv;
+	typename TypeParam::Type val;
+	for (size_t i = 0; i < this->iterations; ++i) {
+		for (size_t s = 0; s < this->step; ++s) {
+			val = this->distribution(this->generator);
+			hv = hash(val);
+			this->hll.update_via_hashval(hv);
+			dhll.update_via_hashval(hv);
+			this->uniq.insert(val);
+		}
+		if (this->hll.is_sparse()) this->report(i, this->hll, this->uniq);
+		else EXPECT_EQ(dhll.estimate(), this->hll.estimate());
+	}
+	EXPECT_FALSE(dhll.is_sparse());
+}
+
 // testing the copy constructor
 TYPED_TEST_P(HyperLogLog64Test, swap){
 
@@ -342,7 +400,9 @@ REGISTER_TYPED_TEST_CASE_P(HyperLogLog64Test,
 		estimate_by_hash,
 		merge, swap,
 		estimate_batch,
-		estimate_by_hash_batch);
+		estimate_by_hash_batch,
+		batch_matches_scalar,
+		sparse_matches_dense);
 
 //////////////////// RUN the tests with different types.
 
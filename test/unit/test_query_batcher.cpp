@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/query_batcher.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <numeric>  // iota
+#include <algorithm>  // reverse
+
+
+// a single rank.  the query answers key * 3, in reverse order, to exercise the order mapping.
+static void query(std::vector<uint64_t> & keys, uint64_t * results, std::vector<size_t> & order) {
+	order.resize(keys.size());
+	std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+	std::reverse(order.begin(), order.end());
+	for (size_t j = 0; j < keys.size(); ++j) results[j] = keys[order[j]] * 3;
+}
+
+static bool all_of(bool x) { return x; }
+
+
+TEST(QueryBatcherTest, concurrent_producers)
+{
+	::fsc::query_batcher<uint64_t, uint64_t> batcher(64, std::chrono::milliseconds(2));
+
+	std::thread driver([&batcher]() {
+		while (batcher.flush(query, all_of)) {}
+	});
+
+	constexpr size_t nthreads = 4;
+	constexpr size_t per_thread = 500;
+	std::atomic<int> errors(0);
+	std::vector<std::thread> producers;
+	for (size_t t = 0; t < nthreads; ++t) {
+		producers.emplace_back([&batcher, &errors, t]() {
+			// single keys with futures.
+			std::vector<std::future<uint64_t> > futures;
+			for (size_t i = 0; i < per_thread; ++i) futures.emplace_back(batcher.submit(t * 100000 + i));
+			for (size_t i = 0; i < per_thread; ++i)
+				if (futures[i].get() != (t * 100000 + i) * 3) ++errors;
+
+			// a group of keys with a callback.
+			std::vector<uint64_t> keys(per_thread);
+			std::iota(keys.begin(), keys.end(), t * 100000);
+			std::vector<uint64_t> results(per_thread, 0);
+			std::promise<void> all_done;
+			std::atomic<size_t> remaining(per_thread);
+			batcher.submit(keys.data(), keys.size(), [&results, &remaining, &all_done](size_t i, uint64_t const & r) {
+				results[i] = r;
+				if (--remaining == 0) all_done.set_value();
+			});
+			all_done.get_future().wait();
+			for (size_t i = 0; i < per_thread; ++i)
+				if (results[i] != keys[i] * 3) ++errors;
+		});
+	}
+	for (auto & p : producers) p.join();
+
+	batcher.close();
+	driver.join();
+
+	EXPECT_EQ(errors.load(), 0);
+	EXPECT_EQ(batcher.flushed_count(), 2 * nthreads * per_thread);
+	EXPECT_EQ(batcher.pending(), 0UL);
+	EXPECT_THROW(batcher.submit(1), std::logic_error);
+}
+
+TEST(QueryBatcherTest, idle_flush_returns)
+{
+	// an empty queue still flushes within max_delay, so an idle rank joins the collective.
+	::fsc::query_batcher<uint64_t, uint64_t> batcher(1024, std::chrono::milliseconds(1));
+	size_t calls = 0;
+	EXPECT_TRUE(batcher.flush([&calls](std::vector<uint64_t> & keys, uint64_t * results, std::vector<size_t> & order) {
+		++calls;
+		query(keys, results, order);
+	}, all_of));
+	EXPECT_EQ(calls, 1UL);
+
+	batcher.close();
+	EXPECT_FALSE(batcher.flush(query, all_of));
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/query_cache.hpp"
+
+#include <random>
+#include <functional>  // std::hash
+#include <cstdint>  // uint64_t
+#include <vector>
+
+
+/*
+ * test class holding some information.  Also, needed for the typed tests
+ */
+template<typename T>
+class QueryCacheTest : public ::testing::Test
+{
+    static_assert(std::is_integral<T>::value, "only supporting integral types in tests right now.");
+  protected:
+
+    ::std::vector<T> keys;
+
+    size_t iters = 100000;
+
+    virtual void SetUp()
+    { // a few hot keys in a lot of uniform noise.
+      std::default_random_engine generator;
+      std::uniform_int_distribution<T> distribution(100, 1000000);
+
+      for (size_t i=0; i< iters; ++i) {
+        keys.emplace_back(((i % 2) == 0) ? static_cast<T>(i % 32) : distribution(generator));
+      }
+    }
+};
+
+// indicate this is a typed test
+TYPED_TEST_CASE_P(QueryCacheTest);
+
+TYPED_TEST_P(QueryCacheTest, hot_keys_stay)
+{
+	::fsc::query_cache<TypeParam, size_t, ::std::hash<TypeParam> > cache(256);
+	EXPECT_TRUE(cache.active());
+	EXPECT_EQ(cache.capacity(), 256UL);
+
+	// read-through:  the value for a key is the key + 1.
+	size_t val;
+	for (auto k : this->keys) {
+		if (cache.find(k, 1, val)) {
+			EXPECT_EQ(val, static_cast<size_t>(k) + 1);
+		} else {
+			cache.insert(k, 1, static_cast<size_t>(k) + 1);
+		}
+	}
+	EXPECT_EQ(cache.lookup_count(), this->iters);
+	// the hot half nearly always hits.
+	EXPECT_GT(cache.hit_count(), (this->iters * 2) / 5);
+
+	// a new epoch sees nothing.
+	cache.reset_stats();
+	for (TypeParam k = 0; k < 32; ++k) EXPECT_FALSE(cache.find(k, 2, val));
+	EXPECT_EQ(cache.hit_count(), 0UL);
+
+	cache.insert(3, 2, 7);
+	EXPECT_TRUE(cache.find(3, 2, val));
+	EXPECT_EQ(val, 7UL);
+	cache.insert(3, 2, 8);
+	EXPECT_TRUE(cache.find(3, 2, val));
+	EXPECT_EQ(val, 8UL);
+
+	cache.resize(0);
+	EXPECT_FALSE(cache.active());
+}
+
+
+REGISTER_TYPED_TEST_CASE_P(QueryCacheTest, hot_keys_stay);
+
+typedef ::testing::Types<uint32_t, uint64_t> QueryCacheTestTypes;
+INSTANTIATE_TYPED_TEST_CASE_P(Bliss, QueryCacheTest, QueryCacheTestTypes);
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/splitters.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <algorithm>  // upper_bound, max_element
+#include <random>
+
+
+TEST(SplittersTest, regular_sample)
+{
+	std::vector<uint64_t> input(100);
+	for (size_t i = 0; i < input.size(); ++i) input[i] = i;
+
+	std::vector<uint64_t> samples;
+	::fsc::regular_sample(input.begin(), input.end(), 10, [&samples](uint64_t const & x) { samples.emplace_back(x); });
+	ASSERT_EQ(samples.size(), 10UL);
+	for (size_t i = 0; i < samples.size(); ++i) EXPECT_EQ(samples[i], i * 10);
+
+	// never more than the input.
+	samples.clear();
+	::fsc::regular_sample(input.begin(), input.begin() + 3, 10, [&samples](uint64_t const & x) { samples.emplace_back(x); });
+	EXPECT_EQ(samples.size(), 3UL);
+
+	samples.clear();
+	::fsc::regular_sample(input.begin(), input.begin(), 10, [&samples](uint64_t const & x) { samples.emplace_back(x); });
+	EXPECT_EQ(samples.size(), 0UL);
+}
+
+TEST(SplittersTest, empty)
+{
+	std::vector<uint64_t> samples;
+	std::vector<uint64_t> splitters(3, 1);
+	EXPECT_FALSE(::fsc::pick_splitters(samples, 4, splitters));
+	EXPECT_EQ(splitters.size(), 0UL);
+}
+
+TEST(SplittersTest, skewed_balance)
+{
+	// half the keys in a narrow band.  the splitters have to follow the keys, not the key space.
+	std::default_random_engine generator(17);
+	std::uniform_int_distribution<uint64_t> wide(0, 1UL << 40);
+	std::uniform_int_distribution<uint64_t> narrow(1000, 2000);
+	std::vector<uint64_t> keys(100000);
+	for (size_t i = 0; i < keys.size(); ++i) keys[i] = (i & 1) ? wide(generator) : narrow(generator);
+
+	size_t const buckets = 8;
+	std::vector<uint64_t> samples;
+	::fsc::regular_sample(keys.begin(), keys.end(), 16 * buckets * buckets,
+			[&samples](uint64_t const & x) { samples.emplace_back(x); });
+
+	std::vector<uint64_t> splitters;
+	ASSERT_TRUE(::fsc::pick_splitters(samples, buckets, splitters));
+	ASSERT_EQ(splitters.size(), buckets - 1);
+	EXPECT_TRUE(std::is_sorted(samples.begin(), samples.end()));
+	EXPECT_TRUE(std::is_sorted(splitters.begin(), splitters.end()));
+
+	// bucket i holds (splitters[i-1], splitters[i]].
+	std::vector<size_t> sizes(buckets, 0);
+	for (auto k : keys) ++sizes[std::lower_bound(splitters.begin(), splitters.end(), k) - splitters.begin()];
+	EXPECT_LT(*std::max_element(sizes.begin(), sizes.end()), 2 * keys.size() / buckets);
+}
+
+TEST(SplittersTest, single_bucket)
+{
+	std::vector<uint64_t> samples = {5, 3, 1};
+	std::vector<uint64_t> splitters;
+	EXPECT_TRUE(::fsc::pick_splitters(samples, 1, splitters));
+	EXPECT_EQ(splitters.size(), 0UL);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/streaming_combiner.hpp"
+
+#include <unordered_map>
+#include <random>
+#include <cstdint>  // uint64_t
+#include <utility>  // pair
+#include <vector>
+#include <algorithm>  // sort
+
+
+/*
+ * test class holding some information.  Also, needed for the typed tests
+ */
+template<typename T>
+class StreamingCombinerTest : public ::testing::Test
+{
+    static_assert(std::is_integral<T>::value, "only supporting integral types in tests right now.");
+  protected:
+
+    ::std::unordered_map<T, uint32_t> gold;
+    ::std::vector<::std::pair<T, uint32_t> > input;
+
+    size_t iters = 200000;
+
+    virtual void SetUp()
+    { // lots of duplicates, plus noise that collides in the table.
+      std::default_random_engine generator;
+      std::uniform_int_distribution<T> distribution(0, 1000000);
+
+      for (size_t i=0; i< iters; ++i) {
+        T key = ((i % 2) == 0) ? static_cast<T>(i % 100) : distribution(generator);
+        gold[key] += 1;
+        input.emplace_back(key, 1);
+      }
+    }
+};
+
+// indicate this is a typed test
+TYPED_TEST_CASE_P(StreamingCombinerTest);
+
+TYPED_TEST_P(StreamingCombinerTest, reduce_in_place)
+{
+	::fsc::streaming_combiner<TypeParam, uint32_t, ::std::hash<TypeParam> > comb(16 * 1024);
+	EXPECT_EQ(comb.capacity() & (comb.capacity() - 1), 0UL);
+
+	size_t j = 0;
+	auto emit = [this, &j](TypeParam const & k, uint32_t const & v) {
+		this->input[j].first = k;
+		this->input[j].second = v;
+		++j;
+	};
+	for (size_t i = 0; i < this->input.size(); ++i) {
+		comb.absorb(this->input[i].first, this->input[i].second, emit);
+		EXPECT_LE(j, i);
+	}
+	comb.flush(emit);
+	this->input.resize(j);
+
+	EXPECT_EQ(comb.absorbed_count(), this->iters);
+	EXPECT_EQ(comb.absorbed_count() - comb.hit_count(), this->input.size());
+	EXPECT_LT(this->input.size(), this->iters);
+
+	// partial reduction:  counts per key still add up.
+	::std::unordered_map<TypeParam, uint32_t> result;
+	for (auto const & x : this->input) result[x.first] += x.second;
+	EXPECT_EQ(result, this->gold);
+
+	// flush empties the table.
+	j = 0;
+	comb.flush(emit);
+	EXPECT_EQ(j, 0UL);
+}
+
+TYPED_TEST_P(StreamingCombinerTest, combine_keys)
+{
+	// the counting map's combine path:  singletons stay keys, repeats become (key, count).
+	::std::vector<TypeParam> keys;
+	for (auto const & x : this->input) keys.emplace_back(x.first);
+
+	::fsc::streaming_combiner<TypeParam, uint32_t, ::std::hash<TypeParam> > comb(16 * 1024);
+	::std::vector<::std::pair<TypeParam, uint32_t> > counts;
+	EXPECT_TRUE(::fsc::combine_keys(comb, keys, counts, 1024));
+	EXPECT_LT(keys.size() + counts.size(), this->iters);
+
+	::std::unordered_map<TypeParam, uint32_t> result;
+	for (auto const & k : keys) result[k] += 1;
+	for (auto const & x : counts) {
+		EXPECT_GT(x.second, 1U);
+		result[x.first] += x.second;
+	}
+	EXPECT_EQ(result, this->gold);
+
+	// unique input:  gives up after the probe and leaves the rest as is.
+	::std::vector<TypeParam> uniq(this->iters);
+	for (size_t i = 0; i < uniq.size(); ++i) uniq[i] = static_cast<TypeParam>(i * 7919);
+	::fsc::streaming_combiner<TypeParam, uint32_t, ::std::hash<TypeParam> > comb2(16 * 1024);
+	counts.clear();
+	EXPECT_FALSE(::fsc::combine_keys(comb2, uniq, counts, 1024));
+	EXPECT_EQ(comb2.absorbed_count(), 1024UL);
+	EXPECT_EQ(uniq.size(), this->iters);
+	EXPECT_TRUE(counts.empty());
+	::std::sort(uniq.begin(), uniq.end());
+	for (size_t i = 0; i < uniq.size(); ++i) EXPECT_EQ(uniq[i], static_cast<TypeParam>(i * 7919));
+}
+
+
+REGISTER_TYPED_TEST_CASE_P(StreamingCombinerTest, reduce_in_place, combine_keys);
+
+typedef ::testing::Types<uint32_t, uint64_t> StreamingCombinerTestTypes;
+INSTANTIATE_TYPED_TEST_CASE_P(Bliss, StreamingCombinerTest, StreamingCombinerTestTypes);
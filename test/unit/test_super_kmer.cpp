@@ -0,0 +1,138 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/super_kmer.hpp"
+
+#include <random>
+#include <cstdint>  // uint64_t
+#include <vector>
+
+#include "common/kmer.hpp"
+#include "common/alphabets.hpp"
+
+
+/*
+ * test class holding some information.  Also, needed for the typed tests
+ */
+template<typename T>
+class SuperKmerTest : public ::testing::Test
+{
+  protected:
+    static constexpr unsigned int minimizer_length = 11;
+
+    ::std::vector<T> kmers;
+    ::std::vector<uint32_t> ranks;
+
+    size_t nranks = 7;
+
+    virtual void SetUp()
+    { // kmers from a few reads, in read order.
+      std::default_random_engine generator;
+      std::uniform_int_distribution<unsigned int> distribution(0, T::KmerAlphabet::SIZE - 1);
+
+      ::fsc::minimizer_hash<T, minimizer_length> mh;
+
+      for (size_t r = 0; r < 20; ++r) {
+        T kmer;
+        for (size_t i = 0; i < T::size - 1; ++i) kmer.nextFromChar(distribution(generator));
+        for (size_t i = 0; i < 500; ++i) {
+          kmer.nextFromChar(distribution(generator));
+          kmers.emplace_back(kmer);
+          ranks.emplace_back(mh(kmer) % nranks);
+        }
+      }
+    }
+};
+
+// indicate this is a typed test
+TYPED_TEST_CASE_P(SuperKmerTest);
+
+TYPED_TEST_P(SuperKmerTest, round_trip)
+{
+	std::vector<uint8_t> encoded;
+	std::vector<size_t> byte_counts;
+	size_t runs = ::fsc::super_kmer_codec<TypeParam>::encode(this->kmers.data(), this->kmers.size(),
+			this->ranks.data(), this->nranks, encoded, byte_counts);
+
+	// consecutive kmers mostly share the minimizer.
+	EXPECT_LT(runs * 2, this->kmers.size());
+	EXPECT_LT(encoded.size() * 2, this->kmers.size() * sizeof(TypeParam));
+
+	// each rank gets its own kmers, in input order.
+	size_t offset = 0;
+	for (size_t r = 0; r < this->nranks; ++r) {
+		std::vector<TypeParam> expected;
+		for (size_t i = 0; i < this->kmers.size(); ++i) {
+			if (this->ranks[i] == r) expected.emplace_back(this->kmers[i]);
+		}
+
+		EXPECT_EQ(::fsc::super_kmer_codec<TypeParam>::count(encoded.data() + offset,
+				encoded.data() + offset + byte_counts[r]), expected.size());
+
+		std::vector<TypeParam> decoded;
+		::fsc::super_kmer_codec<TypeParam>::decode(encoded.data() + offset,
+				encoded.data() + offset + byte_counts[r], decoded);
+		ASSERT_EQ(decoded.size(), expected.size());
+		for (size_t i = 0; i < expected.size(); ++i) {
+			EXPECT_TRUE(decoded[i] == expected[i]);
+		}
+		offset += byte_counts[r];
+	}
+	EXPECT_EQ(offset, encoded.size());
+}
+
+TYPED_TEST_P(SuperKmerTest, minimizer_is_shared)
+{
+	// the minimizer only depends on the m-mers, so a kmer and its successor agree unless the minimum left.
+	::fsc::minimizer_hash<TypeParam, SuperKmerTest<TypeParam>::minimizer_length> mh;
+	size_t same = 0;
+	for (size_t i = 1; i < this->kmers.size(); ++i) {
+		if (mh(this->kmers[i]) == mh(this->kmers[i - 1])) ++same;
+	}
+	EXPECT_GT(same * 2, this->kmers.size());
+}
+
+TYPED_TEST_P(SuperKmerTest, canonical_minimizer)
+{
+	// a kmer and its reverse complement have the same owner, and runs of raw kmers still form.
+	::fsc::minimizer_hash<TypeParam, SuperKmerTest<TypeParam>::minimizer_length, true> mh;
+	std::vector<uint32_t> ranks;
+	for (size_t i = 0; i < this->kmers.size(); ++i) {
+		TypeParam rc = this->kmers[i].reverse_complement();
+		EXPECT_EQ(mh(this->kmers[i]), mh(rc));
+		ranks.emplace_back(mh(this->kmers[i]) % this->nranks);
+	}
+
+	std::vector<uint8_t> encoded;
+	std::vector<size_t> byte_counts;
+	size_t runs = ::fsc::super_kmer_codec<TypeParam>::encode(this->kmers.data(), this->kmers.size(),
+			ranks.data(), this->nranks, encoded, byte_counts);
+	EXPECT_LT(runs * 2, this->kmers.size());
+	EXPECT_LT(encoded.size() * 2, this->kmers.size() * sizeof(TypeParam));
+}
+
+
+REGISTER_TYPED_TEST_CASE_P(SuperKmerTest, round_trip, minimizer_is_shared, canonical_minimizer);
+
+typedef ::testing::Types<
+		::bliss::common::Kmer<21, ::bliss::common::DNA, uint64_t>,
+		::bliss::common::Kmer<31, ::bliss::common::DNA, uint64_t>,
+		::bliss::common::Kmer<31, ::bliss::common::DNA5, uint64_t>,
+		::bliss::common::Kmer<63, ::bliss::common::DNA, uint64_t> > SuperKmerTestTypes;
+INSTANTIATE_TYPED_TEST_CASE_P(Bliss, SuperKmerTest, SuperKmerTestTypes);
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/thread_comm.hpp"
+
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <atomic>
+#include <functional>  // std::plus
+#include <stdexcept>  // length_error
+
+
+class ThreadCommTest : public ::testing::TestWithParam<int> {};
+
+
+TEST_P(ThreadCommTest, all2allv)
+{
+	std::atomic<int> errors(0);
+	::khmxx::thread_comm::run(GetParam(), [&errors](::khmxx::thread_comm const & comm) {
+		int p = comm.size();
+		int r = comm.rank();
+
+		// rank r sends r + d elements to rank d, each encoding (source, dest, index).
+		std::vector<size_t> send_counts(p), recv_counts(p);
+		for (int d = 0; d < p; ++d) send_counts[d] = r + d;
+		comm.all2all(send_counts.data(), 1, recv_counts.data());
+
+		std::vector<uint64_t> send;
+		for (int d = 0; d < p; ++d)
+			for (size_t i = 0; i < send_counts[d]; ++i) send.emplace_back((r << 24) | (d << 16) | i);
+
+		size_t total = 0;
+		for (int s = 0; s < p; ++s) {
+			if (recv_counts[s] != static_cast<size_t>(s + r)) ++errors;
+			total += recv_counts[s];
+		}
+		std::vector<uint64_t> recv(total);
+		comm.all2allv(send.data(), send_counts, recv.data(), recv_counts);
+
+		size_t j = 0;
+		for (int s = 0; s < p; ++s)
+			for (size_t i = 0; i < recv_counts[s]; ++i, ++j)
+				if (recv[j] != static_cast<uint64_t>((s << 24) | (r << 16) | i)) ++errors;
+	});
+	EXPECT_EQ(errors.load(), 0);
+}
+
+TEST_P(ThreadCommTest, reductions)
+{
+	std::atomic<int> errors(0);
+	::khmxx::thread_comm::run(GetParam(), [&errors](::khmxx::thread_comm const & comm) {
+		int p = comm.size();
+		int r = comm.rank();
+		for (int it = 0; it < 20; ++it) {
+			size_t x = r + it;
+			if (comm.allreduce(x, std::plus<size_t>()) != static_cast<size_t>(p * (p - 1) / 2 + p * it)) ++errors;
+			if (comm.exscan(x, std::plus<size_t>()) != static_cast<size_t>(r * (r - 1) / 2 + r * it)) ++errors;
+		}
+	});
+	EXPECT_EQ(errors.load(), 0);
+}
+
+TEST_P(ThreadCommTest, pairwise)
+{
+	std::atomic<int> errors(0);
+	::khmxx::thread_comm::run(GetParam(), [&errors](::khmxx::thread_comm const & comm) {
+		int p = comm.size();
+		int r = comm.rank();
+
+		// 2 tags per peer, received in the opposite order they are sent.
+		std::vector<uint64_t> out(2 * p), in(2 * p, 0);
+		std::vector<::khmxx::thread_comm::request> reqs;
+		for (int i = 0; i < p; ++i) {
+			out[2 * i] = r * 1000 + i;
+			out[2 * i + 1] = r * 1000 + i + 500;
+			reqs.emplace_back(comm.isend(out.data() + 2 * i, 1, i, 7));
+			reqs.emplace_back(comm.isend(out.data() + 2 * i + 1, 1, i, 8));
+		}
+		for (int i = p - 1; i >= 0; --i) {
+			reqs.emplace_back(comm.irecv(in.data() + 2 * i + 1, 1, i, 8));
+			reqs.emplace_back(comm.irecv(in.data() + 2 * i, 1, i, 7));
+		}
+		for (auto & q : reqs) q.wait();
+
+		for (int i = 0; i < p; ++i) {
+			if (in[2 * i] != static_cast<uint64_t>(i * 1000 + r)) ++errors;
+			if (in[2 * i + 1] != static_cast<uint64_t>(i * 1000 + r + 500)) ++errors;
+		}
+
+		// same source and tag arrive in send order.
+		int next = (r + 1) % p;
+		int prev = (r + p - 1) % p;
+		std::vector<uint64_t> seq(10), got(10);
+		reqs.clear();
+		for (size_t i = 0; i < seq.size(); ++i) {
+			seq[i] = i;
+			reqs.emplace_back(comm.isend(seq.data() + i, 1, next, 3));
+		}
+		for (size_t i = 0; i < got.size(); ++i) comm.recv(got.data() + i, 1, prev, 3);
+		for (auto & q : reqs) q.wait();
+		for (size_t i = 0; i < got.size(); ++i) if (got[i] != i) ++errors;
+
+		comm.barrier();
+	});
+	EXPECT_EQ(errors.load(), 0);
+}
+
+TEST_P(ThreadCommTest, truncation)
+{
+	std::atomic<int> errors(0);
+	::khmxx::thread_comm::run(GetParam(), [&errors](::khmxx::thread_comm const & comm) {
+		int p = comm.size();
+		int r = comm.rank();
+		int next = (r + 1) % p;
+		int prev = (r + p - 1) % p;
+
+		// a receive smaller than the message throws at wait, and the receive buffer is untouched.
+		std::vector<uint64_t> out(4, r), in(2, 99);
+		::khmxx::thread_comm::request s = comm.isend(out.data(), out.size(), next, 5);
+		try {
+			comm.irecv(in.data(), in.size(), prev, 5).wait();
+			++errors;
+		} catch (std::length_error const &) {
+			if (in[0] != 99 || in[1] != 99) ++errors;
+		}
+		s.wait();
+
+		// all2allv recv counts that do not match the senders' throw on every rank.
+		std::vector<size_t> send_counts(p, 1), recv_counts(p, 1);
+		recv_counts[0] = (r == p - 1) ? 2 : 1;
+		std::vector<uint64_t> send(p, r), recv(p + 1, 0);
+		try {
+			comm.all2allv(send.data(), send_counts, recv.data(), recv_counts);
+			++errors;
+		} catch (std::length_error const &) {}
+
+		comm.barrier();
+	});
+	EXPECT_EQ(errors.load(), 0);
+}
+
+INSTANTIATE_TEST_CASE_P(Bliss, ThreadCommTest, ::testing::Values(1, 2, 3, 4, 7));
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// include google test
+#include <gtest/gtest.h>
+#include "kmerhash/wide_key_equal.hpp"
+
+#include <random>
+#include <cstdint>  // uint64_t
+#include <vector>
+#include <algorithm>  // std::equal
+
+
+// minimal stand-in for a multi-word kmer.
+template <unsigned int WORDS>
+struct TestKmer {
+	using KmerWordType = uint64_t;
+	static constexpr unsigned int nWords = WORDS;
+
+	KmerWordType data[WORDS];
+
+	bool operator==(TestKmer const & other) const {
+		return ::std::equal(data, data + WORDS, other.data);
+	}
+};
+
+
+/*
+ * test class holding some information.  Also, needed for the typed tests
+ */
+template<typename T>
+class WideKeyEqualTest : public ::testing::Test
+{
+  protected:
+    ::std::vector<T> keys;
+
+    virtual void SetUp()
+    { // generate keys, then copies that differ in one word only.
+      std::default_random_engine generator;
+      std::uniform_int_distribution<uint64_t> distribution;
+
+      for (size_t i = 0; i < 1000; ++i) {
+        T key;
+        for (size_t w = 0; w < T::nWords; ++w) key.data[w] = distribution(generator);
+        keys.emplace_back(key);
+        key.data[i % T::nWords] ^= (1ULL << (i % 64));
+        keys.emplace_back(key);
+      }
+    }
+};
+
+// indicate this is a typed test
+TYPED_TEST_CASE_P(WideKeyEqualTest);
+
+TYPED_TEST_P(WideKeyEqualTest, matches_operator_eq)
+{
+	::fsc::wide_key_equal<TypeParam, ::std::equal_to<TypeParam> > eq;
+
+	for (size_t i = 0; i < this->keys.size(); ++i) {
+		for (size_t j = i; j < ::std::min(i + 4, this->keys.size()); ++j) {
+			EXPECT_EQ(eq(this->keys[i], this->keys[j]), this->keys[i] == this->keys[j]);
+		}
+	}
+}
+
+REGISTER_TYPED_TEST_CASE_P(WideKeyEqualTest, matches_operator_eq);
+
+typedef ::testing::Types<TestKmer<1>, TestKmer<2>, TestKmer<3>, TestKmer<4> > WideKeyEqualTestTypes;
+INSTANTIATE_TYPED_TEST_CASE_P(Bliss, WideKeyEqualTest, WideKeyEqualTestTypes);